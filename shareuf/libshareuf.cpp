@@ -14,6 +14,8 @@
 #include "rcConnect.h"
 #include "miscServerFunct.hpp"
 #include "generalAdmin.h"
+#include "genQuery.h"
+#include "rsGenQuery.hpp"
 
 // =-=-=-=-=-=-=-
 #include "irods_resource_plugin.hpp"
@@ -28,12 +30,45 @@
 #include "irods_hierarchy_parser.hpp"
 #include "irods_kvp_string_parser.hpp"
 
+// =-=-=-=-=-=-=-
+// shareuf includes
+#include "shareuf_open_files.hpp"
+#include "shareuf_fd_pool.hpp"
+#include "shareuf_buffer_pool.hpp"
+#include "shareuf_metrics.hpp"
+#include "shareuf_durability.hpp"
+#include "shareuf_reservations.hpp"
+#include "shareuf_vault_roots.hpp"
+#include "shareuf_tier_migrator.hpp"
+#include "shareuf_qos.hpp"
+#include "shareuf_streaming_io.hpp"
+#include "shareuf_inline_digest.hpp"
+#include "shareuf_copy_progress.hpp"
+#include "shareuf_block_diff.hpp"
+#include "shareuf_dedup.hpp"
+#include "shareuf_publish.hpp"
+#include "shareuf_event_feed.hpp"
+#include "shareuf_bulk_ingest.hpp"
+#include "shareuf_rename.hpp"
+#include "shareuf_extents.hpp"
+#include "shareuf_block_cache.hpp"
+#include "shareuf_prefetch.hpp"
+#ifdef SHAREUF_FAULT_INJECTION
+#include "shareuf_faults.hpp"
+#endif
+#include "shareuf_checksum_kernels.hpp"
+#include "shareuf_scrubber.hpp"
+
 // =-=-=-=-=-=-=-
 // stl includes
 #include <iostream>
-#include <sstream>
 #include <vector>
 #include <string>
+#include <set>
+#include <memory>
+#include <type_traits>
+#include <algorithm>
+#include <chrono>
 
 // =-=-=-=-=-=-=-
 // boost includes
@@ -81,8 +116,8 @@
 #endif
 #include <sys/stat.h>
 
+#include <stdarg.h>
 #include <string.h>
-#include <sstream>
 
 
 // =-=-=-=-=-=-=-
@@ -91,12 +126,514 @@ const std::string DEFAULT_VAULT_DIR_MODE( "default_vault_directory_mode_kw" );
 const std::string HIGH_WATER_MARK( "high_water_mark" ); // no longer used
 const std::string REQUIRED_FREE_INODES_FOR_CREATE("required_free_inodes_for_create"); // no longer used
 const std::string MINIMUM_FREE_SPACE_FOR_CREATE_IN_BYTES("minimum_free_space_for_create_in_bytes");
+const std::string FD_POOL_MAX_DESCRIPTORS("fd_pool_max_descriptors");
+const std::string EVENT_FEED_RING_RECORDS("event_feed_ring_records");
+const std::string EVENT_FEED_SOCKET("event_feed_socket");
+const std::string DURABILITY_MODE("durability_mode");
+const std::string GROUP_COMMIT_WINDOW_IN_MICROSECONDS("group_commit_window_in_microseconds");
+const std::string GROUP_COMMIT_USE_SYNCFS("group_commit_use_syncfs");
+const std::string INLINE_CHECKSUM("inline_checksum");
+const std::string ATOMIC_PUBLISH("atomic_publish");
+const std::string BUFFER_POOL_MAX_CACHED("buffer_pool_max_cached");
+const std::string BUFFER_POOL_USE_HUGETLB("buffer_pool_use_hugetlb");
+const std::string RESERVE_FREE_SPACE("reserve_free_space");
+const std::string VAULT_ROOTS("vault_roots");
+const std::string VAULT_ROOT_CHOICES("vault_root_choices");
+const std::string SMALL_OBJECT_VAULT("small_object_vault");
+const std::string SMALL_OBJECT_THRESHOLD_IN_BYTES("small_object_threshold_in_bytes");
+const std::string TIER_DEMOTE_AFTER_SECONDS("tier_demote_after_seconds");
+const std::string TIER_MIGRATE_INTERVAL_IN_SECONDS("tier_migrate_interval_in_seconds");
+const std::string TIER_MIGRATE_BYTES_PER_SECOND("tier_migrate_bytes_per_second");
+const std::string QOS_COPY_BYTES_PER_SECOND("qos_copy_bytes_per_second");
+const std::string QOS_BULK_WRITE_BYTES_PER_SECOND("qos_bulk_write_bytes_per_second");
+const std::string QOS_BULK_WRITE_THRESHOLD_IN_BYTES("qos_bulk_write_threshold_in_bytes");
+const std::string QOS_USER_BYTES_PER_SECOND("qos_user_bytes_per_second");
+const std::string QOS_COPY_IOPRIO("qos_copy_ioprio");
+const std::string DEDUP_ON_CLOSE("dedup_on_close");
+const std::string DEDUP_MIN_SIZE_IN_BYTES("dedup_min_size_in_bytes");
+const std::string DEDUP_INDEX_SLOTS("dedup_index_slots");
+const std::string DIFFERENTIAL_SYNC("differential_sync");
+const std::string DIFFERENTIAL_SYNC_BLOCK_SIZE_IN_BYTES("differential_sync_block_size_in_bytes");
+const std::string DIFFERENTIAL_SYNC_MAX_CHANGED_PERCENT("differential_sync_max_changed_percent");
+const std::string DIFFERENTIAL_SYNC_THREADS("differential_sync_threads");
+const std::string RESUMABLE_COPY_CHECKPOINT_IN_BYTES("resumable_copy_checkpoint_in_bytes");
+const std::string STREAMING_IO_MODE("streaming_io_mode");
+const std::string STREAMING_IO_THRESHOLD_IN_BYTES("streaming_io_threshold_in_bytes");
+const std::string BULK_INGEST_OBJECT_THRESHOLD("bulk_ingest_object_threshold");
+const std::string BULK_INGEST_BATCH_IN_BYTES("bulk_ingest_batch_in_bytes");
+const std::string BULK_INGEST_IDLE_SECONDS("bulk_ingest_idle_seconds");
+const std::string TRUNCATE_PUNCH_CHUNK_IN_BYTES("truncate_punch_chunk_in_bytes");
+const std::string TRUNCATE_PREALLOCATE("truncate_preallocate");
+const std::string BLOCK_CACHE_DIR("block_cache_dir");
+const std::string BLOCK_CACHE_SIZE_IN_BYTES("block_cache_size_in_bytes");
+const std::string BLOCK_CACHE_BLOCK_SIZE_IN_BYTES("block_cache_block_size_in_bytes");
+const std::string PREFETCH_WINDOW_IN_BYTES("prefetch_window_in_bytes");
+const std::string PREFETCH_CHUNK_IN_BYTES("prefetch_chunk_in_bytes");
+const std::string PREFETCH_THREADS("prefetch_threads");
+const std::string PREFETCH_MAX_MEMORY_IN_BYTES("prefetch_max_memory_in_bytes");
+const std::string PREFETCH_MIN_FILE_SIZE_IN_BYTES("prefetch_min_file_size_in_bytes");
+const std::string FAULT_INJECTION("fault_injection");
+const std::string MAINTENANCE_TASK_BUDGET_IN_MS("maintenance_task_budget_in_ms");
+const std::string REAP_TEMP_FILES_AFTER_IN_SECONDS("reap_temp_files_after_in_seconds");
+const std::string REAP_PARTIAL_COPIES_AFTER_IN_SECONDS("reap_partial_copies_after_in_seconds");
+const std::string SCRUB_ON_REBALANCE("scrub_on_rebalance");
+const std::string SCRUB_THREADS("scrub_threads");
+const std::string SCRUB_BYTES_PER_SECOND("scrub_bytes_per_second");
+const std::string SCRUB_REPORT_FILE("scrub_report_file");
+const std::string SCRUB_CHECKPOINT_FILE("scrub_checkpoint_file");
+
+// =-=-=-=-=-=-=-
+// directory under the vault root holding the plugin's own bookkeeping
+const std::string SHAREUF_STATE_DIR(".shareuf");
+
+// =-=-=-=-=-=-=-
+// settings parsed once when the resource is made, kept in the property map
+const std::string DURABILITY_OPTIONS_KW( "shareuf_durability_options_kw" );
+const std::string QOS_OPTIONS_KW( "shareuf_qos_options_kw" );
+const std::string BLOCK_CACHE_OPTIONS_KW( "shareuf_block_cache_options_kw" );
+
+// =-=-=-=-=-=-=-
+/// @brief fetch an optional tuning value from the context string, falling
+///        back to _default when it is not set or cannot be parsed
+template< typename T >
+T shareuf_get_setting(
+    irods::plugin_property_map& _prop_map,
+    const std::string&          _key,
+    const T&                    _default ) {
+    std::string value;
+    irods::error ret = _prop_map.get< std::string >( _key, value );
+    if ( !ret.ok() ) {
+        return _default;
+    }
+
+    // do sign check on string because boost::lexical_cast will wrap negative numbers around
+    if ( std::is_unsigned< T >::value && value.size() > 0 && value[0] == '-' ) {
+        rodsLog( LOG_ERROR, "shareuf_get_setting: negative value [%s] for [%s], using default", value.c_str(), _key.c_str() );
+        return _default;
+    }
+
+    try {
+        return boost::lexical_cast< T >( value );
+    } catch ( const boost::bad_lexical_cast& ) {
+        rodsLog( LOG_ERROR, "shareuf_get_setting: invalid value [%s] for [%s], using default", value.c_str(), _key.c_str() );
+        return _default;
+    }
+
+} // shareuf_get_setting
+
+template<>
+bool shareuf_get_setting< bool >(
+    irods::plugin_property_map& _prop_map,
+    const std::string&          _key,
+    const bool&                 _default ) {
+    std::string value;
+    irods::error ret = _prop_map.get< std::string >( _key, value );
+    if ( !ret.ok() ) {
+        return _default;
+    }
+
+    if ( value == "1" || value == "true" || value == "yes" || value == "on" ) {
+        return true;
+    }
+    if ( value == "0" || value == "false" || value == "no" || value == "off" ) {
+        return false;
+    }
+
+    rodsLog( LOG_ERROR, "shareuf_get_setting: invalid boolean [%s] for [%s], using default", value.c_str(), _key.c_str() );
+    return _default;
+
+} // shareuf_get_setting< bool >
+
+// =-=-=-=-=-=-=-
+/// @brief format the message of a real error into a buffer the thread
+///        reuses, valid until its next call.  expected conditions, such as
+///        ENOENT answering an existence probe, should pass no message at all.
+const char* shareuf_error_message(
+    const char* _format,
+    ... ) __attribute__( ( format( printf, 1, 2 ) ) );
+
+const char* shareuf_error_message(
+    const char* _format,
+    ... ) {
+    static thread_local char buffer[ 8192 ];
+    va_list args;
+    va_start( args, _format );
+    vsnprintf( buffer, sizeof( buffer ), _format, args );
+    va_end( args );
+    return buffer;
+
+} // shareuf_error_message
+
+// =-=-=-=-=-=-=-
+/// @brief parse the durability settings of the resource
+shareuf_durability_options shareuf_read_durability_options(
+    irods::plugin_property_map& _prop_map ) {
+    shareuf_durability_options opts;
+    std::string mode_string;
+    if ( _prop_map.get< std::string >( DURABILITY_MODE, mode_string ).ok() &&
+            !shareuf_parse_durability_mode( mode_string, opts.mode ) ) {
+        rodsLog( LOG_ERROR, "shareuf_read_durability_options: invalid durability_mode [%s]", mode_string.c_str() );
+        opts.mode = SHAREUF_DURABILITY_NONE;
+    }
+    opts.window_usec = shareuf_get_setting< unsigned >( _prop_map, GROUP_COMMIT_WINDOW_IN_MICROSECONDS, 0 );
+    opts.use_syncfs  = shareuf_get_setting< bool >( _prop_map, GROUP_COMMIT_USE_SYNCFS, false );
+    return opts;
+
+} // shareuf_read_durability_options
+
+// =-=-=-=-=-=-=-
+// defined with the path helpers below
+std::string shareuf_vault_root_of(
+    irods::plugin_property_map& _prop_map,
+    const std::string&          _path );
+
+irods::error shareuf_file_mkdir_r(
+    const std::string& path,
+    mode_t             mode );
+
+// =-=-=-=-=-=-=-
+/// @brief sync the filesystem holding _fd with a syncfs shared by the
+///        agents on the host, making the ticket file on first use.  the
+///        tickets are kept per device, as a syncfs covers only its own
+///        filesystem and a vault root may span several.
+int shareuf_shared_commit(
+    irods::plugin_property_map&       _prop_map,
+    int                               _fd,
+    const std::string&                _path,
+    const shareuf_durability_options& _opts ) {
+    struct stat sb;
+    if ( fstat( _fd, &sb ) < 0 ) {
+        return -errno;
+    }
+    std::string tickets = shareuf_vault_root_of( _prop_map, _path ) + "/" + SHAREUF_STATE_DIR + "/group_commit." +
+                          std::to_string( static_cast< unsigned long long >( sb.st_dev ) );
+    int status = shareuf_shared_syncfs( tickets, _fd, _opts.window_usec );
+    if ( -ENOENT == status ) {
+        mode_t mode = 0755;
+        _prop_map.get< mode_t >( DEFAULT_VAULT_DIR_MODE, mode );
+        if ( shareuf_file_mkdir_r( tickets.substr( 0, tickets.find_last_of( '/' ) ), mode ).ok() ) {
+            status = shareuf_shared_syncfs( tickets, _fd, _opts.window_usec );
+        }
+    }
+    return status;
+
+} // shareuf_shared_commit
+
+// =-=-=-=-=-=-=-
+/// @brief apply the resource's durability_mode to a descriptor which was
+///        written to and is about to be closed
+irods::error shareuf_make_durable(
+    irods::plugin_property_map& _prop_map,
+    int                         _fd,
+    const std::string&          _path ) {
+    shareuf_durability_options opts;
+    if ( !_prop_map.get< shareuf_durability_options >( DURABILITY_OPTIONS_KW, opts ).ok() ) {
+        opts = shareuf_read_durability_options( _prop_map );
+    }
+
+    int status = 0;
+    if ( SHAREUF_DURABILITY_FDATASYNC == opts.mode ) {
+        shareuf_latency_timer timer( "durability.commit" );
+        status = fdatasync( _fd ) < 0 ? -errno : 0;
+    }
+    else if ( SHAREUF_DURABILITY_GROUP_COMMIT == opts.mode && opts.use_syncfs ) {
+        shareuf_latency_timer timer( "durability.commit" );
+        status = shareuf_shared_commit( _prop_map, _fd, _path, opts );
+    }
+    else if ( SHAREUF_DURABILITY_GROUP_COMMIT == opts.mode ) {
+        shareuf_latency_timer timer( "durability.commit" );
+        status = shareuf_group_commit::instance().commit( _fd, opts.window_usec );
+    }
+
+    return ASSERT_ERROR( status >= 0, UNIX_FILE_CLOSE_ERR + status, "Sync error for file: \"%s\", errno = \"%s\".",
+                         _path.c_str(), strerror( -status ) );
+
+} // shareuf_make_durable
+
+// =-=-=-=-=-=-=-
+/// @brief parse the QoS settings of the resource
+shareuf_qos_options shareuf_read_qos_options(
+    irods::plugin_property_map& _prop_map ) {
+    shareuf_qos_options opts;
+    opts.class_rates[ SHAREUF_QOS_COPY ]       = shareuf_get_setting< unsigned long long >( _prop_map, QOS_COPY_BYTES_PER_SECOND, 0 );
+    opts.class_rates[ SHAREUF_QOS_BULK_WRITE ] = shareuf_get_setting< unsigned long long >( _prop_map, QOS_BULK_WRITE_BYTES_PER_SECOND, 0 );
+    opts.user_rate            = shareuf_get_setting< unsigned long long >( _prop_map, QOS_USER_BYTES_PER_SECOND, 0 );
+    opts.bulk_write_threshold = shareuf_get_setting< long long >( _prop_map, QOS_BULK_WRITE_THRESHOLD_IN_BYTES, 16 * 1024 * 1024 );
+    std::string ioprio_string;
+    if ( _prop_map.get< std::string >( QOS_COPY_IOPRIO, ioprio_string ).ok() &&
+            !shareuf_parse_ioprio_class( ioprio_string, opts.copy_ioprio ) ) {
+        rodsLog( LOG_ERROR, "shareuf_read_qos_options: invalid qos_copy_ioprio [%s]", ioprio_string.c_str() );
+        opts.copy_ioprio = SHAREUF_IOPRIO_BE;
+    }
+    return opts;
+
+} // shareuf_read_qos_options
+
+// =-=-=-=-=-=-=-
+/// @brief the QoS settings parsed when the resource was made
+shareuf_qos_options shareuf_qos_options_of(
+    irods::plugin_property_map& _prop_map ) {
+    shareuf_qos_options opts;
+    if ( !_prop_map.get< shareuf_qos_options >( QOS_OPTIONS_KW, opts ).ok() ) {
+        opts = shareuf_read_qos_options( _prop_map );
+    }
+    return opts;
+
+} // shareuf_qos_options_of
+
+// =-=-=-=-=-=-=-
+/// @brief charge _bytes of bulk traffic to the resource's QoS buckets,
+///        blocking while the class or the client user is over its rate
+void shareuf_throttle(
+    irods::plugin_property_map& _prop_map,
+    const shareuf_qos_options&  _opts,
+    shareuf_qos_class           _class,
+    const std::string&          _user,
+    unsigned long long          _bytes ) {
+    std::string vault_path;
+    if ( ( 0 == _opts.class_rates[ _class ] && 0 == _opts.user_rate ) ||
+            !_prop_map.get< std::string >( irods::RESOURCE_PATH, vault_path ).ok() ) {
+        return;
+    }
+
+    mode_t mode = 0755;
+    _prop_map.get< mode_t >( DEFAULT_VAULT_DIR_MODE, mode );
+    shareuf_qos_throttle( vault_path + "/" + SHAREUF_STATE_DIR + "/qos", mode, _class,
+                          _opts.class_rates[ _class ], _user, _opts.user_rate, _bytes );
+
+} // shareuf_throttle
+
+// =-=-=-=-=-=-=-
+/// @brief publish a change to the event feeds configured for the resource.
+///        events which cannot be delivered are counted and dropped.
+void shareuf_emit_event(
+    irods::plugin_property_map& _prop_map,
+    shareuf_event_type          _type,
+    const std::string&          _path,
+    rodsLong_t                  _size,
+    const std::string&          _detail = std::string() ) {
+    unsigned records = shareuf_get_setting< unsigned >( _prop_map, EVENT_FEED_RING_RECORDS, 0 );
+    std::string socket_path = shareuf_get_setting< std::string >( _prop_map, EVENT_FEED_SOCKET, "" );
+    if ( 0 == records && socket_path.empty() ) {
+        return;
+    }
+
+    shareuf_event event;
+    struct timespec now;
+    clock_gettime( CLOCK_REALTIME, &now );
+    event.type    = _type;
+    event.size    = _size;
+    event.time_ns = static_cast< int64_t >( now.tv_sec ) * 1000000000LL + now.tv_nsec;
+    event.path    = _path;
+    event.detail  = _detail;
+
+    std::string vault_path;
+    if ( records > 0 && _prop_map.get< std::string >( irods::RESOURCE_PATH, vault_path ).ok() ) {
+        mode_t mode = 0755;
+        _prop_map.get< mode_t >( DEFAULT_VAULT_DIR_MODE, mode );
+        std::string ring = vault_path + "/" + SHAREUF_STATE_DIR + "/events";
+        int status = shareuf_ring_append( ring, mode, records, event );
+        if ( status < 0 ) {
+            shareuf_metrics::instance().add( "events.dropped", 1 );
+            rodsLog( LOG_DEBUG, "shareuf_emit_event: cannot append to \"%s\", errno = \"%s\"", ring.c_str(), strerror( -status ) );
+        }
+    }
+    if ( !socket_path.empty() && shareuf_socket_send( socket_path, event ) < 0 ) {
+        shareuf_metrics::instance().add( "events.dropped", 1 );
+    }
+
+} // shareuf_emit_event
+
+// =-=-=-=-=-=-=-
+/// @brief parse the SSD block cache settings of the resource, the
+///        directory is left empty when there is no usable cache
+shareuf_block_cache_options shareuf_read_block_cache_options(
+    irods::plugin_property_map& _prop_map ) {
+    shareuf_block_cache_options opts;
+    opts.dir = shareuf_get_setting< std::string >( _prop_map, BLOCK_CACHE_DIR, "" );
+    if ( opts.dir.empty() ) {
+        return opts;
+    }
+    opts.size       = shareuf_get_setting< unsigned long long >( _prop_map, BLOCK_CACHE_SIZE_IN_BYTES, 1024ULL * 1024 * 1024 );
+    opts.block_size = shareuf_get_setting< unsigned >( _prop_map, BLOCK_CACHE_BLOCK_SIZE_IN_BYTES, 1024 * 1024 );
+    _prop_map.get< mode_t >( DEFAULT_VAULT_DIR_MODE, opts.dir_mode );
+    if ( 0 == opts.block_size ) {
+        opts.dir.clear();
+    }
+    return opts;
+
+} // shareuf_read_block_cache_options
+
+// =-=-=-=-=-=-=-
+/// @brief the SSD block cache parsed when the resource was made, false if
+///        none
+bool shareuf_block_cache_settings(
+    irods::plugin_property_map&  _prop_map,
+    shareuf_block_cache_options& _out ) {
+    if ( !_prop_map.get< shareuf_block_cache_options >( BLOCK_CACHE_OPTIONS_KW, _out ).ok() ) {
+        _out = shareuf_read_block_cache_options( _prop_map );
+    }
+    return !_out.dir.empty();
+
+} // shareuf_block_cache_settings
+
+// =-=-=-=-=-=-=-
+/// @brief drop the cached blocks of the file open as _fd, or at _path when
+///        _fd is negative
+void shareuf_invalidate_cached_blocks(
+    irods::plugin_property_map& _prop_map,
+    int                         _fd,
+    const std::string&          _path ) {
+    shareuf_block_cache_options opts;
+    struct stat sb;
+    if ( shareuf_block_cache_settings( _prop_map, opts ) &&
+            ( _fd >= 0 ? fstat( _fd, &sb ) : stat( _path.c_str(), &sb ) ) == 0 ) {
+        shareuf_block_cache_invalidate( opts, sb.st_dev, sb.st_ino );
+    }
+
+} // shareuf_invalidate_cached_blocks
+
+// =-=-=-=-=-=-=-
+/// @brief read plain read-only opens of the file open as _fd through the
+///        block cache, when there is one
+void shareuf_init_block_cache(
+    irods::plugin_property_map& _prop_map,
+    int                         _fd,
+    shareuf_open_file&          _of ) {
+    shareuf_block_cache_options opts;
+    if ( ( _of.flags & ( O_ACCMODE | O_CREAT | O_TRUNC | O_APPEND ) ) == O_RDONLY && _of.publish_path.empty() &&
+            shareuf_block_cache_settings( _prop_map, opts ) ) {
+        _of.cached = shareuf_block_file_of( _fd, _of.cache_file ) == 0;
+    }
+
+} // shareuf_init_block_cache
+
+// =-=-=-=-=-=-=-
+/// @brief read ahead plain read-only opens of large files, when enabled
+void shareuf_init_prefetch(
+    irods::plugin_property_map& _prop_map,
+    int                         _fd,
+    shareuf_open_file&          _of ) {
+    shareuf_prefetch_options opts;
+    opts.window = shareuf_get_setting< size_t >( _prop_map, PREFETCH_WINDOW_IN_BYTES, 0 );
+    if ( 0 == opts.window || ( _of.flags & ( O_ACCMODE | O_CREAT | O_TRUNC | O_APPEND ) ) != O_RDONLY || !_of.publish_path.empty() ) {
+        return;
+    }
+    struct stat sb;
+    if ( fstat( _fd, &sb ) < 0 || sb.st_size < shareuf_get_setting< off_t >( _prop_map, PREFETCH_MIN_FILE_SIZE_IN_BYTES, 64 * 1024 * 1024 ) ) {
+        return;
+    }
+    opts.chunk      = shareuf_get_setting< size_t >( _prop_map, PREFETCH_CHUNK_IN_BYTES, 4 * 1024 * 1024 );
+    opts.threads    = shareuf_get_setting< unsigned >( _prop_map, PREFETCH_THREADS, 4 );
+    opts.max_memory = shareuf_get_setting< size_t >( _prop_map, PREFETCH_MAX_MEMORY_IN_BYTES, 256 * 1024 * 1024 );
+    _of.prefetch    = shareuf_prefetch_start( _fd, _of.offset, sb.st_size, opts );
+
+} // shareuf_init_prefetch
+
+// =-=-=-=-=-=-=-
+/// @brief record the read-ahead of a call in the metrics
+void shareuf_count_prefetch(
+    const shareuf_prefetch_io& _io ) {
+    if ( _io.used > 0 ) {
+        shareuf_metrics::instance().add( "prefetch.used_bytes", _io.used );
+    }
+    if ( _io.wasted > 0 ) {
+        shareuf_metrics::instance().add( "prefetch.wasted_bytes", _io.wasted );
+    }
+    if ( _io.waits > 0 ) {
+        shareuf_metrics::instance().add( "prefetch.waits", _io.waits );
+    }
+
+} // shareuf_count_prefetch
+
+// =-=-=-=-=-=-=-
+/// @brief apply the faults injected into _op by the SHAREUF_FAULTS
+///        environment variable, or else the fault_injection setting, in
+///        builds with SHAREUF_FAULT_INJECTION only.  an injected error is
+///        returned as _code - errno, _len may come back shorter.
+irods::error shareuf_inject_fault(
+    irods::plugin_context& _ctx,
+    const char*            _op,
+    int                    _code,
+    int*                   _len = 0 ) {
+#ifdef SHAREUF_FAULT_INJECTION
+    const char* env  = getenv( "SHAREUF_FAULTS" );
+    std::string spec = env ? env : shareuf_get_setting< std::string >( _ctx.prop_map(), FAULT_INJECTION, "" );
+    if ( shareuf_faults::instance().configure( spec ) < 0 ) {
+        return ERROR( SYS_INVALID_INPUT_PARAM, "shareuf_inject_fault - invalid fault injection spec [" + spec + "]" );
+    }
+
+    shareuf_fault_io io;
+    size_t len    = _len ? *_len : 0;
+    int    status = shareuf_faults::instance().inject( _op, _len ? &len : 0, io );
+    if ( io.delay_us > 0 ) {
+        shareuf_metrics::instance().add( "faults.delay_us", io.delay_us );
+    }
+    if ( io.shortened ) {
+        *_len = len;
+        shareuf_metrics::instance().add( "faults.short_io", 1 );
+    }
+    if ( status < 0 ) {
+        shareuf_metrics::instance().add( "faults.errors", 1 );
+        return ERROR( _code + status, shareuf_error_message( "Injected fault in %s, errno = \"%s\".", _op, strerror( -status ) ) );
+    }
+#else
+    ( void )_ctx;
+    ( void )_op;
+    ( void )_code;
+    ( void )_len;
+#endif
+    return SUCCESS();
+
+} // shareuf_inject_fault
+
+// =-=-=-=-=-=-=-
+/// @brief name of the client user an operation is performed for
+std::string shareuf_client_user(
+    irods::plugin_context& _ctx ) {
+    return _ctx.comm() ? std::string( _ctx.comm()->clientUser.userName ) : std::string();
+
+} // shareuf_client_user
+
+// =-=-=-=-=-=-=-
+/// @brief the streaming_io_mode to use for a transfer of _size bytes, which
+///        is buffered below streaming_io_threshold_in_bytes
+shareuf_streaming_mode shareuf_get_streaming_mode(
+    irods::plugin_property_map& _prop_map,
+    rodsLong_t                  _size ) {
+    std::string mode_string;
+    irods::error ret = _prop_map.get< std::string >( STREAMING_IO_MODE, mode_string );
+    if ( !ret.ok() ||
+            _size < shareuf_get_setting< rodsLong_t >( _prop_map, STREAMING_IO_THRESHOLD_IN_BYTES, 64 * 1024 * 1024 ) ) {
+        return SHAREUF_STREAMING_BUFFERED;
+    }
+
+    shareuf_streaming_mode mode = SHAREUF_STREAMING_BUFFERED;
+    if ( !shareuf_parse_streaming_mode( mode_string, mode ) ) {
+        rodsLog( LOG_ERROR, "shareuf_get_streaming_mode: invalid streaming_io_mode [%s]", mode_string.c_str() );
+    }
+    return mode;
+
+} // shareuf_get_streaming_mode
+
+// =-=-=-=-=-=-=-
+/// @brief arm a writable descriptor so its writes switch to the streaming
+///        mode once the stream passes the threshold
+void shareuf_init_streaming(
+    irods::plugin_property_map& _prop_map,
+    shareuf_open_file&          _of ) {
+    _of.streaming_threshold = shareuf_get_setting< rodsLong_t >( _prop_map, STREAMING_IO_THRESHOLD_IN_BYTES, 64 * 1024 * 1024 );
+    _of.streaming           = shareuf_get_streaming_mode( _prop_map, _of.streaming_threshold );
+
+} // shareuf_init_streaming
 
 // =-=-=-=-=-=-=-
 // NOTE: All storage resources must do this on the physical path stored in the file object and then update
 //       the file object's physical path with the full path
 
 static irods::error shareuf_file_copy(
+    irods::plugin_property_map& _prop_map,
+    const std::string& _client_user,
     int mode,
     const char* srcFileName,
     const char* destFileName ) {
@@ -106,31 +643,51 @@ static irods::error shareuf_file_copy(
     int inFd = open( srcFileName, O_RDONLY, 0 );
     int err_status = UNIX_FILE_OPEN_ERR - errno;
     if ( inFd < 0 ) {
-        std::stringstream msg_stream;
-        msg_stream << "Open error for srcFileName \"" << srcFileName << "\", status = " << err_status;
-        result = ERROR( err_status, msg_stream.str() );
+        result = ERROR( err_status, shareuf_error_message( "Open error for srcFileName \"%s\", status = %d", srcFileName, err_status ) );
     }
     else {
         struct stat statbuf;
         int status = stat( srcFileName, &statbuf );
         err_status = errno;
         if ( status < 0 ) {
-            std::stringstream msg_stream;
-            msg_stream << "stat failed on \"" << srcFileName << "\", status: " << err_status;
-            result = ERROR( UNIX_FILE_STAT_ERR, msg_stream.str() );
+            result = ERROR( UNIX_FILE_STAT_ERR, shareuf_error_message( "stat failed on \"%s\", status: %d", srcFileName, err_status ) );
         }
         else if ( ( statbuf.st_mode & S_IFREG ) == 0 ) {
-            std::stringstream msg_stream;
-            msg_stream << "srcFileName \"" << srcFileName << "\" is not a regular file.";
-            result = ERROR( UNIX_FILE_STAT_ERR, msg_stream.str() );
+            result = ERROR( UNIX_FILE_STAT_ERR, shareuf_error_message( "srcFileName \"%s\" is not a regular file.", srcFileName ) );
         }
         else {
-            int outFd = open( destFileName, O_WRONLY | O_CREAT | O_TRUNC, mode );
+            // =-=-=-=-=-=-=-
+            // large copies may bypass or drop the page cache, falling back
+            // to buffered I/O where the filesystem has no O_DIRECT
+            shareuf_streaming_mode streaming = shareuf_get_streaming_mode( _prop_map, statbuf.st_size );
+            bool direct = SHAREUF_STREAMING_DIRECT == streaming;
+            off_t dropped = 0;
+
+            // =-=-=-=-=-=-=-
+            // copies longer than a checkpoint interval are written to a
+            // partial sibling that a retry can pick up from, and renamed
+            // into place once complete
+            rodsLong_t checkpoint = shareuf_get_setting< rodsLong_t >( _prop_map, RESUMABLE_COPY_CHECKPOINT_IN_BYTES, 0 );
+            bool resumable = checkpoint > 0 && statbuf.st_size > checkpoint;
+            std::string outPath = resumable ? shareuf_partial_path( destFileName ) : std::string( destFileName );
+
+            shareuf_fd_pool::instance().invalidate( destFileName );
+            shareuf_invalidate_cached_blocks( _prop_map, -1, destFileName );
+            int outFd = -1;
+            if ( resumable ) {
+                outFd = open( outPath.c_str(), O_RDWR | O_CREAT, mode );
+            }
+            else {
+                outFd = open( outPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | ( direct ? O_DIRECT : 0 ), mode );
+                if ( outFd < 0 && direct && EINVAL == errno ) {
+                    shareuf_metrics::instance().add( "streaming_io.direct_fallbacks", 1 );
+                    direct = false;
+                    outFd  = open( outPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, mode );
+                }
+            }
             err_status = UNIX_FILE_OPEN_ERR - errno;
             if ( outFd < 0 ) {
-                std::stringstream msg_stream;
-                msg_stream << "Open error for destFileName \"" << destFileName << "\", status = " << err_status;
-                result = ERROR( err_status, msg_stream.str() );
+                result = ERROR( err_status, shareuf_error_message( "Open error for destFileName \"%s\", status = %d", destFileName, err_status ) );
             }
             else {
                 size_t trans_buff_size;
@@ -142,17 +699,118 @@ static irods::error shareuf_file_copy(
                     return irods::error(e);
                 }
 
-                std::vector<char> myBuf( trans_buff_size );
-                int bytesRead;
-                rodsLong_t bytesCopied = 0;
-                while ( result.ok() && ( bytesRead = read( inFd, ( void * ) myBuf.data(), trans_buff_size ) ) > 0 ) {
-                    int bytesWritten = write( outFd, ( void * ) myBuf.data(), bytesRead );
-                    err_status = UNIX_FILE_WRITE_ERR - errno;
-                    if ( ( result = ASSERT_ERROR( bytesWritten > 0, err_status, "Write error for srcFileName %s, status = %d",
-                                                  destFileName, status ) ).ok() ) {
-                        bytesCopied += bytesWritten;
+                // =-=-=-=-=-=-=-
+                // hash the stream on its way through when inline checksums are on
+                std::unique_ptr< shareuf_inline_digest > digest;
+                if ( shareuf_get_setting< bool >( _prop_map, INLINE_CHECKSUM, false ) ) {
+                    digest.reset( new shareuf_inline_digest );
+                }
+
+                // =-=-=-=-=-=-=-
+                // stage through a pooled buffer so repeated copies reuse
+                // memory that is already mapped and faulted in
+                shareuf_buffer_pool& pool = shareuf_buffer_pool::instance();
+                pool.configure( shareuf_get_setting< size_t >( _prop_map, BUFFER_POOL_MAX_CACHED, 4 ),
+                                shareuf_get_setting< bool >( _prop_map, BUFFER_POOL_USE_HUGETLB, false ) );
+                shareuf_buffer_pool::buffer myBuf = pool.acquire( trans_buff_size );
+                if ( !myBuf ) {
+                    close( inFd );
+                    close( outFd );
+                    return ERROR( SYS_MALLOC_ERR, shareuf_error_message( "Failed to allocate a %zu byte transfer buffer for \"%s\"", trans_buff_size, destFileName ) );
+                }
+
+                // =-=-=-=-=-=-=-
+                // resume after the last checkpoint if the partial file still
+                // matches it, otherwise start it over
+                shareuf_chunked_copy copy;
+                copy.in_fd      = inFd;
+                copy.out_fd     = outFd;
+                copy.buf        = myBuf.data();
+                copy.len        = trans_buff_size;
+                copy.checkpoint = resumable ? checkpoint : 0;
+                if ( resumable ) {
+                    copy.progress_path = shareuf_progress_path( destFileName );
+                    int resume_status = shareuf_resume_copy( copy, statbuf, digest.get() );
+                    if ( resume_status < 0 ) {
+                        err_status = UNIX_FILE_LSEEK_ERR + resume_status;
+                        close( inFd );
+                        close( outFd );
+                        return ERROR( err_status, shareuf_error_message( "Failed to position resumed copy of \"%s\", status = %d", srcFileName, err_status ) );
+                    }
+                    if ( copy.copied > 0 ) {
+                        shareuf_metrics::instance().add( "copy.resumed_bytes", copy.copied );
+                        rodsLog( LOG_NOTICE, "shareuf_file_copy: resuming copy of \"%s\" to \"%s\" at offset %lld",
+                                 srcFileName, destFileName, static_cast< long long >( copy.copied ) );
+                    }
+                    else if ( digest ) {
+                        digest.reset( new shareuf_inline_digest );
+                    }
+                    direct = direct && 0 == copy.copied % SHAREUF_DIRECT_IO_ALIGNMENT && 0 == shareuf_set_direct( outFd, true );
+                }
+
+                bool inDirect = direct && 0 == shareuf_set_direct( inFd, true );
+
+                // =-=-=-=-=-=-=-
+                // copies are background work: lower their I/O priority and
+                // keep them within the copy bandwidth
+                shareuf_qos_options qos = shareuf_qos_options_of( _prop_map );
+                shareuf_ioprio_guard ioprio_guard( qos.copy_ioprio );
+
+                copy.read = [&]( int _fd, char* _buf, size_t _len ) {
+                    ssize_t n = shareuf_read_direct( _fd, _buf, _len, inDirect );
+                    if ( n > 0 ) {
+                        shareuf_throttle( _prop_map, qos, SHAREUF_QOS_COPY, _client_user, n );
+                    }
+                    return n;
+                };
+                copy.write = [&]( int _fd, const char* _buf, size_t _len ) {
+                    return shareuf_write_direct( _fd, _buf, _len, direct );
+                };
+                copy.on_chunk = [&]( const char* _buf, size_t _len, off_t _offset ) {
+                    if ( digest ) {
+                        digest->update( _offset, _buf, _len );
+                    }
+                    if ( SHAREUF_STREAMING_DONTNEED == streaming ) {
+                        shareuf_write_behind( outFd, dropped, _offset, _len );
+                    }
+                };
+                int copy_status = shareuf_run_copy( copy, [&]( int _status ) {
+                    rodsLog( LOG_NOTICE, "shareuf_file_copy: failed to checkpoint \"%s\", errno = \"%s\"",
+                             copy.progress_path.c_str(), strerror( -_status ) );
+                } );
+                rodsLong_t bytesCopied = copy.copied;
+                err_status = UNIX_FILE_WRITE_ERR + copy_status;
+                result = ASSERT_ERROR( copy_status >= 0, err_status, "Write error for destFileName %s, status = %d",
+                                       destFileName, err_status );
+
+                // =-=-=-=-=-=-=-
+                // a source digest still valid for its size and mtime must
+                // match what was read from it
+                shareuf_stored_digest source_digest;
+                if ( result.ok() && digest && digest->valid && bytesCopied == statbuf.st_size &&
+                        shareuf_lookup_digest( inFd, statbuf, source_digest ) &&
+                        source_digest.crc32c != digest->crc32c ) {
+                    result = ERROR( USER_CHKSUM_MISMATCH, shareuf_error_message( "Checksum mismatch copying \"%s\"", srcFileName ) );
+                }
+
+                if ( result.ok() && digest ) {
+                    int digest_status = shareuf_store_digest( outFd, *digest );
+                    if ( digest_status < 0 ) {
+                        rodsLog( LOG_NOTICE, "shareuf_file_copy: failed to store digest for \"%s\", errno = \"%s\"",
+                                 destFileName, strerror( -digest_status ) );
                     }
                 }
+                else {
+                    shareuf_drop_digest( outFd );
+                }
+
+                if ( result.ok() ) {
+                    result = ASSERT_PASS( shareuf_make_durable( _prop_map, outFd, destFileName ), "Failed to sync \"%s\".", destFileName );
+                }
+
+                if ( SHAREUF_STREAMING_DONTNEED == streaming ) {
+                    shareuf_drop_written( outFd, dropped );
+                }
 
                 close( outFd );
 
@@ -160,6 +818,21 @@ static irods::error shareuf_file_copy(
                     result = ASSERT_ERROR( bytesCopied == statbuf.st_size, SYS_COPY_LEN_ERR, "Copied size %lld does not match source size %lld of %s",
                                            bytesCopied, statbuf.st_size, srcFileName );
                 }
+
+                // =-=-=-=-=-=-=-
+                // publish a finished resumable copy; an interrupted one is
+                // kept for the retry unless what it holds is known to be wrong
+                if ( resumable && result.ok() ) {
+                    int publish_status = shareuf_publish_copy( destFileName );
+                    if ( publish_status < 0 ) {
+                        err_status = UNIX_FILE_RENAME_ERR + publish_status;
+                        result = ERROR( err_status, shareuf_error_message( "Rename error for \"%s\" to \"%s\", status = %d", outPath.c_str(), destFileName, err_status ) );
+                    }
+                }
+                else if ( resumable && ( USER_CHKSUM_MISMATCH == result.code() || SYS_COPY_LEN_ERR == result.code() ) ) {
+                    unlink( outPath.c_str() );
+                    unlink( copy.progress_path.c_str() );
+                }
             }
         }
         close( inFd );
@@ -169,6 +842,105 @@ static irods::error shareuf_file_copy(
 
 
 
+// =-=-=-=-=-=-=-
+/// @brief the roots objects are striped over, empty unless vault_roots is set
+std::vector< std::string > shareuf_vault_roots(
+    irods::plugin_property_map& _prop_map ) {
+    std::string list;
+    if ( !_prop_map.get< std::string >( VAULT_ROOTS, list ).ok() ) {
+        return std::vector< std::string >();
+    }
+    return shareuf_parse_vault_roots( list );
+
+} // shareuf_vault_roots
+
+// =-=-=-=-=-=-=-
+/// @brief root of the small object tier, empty unless small_object_vault is set
+std::string shareuf_small_object_vault(
+    irods::plugin_property_map& _prop_map ) {
+    std::string root;
+    if ( !_prop_map.get< std::string >( SMALL_OBJECT_VAULT, root ).ok() ) {
+        return std::string();
+    }
+    std::vector< std::string > roots = shareuf_parse_vault_roots( root );
+    return roots.empty() ? std::string() : roots.front();
+
+} // shareuf_small_object_vault
+
+// =-=-=-=-=-=-=-
+/// @brief the vault root holding _path: the small object tier, one of the
+///        vault_roots, or else the vault path itself
+std::string shareuf_vault_root_of(
+    irods::plugin_property_map& _prop_map,
+    const std::string&          _path ) {
+    std::vector< std::string > roots = shareuf_vault_roots( _prop_map );
+    std::string small_object_vault = shareuf_small_object_vault( _prop_map );
+    if ( !small_object_vault.empty() ) {
+        roots.insert( roots.begin(), small_object_vault );
+    }
+    std::string relative;
+    for ( size_t i = 0; i < roots.size(); ++i ) {
+        if ( shareuf_path_under( roots[ i ], _path, relative ) ) {
+            return roots[ i ];
+        }
+    }
+
+    std::string vault_path;
+    _prop_map.get< std::string >( irods::RESOURCE_PATH, vault_path );
+    return vault_path;
+
+} // shareuf_vault_root_of
+
+// =-=-=-=-=-=-=-
+/// @brief a path under the vault path that does not exist there is looked
+///        for on the small object tier, then on the vault roots in its
+///        rendezvous order, which finds an object within vault_root_choices
+///        probes unless roots were added since it was placed.  a path on
+///        the small object tier that is gone was demoted and is looked for
+///        on the vault path and roots.  _path is left alone if not found.
+void shareuf_locate_on_vault_roots(
+    irods::plugin_property_map& _prop_map,
+    std::string&                _path ) {
+    std::vector< std::string > roots = shareuf_vault_roots( _prop_map );
+    std::string small_object_vault   = shareuf_small_object_vault( _prop_map );
+    std::string vault_path;
+    if ( ( roots.empty() && small_object_vault.empty() ) ||
+            !_prop_map.get< std::string >( irods::RESOURCE_PATH, vault_path ).ok() ) {
+        return;
+    }
+
+    std::string root = shareuf_vault_root_of( _prop_map, _path );
+    std::string relative;
+    if ( ( root != vault_path && root != small_object_vault ) ||
+            !shareuf_path_under( root, _path, relative ) || relative.empty() ) {
+        return;
+    }
+
+    struct stat sb;
+    if ( 0 == lstat( _path.c_str(), &sb ) || errno != ENOENT ) {
+        return;
+    }
+
+    std::vector< std::string > candidates;
+    candidates.push_back( root == vault_path ? small_object_vault : vault_path );
+    std::vector< size_t > order = shareuf_rendezvous_order( roots, relative );
+    for ( size_t i = 0; i < order.size(); ++i ) {
+        candidates.push_back( roots[ order[ i ] ] );
+    }
+
+    for ( size_t i = 0; i < candidates.size(); ++i ) {
+        if ( candidates[ i ].empty() ) {
+            continue;
+        }
+        std::string candidate = candidates[ i ] + "/" + relative;
+        if ( 0 == lstat( candidate.c_str(), &sb ) ) {
+            _path = candidate;
+            return;
+        }
+    }
+
+} // shareuf_locate_on_vault_roots
+
 // =-=-=-=-=-=-=-
 /// @brief Generates a full path name from the partial physical path and the specified resource's vault path
 irods::error shareuf_generate_full_path(
@@ -198,9 +970,11 @@ irods::error shareuf_generate_full_path(
 } // shareuf_generate_full_path
 
 // =-=-=-=-=-=-=-
-/// @brief update the physical path in the file object
+/// @brief update the physical path in the file object, looking for it on
+///        the vault roots unless _locate is false
 irods::error shareuf_check_path(
-    irods::plugin_context& _ctx ) {
+    irods::plugin_context& _ctx,
+    bool                   _locate = true ) {
     irods::error result = SUCCESS();
 
     // =-=-=-=-=-=-=-
@@ -214,6 +988,9 @@ irods::error shareuf_check_path(
                            data_obj->physical_path(),
                            full_path );
         if ( ( result = ASSERT_PASS( ret, "Failed generating full path for object." ) ).ok() ) {
+            if ( _locate ) {
+                shareuf_locate_on_vault_roots( _ctx.prop_map(), full_path );
+            }
             data_obj->physical_path( full_path );
         }
     }
@@ -245,7 +1022,8 @@ irods::error shareuf_check_params_and_path(
 // =-=-=-=-=-=-=-
 /// @brief Checks the basic operation parameters and updates the physical path in the file object
 irods::error shareuf_check_params_and_path(
-    irods::plugin_context& _ctx ) {
+    irods::plugin_context& _ctx,
+    bool                   _locate = true ) {
 
     irods::error result = SUCCESS();
     irods::error ret;
@@ -254,7 +1032,7 @@ irods::error shareuf_check_params_and_path(
     // verify that the resc context is valid
     ret = _ctx.valid();
     if ( ( result = ASSERT_PASS( ret, "shareuf_check_params_and_path - resource context is invalid" ) ).ok() ) {
-        result = shareuf_check_path( _ctx );
+        result = shareuf_check_path( _ctx, _locate );
     }
 
     return result;
@@ -271,34 +1049,54 @@ irods::error shareuf_file_mkdir_r(
     std::size_t pos = 0;
     bool done = false;
 
-    mode_t myMask = umask( ( mode_t ) 0000 );
+    // =-=-=-=-=-=-=-
+    // during a bulk ingest directories known to exist are skipped and the
+    // per directory logging is left to the summary
+    shareuf_bulk_ingest& bulk = shareuf_bulk_ingest::instance();
+    bool bulk_active = bulk.active();
 
-            rodsLog( LOG_ERROR, "shareuf_file_mkdir_r ... " );
+    if ( !bulk_active ) {
+        rodsLog( LOG_ERROR, "shareuf_file_mkdir_r ... " );
+    }
 
     while ( !done && result.ok() ) {
         pos = path.find_first_of( '/', pos + 1 );
         if ( pos > 0 ) {
             subdir = path.substr( 0, pos );
-            int status = mkdir( subdir.c_str(), mode );
+            if ( !bulk_active || !bulk.known_directory( subdir ) ) {
+                // =-=-=-=-=-=-=-
+                // the mode is applied with chmod, the umask is process wide
+                // and other threads may be relying on it
+                int status = mkdir( subdir.c_str(), mode );
+                int errsav = errno;
+                if ( status >= 0 ) {
+                    chmod( subdir.c_str(), mode );
+                }
 
-            struct stat fStat;
-            stat( subdir.c_str(), &fStat );
-            rodsLog( LOG_NOTICE, "shareuf_file_mkdir_r '%s' made with mode %o",
-                     subdir.c_str(), fStat.st_mode );
+                if ( bulk_active ) {
+                    rodsLog( LOG_DEBUG, "shareuf_file_mkdir_r '%s' made", subdir.c_str() );
+                }
+                else {
+                    struct stat fStat;
+                    stat( subdir.c_str(), &fStat );
+                    rodsLog( LOG_NOTICE, "shareuf_file_mkdir_r '%s' made with mode %o",
+                             subdir.c_str(), fStat.st_mode );
+                }
 
-            // =-=-=-=-=-=-=-
-            // handle error cases
-            result = ASSERT_ERROR( status >= 0 || errno == EEXIST, UNIX_FILE_RENAME_ERR - errno, "mkdir error for \"%s\", errno = \"%s\", status = %d.",
-                                   subdir.c_str(), strerror( errno ), status );
+                // =-=-=-=-=-=-=-
+                // handle error cases
+                result = ASSERT_ERROR( status >= 0 || errsav == EEXIST, UNIX_FILE_RENAME_ERR - errsav, "mkdir error for \"%s\", errno = \"%s\", status = %d.",
+                                       subdir.c_str(), strerror( errsav ), status );
+                if ( result.ok() && bulk_active ) {
+                    bulk.add_directory( subdir, status >= 0 );
+                }
+            }
         }
         if ( pos == std::string::npos ) {
             done = true;
         }
     }
 
-    // reset the old mask
-    umask( ( mode_t ) myMask );
-
     return result;
 
 } // shareuf_file_mkdir_r
@@ -323,9 +1121,11 @@ irods::error shareuf_file_registered(
 
     // Check the operation parameters and update the physical path
     irods::error ret = shareuf_check_params_and_path( _ctx );
-    result = ASSERT_PASS( ret, "Invalid parameters or physical path." );
+    if ( ( result = ASSERT_PASS( ret, "Invalid parameters or physical path." ) ).ok() ) {
+        irods::file_object_ptr fco = boost::dynamic_pointer_cast< irods::file_object >( _ctx.fco() );
+        shareuf_emit_event( _ctx.prop_map(), SHAREUF_EVENT_REGISTERED, fco->physical_path(), fco->size() );
+    }
 
-    // NOOP
     return result;
 }
 
@@ -337,9 +1137,11 @@ irods::error shareuf_file_unregistered(
 
     // Check the operation parameters and update the physical path
     irods::error ret = shareuf_check_params_and_path( _ctx );
-    result = ASSERT_PASS( ret, "Invalid parameters or physical path." );
+    if ( ( result = ASSERT_PASS( ret, "Invalid parameters or physical path." ) ).ok() ) {
+        irods::file_object_ptr fco = boost::dynamic_pointer_cast< irods::file_object >( _ctx.fco() );
+        shareuf_emit_event( _ctx.prop_map(), SHAREUF_EVENT_UNREGISTERED, fco->physical_path(), fco->size() );
+    }
 
-    // NOOP
     return result;
 }
 
@@ -351,9 +1153,11 @@ irods::error shareuf_file_modified(
 
     // Check the operation parameters and update the physical path
     irods::error ret = shareuf_check_params_and_path( _ctx );
-    result = ASSERT_PASS( ret, "Invalid parameters or physical path." );
+    if ( ( result = ASSERT_PASS( ret, "Invalid parameters or physical path." ) ).ok() ) {
+        irods::file_object_ptr fco = boost::dynamic_pointer_cast< irods::file_object >( _ctx.fco() );
+        shareuf_emit_event( _ctx.prop_map(), SHAREUF_EVENT_MODIFIED, fco->physical_path(), fco->size() );
+    }
 
-    // NOOP
     return result;
 }
 
@@ -361,13 +1165,15 @@ irods::error shareuf_file_modified(
 /// @brief interface to notify of a file operation
 irods::error shareuf_file_notify(
     irods::plugin_context& _ctx,
-    const std::string* ) {
+    const std::string*     _opr ) {
     irods::error result = SUCCESS();
     // Check the operation parameters and update the physical path
     irods::error ret = shareuf_check_params_and_path( _ctx );
-    result = ASSERT_PASS( ret, "Invalid parameters or physical path." );
+    if ( ( result = ASSERT_PASS( ret, "Invalid parameters or physical path." ) ).ok() ) {
+        irods::file_object_ptr fco = boost::dynamic_pointer_cast< irods::file_object >( _ctx.fco() );
+        shareuf_emit_event( _ctx.prop_map(), SHAREUF_EVENT_NOTIFY, fco->physical_path(), fco->size(), _opr ? *_opr : std::string() );
+    }
 
-    // NOOP
     return result;
 }
 
@@ -377,6 +1183,13 @@ irods::error shareuf_file_getfs_freespace(
     irods::plugin_context& _ctx ) {
     irods::error result = SUCCESS();
 
+    // =-=-=-=-=-=-=-
+    // slow down or fail the call when faults are injected
+    irods::error fault = shareuf_inject_fault( _ctx, "freespace", UNIX_FILE_GET_FS_FREESPACE_ERR );
+    if ( !fault.ok() ) {
+        return fault;
+    }
+
     // =-=-=-=-=-=-=-
     // Check the operation parameters and update the physical path
     irods::error ret = shareuf_check_params_and_path( _ctx );
@@ -459,12 +1272,10 @@ irods::error stat_vault_path(
 
     int err = statfs( vp.string().c_str(), &_sb );
     if( err < 0 ) {
-        std::stringstream msg;
-        msg << "statfs failed for ["
-            << _path << "] errno " << errno;
+        int errsav = errno;
         return ERROR(
-                errno,
-                msg.str() );
+                errsav,
+                shareuf_error_message( "statfs failed for [%s] errno %d", _path.c_str(), errsav ) );
     }
 
     return SUCCESS();
@@ -490,8 +1301,312 @@ void warn_if_deprecated_context_string_set(irods::plugin_context& _ctx) {
     }
 }
 
-static bool replica_exceeds_resource_free_space(irods::plugin_context& _ctx, rodsLong_t _file_size) {
-    std::string resource_name;
+// =-=-=-=-=-=-=-
+/// @brief path of the free space reservation ledger of a vault root, empty
+///        when disabled
+std::string shareuf_ledger_path(
+    irods::plugin_property_map& _prop_map,
+    const std::string&          _root ) {
+    if ( _root.empty() || !shareuf_get_setting< bool >( _prop_map, RESERVE_FREE_SPACE, true ) ) {
+        return std::string();
+    }
+    return _root + "/" + SHAREUF_STATE_DIR + "/reservations";
+
+} // shareuf_ledger_path
+
+// =-=-=-=-=-=-=-
+/// @brief log the summary of a bulk ingest which has ended
+void shareuf_report_bulk_ingest(
+    const shareuf_bulk_ingest_summary& _summary ) {
+    rodsLog( LOG_NOTICE, "shareuf_bulk_ingest: ended after %lld of %lld objects, %lld directories made, %lld space reservations in %.1f seconds",
+             _summary.objects, _summary.expected, _summary.directories, _summary.refills, _summary.seconds );
+    shareuf_metrics::instance().add( "bulk_ingest.objects", _summary.objects );
+
+} // shareuf_report_bulk_ingest
+
+// =-=-=-=-=-=-=-
+/// @brief whether a bulk ingest is under way, ending it with a summary in
+///        place of the per-object logging once it is over
+bool shareuf_bulk_ingest_active() {
+    shareuf_bulk_ingest_summary summary;
+    if ( shareuf_bulk_ingest::instance().finish_if_done( summary ) ) {
+        shareuf_report_bulk_ingest( summary );
+    }
+    return shareuf_bulk_ingest::instance().active();
+
+} // shareuf_bulk_ingest_active
+
+// =-=-=-=-=-=-=-
+/// @brief take the space for a create from the batch reserved for a bulk
+///        ingest, reserving the next batch with a single free space probe
+///        once it runs out.  false when the create has to make its own
+///        reservation.
+bool shareuf_draw_from_bulk_batch(
+    irods::plugin_context& _ctx,
+    const std::string&     _path,
+    rodsLong_t             _size ) {
+    if ( !shareuf_bulk_ingest_active() ) {
+        return false;
+    }
+
+    shareuf_bulk_ingest& bulk   = shareuf_bulk_ingest::instance();
+    std::string          ledger = shareuf_ledger_path( _ctx.prop_map(), shareuf_vault_root_of( _ctx.prop_map(), _path ) );
+    int64_t              bytes  = std::max< rodsLong_t >( _size, 0 );
+    if ( bulk.draw( ledger, bytes ) ) {
+        return true;
+    }
+
+    irods::error ret = shareuf_file_getfs_freespace( _ctx );
+    if ( !ret.ok() ) {
+        return false;
+    }
+    int64_t batch = std::max< int64_t >( bytes, shareuf_get_setting< rodsLong_t >( _ctx.prop_map(), BULK_INGEST_BATCH_IN_BYTES, 1024LL * 1024 * 1024 ) );
+    batch = std::min< int64_t >( batch, ret.code() );
+    if ( batch < bytes ) {
+        return false;
+    }
+
+    // =-=-=-=-=-=-=-
+    // without a ledger the batch only spares the probes.  the remainder
+    // of the last batch goes back first, the ledger would otherwise count
+    // it against the new one.
+    bulk.drop( ledger );
+    shareuf_reservation reservation;
+    if ( !ledger.empty() && shareuf_reserve_space( ledger, batch, ret.code(), reservation ) < 0 ) {
+        return false;
+    }
+    bulk.hold( ledger, reservation, batch );
+    return bulk.draw( ledger, bytes );
+
+} // shareuf_draw_from_bulk_batch
+
+// =-=-=-=-=-=-=-
+/// @brief hold _size bytes of the _available free space for a create, failing
+///        with USER_FILE_TOO_LARGE when transfers in flight already claim it.
+///        an unusable ledger is logged and the create goes ahead unreserved.
+irods::error shareuf_reserve_for_create(
+    irods::plugin_property_map& _prop_map,
+    const std::string&          _path,
+    rodsLong_t                  _size,
+    rodsLong_t                  _available,
+    shareuf_reservation&        _out ) {
+    std::string ledger = shareuf_ledger_path( _prop_map, shareuf_vault_root_of( _prop_map, _path ) );
+    if ( _size <= 0 || ledger.empty() ) {
+        return SUCCESS();
+    }
+
+    int status = shareuf_reserve_space( ledger, _size, _available, _out );
+    if ( -ENOENT == status ) {
+        mode_t mode = 0755;
+        _prop_map.get< mode_t >( DEFAULT_VAULT_DIR_MODE, mode );
+        irods::error ret = shareuf_file_mkdir_r( ledger.substr( 0, ledger.find_last_of( '/' ) ), mode );
+        if ( ret.ok() ) {
+            status = shareuf_reserve_space( ledger, _size, _available, _out );
+        }
+    }
+
+    if ( -ENOSPC == status ) {
+        return ERROR( USER_FILE_TOO_LARGE, shareuf_error_message( "File size: %lld for \"%s\" does not fit in the %lld bytes left on device once transfers in progress are accounted for",
+                                                                  static_cast< long long >( _size ), _path.c_str(), static_cast< long long >( _available ) ) );
+    }
+    if ( status < 0 ) {
+        rodsLog( LOG_NOTICE, "shareuf_reserve_for_create: reservation ledger \"%s\" unavailable, errno = \"%s\"",
+                 ledger.c_str(), strerror( -status ) );
+    }
+    return SUCCESS();
+
+} // shareuf_reserve_for_create
+
+// =-=-=-=-=-=-=-
+/// @brief count _written bytes against a reservation.  bytes on disk show
+///        up in statfs, so what the file has allocated is handed back to
+///        the ledger in coarse steps to keep it off the per-write path.
+///        allocation rather than an offset is what counts, as the threads
+///        of a parallel transfer write different parts of the file.
+void shareuf_settle_reservation(
+    shareuf_shared_reservation& _shared,
+    int                         _fd,
+    ssize_t                     _written ) {
+    std::lock_guard< std::mutex > lock( _shared.mutex );
+    _shared.unsettled += _written;
+    if ( !_shared.reservation.active() || _shared.unsettled < 256 * 1024 * 1024 ) {
+        return;
+    }
+    _shared.unsettled = 0;
+
+    struct stat sb;
+    if ( fstat( _fd, &sb ) == 0 ) {
+        int64_t remaining = _shared.total - static_cast< int64_t >( sb.st_blocks ) * 512;
+        if ( remaining < _shared.reservation.bytes ) {
+            shareuf_update_reservation( _shared.reservation, remaining );
+        }
+    }
+
+} // shareuf_settle_reservation
+
+// =-=-=-=-=-=-=-
+/// @brief point a new object at _path, making its directory since the server
+///        only makes directories under the vault path
+irods::error shareuf_move_new_object(
+    irods::plugin_property_map& _prop_map,
+    irods::file_object_ptr      _fco,
+    const std::string&          _path ) {
+    std::string dir = _path.substr( 0, _path.find_last_of( '/' ) );
+    struct stat st;
+    if ( !shareuf_bulk_ingest::instance().known_directory( dir ) && stat( dir.c_str(), &st ) < 0 ) {
+        mode_t mode = 0755;
+        _prop_map.get< mode_t >( DEFAULT_VAULT_DIR_MODE, mode );
+        irods::error ret = shareuf_file_mkdir_r( dir, mode );
+        if ( !ret.ok() ) {
+            return PASSMSG( "Failed to make directory \"" + dir + "\".", ret );
+        }
+    }
+    shareuf_bulk_ingest::instance().add_directory( dir, false );
+
+    _fco->physical_path( _path );
+    return SUCCESS();
+
+} // shareuf_move_new_object
+
+// =-=-=-=-=-=-=-
+/// @brief move a new object from the vault path onto a vault root: the one
+///        of its vault_root_choices most preferred roots with the most free
+///        space not reserved by transfers in flight
+irods::error shareuf_place_on_vault_root(
+    irods::plugin_property_map& _prop_map,
+    irods::file_object_ptr      _fco ) {
+    std::vector< std::string > roots = shareuf_vault_roots( _prop_map );
+    std::string vault_path;
+    std::string relative;
+    if ( roots.empty() ||
+            !_prop_map.get< std::string >( irods::RESOURCE_PATH, vault_path ).ok() ||
+            shareuf_vault_root_of( _prop_map, _fco->physical_path() ) != vault_path ||
+            !shareuf_path_under( vault_path, _fco->physical_path(), relative ) || relative.empty() ) {
+        return SUCCESS();
+    }
+
+    // =-=-=-=-=-=-=-
+    // unreachable roots are passed over in favour of the next preference
+    std::vector< size_t > order = shareuf_rendezvous_order( roots, relative );
+    size_t choices = std::max< size_t >( 1, shareuf_get_setting< size_t >( _prop_map, VAULT_ROOT_CHOICES, 2 ) );
+    size_t best = roots.size();
+    rodsLong_t best_free = 0;
+    for ( size_t i = 0; i < order.size() && choices > 0; ++i ) {
+        const std::string& root = roots[ order[ i ] ];
+        struct statfs sb;
+        if ( statfs( root.c_str(), &sb ) < 0 ) {
+            rodsLog( LOG_NOTICE, "shareuf_place_on_vault_root: skipping vault root \"%s\", errno = \"%s\"",
+                     root.c_str(), strerror( errno ) );
+            continue;
+        }
+        --choices;
+
+        rodsLong_t available = static_cast< rodsLong_t >( sb.f_bavail ) * sb.f_bsize -
+                               shareuf_reserved_space( shareuf_ledger_path( _prop_map, root ) );
+        if ( best == roots.size() || available > best_free ) {
+            best      = order[ i ];
+            best_free = available;
+        }
+    }
+
+    if ( best == roots.size() ) {
+        rodsLog( LOG_ERROR, "shareuf_place_on_vault_root: no vault root is available, creating \"%s\" in the vault path",
+                 _fco->physical_path().c_str() );
+        return SUCCESS();
+    }
+
+    return shareuf_move_new_object( _prop_map, _fco, roots[ best ] + "/" + relative );
+
+} // shareuf_place_on_vault_root
+
+// =-=-=-=-=-=-=-
+/// @brief put objects announced smaller than small_object_threshold_in_bytes
+///        on the small object tier
+irods::error shareuf_place_on_small_object_tier(
+    irods::plugin_property_map& _prop_map,
+    irods::file_object_ptr      _fco ) {
+    std::string small_object_vault = shareuf_small_object_vault( _prop_map );
+    std::string vault_path;
+    std::string relative;
+    if ( small_object_vault.empty() || _fco->size() < 0 ||
+            _fco->size() >= shareuf_get_setting< rodsLong_t >( _prop_map, SMALL_OBJECT_THRESHOLD_IN_BYTES, 1024 * 1024 ) ||
+            !_prop_map.get< std::string >( irods::RESOURCE_PATH, vault_path ).ok() ||
+            shareuf_vault_root_of( _prop_map, _fco->physical_path() ) != vault_path ||
+            !shareuf_path_under( vault_path, _fco->physical_path(), relative ) || relative.empty() ) {
+        return SUCCESS();
+    }
+
+    return shareuf_move_new_object( _prop_map, _fco, small_object_vault + "/" + relative );
+
+} // shareuf_place_on_small_object_tier
+
+// =-=-=-=-=-=-=-
+/// @brief fill in the options of the tier migrator, false when
+///        tier_migrate_interval_in_seconds is not set
+bool shareuf_tier_migrator_settings(
+    irods::plugin_property_map& _prop_map,
+    shareuf_migrator_options&   _opts ) {
+    std::string small_object_vault = shareuf_small_object_vault( _prop_map );
+    time_t interval = shareuf_get_setting< time_t >( _prop_map, TIER_MIGRATE_INTERVAL_IN_SECONDS, 0 );
+    std::string vault_path;
+    if ( small_object_vault.empty() || interval <= 0 ||
+            !_prop_map.get< std::string >( irods::RESOURCE_PATH, vault_path ).ok() ) {
+        return false;
+    }
+
+    mode_t mode = 0755;
+    _prop_map.get< mode_t >( DEFAULT_VAULT_DIR_MODE, mode );
+    // =-=-=-=-=-=-=-
+    // reached on every disconnect, the state directory is only made once
+    std::string state_dir = small_object_vault + "/" + SHAREUF_STATE_DIR;
+    struct stat sb;
+    if ( stat( state_dir.c_str(), &sb ) < 0 && ( ENOENT != errno || !shareuf_file_mkdir_r( state_dir, mode ).ok() ) ) {
+        return false;
+    }
+
+    _opts.fast_root        = small_object_vault;
+    _opts.skip_dir         = state_dir;
+    _opts.state_path       = state_dir + "/tier_migrator";
+    _opts.bytes_per_second = shareuf_get_setting< unsigned long long >( _prop_map, TIER_MIGRATE_BYTES_PER_SECOND, 0 );
+    _opts.demote_after     = shareuf_get_setting< time_t >( _prop_map, TIER_DEMOTE_AFTER_SECONDS, 30 * 24 * 3600 );
+    _opts.interval         = interval;
+    _opts.dir_mode         = mode;
+
+    // =-=-=-=-=-=-=-
+    // demoted objects go where lookups probe first
+    std::vector< std::string > roots = shareuf_vault_roots( _prop_map );
+    _opts.destination = [roots, vault_path]( const std::string& _relative ) {
+        if ( roots.empty() ) {
+            return vault_path + "/" + _relative;
+        }
+        return roots[ shareuf_rendezvous_order( roots, _relative ).front() ] + "/" + _relative;
+    };
+    return true;
+
+} // shareuf_tier_migrator_settings
+
+// =-=-=-=-=-=-=-
+/// @brief run or carry on a due pass of the tier migrator at the idle I/O
+///        priority, until _opts.deadline
+void shareuf_run_tier_migration(
+    const shareuf_migrator_options& _opts ) {
+    shareuf_ioprio_guard ioprio_guard( SHAREUF_IOPRIO_IDLE );
+    shareuf_migrator_summary summary;
+    int status = shareuf_demote_cold_files( _opts, summary );
+    if ( status < 0 && status != -EWOULDBLOCK && status != -ETIMEDOUT ) {
+        rodsLog( LOG_ERROR, "shareuf tier migration of [%s] failed, errno = \"%s\"",
+                 _opts.fast_root.c_str(), strerror( -status ) );
+    }
+    else if ( summary.demoted > 0 || summary.errors > 0 ) {
+        rodsLog( LOG_NOTICE, "shareuf tier migration of [%s] files [%llu] demoted [%llu] bytes [%llu] skipped [%llu] errors [%llu]%s",
+                 _opts.fast_root.c_str(), summary.files, summary.demoted, summary.bytes,
+                 summary.skipped, summary.errors, -ETIMEDOUT == status ? " to be continued" : "" );
+    }
+
+} // shareuf_run_tier_migration
+
+static bool replica_exceeds_resource_free_space(irods::plugin_context& _ctx, rodsLong_t _file_size) {
+    std::string resource_name;
     irods::error ret = _ctx.prop_map().get<std::string>(irods::RESOURCE_NAME, resource_name);
     if (!ret.ok()) {
         rodsLog(LOG_ERROR, "replica_exceeds_resource_free_space: failed to get resource name");
@@ -545,6 +1660,24 @@ static bool replica_exceeds_resource_free_space(irods::plugin_context& _ctx, rod
         return true;
     }
 
+    // the catalog figure does not yet account for transfers still streaming to the vault
+    std::vector<std::string> ledger_roots = shareuf_vault_roots(_ctx.prop_map());
+    std::string small_object_vault = shareuf_small_object_vault(_ctx.prop_map());
+    if (!small_object_vault.empty() &&
+            std::find(ledger_roots.begin(), ledger_roots.end(), small_object_vault) == ledger_roots.end()) {
+        ledger_roots.push_back(small_object_vault);
+    }
+    std::string vault_path;
+    if (_ctx.prop_map().get<std::string>(irods::RESOURCE_PATH, vault_path).ok() &&
+            std::find(ledger_roots.begin(), ledger_roots.end(), vault_path) == ledger_roots.end()) {
+        ledger_roots.push_back(vault_path);
+    }
+    uintmax_t reserved_space = 0;
+    for (size_t i = 0; i < ledger_roots.size(); ++i) {
+        reserved_space += shareuf_reserved_space(shareuf_ledger_path(_ctx.prop_map(), ledger_roots[i]));
+    }
+    resource_free_space = reserved_space < resource_free_space ? resource_free_space - reserved_space : 0;
+
     if (minimum_free_space > resource_free_space) {
         return true;
     }
@@ -556,21 +1689,59 @@ static bool replica_exceeds_resource_free_space(irods::plugin_context& _ctx, rod
     return false;
 }
 
+// =-=-=-=-=-=-=-
+/// @brief open a new file at _path, or an unpublished one which close will
+///        link there when _unpublished, with mode 0644 whatever the umask.
+///        POSIX style, -1 with errno set.
+static int shareuf_create_file(
+    bool               _unpublished,
+    const std::string& _path,
+    std::string&       _temp ) {
+    int fd = _unpublished ? shareuf_open_unpublished( _path, 0644, _temp ) : open( _path.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644 );
+
+    // =-=-=-=-=-=-=-
+    // the mode is applied with fchmod, the umask is process wide and other
+    // threads may be relying on it
+    if ( fd >= 0 ) {
+        fchmod( fd, 0644 );
+    }
+    return fd;
+
+} // shareuf_create_file
+
 // =-=-=-=-=-=-=-
 // interface for POSIX create
 irods::error shareuf_file_create(
     irods::plugin_context& _ctx ) {
     irods::error result = SUCCESS();
 
+    // =-=-=-=-=-=-=-
+    // slow down or fail the call when faults are injected
+    irods::error fault = shareuf_inject_fault( _ctx, "create", UNIX_FILE_CREATE_ERR );
+    if ( !fault.ok() ) {
+        return fault;
+    }
+
     // =-=-=-=-=-=-=-
     // Check the operation parameters and update the physical path
-    irods::error ret = shareuf_check_params_and_path( _ctx );
+    irods::error ret = shareuf_check_params_and_path( _ctx, false );
     if ( ( result = ASSERT_PASS( ret, "Invalid parameters or physical path." ) ).ok() ) {
 
         // =-=-=-=-=-=-=-
         // get ref to fco
         irods::file_object_ptr fco = boost::dynamic_pointer_cast< irods::file_object >( _ctx.fco() );
 
+        // =-=-=-=-=-=-=-
+        // small objects go to the fast tier, the rest are striped over the
+        // vault roots
+        ret = shareuf_place_on_small_object_tier( _ctx.prop_map(), fco );
+        if ( ret.ok() ) {
+            ret = shareuf_place_on_vault_root( _ctx.prop_map(), fco );
+        }
+        if ( !ret.ok() ) {
+            return PASSMSG( "Failed to place object on a vault root.", ret );
+        }
+
         char* kvp_str = getValByKey(
                             &fco->cond_input(),
                             KEY_VALUE_PASSTHROUGH_KW );
@@ -594,60 +1765,120 @@ irods::error shareuf_file_create(
             }
         }
 
-        ret = shareuf_file_getfs_freespace( _ctx );
+        // =-=-=-=-=-=-=-
+        // a bulk ingest probes free space once per batch, not per create
+        rodsLong_t file_size = fco->size();
+        bool drawn = shareuf_draw_from_bulk_batch( _ctx, fco->physical_path(), file_size );
+        ret = drawn ? SUCCESS() : shareuf_file_getfs_freespace( _ctx );
         if ( ( result = ASSERT_PASS( ret, "Error determining freespace on system." ) ).ok() ) {
-            rodsLong_t file_size = fco->size();
-            if ( ( result = ASSERT_ERROR( file_size < 0 || ret.code() >= file_size, USER_FILE_TOO_LARGE, "File size: %ld is greater than space left on device: %ld",
-                                          file_size, ret.code() ) ).ok() ) {
+            shareuf_reservation reservation;
+            if ( ( result = ASSERT_ERROR( drawn || file_size < 0 || ret.code() >= file_size, USER_FILE_TOO_LARGE, "File size: %ld is greater than space left on device: %ld",
+                                          file_size, ret.code() ) ).ok() &&
+                    ( drawn || ( result = ASSERT_PASS( shareuf_reserve_for_create( _ctx.prop_map(), fco->physical_path(), file_size, ret.code(), reservation ),
+                                                       "Failed to reserve space for \"%s\".", fco->physical_path().c_str() ) ).ok() ) ) {
                 // =-=-=-=-=-=-=-
-                // make call to umask & open for create
-                mode_t myMask = umask( ( mode_t ) 0000 );
-                int    fd     = open( fco->physical_path().c_str(), O_RDWR | O_CREAT | O_EXCL, 0644 );
+                // make call to open for create
+                bool   unpublished = shareuf_get_setting< bool >( _ctx.prop_map(), ATOMIC_PUBLISH, false );
+                std::string temp;
+                int    fd     = shareuf_create_file( unpublished, fco->physical_path(), temp );
                 int errsav = errno;
 
-                // =-=-=-=-=-=-=-
-                // reset the old mask
-                ( void ) umask( ( mode_t ) myMask );
-
                 // =-=-=-=-=-=-=-
                 // if we got a 0 descriptor, try again
                 if ( fd == 0 ) {
 
                     close( fd );
+                    if ( !temp.empty() ) {
+                        unlink( temp.c_str() );
+                    }
                     int null_fd = open( "/dev/null", O_RDWR, 0 );
 
                     // =-=-=-=-=-=-=-
-                    // make call to umask & open for create
-                    mode_t myMask = umask( ( mode_t ) 0000 );
-                    fd = open( fco->physical_path().c_str(), O_RDWR | O_CREAT | O_EXCL, 0644 );
+                    // make call to open for create
+                    fd = shareuf_create_file( unpublished, fco->physical_path(), temp );
                     errsav = errno;
                     if ( null_fd >= 0 ) {
                         close( null_fd );
                     }
                     rodsLog( LOG_NOTICE, "shareuf_file_create_plugin: 0 descriptor" );
+                }
 
-                    // =-=-=-=-=-=-=-
-                    // reset the old mask
-                    ( void ) umask( ( mode_t ) myMask );
+                // =-=-=-=-=-=-=-
+                // out of descriptors, give back the pooled ones and try again
+                if ( fd < 0 && ( errsav == EMFILE || errsav == ENFILE ) &&
+                        shareuf_fd_pool::instance().evict( shareuf_fd_pool::instance().size() ) > 0 ) {
+                    fd = shareuf_create_file( unpublished, fco->physical_path(), temp );
+                    errsav = errno;
+                }
+
+                // =-=-=-=-=-=-=-
+                // an unpublished file is tracked until its last close
+                if ( fd >= 0 && unpublished ) {
+                    int pending_status = shareuf_pending_publishes::instance().add( fco->physical_path(), temp, fd );
+                    if ( pending_status < 0 ) {
+                        close( fd );
+                        if ( !temp.empty() ) {
+                            unlink( temp.c_str() );
+                        }
+                        fd     = -1;
+                        errsav = -pending_status;
+                    }
                 }
 
                 // =-=-=-=-=-=-=-
                 // trap error case with bad fd
                 if ( fd < 0 ) {
                     int status = UNIX_FILE_CREATE_ERR - errsav;
-                    std::stringstream msg;
-                    msg << "create error for \"";
-                    msg << fco->physical_path();
-                    msg << "\", errno = \"";
-                    msg << strerror( errsav );
-                    msg << "\".";
                     // =-=-=-=-=-=-=-
                     // WARNING :: Major Assumptions are made upstream and use the FD also as a
                     //         :: Status, if this is not done EVERYTHING BREAKS!!!!111one
                     fco->file_descriptor( status );
-                    result = ERROR( status, msg.str() );
+
+                    // =-=-=-=-=-=-=-
+                    // a missing directory is an expected answer, the server
+                    // makes it and retries, so it gets no message
+                    result = ERROR( status, ENOENT == errsav ? "" :
+                                    shareuf_error_message( "create error for \"%s\", errno = \"%s\".",
+                                                           fco->physical_path().c_str(), strerror( errsav ) ) );
+                    shareuf_release_reservation( reservation );
+                    if ( ENOENT == errsav ) {
+                        shareuf_bulk_ingest::instance().forget_directory( fco->physical_path().substr( 0, fco->physical_path().find_last_of( '/' ) ) );
+                    }
                 }
                 else {
+                    shareuf_fd_pool::instance().invalidate( fco->physical_path() );
+                    shareuf_open_file_ptr of( new shareuf_open_file( fco->physical_path(), O_RDWR | O_CREAT | O_EXCL ) );
+                    if ( reservation.active() ) {
+                        of->reservation.reset( new shareuf_shared_reservation );
+                        of->reservation->reservation = reservation;
+                        of->reservation->total       = reservation.bytes;
+                    }
+                    if ( unpublished ) {
+                        of->publish_path = fco->physical_path();
+                    }
+                    if ( shareuf_get_setting< bool >( _ctx.prop_map(), INLINE_CHECKSUM, false ) ) {
+                        of->digest.reset( new shareuf_inline_digest );
+                    }
+                    shareuf_init_streaming( _ctx.prop_map(), *of );
+                    shareuf_open_files::instance().insert( fd, of );
+
+                    // =-=-=-=-=-=-=-
+                    // an unpublished file is announced once it has a name
+                    if ( !unpublished ) {
+                        shareuf_emit_event( _ctx.prop_map(), SHAREUF_EVENT_CREATE, fco->physical_path(), 0 );
+                    }
+
+                    // =-=-=-=-=-=-=-
+                    // the first create in a directory fills the cache with it
+                    // and the directories next to it
+                    if ( drawn ) {
+                        std::string dir = fco->physical_path().substr( 0, fco->physical_path().find_last_of( '/' ) );
+                        shareuf_bulk_ingest::instance().note_object();
+                        if ( !shareuf_bulk_ingest::instance().known_directory( dir ) ) {
+                            shareuf_bulk_ingest::instance().prewarm( dir );
+                        }
+                    }
+
                     // =-=-=-=-=-=-=-
                     // cache file descriptor in out-variable
                     fco->file_descriptor( fd );
@@ -668,6 +1899,13 @@ irods::error shareuf_file_open(
     irods::plugin_context& _ctx ) {
     irods::error result = SUCCESS();
 
+    // =-=-=-=-=-=-=-
+    // slow down or fail the call when faults are injected
+    irods::error fault = shareuf_inject_fault( _ctx, "open", UNIX_FILE_OPEN_ERR );
+    if ( !fault.ok() ) {
+        return fault;
+    }
+
     // =-=-=-=-=-=-=-
     // Check the operation parameters and update the physical path
     irods::error ret = shareuf_check_params_and_path( _ctx );
@@ -711,10 +1949,40 @@ irods::error shareuf_file_open(
             flags = flags | O_TRUNC;
         }
 #endif
+        // =-=-=-=-=-=-=-
+        // plain read-only opens borrow from the descriptor pool, anything
+        // which may modify the file bypasses it and drops the pooled entry
+        // =-=-=-=-=-=-=-
+        // a file created by this agent and not yet published is reopened
+        // by its unpublished name, typically by parallel transfer threads
+        std::string open_path = fco->physical_path();
+        bool pending = shareuf_pending_publishes::instance().acquire( fco->physical_path(), open_path );
+
+        size_t pool_max = shareuf_get_setting< size_t >( _ctx.prop_map(), FD_POOL_MAX_DESCRIPTORS, 0 );
+        if ( ( flags & ( O_ACCMODE | O_CREAT | O_TRUNC | O_APPEND ) ) != O_RDONLY ) {
+            shareuf_fd_pool::instance().invalidate( fco->physical_path() );
+        }
+        else if ( pool_max > 0 && !pending ) {
+            struct stat sb;
+            int fd = shareuf_fd_pool::instance().borrow( fco->physical_path(), pool_max, sb );
+            if ( fd >= 0 ) {
+                shareuf_open_file_ptr of( new shareuf_open_file( fco->physical_path(), flags ) );
+                of->pooled = true;
+                of->size   = sb.st_size;
+                shareuf_init_block_cache( _ctx.prop_map(), fd, *of );
+                shareuf_init_prefetch( _ctx.prop_map(), fd, *of );
+                shareuf_open_files::instance().insert( fd, of );
+
+                fco->file_descriptor( fd );
+                result.code( fd );
+                return result;
+            }
+        }
+
         // =-=-=-=-=-=-=-
         // make call to open
         errno = 0;
-        int fd = open( fco->physical_path().c_str(), flags, fco->mode() );
+        int fd = open( open_path.c_str(), flags, fco->mode() );
         int errsav = errno;
 
         // =-=-=-=-=-=-=-
@@ -722,7 +1990,7 @@ irods::error shareuf_file_open(
         if ( fd == 0 ) {
             close( fd );
             int null_fd = open( "/dev/null", O_RDWR, 0 );
-            fd = open( fco->physical_path().c_str(), flags, fco->mode() );
+            fd = open( open_path.c_str(), flags, fco->mode() );
             errsav = errno;
             if ( null_fd >= 0 ) {
                 close( null_fd );
@@ -730,23 +1998,56 @@ irods::error shareuf_file_open(
             rodsLog( LOG_NOTICE, "shareuf_file_open: 0 descriptor" );
         }
 
+        // =-=-=-=-=-=-=-
+        // out of descriptors, give back the pooled ones and try again
+        if ( fd < 0 && ( errsav == EMFILE || errsav == ENFILE ) &&
+                shareuf_fd_pool::instance().evict( shareuf_fd_pool::instance().size() ) > 0 ) {
+            fd = open( open_path.c_str(), flags, fco->mode() );
+            errsav = errno;
+        }
+
         // =-=-=-=-=-=-=-
         // trap error case with bad fd
         if ( fd < 0 ) {
+            if ( pending ) {
+                bool published = false;
+                shareuf_pending_publishes::instance().release( fco->physical_path(), published );
+                if ( published ) {
+                    shareuf_emit_event( _ctx.prop_map(), SHAREUF_EVENT_CREATE, fco->physical_path(), 0 );
+                }
+            }
+            // =-=-=-=-=-=-=-
+            // a missing file is an expected answer, it gets no message
             int status = UNIX_FILE_OPEN_ERR - errsav;
-            std::stringstream msg;
-            msg << "Open error for \"";
-            msg << fco->physical_path();
-            msg << "\", errno = \"";
-            msg << strerror( errsav );
-            msg << "\", status = \"";
-            msg << status;
-            msg << "\", flags = \"";
-            msg << flags;
-            msg << "\".";
-            result = ERROR( status, msg.str() );
+            result = ERROR( status, ENOENT == errsav ? "" :
+                            shareuf_error_message( "Open error for \"%s\", errno = \"%s\", status = \"%d\", flags = \"%d\".",
+                                                   fco->physical_path().c_str(), strerror( errsav ), status, flags ) );
         }
         else {
+            shareuf_open_file_ptr of( new shareuf_open_file( fco->physical_path(), flags ) );
+            if ( pending ) {
+                of->publish_path = fco->physical_path();
+            }
+            if ( ( flags & O_ACCMODE ) != O_RDONLY ) {
+                // =-=-=-=-=-=-=-
+                // a transfer thread writing the file being created shares
+                // the space reserved for it rather than holding it twice
+                of->reservation = shareuf_open_files::instance().reservation_of( fco->physical_path() );
+
+                // =-=-=-=-=-=-=-
+                // any stored digest is about to go stale, only a truncated
+                // file can be hashed again from the first byte
+                shareuf_drop_digest( fd );
+                if ( ( flags & O_TRUNC ) && !( flags & O_APPEND ) &&
+                        shareuf_get_setting< bool >( _ctx.prop_map(), INLINE_CHECKSUM, false ) ) {
+                    of->digest.reset( new shareuf_inline_digest );
+                }
+                shareuf_init_streaming( _ctx.prop_map(), *of );
+            }
+            shareuf_init_block_cache( _ctx.prop_map(), fd, *of );
+            shareuf_init_prefetch( _ctx.prop_map(), fd, *of );
+            shareuf_open_files::instance().insert( fd, of );
+
             // =-=-=-=-=-=-=-
             // cache status in the file object
             fco->file_descriptor( fd );
@@ -768,9 +2069,16 @@ irods::error shareuf_file_read(
     int                                 _len ) {
     irods::error result = SUCCESS();
 
+    // =-=-=-=-=-=-=-
+    // slow down or fail the call when faults are injected
+    irods::error fault = shareuf_inject_fault( _ctx, "read", UNIX_FILE_READ_ERR, &_len );
+    if ( !fault.ok() ) {
+        return fault;
+    }
+
     // =-=-=-=-=-=-=-
     // Check the operation parameters and update the physical path
-    irods::error ret = shareuf_check_params_and_path( _ctx );
+    irods::error ret = shareuf_check_params_and_path( _ctx, false );
     if ( ( result = ASSERT_PASS( ret, "Invalid parameters or physical path." ) ).ok() ) {
 
         // =-=-=-=-=-=-=-
@@ -778,8 +2086,65 @@ irods::error shareuf_file_read(
         irods::file_object_ptr fco = boost::dynamic_pointer_cast< irods::file_object >( _ctx.fco() );
 
         // =-=-=-=-=-=-=-
-        // make the call to read
-        int status = read( fco->file_descriptor(), _buf, _len );
+        // serve what the read-ahead already fetched, the rest is read below
+        int status;
+        shareuf_open_file_ptr of = shareuf_open_files::instance().find( fco->file_descriptor() );
+        size_t served = 0;
+        if ( of && of->prefetch ) {
+            shareuf_prefetch_io io;
+            served      = shareuf_prefetch_read( *of->prefetch, _buf, _len, of->offset, io );
+            of->offset += served;
+            shareuf_count_prefetch( io );
+        }
+        char* buf = static_cast< char* >( _buf ) + served;
+        int   len = _len - served;
+
+        // =-=-=-=-=-=-=-
+        // make the call to read, pooled descriptors share their offset
+        // with the pool entry so they are read positionally, as are those
+        // read through the block cache or read ahead
+        shareuf_block_cache_options cache_opts;
+        if ( 0 == len ) {
+            status = 0;
+        }
+        else if ( of && of->cached && shareuf_block_cache_settings( _ctx.prop_map(), cache_opts ) ) {
+            shareuf_block_cache_io io;
+            ssize_t n = shareuf_cached_pread( cache_opts, fco->file_descriptor(), of->cache_file, buf, len, of->offset, io );
+            if ( n < 0 ) {
+                errno  = -n;
+                status = -1;
+            }
+            else {
+                status      = n;
+                of->offset += n;
+            }
+            if ( io.hits > 0 ) {
+                shareuf_metrics::instance().add( "block_cache.hits", io.hits );
+                shareuf_metrics::instance().add( "block_cache.bytes_saved", io.bytes_saved );
+            }
+            if ( io.misses > 0 ) {
+                shareuf_metrics::instance().add( "block_cache.misses", io.misses );
+            }
+        }
+        else if ( of && ( of->pooled || of->prefetch ) ) {
+            status = pread( fco->file_descriptor(), buf, len, of->offset );
+            if ( status > 0 ) {
+                of->offset += status;
+            }
+        }
+        else {
+            status = read( fco->file_descriptor(), buf, len );
+            if ( of && status > 0 ) {
+                of->offset += status;
+            }
+        }
+
+        // =-=-=-=-=-=-=-
+        // bytes already served make the read a short one, a failure
+        // shows up again on the next call
+        if ( served > 0 ) {
+            status = status < 0 ? served : status + served;
+        }
 
         // =-=-=-=-=-=-=-
         // pass along an error if it was not successful
@@ -807,9 +2172,205 @@ irods::error shareuf_file_write(
     int                                 _len ) {
     irods::error result = SUCCESS();
 
+    // =-=-=-=-=-=-=-
+    // slow down or fail the call when faults are injected
+    irods::error fault = shareuf_inject_fault( _ctx, "write", UNIX_FILE_WRITE_ERR, &_len );
+    if ( !fault.ok() ) {
+        return fault;
+    }
+
+    // =-=-=-=-=-=-=-
+    // Check the operation parameters and update the physical path
+    irods::error ret = shareuf_check_params_and_path( _ctx, false );
+    if ( ( result = ASSERT_PASS( ret, "Invalid parameters or physical path." ) ).ok() ) {
+
+        // =-=-=-=-=-=-=-
+        // get ref to fco
+        irods::file_object_ptr fco = boost::dynamic_pointer_cast< irods::file_object >( _ctx.fco() );
+
+        // =-=-=-=-=-=-=-
+        // large uploads are held to the bulk write rate, small writes and
+        // everything else pass untouched
+        shareuf_open_file_ptr of = shareuf_open_files::instance().find( fco->file_descriptor() );
+        if ( of ) {
+            shareuf_qos_options qos = shareuf_qos_options_of( _ctx.prop_map() );
+            if ( of->offset + _len >= qos.bulk_write_threshold ) {
+                shareuf_throttle( _ctx.prop_map(), qos, SHAREUF_QOS_BULK_WRITE, shareuf_client_user( _ctx ), _len );
+            }
+        }
+
+        // =-=-=-=-=-=-=-
+        // the first write through a descriptor drops the cached blocks of
+        // the file, its close drops those read meanwhile
+        if ( of && !of->cache_invalidated ) {
+            shareuf_invalidate_cached_blocks( _ctx.prop_map(), fco->file_descriptor(), fco->physical_path() );
+            of->cache_invalidated = true;
+        }
+
+        // =-=-=-=-=-=-=-
+        // a stream past the threshold goes out with O_DIRECT while its
+        // offset stays aligned, staged through an aligned pooled buffer
+        if ( of && SHAREUF_STREAMING_DIRECT == of->streaming && !of->direct &&
+                of->offset + _len >= of->streaming_threshold ) {
+            of->direct = 0 == of->offset % SHAREUF_DIRECT_IO_ALIGNMENT &&
+                         0 == shareuf_set_direct( fco->file_descriptor(), true );
+            if ( !of->direct ) {
+                of->streaming = SHAREUF_STREAMING_BUFFERED;
+            }
+        }
+
+        // =-=-=-=-=-=-=-
+        // make the call to write
+        int status;
+        if ( of && of->direct ) {
+            shareuf_buffer_pool::buffer staging = shareuf_buffer_pool::instance().acquire( _len );
+            if ( staging ) {
+                memcpy( staging.data(), _buf, _len );
+                status = shareuf_write_direct( fco->file_descriptor(), staging.data(), _len, of->direct );
+            }
+            else {
+                shareuf_set_direct( fco->file_descriptor(), false );
+                of->direct = false;
+                status = write( fco->file_descriptor(), _buf, _len );
+            }
+            if ( !of->direct ) {
+                of->streaming = SHAREUF_STREAMING_BUFFERED;
+            }
+        }
+        else {
+            status = write( fco->file_descriptor(), _buf, _len );
+        }
+
+        // =-=-=-=-=-=-=-
+        // track the offset and fold sequential writes into the inline digest
+        if ( of && status > 0 ) {
+            if ( of->digest ) {
+                of->digest->update( of->offset, _buf, status );
+            }
+            if ( SHAREUF_STREAMING_DONTNEED == of->streaming && of->offset + status >= of->streaming_threshold ) {
+                shareuf_write_behind( fco->file_descriptor(), of->dropped, of->offset, status );
+            }
+            of->offset += status;
+
+            if ( of->reservation ) {
+                shareuf_settle_reservation( *of->reservation, fco->file_descriptor(), status );
+            }
+        }
+
+        // =-=-=-=-=-=-=-
+        // pass along an error if it was not successful
+        int err_status = UNIX_FILE_WRITE_ERR - errno;
+        if ( !( result = ASSERT_ERROR( status >= 0, err_status, "Write file: \"%s\", errno = \"%s\", status = %d.",
+                                       fco->physical_path().c_str(), strerror( errno ), err_status ) ).ok() ) {
+            result.code( err_status );
+        }
+        else {
+            result.code( status );
+        }
+    }
+
+    // =-=-=-=-=-=-=-
+    // win!
+    return result;
+
+} // shareuf_file_write_plugin
+
+// =-=-=-=-=-=-=-
+/// @brief digest of a newly written file: the stored one when it is still
+///        current, otherwise computed by reading the file back
+static std::string shareuf_content_digest(
+    int                _fd,
+    const std::string& _path,
+    const struct stat& _sb ) {
+    shareuf_stored_digest stored;
+    if ( shareuf_lookup_digest( _fd, _sb, stored ) ) {
+        return stored.sha256;
+    }
+
+    int fd = open( _path.c_str(), O_RDONLY );
+    if ( fd < 0 ) {
+        return std::string();
+    }
+    shareuf_buffer_pool::buffer buf = shareuf_buffer_pool::instance().acquire( 1024 * 1024 );
+    shareuf_sha256 sha256;
+    ssize_t n = 0;
+    while ( buf && ( n = read( fd, buf.data(), buf.size() ) ) > 0 ) {
+        sha256.update( buf.data(), n );
+    }
+    close( fd );
+    if ( !buf || n < 0 ) {
+        return std::string();
+    }
+
+    unsigned char digest[ SHAREUF_SHA256_DIGEST_SIZE ];
+    sha256.final( digest );
+    return shareuf_sha256_to_irods( digest );
+
+} // shareuf_content_digest
+
+// =-=-=-=-=-=-=-
+/// @brief share the extents of a newly written file with an identical one
+///        already in the vault's content index, or index it.  failures
+///        only cost the space saving and are logged.
+static void shareuf_dedup_on_close(
+    irods::plugin_property_map& _prop_map,
+    int                         _fd,
+    const std::string&          _path ) {
+    struct stat sb;
+    if ( fstat( _fd, &sb ) < 0 ||
+            sb.st_size < shareuf_get_setting< rodsLong_t >( _prop_map, DEDUP_MIN_SIZE_IN_BYTES, 1024 * 1024 ) ) {
+        return;
+    }
+
+    std::string digest = shareuf_content_digest( _fd, _path, sb );
+    if ( digest.empty() ) {
+        return;
+    }
+
+    std::string index = shareuf_vault_root_of( _prop_map, _path ) + "/" + SHAREUF_STATE_DIR + "/dedup";
+    unsigned slots = shareuf_get_setting< unsigned >( _prop_map, DEDUP_INDEX_SLOTS, 65536 );
+    unsigned long long saved = 0;
+    int status = 0;
+    {
+        shareuf_latency_timer timer( "dedup.close" );
+        status = shareuf_dedup_file( index, slots, _fd, _path, digest, sb.st_size, saved );
+        if ( -ENOENT == status ) {
+            mode_t mode = 0755;
+            _prop_map.get< mode_t >( DEFAULT_VAULT_DIR_MODE, mode );
+            if ( shareuf_file_mkdir_r( index.substr( 0, index.find_last_of( '/' ) ), mode ).ok() ) {
+                status = shareuf_dedup_file( index, slots, _fd, _path, digest, sb.st_size, saved );
+            }
+        }
+    }
+
+    if ( saved > 0 ) {
+        shareuf_metrics::instance().add( "dedup.hits", 1 );
+        shareuf_metrics::instance().add( "dedup.bytes_saved", saved );
+    }
+    else if ( -EOPNOTSUPP == status ) {
+        shareuf_metrics::instance().add( "dedup.unsupported", 1 );
+        rodsLog( LOG_DEBUG, "shareuf_dedup_on_close: the filesystem of \"%s\" cannot share extents", _path.c_str() );
+    }
+    else if ( status < 0 ) {
+        shareuf_metrics::instance().add( "dedup.errors", 1 );
+        rodsLog( LOG_NOTICE, "shareuf_dedup_on_close: deduplication of \"%s\" failed, errno = \"%s\"",
+                 _path.c_str(), strerror( -status ) );
+    }
+    else {
+        shareuf_metrics::instance().add( "dedup.misses", 1 );
+    }
+
+} // shareuf_dedup_on_close
+
+// =-=-=-=-=-=-=-
+// interface for POSIX Close
+irods::error shareuf_file_close(
+    irods::plugin_context& _ctx ) {
+    irods::error result = SUCCESS();
+
     // =-=-=-=-=-=-=-
     // Check the operation parameters and update the physical path
-    irods::error ret = shareuf_check_params_and_path( _ctx );
+    irods::error ret = shareuf_check_params_and_path( _ctx, false );
     if ( ( result = ASSERT_PASS( ret, "Invalid parameters or physical path." ) ).ok() ) {
 
         // =-=-=-=-=-=-=-
@@ -817,41 +2378,69 @@ irods::error shareuf_file_write(
         irods::file_object_ptr fco = boost::dynamic_pointer_cast< irods::file_object >( _ctx.fco() );
 
         // =-=-=-=-=-=-=-
-        // make the call to write
-        int status = write( fco->file_descriptor(), _buf, _len );
+        // make written data durable according to the resource policy
+        shareuf_open_file_ptr of = shareuf_open_files::instance().erase( fco->file_descriptor() );
+        irods::error sync_ret = SUCCESS();
+        if ( of && of->prefetch ) {
+            shareuf_prefetch_io io;
+            shareuf_prefetch_cancel( *of->prefetch, io );
+            shareuf_count_prefetch( io );
+        }
+        if ( of && of->digest ) {
+            int digest_status = shareuf_store_digest( fco->file_descriptor(), *of->digest );
+            if ( digest_status < 0 ) {
+                rodsLog( LOG_NOTICE, "shareuf_file_close: failed to store digest for \"%s\", errno = \"%s\"",
+                         fco->physical_path().c_str(), strerror( -digest_status ) );
+            }
+        }
+        else if ( of && ( of->flags & O_ACCMODE ) != O_RDONLY ) {
+            shareuf_drop_digest( fco->file_descriptor() );
+        }
 
         // =-=-=-=-=-=-=-
-        // pass along an error if it was not successful
-        int err_status = UNIX_FILE_WRITE_ERR - errno;
-        if ( !( result = ASSERT_ERROR( status >= 0, err_status, "Write file: \"%s\", errno = \"%s\", status = %d.",
-                                       fco->physical_path().c_str(), strerror( errno ), err_status ) ).ok() ) {
-            result.code( err_status );
-        }
-        else {
-            result.code( status );
+        // the reservation is released with its last descriptor
+        if ( of ) {
+            of->reservation.reset();
         }
-    }
 
-    // =-=-=-=-=-=-=-
-    // win!
-    return result;
+        if ( of && ( of->flags & O_ACCMODE ) != O_RDONLY ) {
+            sync_ret = shareuf_make_durable( _ctx.prop_map(), fco->file_descriptor(), fco->physical_path() );
+        }
+        if ( of && of->cache_invalidated ) {
+            shareuf_invalidate_cached_blocks( _ctx.prop_map(), fco->file_descriptor(), fco->physical_path() );
+        }
 
-} // shareuf_file_write_plugin
+        // =-=-=-=-=-=-=-
+        // the last descriptor on an unpublished file links it into place
+        irods::error publish_ret = SUCCESS();
+        bool published = true;
+        if ( of && !of->publish_path.empty() ) {
+            int publish_status = shareuf_pending_publishes::instance().release( of->publish_path, published );
+            publish_ret = ASSERT_ERROR( publish_status >= 0, UNIX_FILE_RENAME_ERR + publish_status, "Publish error for \"%s\", errno = \"%s\".",
+                                        of->publish_path.c_str(), strerror( -publish_status ) );
+            if ( published ) {
+                shareuf_emit_event( _ctx.prop_map(), SHAREUF_EVENT_CREATE, of->publish_path, 0 );
+            }
+        }
 
-// =-=-=-=-=-=-=-
-// interface for POSIX Close
-irods::error shareuf_file_close(
-    irods::plugin_context& _ctx ) {
-    irods::error result = SUCCESS();
+        // =-=-=-=-=-=-=-
+        // newly written files may share their extents with a copy already
+        // in the vault
+        if ( of && sync_ret.ok() && published && ( of->flags & O_ACCMODE ) != O_RDONLY && ( of->flags & ( O_CREAT | O_TRUNC ) ) &&
+                shareuf_get_setting< bool >( _ctx.prop_map(), DEDUP_ON_CLOSE, false ) ) {
+            shareuf_dedup_on_close( _ctx.prop_map(), fco->file_descriptor(), fco->physical_path() );
+        }
 
-    // =-=-=-=-=-=-=-
-    // Check the operation parameters and update the physical path
-    irods::error ret = shareuf_check_params_and_path( _ctx );
-    if ( ( result = ASSERT_PASS( ret, "Invalid parameters or physical path." ) ).ok() ) {
+        if ( of && SHAREUF_STREAMING_DONTNEED == of->streaming && of->dropped < of->offset &&
+                of->offset >= of->streaming_threshold ) {
+            shareuf_drop_written( fco->file_descriptor(), of->dropped );
+        }
 
         // =-=-=-=-=-=-=-
-        // get ref to fco
-        irods::file_object_ptr fco = boost::dynamic_pointer_cast< irods::file_object >( _ctx.fco() );
+        // written files are announced with their final size
+        struct stat written;
+        bool announce = of && ( of->flags & O_ACCMODE ) != O_RDONLY && published &&
+                        fstat( fco->file_descriptor(), &written ) == 0;
 
         // =-=-=-=-=-=-=-
         // make the call to close
@@ -864,11 +2453,28 @@ irods::error shareuf_file_close(
                                        fco->physical_path().c_str(), strerror( errno ), err_status ) ).ok() ) {
             result.code( err_status );
         }
+        else if ( !( result = ASSERT_PASS( sync_ret, "Failed to make \"%s\" durable.", fco->physical_path().c_str() ) ).ok() ) {
+            result.code( sync_ret.code() );
+        }
+        else if ( !( result = ASSERT_PASS( publish_ret, "Failed to publish \"%s\".", fco->physical_path().c_str() ) ).ok() ) {
+            result.code( publish_ret.code() );
+        }
         else {
+            if ( announce ) {
+                shareuf_emit_event( _ctx.prop_map(), SHAREUF_EVENT_CLOSE, fco->physical_path(), written.st_size );
+            }
             result.code( status );
         }
     }
 
+    // =-=-=-=-=-=-=-
+    // slow down or fail the call when faults are injected, once the
+    // descriptor and what its open file held are released
+    irods::error fault = shareuf_inject_fault( _ctx, "close", UNIX_FILE_CLOSE_ERR );
+    if ( result.ok() && !fault.ok() ) {
+        return fault;
+    }
+
     return result;
 
 } // shareuf_file_close_plugin
@@ -879,6 +2485,13 @@ irods::error shareuf_file_unlink(
     irods::plugin_context& _ctx ) {
     irods::error result = SUCCESS();
 
+    // =-=-=-=-=-=-=-
+    // slow down or fail the call when faults are injected
+    irods::error fault = shareuf_inject_fault( _ctx, "unlink", UNIX_FILE_UNLINK_ERR );
+    if ( !fault.ok() ) {
+        return fault;
+    }
+
     // =-=-=-=-=-=-=-
     // Check the operation parameters and update the physical path
     irods::error ret = shareuf_check_params_and_path( _ctx );
@@ -890,6 +2503,8 @@ irods::error shareuf_file_unlink(
 
         // =-=-=-=-=-=-=-
         // make the call to unlink
+        shareuf_fd_pool::instance().invalidate( fco->physical_path() );
+        shareuf_invalidate_cached_blocks( _ctx.prop_map(), -1, fco->physical_path() );
         int status = unlink( fco->physical_path().c_str() );
 
         // =-=-=-=-=-=-=-
@@ -901,6 +2516,7 @@ irods::error shareuf_file_unlink(
             result.code( err_status );
         }
         else {
+            shareuf_emit_event( _ctx.prop_map(), SHAREUF_EVENT_UNLINK, fco->physical_path(), -1 );
             result.code( status );
         }
     }
@@ -915,6 +2531,13 @@ irods::error shareuf_file_stat(
     irods::plugin_context& _ctx,
     struct stat*                        _statbuf ) {
     irods::error result = SUCCESS();
+
+    // =-=-=-=-=-=-=-
+    // slow down or fail the call when faults are injected
+    irods::error fault = shareuf_inject_fault( _ctx, "stat", UNIX_FILE_STAT_ERR );
+    if ( !fault.ok() ) {
+        return fault;
+    }
     // =-=-=-=-=-=-=-
     // NOTE:: this function assumes the object's physical path is
     //        correct and should not have the vault path
@@ -932,10 +2555,14 @@ irods::error shareuf_file_stat(
         int status = stat( fco->physical_path().c_str(), _statbuf );
 
         // =-=-=-=-=-=-=-
-        // return an error if necessary
+        // return an error if necessary, a missing file is the expected
+        // answer to a probe and gets no message
         int err_status = UNIX_FILE_STAT_ERR - errno;
-        if ( ( result = ASSERT_ERROR( status >= 0, err_status, "Stat error for \"%s\", errno = \"%s\", status = %d.",
-                                      fco->physical_path().c_str(), strerror( errno ), err_status ) ).ok() ) {
+        if ( status < 0 && ENOENT == errno ) {
+            result = ERROR( err_status, "" );
+        }
+        else if ( ( result = ASSERT_ERROR( status >= 0, err_status, "Stat error for \"%s\", errno = \"%s\", status = %d.",
+                                           fco->physical_path().c_str(), strerror( errno ), err_status ) ).ok() ) {
             result.code( status );
         }
     }
@@ -952,9 +2579,16 @@ irods::error shareuf_file_lseek(
     int                                 _whence ) {
     irods::error result = SUCCESS();
 
+    // =-=-=-=-=-=-=-
+    // slow down or fail the call when faults are injected
+    irods::error fault = shareuf_inject_fault( _ctx, "lseek", UNIX_FILE_LSEEK_ERR );
+    if ( !fault.ok() ) {
+        return fault;
+    }
+
     // =-=-=-=-=-=-=-
     // Check the operation parameters and update the physical path
-    irods::error ret = shareuf_check_params_and_path( _ctx );
+    irods::error ret = shareuf_check_params_and_path( _ctx, false );
     if ( ( result = ASSERT_PASS( ret, "Invalid parameters or physical path." ) ).ok() ) {
 
         // =-=-=-=-=-=-=-
@@ -962,8 +2596,54 @@ irods::error shareuf_file_lseek(
         irods::file_object_ptr fco = boost::dynamic_pointer_cast< irods::file_object >( _ctx.fco() );
 
         // =-=-=-=-=-=-=-
-        // make the call to lseek
-        long long status = lseek( fco->file_descriptor(),  _offset, _whence );
+        // make the call to lseek, pooled, cached and read ahead descriptors
+        // only move their own offset
+        long long status;
+        shareuf_open_file_ptr of = shareuf_open_files::instance().find( fco->file_descriptor() );
+        if ( of && ( of->pooled || of->cached || of->prefetch ) ) {
+            struct stat sb;
+            errno  = 0;
+            status = -1;
+            if ( SEEK_SET == _whence ) {
+                status = _offset;
+            }
+            else if ( SEEK_CUR == _whence ) {
+                status = of->offset + _offset;
+            }
+            else if ( SEEK_END == _whence ) {
+                if ( fstat( fco->file_descriptor(), &sb ) == 0 ) {
+                    status = sb.st_size + _offset;
+                }
+            }
+#if defined(SEEK_DATA) && defined(SEEK_HOLE)
+            else if ( SEEK_DATA == _whence || SEEK_HOLE == _whence ) {
+                // =-=-=-=-=-=-=-
+                // the kernel finds the extent, pooled reads never use the
+                // shared offset it leaves behind
+                status = lseek( fco->file_descriptor(), _offset, _whence );
+            }
+#endif
+            if ( status >= 0 ) {
+                of->offset = status;
+            }
+            else if ( 0 == errno ) {
+                errno = EINVAL;
+            }
+
+            // =-=-=-=-=-=-=-
+            // a seek away from the window drops the chunks read ahead
+            if ( status >= 0 && of->prefetch ) {
+                shareuf_prefetch_io io;
+                shareuf_prefetch_seek( *of->prefetch, status, io );
+                shareuf_count_prefetch( io );
+            }
+        }
+        else {
+            status = lseek( fco->file_descriptor(),  _offset, _whence );
+            if ( of && status >= 0 ) {
+                of->offset = status;
+            }
+        }
 
         // =-=-=-=-=-=-=-
         // return an error if necessary
@@ -984,6 +2664,13 @@ irods::error shareuf_file_mkdir(
     irods::plugin_context& _ctx ) {
     irods::error result = SUCCESS();
 
+    // =-=-=-=-=-=-=-
+    // slow down or fail the call when faults are injected
+    irods::error fault = shareuf_inject_fault( _ctx, "mkdir", UNIX_FILE_MKDIR_ERR );
+    if ( !fault.ok() ) {
+        return fault;
+    }
+
     // =-=-=-=-=-=-=-
     // NOTE :: this function assumes the object's physical path is correct and
     //         should not have the vault path prepended - hcj
@@ -996,13 +2683,16 @@ irods::error shareuf_file_mkdir(
         irods::collection_object_ptr fco = boost::dynamic_pointer_cast< irods::collection_object >( _ctx.fco() );
 
         // =-=-=-=-=-=-=-
-        // make the call to mkdir & umask
-        mode_t myMask = umask( ( mode_t ) 0000 );
-        int    status = mkdir( fco->physical_path().c_str(), 0755 );
-
-        // =-=-=-=-=-=-=-
-        // reset the old mask
-        umask( ( mode_t ) myMask );
+        // make the call to mkdir & chmod, unless a bulk ingest already
+        // knows the directory is there.  the umask is process wide, so the
+        // mode is applied with chmod.
+        int status = -1;
+        if ( shareuf_bulk_ingest::instance().known_directory( fco->physical_path() ) ) {
+            errno = EEXIST;
+        }
+        else if ( ( status = mkdir( fco->physical_path().c_str(), 0755 ) ) >= 0 ) {
+            chmod( fco->physical_path().c_str(), 0755 );
+        }
 
         // =-=-=-=-=-=-=-
         // return an error if necessary
@@ -1011,6 +2701,7 @@ irods::error shareuf_file_mkdir(
         if ( ( result = ASSERT_ERROR( status >= 0, err_status, "Mkdir error for \"%s\", errno = \"%s\", status = %d.",
                                       fco->physical_path().c_str(), strerror( errno ), err_status ) ).ok() ) {
             result.code( status );
+            shareuf_bulk_ingest::instance().add_directory( fco->physical_path(), true );
         }
     }
     return result;
@@ -1023,6 +2714,13 @@ irods::error shareuf_file_rmdir(
     irods::plugin_context& _ctx ) {
     irods::error result = SUCCESS();
 
+    // =-=-=-=-=-=-=-
+    // slow down or fail the call when faults are injected
+    irods::error fault = shareuf_inject_fault( _ctx, "rmdir", UNIX_FILE_RMDIR_ERR );
+    if ( !fault.ok() ) {
+        return fault;
+    }
+
     // =-=-=-=-=-=-=-
     // Check the operation parameters and update the physical path
     irods::error ret = shareuf_check_params_and_path( _ctx );
@@ -1035,6 +2733,7 @@ irods::error shareuf_file_rmdir(
         // =-=-=-=-=-=-=-
         // make the call to rmdir
         int status = rmdir( fco->physical_path().c_str() );
+        shareuf_bulk_ingest::instance().forget_directory( fco->physical_path() );
 
         // =-=-=-=-=-=-=-
         // return an error if necessary
@@ -1053,6 +2752,13 @@ irods::error shareuf_file_opendir(
     irods::plugin_context& _ctx ) {
     irods::error result = SUCCESS();
 
+    // =-=-=-=-=-=-=-
+    // slow down or fail the call when faults are injected
+    irods::error fault = shareuf_inject_fault( _ctx, "opendir", UNIX_FILE_OPENDIR_ERR );
+    if ( !fault.ok() ) {
+        return fault;
+    }
+
     // =-=-=-=-=-=-=-
     // Check the operation parameters and update the physical path
     irods::error ret = shareuf_check_params_and_path< irods::collection_object >( _ctx );
@@ -1073,15 +2779,9 @@ irods::error shareuf_file_opendir(
     // trap error case with bad fd
     if ( NULL == dir_ptr ) {
         int status = UNIX_FILE_CREATE_ERR - errsav;
-        std::stringstream msg;
-        msg << "Open error for \"";
-        msg << fco->physical_path();
-        msg << "\", errno = \"";
-        msg << strerror( errsav );
-        msg << "\", status = \"";
-        msg << status;
-        msg << "\".";
-        result = ERROR( status, msg.str() );
+        result = ERROR( status, ENOENT == errsav ? "" :
+                        shareuf_error_message( "Open error for \"%s\", errno = \"%s\", status = \"%d\".",
+                                               fco->physical_path().c_str(), strerror( errsav ), status ) );
     }
     else {
         // =-=-=-=-=-=-=-
@@ -1100,6 +2800,13 @@ irods::error shareuf_file_closedir(
     irods::plugin_context& _ctx ) {
     irods::error result = SUCCESS();
 
+    // =-=-=-=-=-=-=-
+    // slow down or fail the call when faults are injected
+    irods::error fault = shareuf_inject_fault( _ctx, "closedir", UNIX_FILE_CLOSEDIR_ERR );
+    if ( !fault.ok() ) {
+        return fault;
+    }
+
     // =-=-=-=-=-=-=-
     // Check the operation parameters and update the physical path
     irods::error ret = shareuf_check_params_and_path< irods::collection_object >( _ctx );
@@ -1131,6 +2838,13 @@ irods::error shareuf_file_readdir(
     struct rodsDirent**                 _dirent_ptr ) {
     irods::error result = SUCCESS();
 
+    // =-=-=-=-=-=-=-
+    // slow down or fail the call when faults are injected
+    irods::error fault = shareuf_inject_fault( _ctx, "readdir", UNIX_FILE_READDIR_ERR );
+    if ( !fault.ok() ) {
+        return fault;
+    }
+
     // =-=-=-=-=-=-=-
     // Check the operation parameters and update the physical path
     irods::error ret = shareuf_check_params_and_path< irods::collection_object >( _ctx );
@@ -1149,8 +2863,16 @@ irods::error shareuf_file_readdir(
         struct dirent * tmp_dirent = readdir( fco->directory_pointer() );
 
         // =-=-=-=-=-=-=-
-        // handle error cases
-        if ( ( result = ASSERT_ERROR( tmp_dirent != NULL, -1, "End of directory list reached." ) ).ok() ) {
+        // the end of the directory is signalled by a code of -1 without
+        // a message, only a real error is formatted
+        if ( !tmp_dirent ) {
+            if ( 0 == errno ) {
+                return CODE( -1 );
+            }
+            int status = UNIX_FILE_READDIR_ERR - errno;
+            return ERROR( status, shareuf_error_message( "Readdir error, status = %d, errno= \"%s\".", status, strerror( errno ) ) );
+        }
+        else {
 
             // =-=-=-=-=-=-=-
             // alloc dirent as necessary
@@ -1170,15 +2892,6 @@ irods::error shareuf_file_readdir(
             rstrcpy( ( *_dirent_ptr )->d_name, tmp_dirent->d_name, MAX_NAME_LEN );
 #endif
         }
-        else {
-            // =-=-=-=-=-=-=-
-            // cache status in out variable
-            int status = UNIX_FILE_READDIR_ERR - errno;
-            if ( ( result = ASSERT_ERROR( errno == 0, status, "Readdir error, status = %d, errno= \"%s\".",
-                                          status, strerror( errno ) ) ).ok() ) {
-                result.code( -1 );
-            }
-        }
     }
 
     return result;
@@ -1192,6 +2905,13 @@ irods::error shareuf_file_rename(
     const char*                         _new_file_name ) {
     irods::error result = SUCCESS();
 
+    // =-=-=-=-=-=-=-
+    // slow down or fail the call when faults are injected
+    irods::error fault = shareuf_inject_fault( _ctx, "rename", UNIX_FILE_RENAME_ERR );
+    if ( !fault.ok() ) {
+        return fault;
+    }
+
     // =-=-=-=-=-=-=-
     // Check the operation parameters and update the physical path
     irods::error ret = shareuf_check_params_and_path( _ctx );
@@ -1209,35 +2929,60 @@ irods::error shareuf_file_rename(
             irods::file_object_ptr fco = boost::dynamic_pointer_cast< irods::file_object >( _ctx.fco() );
 
             // =-=-=-=-=-=-=-
-            // get the default directory mode
-            mode_t mode = 0755;
-            ret = _ctx.prop_map().get<mode_t>(
-                      DEFAULT_VAULT_DIR_MODE,
-                      mode );
-            if ( !ret.ok() ) {
-                return PASS( ret );
-
+            // an object on a vault root stays on it, only the path below the
+            // root changes
+            std::string old_root = shareuf_vault_root_of( _ctx.prop_map(), fco->physical_path() );
+            std::string vault_path;
+            std::string relative;
+            if ( _ctx.prop_map().get< std::string >( irods::RESOURCE_PATH, vault_path ).ok() && old_root != vault_path &&
+                    shareuf_vault_root_of( _ctx.prop_map(), new_full_path ) == vault_path &&
+                    shareuf_path_under( vault_path, new_full_path, relative ) ) {
+                new_full_path = old_root + "/" + relative;
             }
 
             // =-=-=-=-=-=-=-
-            // make the directories in the path to the new file
-            std::string new_path = new_full_path;
-            std::size_t last_slash = new_path.find_last_of( '/' );
-            new_path.erase( last_slash );
-            ret = shareuf_file_mkdir_r( new_path.c_str(), mode );
-            if ( ( result = ASSERT_PASS( ret, "Mkdir error for \"%s\".", new_path.c_str() ) ).ok() ) {
+            // make the call to rename
+            shareuf_fd_pool::instance().invalidate( fco->physical_path() );
+            shareuf_fd_pool::instance().invalidate( new_full_path );
+            int status = shareuf_rename( fco->physical_path(), new_full_path );
+
+            // =-=-=-=-=-=-=-
+            // make the directories in the path to the new file only when
+            // they are missing
+            if ( -ENOENT == status ) {
+                mode_t mode = 0755;
+                ret = _ctx.prop_map().get<mode_t>(
+                          DEFAULT_VAULT_DIR_MODE,
+                          mode );
+                if ( !ret.ok() ) {
+                    return PASS( ret );
+
+                }
 
+                std::string new_path = new_full_path;
+                std::size_t last_slash = new_path.find_last_of( '/' );
+                new_path.erase( last_slash );
+                ret = shareuf_file_mkdir_r( new_path.c_str(), mode );
+                if ( !ret.ok() ) {
+                    return PASSMSG( "Mkdir error for \"" + new_path + "\".", ret );
+                }
+                status = shareuf_rename( fco->physical_path(), new_full_path );
             }
 
             // =-=-=-=-=-=-=-
-            // make the call to rename
-            int status = rename( fco->physical_path().c_str(), new_full_path.c_str() );
+            // another filesystem mounted under the vault
+            if ( -EXDEV == status ) {
+                status = shareuf_move_across_devices( fco->physical_path(), new_full_path );
+                shareuf_metrics::instance().add( 0 == status ? "rename.cross_device" : "rename.cross_device_errors", 1 );
+            }
 
             // =-=-=-=-=-=-=-
             // handle error cases
-            int err_status = UNIX_FILE_RENAME_ERR - errno;
+            int err_status = UNIX_FILE_RENAME_ERR + status;
             if ( ( result = ASSERT_ERROR( status >= 0, err_status, "Rename error for \"%s\" to \"%s\", errno = \"%s\", status = %d.",
-                                          fco->physical_path().c_str(), new_full_path.c_str(), strerror( errno ), err_status ) ).ok() ) {
+                                          fco->physical_path().c_str(), new_full_path.c_str(), strerror( -status ), err_status ) ).ok() ) {
+                shareuf_emit_event( _ctx.prop_map(), SHAREUF_EVENT_RENAME, new_full_path, fco->size(), fco->physical_path() );
+                fco->physical_path( new_full_path );
                 result.code( status );
             }
         }
@@ -1253,6 +2998,13 @@ irods::error shareuf_file_truncate(
     irods::plugin_context& _ctx ) {
     irods::error result = SUCCESS();
 
+    // =-=-=-=-=-=-=-
+    // slow down or fail the call when faults are injected
+    irods::error fault = shareuf_inject_fault( _ctx, "truncate", UNIX_FILE_TRUNCATE_ERR );
+    if ( !fault.ok() ) {
+        return fault;
+    }
+
     // =-=-=-=-=-=-=-
     // Check the operation parameters and update the physical path
     irods::error ret = shareuf_check_params_and_path< irods::file_object >( _ctx );
@@ -1263,14 +3015,37 @@ irods::error shareuf_file_truncate(
         irods::file_object_ptr file_obj = boost::dynamic_pointer_cast< irods::file_object >( _ctx.fco() );
 
         // =-=-=-=-=-=-=-
-        // make the call to rename
-        int status = truncate( file_obj->physical_path().c_str(), file_obj->size() );
+        // truncate through a descriptor the agent has open for writing on
+        // the file, which also covers a file not yet published, rather
+        // than resolving the path again
+        shareuf_fd_pool::instance().invalidate( file_obj->physical_path() );
+        shareuf_drop_digest( file_obj->physical_path() );
+        int fd = shareuf_open_files::instance().dup_writable( file_obj->physical_path() );
+        if ( fd < 0 ) {
+            fd = open( file_obj->physical_path().c_str(), O_WRONLY | O_CLOEXEC );
+        }
+        int status = fd < 0 ? -errno : 0;
+        if ( fd >= 0 ) {
+            shareuf_truncate_options opts;
+            opts.punch_chunk = shareuf_get_setting< rodsLong_t >( _ctx.prop_map(), TRUNCATE_PUNCH_CHUNK_IN_BYTES, 256 * 1024 * 1024 );
+            opts.preallocate = shareuf_get_setting< bool >( _ctx.prop_map(), TRUNCATE_PREALLOCATE, false );
+            shareuf_truncate_summary summary;
+            status = shareuf_truncate_fd( fd, file_obj->size(), opts, summary );
+            shareuf_invalidate_cached_blocks( _ctx.prop_map(), fd, file_obj->physical_path() );
+            close( fd );
+            if ( summary.punches > 0 ) {
+                shareuf_metrics::instance().add( "truncate.punches", summary.punches );
+            }
+            if ( summary.preallocated > 0 ) {
+                shareuf_metrics::instance().add( "truncate.preallocated_bytes", summary.preallocated );
+            }
+        }
 
         // =-=-=-=-=-=-=-
         // handle any error cases
-        int err_status = UNIX_FILE_TRUNCATE_ERR - errno;
+        int err_status = UNIX_FILE_TRUNCATE_ERR + status;
         result = ASSERT_ERROR( status >= 0, err_status, "Truncate error for: \"%s\", errno = \"%s\", status = %d.",
-                               file_obj->physical_path().c_str(), strerror( errno ), err_status );
+                               file_obj->physical_path().c_str(), strerror( -status ), err_status );
     }
 
     return result;
@@ -1287,6 +3062,13 @@ irods::error shareuf_file_stage_to_cache(
     const char*                      _cache_file_name ) {
     irods::error result = SUCCESS();
 
+    // =-=-=-=-=-=-=-
+    // slow down or fail the call when faults are injected
+    irods::error fault = shareuf_inject_fault( _ctx, "stage", UNIX_FILE_READ_ERR );
+    if ( !fault.ok() ) {
+        return fault;
+    }
+
     // =-=-=-=-=-=-=-
     // Check the operation parameters and update the physical path
     irods::error ret = shareuf_check_params_and_path( _ctx );
@@ -1296,12 +3078,99 @@ irods::error shareuf_file_stage_to_cache(
         // cast down the hierarchy to the desired object
         irods::file_object_ptr fco = boost::dynamic_pointer_cast< irods::file_object >( _ctx.fco() );
 
-        ret = shareuf_file_copy( fco->mode(), fco->physical_path().c_str(), _cache_file_name );
+        ret = shareuf_file_copy( _ctx.prop_map(), shareuf_client_user( _ctx ), fco->mode(), fco->physical_path().c_str(), _cache_file_name );
         result = ASSERT_PASS( ret, "Failed" );
     }
     return result;
 } // shareuf_file_stagetocache
 
+// =-=-=-=-=-=-=-
+/// @brief bring an existing archive copy in line with the cache copy by
+///        rewriting only the blocks that differ.  _done is false when the
+///        caller should fall back to a full copy.
+static irods::error shareuf_file_diff_copy(
+    irods::plugin_property_map& _prop_map,
+    const std::string&          _client_user,
+    const char*                 _src_file_name,
+    const char*                 _dest_file_name,
+    bool&                       _done ) {
+    _done = false;
+
+    int outFd = open( _dest_file_name, O_RDWR );
+    if ( outFd < 0 ) {
+        return SUCCESS();
+    }
+
+    int inFd = open( _src_file_name, O_RDONLY );
+    if ( inFd < 0 ) {
+        int err_status = UNIX_FILE_OPEN_ERR - errno;
+        close( outFd );
+        return ERROR( err_status, shareuf_error_message( "Open error for srcFileName \"%s\", status = %d", _src_file_name, err_status ) );
+    }
+
+    struct stat src_stat, dest_stat;
+    if ( fstat( inFd, &src_stat ) < 0 || fstat( outFd, &dest_stat ) < 0 ||
+            !S_ISREG( src_stat.st_mode ) || !S_ISREG( dest_stat.st_mode ) || 0 == dest_stat.st_size ) {
+        close( inFd );
+        close( outFd );
+        return SUCCESS();
+    }
+
+    shareuf_block_diff_options opts;
+    opts.block_size           = shareuf_get_setting< size_t >( _prop_map, DIFFERENTIAL_SYNC_BLOCK_SIZE_IN_BYTES, 1024 * 1024 );
+    opts.max_changed_fraction = shareuf_get_setting< unsigned >( _prop_map, DIFFERENTIAL_SYNC_MAX_CHANGED_PERCENT, 50 ) / 100.0;
+    opts.threads              = shareuf_get_setting< unsigned >( _prop_map, DIFFERENTIAL_SYNC_THREADS, 4 );
+    shareuf_qos_options qos   = shareuf_qos_options_of( _prop_map );
+    opts.on_read              = [&]( size_t _bytes ) {
+        shareuf_throttle( _prop_map, qos, SHAREUF_QOS_COPY, _client_user, _bytes );
+    };
+
+    shareuf_fd_pool::instance().invalidate( _dest_file_name );
+    shareuf_invalidate_cached_blocks( _prop_map, outFd, _dest_file_name );
+
+    // =-=-=-=-=-=-=-
+    // the stored digest covered the old content and cannot be extended
+    // by an in-place update.  it goes before the first block is rewritten,
+    // so a sync which fails part way leaves no digest of either content.
+    shareuf_drop_digest( outFd );
+
+    shareuf_block_diff_summary summary;
+    int status = 0;
+    {
+        shareuf_ioprio_guard ioprio_guard( qos.copy_ioprio );
+        shareuf_latency_timer timer( "sync.differential" );
+        status = shareuf_block_diff_sync( inFd, src_stat.st_size, outFd, opts, summary );
+    }
+    close( inFd );
+
+    irods::error result = SUCCESS();
+    if ( -E2BIG == status ) {
+        shareuf_metrics::instance().add( "sync.differential_fallbacks", 1 );
+        rodsLog( LOG_DEBUG, "shareuf_file_diff_copy: \"%s\" differs in over %u%% of its blocks, copying it in full",
+                 _src_file_name, shareuf_get_setting< unsigned >( _prop_map, DIFFERENTIAL_SYNC_MAX_CHANGED_PERCENT, 50 ) );
+        close( outFd );
+        return result;
+    }
+    if ( status < 0 ) {
+        result = ERROR( UNIX_FILE_WRITE_ERR + status, shareuf_error_message( "Differential sync of \"%s\" to \"%s\" failed, errno = \"%s\"",
+                                                                             _src_file_name, _dest_file_name, strerror( -status ) ) );
+    }
+    else {
+        result = ASSERT_PASS( shareuf_make_durable( _prop_map, outFd, _dest_file_name ), "Failed to sync \"%s\".", _dest_file_name );
+    }
+    close( outFd );
+
+    if ( result.ok() ) {
+        _done = true;
+        shareuf_metrics::instance().add( "sync.differential_bytes_written", summary.bytes_written );
+        shareuf_metrics::instance().add( "sync.differential_bytes_saved", summary.bytes_saved );
+        rodsLog( LOG_DEBUG, "shareuf_file_diff_copy: rewrote %llu of %llu blocks of \"%s\", saving %llu bytes",
+                 summary.changed_blocks, summary.blocks, _dest_file_name, summary.bytes_saved );
+    }
+    return result;
+
+} // shareuf_file_diff_copy
+
 // =-=-=-=-=-=-=-
 // unixSyncToArch - This routine is for testing the TEST_STAGE_FILE_TYPE.
 // Just copy the file from cacheFilename to filename. optionalInfo info
@@ -1311,6 +3180,13 @@ irods::error shareuf_file_sync_to_arch(
     const char*                     _cache_file_name ) {
     irods::error result = SUCCESS();
 
+    // =-=-=-=-=-=-=-
+    // slow down or fail the call when faults are injected
+    irods::error fault = shareuf_inject_fault( _ctx, "sync", UNIX_FILE_WRITE_ERR );
+    if ( !fault.ok() ) {
+        return fault;
+    }
+
     // =-=-=-=-=-=-=-
     // Check the operation parameters and update the physical path
     irods::error ret = shareuf_check_params_and_path( _ctx );
@@ -1320,8 +3196,18 @@ irods::error shareuf_file_sync_to_arch(
         // cast down the hierarchy to the desired object
         irods::file_object_ptr fco = boost::dynamic_pointer_cast< irods::file_object >( _ctx.fco() );
 
-        ret = shareuf_file_copy( fco->mode(), _cache_file_name, fco->physical_path().c_str() );
-        result = ASSERT_PASS( ret, "Failed" );
+        // =-=-=-=-=-=-=-
+        // an archive copy that already exists may only need a few blocks
+        bool done = false;
+        if ( shareuf_get_setting< bool >( _ctx.prop_map(), DIFFERENTIAL_SYNC, false ) ) {
+            ret = shareuf_file_diff_copy( _ctx.prop_map(), shareuf_client_user( _ctx ), _cache_file_name, fco->physical_path().c_str(), done );
+            result = ASSERT_PASS( ret, "Differential sync failed" );
+        }
+
+        if ( result.ok() && !done ) {
+            ret = shareuf_file_copy( _ctx.prop_map(), shareuf_client_user( _ctx ), fco->mode(), _cache_file_name, fco->physical_path().c_str() );
+            result = ASSERT_PASS( ret, "Failed" );
+        }
     }
 
     return result;
@@ -1544,6 +3430,16 @@ irods::error shareuf_file_resolve_hierarchy(
             rodsLog(LOG_DEBUG, "%s: %s = [%s]", __FUNCTION__, RECURSIVE_OPR__KW, getValByKey(&file_obj->cond_input(), RECURSIVE_OPR__KW));
             rodsLog(LOG_DEBUG, "%s: %s = [%s]", __FUNCTION__, OBJ_COUNT_KW, getValByKey(&file_obj->cond_input(), OBJ_COUNT_KW));
 
+            // =-=-=-=-=-=-=-
+            // a recursive put of many objects switches to bulk-ingest mode
+            const char* obj_count = getValByKey( &file_obj->cond_input(), OBJ_COUNT_KW );
+            unsigned threshold = shareuf_get_setting< unsigned >( _ctx.prop_map(), BULK_INGEST_OBJECT_THRESHOLD, 0 );
+            if ( irods::CREATE_OPERATION == ( *_opr ) && threshold > 0 && obj_count &&
+                    getValByKey( &file_obj->cond_input(), RECURSIVE_OPR__KW ) && atoll( obj_count ) >= threshold ) {
+                shareuf_bulk_ingest::instance().start( atoll( obj_count ),
+                                                       shareuf_get_setting< unsigned >( _ctx.prop_map(), BULK_INGEST_IDLE_SECONDS, 30 ) );
+            }
+
             // =-=-=-=-=-=-=-
             // get the name of this resource
             std::string resc_name;
@@ -1587,12 +3483,262 @@ irods::error shareuf_file_resolve_hierarchy(
 } // shareuf_file_resolve_hierarchy
 
 // =-=-=-=-=-=-=-
-// shareuf_file_rebalance - code which would rebalance the subtree
+/// @brief collect the physical paths of all replicas the catalog holds on this resource
+irods::error shareuf_registered_paths(
+    irods::plugin_context&   _ctx,
+    std::set< std::string >& _paths ) {
+    rodsLong_t resc_id = 0;
+    irods::error ret = _ctx.prop_map().get< rodsLong_t >( irods::RESOURCE_ID, resc_id );
+    if ( !ret.ok() ) {
+        return PASS( ret );
+    }
+
+    genQueryInp_t gen_inp;
+    memset( &gen_inp, 0, sizeof( gen_inp ) );
+    gen_inp.maxRows = MAX_SQL_ROWS;
+    addInxIval( &gen_inp.selectInp, COL_D_DATA_PATH, 1 );
+    std::string cond = "='" + boost::lexical_cast< std::string >( resc_id ) + "'";
+    addInxVal( &gen_inp.sqlCondInp, COL_D_RESC_ID, cond.c_str() );
+
+    genQueryOut_t* gen_out = NULL;
+    int status = rsGenQuery( _ctx.comm(), &gen_inp, &gen_out );
+    while ( status >= 0 && gen_out ) {
+        sqlResult_t* col = getSqlResultByInx( gen_out, COL_D_DATA_PATH );
+        for ( int i = 0; col && i < gen_out->rowCnt; ++i ) {
+            _paths.insert( &col->value[ col->len * i ] );
+        }
+        if ( gen_out->continueInx <= 0 ) {
+            break;
+        }
+        gen_inp.continueInx = gen_out->continueInx;
+        freeGenQueryOut( &gen_out );
+        status = rsGenQuery( _ctx.comm(), &gen_inp, &gen_out );
+    }
+    freeGenQueryOut( &gen_out );
+    clearGenQueryInp( &gen_inp );
+
+    if ( CAT_NO_ROWS_FOUND == status ) {
+        status = 0;
+    }
+    return ASSERT_ERROR( status >= 0, status, "Failed to query data paths for resource id %lld.", resc_id );
+
+} // shareuf_registered_paths
+
+// =-=-=-=-=-=-=-
+// shareuf_file_rebalance - nothing to rebalance in a leaf resource, the
+// operation is used to finish a due pass of the tier migrator and to run
+// the vault scrubber when scrub_on_rebalance is set
 irods::error shareuf_file_rebalance(
     irods::plugin_context& _ctx ) {
+    shareuf_migrator_options tier_opts;
+    if ( shareuf_tier_migrator_settings( _ctx.prop_map(), tier_opts ) ) {
+        shareuf_run_tier_migration( tier_opts );
+    }
+
+    if ( !shareuf_get_setting< bool >( _ctx.prop_map(), SCRUB_ON_REBALANCE, false ) ) {
+        return SUCCESS();
+    }
+
+    std::string vault_path;
+    irods::error ret = _ctx.prop_map().get< std::string >( irods::RESOURCE_PATH, vault_path );
+    if ( !ret.ok() ) {
+        return PASSMSG( "resource has no vault path.", ret );
+    }
+
+    // =-=-=-=-=-=-=-
+    // orphan detection needs the catalog, scrub without it if that fails
+    std::set< std::string > registered;
+    irods::error query_ret = shareuf_registered_paths( _ctx, registered );
+    if ( !query_ret.ok() ) {
+        irods::log( PASSMSG( "shareuf_file_rebalance - skipping orphan detection", query_ret ) );
+    }
+
+    // =-=-=-=-=-=-=-
+    // each vault root keeps its report and checkpoint in its own state
+    // directory, the explicit settings apply to the vault path
+    std::vector< std::string > roots = shareuf_vault_roots( _ctx.prop_map() );
+    std::string small_object_vault = shareuf_small_object_vault( _ctx.prop_map() );
+    if ( !small_object_vault.empty() && std::find( roots.begin(), roots.end(), small_object_vault ) == roots.end() ) {
+        roots.insert( roots.begin(), small_object_vault );
+    }
+    if ( std::find( roots.begin(), roots.end(), vault_path ) == roots.end() ) {
+        roots.insert( roots.begin(), vault_path );
+    }
+
+    mode_t mode = 0755;
+    _ctx.prop_map().get< mode_t >( DEFAULT_VAULT_DIR_MODE, mode );
+    for ( size_t i = 0; i < roots.size(); ++i ) {
+        std::string state_dir = roots[ i ] + "/" + SHAREUF_STATE_DIR;
+        ret = shareuf_file_mkdir_r( state_dir, mode );
+        if ( !ret.ok() ) {
+            return PASS( ret );
+        }
+
+        shareuf_scrub_options opts;
+        opts.root             = roots[ i ];
+        opts.skip_dir         = state_dir;
+        opts.threads          = shareuf_get_setting< unsigned >( _ctx.prop_map(), SCRUB_THREADS, 4 );
+        opts.bytes_per_second = shareuf_get_setting< unsigned long long >( _ctx.prop_map(), SCRUB_BYTES_PER_SECOND, 0 );
+        opts.report_path      = state_dir + "/scrub_report.json";
+        opts.checkpoint_path  = state_dir + "/scrub_checkpoint";
+        if ( roots[ i ] == vault_path ) {
+            opts.report_path     = shareuf_get_setting< std::string >( _ctx.prop_map(), SCRUB_REPORT_FILE, opts.report_path );
+            opts.checkpoint_path = shareuf_get_setting< std::string >( _ctx.prop_map(), SCRUB_CHECKPOINT_FILE, opts.checkpoint_path );
+        }
+        if ( query_ret.ok() ) {
+            opts.registered = &registered;
+        }
+
+        shareuf_scrub_summary summary;
+        int status = shareuf_scrub_vault( opts, summary );
+        if ( status < 0 ) {
+            return ERROR( UNIX_FILE_OPENDIR_ERR + status, "Scrub of \"" + roots[ i ] + "\" failed: " + strerror( -status ) );
+        }
+
+        rodsLog( LOG_NOTICE,
+                 "shareuf_file_rebalance - scrubbed [%s] files [%llu] verified [%llu] mismatches [%llu] stale digests [%llu] missing digests [%llu] orphans [%llu] errors [%llu], report [%s]",
+                 roots[ i ].c_str(), summary.files, summary.verified, summary.mismatches, summary.stale_digests,
+                 summary.missing_digests, summary.orphans, summary.errors, opts.report_path.c_str() );
+    }
+
     return SUCCESS();
 
-} // shareuf_file_rebalancec
+} // shareuf_file_rebalance
+
+// =-=-=-=-=-=-=-
+/// @brief record how long the maintenance task _name took since _start,
+///        noting in the log when it ran over its _budget
+void shareuf_end_maintenance_task(
+    const char*                                  _name,
+    const std::chrono::steady_clock::time_point& _start,
+    const std::chrono::milliseconds&             _budget ) {
+    long long usec = std::chrono::duration_cast< std::chrono::microseconds >(
+                         std::chrono::steady_clock::now() - _start ).count();
+    shareuf_metrics::instance().record_latency( std::string( "maintenance." ) + _name, usec );
+    if ( usec > std::chrono::duration_cast< std::chrono::microseconds >( _budget ).count() ) {
+        rodsLog( LOG_NOTICE, "shareuf_maintenance - [%s] took [%lld] us, over its budget of [%lld] ms",
+                 _name, usec, static_cast< long long >( _budget.count() ) );
+    }
+
+} // shareuf_end_maintenance_task
+
+// =-=-=-=-=-=-=-
+/// @brief flush the closes still waiting on a group commit
+void shareuf_maintain_group_commit(
+    const std::chrono::milliseconds& _budget ) {
+    if ( !shareuf_group_commit::instance().drain( _budget ) ) {
+        rodsLog( LOG_NOTICE, "shareuf_maintenance - group commit still flushing after [%lld] ms",
+                 static_cast< long long >( _budget.count() ) );
+    }
+
+} // shareuf_maintain_group_commit
+
+// =-=-=-=-=-=-=-
+/// @brief give back the space and memory held for files the client left
+///        open, and end a bulk ingest along with its batch reservations.
+///        the entries stay in the table for a close which may still come.
+void shareuf_maintain_reservations(
+    const std::chrono::milliseconds& _budget ) {
+    std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + _budget;
+
+    shareuf_bulk_ingest_summary summary;
+    if ( shareuf_bulk_ingest::instance().finish( summary ) ) {
+        shareuf_report_bulk_ingest( summary );
+    }
+
+    std::vector< shareuf_open_file_ptr > open_files;
+    shareuf_open_files::instance().list( open_files );
+    long long released = 0;
+    for ( size_t i = 0; i < open_files.size() && std::chrono::steady_clock::now() < deadline; ++i ) {
+        shareuf_open_file& of = *open_files[ i ];
+        if ( of.prefetch ) {
+            shareuf_prefetch_io io;
+            shareuf_prefetch_cancel( *of.prefetch, io );
+            shareuf_count_prefetch( io );
+            of.prefetch.reset();
+        }
+        if ( of.reservation ) {
+            std::lock_guard< std::mutex > lock( of.reservation->mutex );
+            if ( of.reservation->reservation.active() && shareuf_release_reservation( of.reservation->reservation ) == 0 ) {
+                ++released;
+            }
+        }
+    }
+    if ( released > 0 ) {
+        shareuf_metrics::instance().add( "maintenance.reservations_released", released );
+    }
+
+} // shareuf_maintain_reservations
+
+// =-=-=-=-=-=-=-
+/// @brief close the pooled descriptors and free the parked buffers, the
+///        agent is not going to read for this client again
+void shareuf_maintain_caches() {
+    size_t closed = shareuf_fd_pool::instance().evict( shareuf_fd_pool::instance().size() );
+    if ( closed > 0 ) {
+        shareuf_metrics::instance().add( "maintenance.descriptors_closed", closed );
+    }
+    shareuf_buffer_pool::instance().trim();
+
+} // shareuf_maintain_caches
+
+// =-=-=-=-=-=-=-
+/// @brief unlink the temp files left by agents which died before publishing
+///        them, in the directories this agent made temp names in
+void shareuf_maintain_temp_files(
+    const std::chrono::milliseconds& _budget,
+    time_t                           _min_age ) {
+    std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + _budget;
+
+    std::vector< std::string > dirs;
+    shareuf_temp_directories( dirs );
+    unsigned long long reaped = 0;
+    for ( size_t i = 0; i < dirs.size(); ++i ) {
+        if ( shareuf_reap_temp_files( dirs[ i ], _min_age, deadline, reaped ) == -ETIMEDOUT ) {
+            break;
+        }
+    }
+    if ( reaped > 0 ) {
+        rodsLog( LOG_NOTICE, "shareuf_maintenance - reaped [%llu] temp files left by exited agents", reaped );
+        shareuf_metrics::instance().add( "maintenance.temp_files_reaped", reaped );
+    }
+
+} // shareuf_maintain_temp_files
+
+// =-=-=-=-=-=-=-
+/// @brief unlink the partial copies no retry came back for, in the
+///        directories this agent made partial copies in
+void shareuf_maintain_partial_copies(
+    const std::chrono::milliseconds& _budget,
+    time_t                           _min_age ) {
+    std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + _budget;
+
+    std::vector< std::string > dirs;
+    shareuf_partial_directories( dirs );
+    unsigned long long reaped = 0;
+    for ( size_t i = 0; i < dirs.size(); ++i ) {
+        if ( shareuf_reap_partial_copies( dirs[ i ], _min_age, deadline, reaped ) == -ETIMEDOUT ) {
+            break;
+        }
+    }
+    if ( reaped > 0 ) {
+        rodsLog( LOG_NOTICE, "shareuf_maintenance - reaped [%llu] abandoned partial copies", reaped );
+        shareuf_metrics::instance().add( "maintenance.partial_copies_reaped", reaped );
+    }
+
+} // shareuf_maintain_partial_copies
+
+// =-=-=-=-=-=-=-
+/// @brief write the metrics gathered for the client to the log and start
+///        over, so the next client of a reused agent is counted apart
+void shareuf_maintain_metrics() {
+    if ( !shareuf_metrics::instance().empty() ) {
+        rodsLog( LOG_NOTICE, "shareuf_resource - metrics [%s]",
+                 shareuf_metrics::instance().format().c_str() );
+        shareuf_metrics::instance().reset();
+    }
+
+} // shareuf_maintain_metrics
 
 // =-=-=-=-=-=-=-
 // 3. create derived class to handle unix file system resources
@@ -1601,30 +3747,62 @@ irods::error shareuf_file_rebalance(
 //    operations.  semicolon is the preferred delimiter
 class shareuf_resource : public irods::resource {
         // =-=-=-=-=-=-=-
-        // 3a. create a class to provide maintenance operations, this is only for example
-        //     and will not be called.
+        // 3a. create a class to provide maintenance operations, run by the
+        //     agent once its client has disconnected.  each task is given
+        //     the budget in turn so the teardown of the agent stays bounded.
         class maintenance_operation {
             public:
-                maintenance_operation( const std::string& _n ) : name_( _n ) {
-                }
-
-                maintenance_operation( const maintenance_operation& _rhs ) {
-                    name_ = _rhs.name_;
-                }
-
-                maintenance_operation& operator=( const maintenance_operation& _rhs ) {
-                    name_ = _rhs.name_;
-                    return *this;
+                maintenance_operation(
+                    const std::chrono::milliseconds& _budget,
+                    time_t                           _reap_age,
+                    time_t                           _partial_age,
+                    irods::plugin_property_map&      _prop_map ) :
+                    budget_( _budget ),
+                    reap_age_( _reap_age ),
+                    partial_age_( _partial_age ),
+                    migrate_( shareuf_tier_migrator_settings( _prop_map, tier_opts_ ) ) {
                 }
 
                 irods::error operator()( rcComm_t* ) {
-                    rodsLog( LOG_NOTICE, "shareuf_resource::post_disconnect_maintenance_operation - [%s]",
-                             name_.c_str() );
+                    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+                    shareuf_maintain_group_commit( budget_ );
+                    shareuf_end_maintenance_task( "group_commit", start, budget_ );
+
+                    start = std::chrono::steady_clock::now();
+                    shareuf_maintain_reservations( budget_ );
+                    shareuf_end_maintenance_task( "reservations", start, budget_ );
+
+                    start = std::chrono::steady_clock::now();
+                    shareuf_maintain_caches();
+                    shareuf_end_maintenance_task( "caches", start, budget_ );
+
+                    start = std::chrono::steady_clock::now();
+                    shareuf_maintain_temp_files( budget_, reap_age_ );
+                    shareuf_end_maintenance_task( "temp_files", start, budget_ );
+
+                    start = std::chrono::steady_clock::now();
+                    shareuf_maintain_partial_copies( budget_, partial_age_ );
+                    shareuf_end_maintenance_task( "partial_copies", start, budget_ );
+
+                    if ( migrate_ ) {
+                        start = std::chrono::steady_clock::now();
+                        tier_opts_.deadline = start + budget_;
+                        shareuf_run_tier_migration( tier_opts_ );
+                        shareuf_end_maintenance_task( "tier_migration", start, budget_ );
+                    }
+
+                    // =-=-=-=-=-=-=-
+                    // last, so the tasks above are in the dump
+                    shareuf_maintain_metrics();
                     return SUCCESS();
                 }
 
             private:
-                std::string name_;
+                std::chrono::milliseconds budget_;
+                time_t                    reap_age_;
+                time_t                    partial_age_;
+                shareuf_migrator_options  tier_opts_;
+                bool                      migrate_;
 
         }; // class maintenance_operation
 
@@ -1653,19 +3831,49 @@ class shareuf_resource : public irods::resource {
                         itr->second );
                 } // for itr
 
+            properties_.set< shareuf_durability_options >( DURABILITY_OPTIONS_KW, shareuf_read_durability_options( properties_ ) );
+            properties_.set< shareuf_qos_options >( QOS_OPTIONS_KW, shareuf_read_qos_options( properties_ ) );
+            properties_.set< shareuf_block_cache_options >( BLOCK_CACHE_OPTIONS_KW, shareuf_read_block_cache_options( properties_ ) );
+
+            rodsLog( LOG_DEBUG, "shareuf_resource - checksum kernels crc32c [%s] sha256 [%s]",
+                     shareuf_crc32c_kernel_name(), shareuf_sha256_kernel_name() );
+
         } // ctor
 
+        ~shareuf_resource() {
+            if ( !shareuf_metrics::instance().empty() ) {
+                rodsLog( LOG_NOTICE, "shareuf_resource - metrics [%s]",
+                         shareuf_metrics::instance().format().c_str() );
+            }
+
+            // =-=-=-=-=-=-=-
+            // the block cache is shared by the agents on the host, report
+            // its totals as well
+            shareuf_block_cache_options cache_opts;
+            shareuf_block_cache_totals  totals;
+            if ( shareuf_block_cache_settings( properties_, cache_opts ) &&
+                    shareuf_block_cache_read_totals( cache_opts, totals ) == 0 && totals.hits + totals.misses > 0 ) {
+                rodsLog( LOG_NOTICE, "shareuf_resource - block cache [%s] hit_rate=%.1f%% hits=%llu misses=%llu bytes_saved=%llu evictions=%llu",
+                         cache_opts.dir.c_str(), 100.0 * totals.hits / ( totals.hits + totals.misses ),
+                         totals.hits, totals.misses, totals.bytes_saved, totals.evictions );
+            }
+        } // dtor
+
         irods::error need_post_disconnect_maintenance_operation( bool& _b ) {
-            _b = false;
+            _b = shareuf_get_setting< unsigned >( properties_, MAINTENANCE_TASK_BUDGET_IN_MS, 200 ) > 0;
             return SUCCESS();
         }
 
         // =-=-=-=-=-=-=-
         // 3b. pass along a functor for maintenance work after
-        //     the client disconnects, uncomment the first two lines for effect.
-        irods::error post_disconnect_maintenance_operation( irods::pdmo_type& ) {
-            irods::error result = SUCCESS();
-            return ERROR( -1, "nop" );
+        //     the client disconnects
+        irods::error post_disconnect_maintenance_operation( irods::pdmo_type& _op ) {
+            _op = maintenance_operation(
+                      std::chrono::milliseconds( shareuf_get_setting< unsigned >( properties_, MAINTENANCE_TASK_BUDGET_IN_MS, 200 ) ),
+                      shareuf_get_setting< time_t >( properties_, REAP_TEMP_FILES_AFTER_IN_SECONDS, 3600 ),
+                      shareuf_get_setting< time_t >( properties_, REAP_PARTIAL_COPIES_AFTER_IN_SECONDS, 24 * 3600 ),
+                      properties_ );
+            return SUCCESS();
         }
 }; // class shareuf_resource
 
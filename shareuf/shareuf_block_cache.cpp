@@ -0,0 +1,882 @@
+#include "shareuf_block_cache.hpp"
+#include "shareuf_checksum.hpp"
+
+// =-=-=-=-=-=-=-
+// stl includes
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+// =-=-=-=-=-=-=-
+// system includes
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+    const char     CACHE_MAGIC[ 8 ]  = { 'S', 'H', 'U', 'F', 'B', 'C', 'K', '2' };
+    const size_t   CACHE_HEADER_SIZE = 4096;
+    const uint32_t MIN_SLOTS         = 16;
+    const uint32_t BUCKET_DELETED    = 0xffffffff;   // 0 is empty, otherwise index + 1
+    const uint32_t MAX_SKIPPED       = 64;           // slots being rewritten passed over for a victim
+
+    enum slot_queue {
+        QUEUE_FREE = 0,
+        QUEUE_A1IN,     // read once, FIFO
+        QUEUE_AM        // read again, LRU
+    };
+
+    // =-=-=-=-=-=-=-
+    // links between slots hold the slot + 1, 0 ends a list
+    struct cache_header {
+        char                    magic[ 8 ];
+        uint32_t                slots;
+        uint32_t                block_size;
+        uint32_t                ghosts;
+        uint32_t                ghost_next;
+        uint32_t                in_count;       // slots in A1in
+        uint32_t                fresh;          // slots from here on were never used
+        uint32_t                free_head;
+        uint32_t                in_head;        // oldest first
+        uint32_t                in_tail;
+        uint32_t                am_head;        // least recently used first
+        uint32_t                am_tail;
+        uint32_t                block_deleted;  // deleted buckets of each table
+        uint32_t                inode_deleted;
+        uint32_t                ghost_deleted;
+        uint32_t                changing;       // set while the lock is held
+        uint32_t                unused;
+        uint64_t                tick;
+        std::atomic< uint64_t > hits;
+        std::atomic< uint64_t > misses;
+        std::atomic< uint64_t > bytes_saved;
+        std::atomic< uint64_t > evictions;
+    };
+
+    struct cache_slot {
+        std::atomic< uint64_t > generation;     // odd while the data is rewritten
+        uint64_t                dev;
+        uint64_t                ino;
+        int64_t                 mtime_ns;
+        uint64_t                block;
+        uint64_t                tick;           // insertion for A1in, last use for Am
+        uint32_t                length;
+        uint32_t                crc;
+        uint32_t                queue;
+        uint32_t                prev;           // in its queue, next also in the free list
+        uint32_t                next;
+        uint32_t                inode_prev;     // blocks of the same file
+        uint32_t                inode_next;
+        uint32_t                unused;
+    };
+
+    static_assert( sizeof( cache_header ) <= CACHE_HEADER_SIZE, "cache header must fit its page" );
+
+    // =-=-=-=-=-=-=-
+    // the index is the header, the slots, the tables of blocks and of
+    // files, each with two buckets per slot, the ring of ghost hashes and
+    // its table with two buckets per ghost
+    struct cache_mapping {
+        std::mutex* mutex;      // flock does not exclude threads sharing the descriptor
+        int         index_fd;
+        int         data_fd;
+        void*       base;
+        size_t      length;
+
+        cache_header* header() const {
+            return static_cast< cache_header* >( base );
+        }
+
+        cache_slot* slot(
+            uint32_t _index ) const {
+            return reinterpret_cast< cache_slot* >( static_cast< char* >( base ) + CACHE_HEADER_SIZE ) + _index;
+        }
+
+        uint32_t* block_buckets() const {
+            return reinterpret_cast< uint32_t* >( slot( header()->slots ) );
+        }
+
+        uint32_t* inode_buckets() const {
+            return block_buckets() + 2 * static_cast< size_t >( header()->slots );
+        }
+
+        uint64_t* ghosts() const {
+            return reinterpret_cast< uint64_t* >( inode_buckets() + 2 * static_cast< size_t >( header()->slots ) );
+        }
+
+        uint32_t* ghost_buckets() const {
+            return reinterpret_cast< uint32_t* >( ghosts() + header()->ghosts );
+        }
+    };
+
+    size_t mapping_length(
+        uint32_t _slots,
+        uint32_t _ghosts ) {
+        return CACHE_HEADER_SIZE + _slots * sizeof( cache_slot ) + 4 * static_cast< size_t >( _slots ) * sizeof( uint32_t ) +
+               _ghosts * sizeof( uint64_t ) + 2 * static_cast< size_t >( _ghosts ) * sizeof( uint32_t );
+    }
+
+    uint64_t key_hash(
+        const shareuf_block_file& _file,
+        uint64_t                  _block ) {
+        uint64_t h = _file.dev * 0x9e3779b97f4a7c15ULL ^ _file.ino;
+        h = ( h ^ static_cast< uint64_t >( _file.mtime_ns ) ) * 0xbf58476d1ce4e5b9ULL;
+        h = ( h ^ _block ) * 0x94d049bb133111ebULL;
+        h ^= h >> 31;
+        return h ? h : 1;   // 0 marks an empty ghost
+    }
+
+    uint64_t slot_hash(
+        const cache_slot& _slot ) {
+        shareuf_block_file file;
+        file.dev      = _slot.dev;
+        file.ino      = _slot.ino;
+        file.mtime_ns = _slot.mtime_ns;
+        return key_hash( file, _slot.block );
+    }
+
+    uint64_t inode_hash(
+        uint64_t _dev,
+        uint64_t _ino ) {
+        uint64_t h = ( _dev * 0x9e3779b97f4a7c15ULL ^ _ino ) * 0xbf58476d1ce4e5b9ULL;
+        return h ^ ( h >> 31 );
+    }
+
+    // =-=-=-=-=-=-=-
+    // map the index, laying out a new one under an flock so concurrent
+    // creators agree on its geometry.  a new index is all zeroes but its
+    // header: no slot used, every list and table empty.
+    int map_cache(
+        const shareuf_block_cache_options& _opts,
+        cache_mapping&                     _out ) {
+        // =-=-=-=-=-=-=-
+        // the mode is applied with chmod, the umask is process wide
+        if ( 0 == mkdir( _opts.dir.c_str(), _opts.dir_mode ) ) {
+            chmod( _opts.dir.c_str(), _opts.dir_mode );
+        }
+        else if ( EEXIST != errno ) {
+            return -errno;
+        }
+        std::string index_path = _opts.dir + "/index";
+        int fd = open( index_path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600 );
+        if ( fd < 0 ) {
+            return -errno;
+        }
+
+        struct stat sb;
+        cache_header header;
+        int status = flock( fd, LOCK_EX ) < 0 || fstat( fd, &sb ) < 0 ? -errno : 0;
+        if ( 0 == status && 0 == sb.st_size ) {
+            if ( 0 == _opts.block_size ) {
+                status = -EINVAL;
+            }
+            else {
+                memset( static_cast< void* >( &header ), 0, sizeof( header ) );
+                memcpy( header.magic, CACHE_MAGIC, sizeof( CACHE_MAGIC ) );
+                header.block_size = _opts.block_size;
+                header.slots      = static_cast< uint32_t >( std::min< uint64_t >( std::max< uint64_t >( _opts.size / _opts.block_size, MIN_SLOTS ), 1u << 30 ) );
+                header.ghosts     = header.slots / 2;
+                if ( ftruncate( fd, mapping_length( header.slots, header.ghosts ) ) < 0 ||
+                        pwrite( fd, &header, sizeof( header ), 0 ) != static_cast< ssize_t >( sizeof( header ) ) ) {
+                    status = -errno;
+                }
+            }
+        }
+        if ( 0 == status && ( fstat( fd, &sb ) < 0 || pread( fd, &header, sizeof( header ), 0 ) != static_cast< ssize_t >( sizeof( header ) ) ) ) {
+            status = -EINVAL;
+        }
+        if ( 0 == status && ( memcmp( header.magic, CACHE_MAGIC, sizeof( CACHE_MAGIC ) ) != 0 || header.slots < MIN_SLOTS ||
+                              0 == header.block_size || header.ghosts != header.slots / 2 ||
+                              sb.st_size < static_cast< off_t >( mapping_length( header.slots, header.ghosts ) ) ) ) {
+            status = -EINVAL;
+        }
+
+        int data_fd = -1;
+        if ( 0 == status ) {
+            std::string data_path = _opts.dir + "/blocks";
+            off_t data_size = static_cast< off_t >( header.slots ) * header.block_size;
+            data_fd = open( data_path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600 );
+            if ( data_fd < 0 || ( fstat( data_fd, &sb ) == 0 && sb.st_size < data_size && ftruncate( data_fd, data_size ) < 0 ) ) {
+                status = -errno;
+            }
+        }
+        if ( 0 == status ) {
+            _out.length = mapping_length( header.slots, header.ghosts );
+            _out.base   = mmap( 0, _out.length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 );
+            if ( MAP_FAILED == _out.base ) {
+                status = -errno;
+            }
+        }
+        flock( fd, LOCK_UN );
+
+        if ( status < 0 ) {
+            close( fd );
+            if ( data_fd >= 0 ) {
+                close( data_fd );
+            }
+            return status;
+        }
+        _out.index_fd = fd;
+        _out.data_fd  = data_fd;
+        return 0;
+    }
+
+    // =-=-=-=-=-=-=-
+    // one mapping per cache directory for the life of the process, a cache
+    // which failed to map is not retried
+    int attach(
+        const shareuf_block_cache_options& _opts,
+        cache_mapping&                     _out ) {
+        static std::mutex                      mutex;
+        static std::map< std::string, int >    failed;
+        static std::map< std::string, cache_mapping > mapped;
+
+        std::lock_guard< std::mutex > lock( mutex );
+        std::map< std::string, cache_mapping >::iterator itr = mapped.find( _opts.dir );
+        if ( itr != mapped.end() ) {
+            _out = itr->second;
+            return 0;
+        }
+        std::map< std::string, int >::iterator fail = failed.find( _opts.dir );
+        if ( fail != failed.end() ) {
+            return fail->second;
+        }
+
+        int status = map_cache( _opts, _out );
+        if ( status < 0 ) {
+            failed[ _opts.dir ] = status;
+            return status;
+        }
+        _out.mutex = new std::mutex;
+        mapped[ _opts.dir ] = _out;
+        return 0;
+    }
+
+    // =-=-=-=-=-=-=-
+    // the rest runs under the lock.  the tables are open addressed with
+    // linear probing, a probe ends at an empty bucket and passes over
+    // deleted ones.
+    template < typename Match >
+    uint32_t* find_bucket(
+        uint32_t* _table,
+        uint32_t  _size,
+        uint64_t  _hash,
+        Match     _match ) {
+        for ( uint32_t i = 0; i < _size; ++i ) {
+            uint32_t& v = _table[ ( _hash + i ) % _size ];
+            if ( 0 == v ) {
+                break;
+            }
+            if ( BUCKET_DELETED != v && _match( v - 1 ) ) {
+                return &v;
+            }
+        }
+        return 0;
+    }
+
+    void insert_bucket(
+        uint32_t* _table,
+        uint32_t  _size,
+        uint64_t  _hash,
+        uint32_t  _index,
+        uint32_t& _deleted ) {
+        for ( uint32_t i = 0; i < _size; ++i ) {
+            uint32_t& v = _table[ ( _hash + i ) % _size ];
+            if ( 0 == v || BUCKET_DELETED == v ) {
+                if ( BUCKET_DELETED == v ) {
+                    --_deleted;
+                }
+                v = _index + 1;
+                return;
+            }
+        }
+    }
+
+    void erase_bucket(
+        uint32_t* _bucket,
+        uint32_t& _deleted ) {
+        *_bucket = BUCKET_DELETED;
+        ++_deleted;
+    }
+
+    int lookup(
+        const cache_mapping&      _cache,
+        const shareuf_block_file& _file,
+        uint64_t                  _block ) {
+        uint32_t* bucket = find_bucket( _cache.block_buckets(), 2 * _cache.header()->slots, key_hash( _file, _block ), [&]( uint32_t _i ) {
+            const cache_slot* s = _cache.slot( _i );
+            return s->dev == _file.dev && s->ino == _file.ino && s->mtime_ns == _file.mtime_ns && s->block == _block;
+        } );
+        return bucket ? static_cast< int >( *bucket - 1 ) : -1;
+    }
+
+    // =-=-=-=-=-=-=-
+    // the bucket of the file with _dev and _ino, holding the first slot of
+    // the chain of its blocks, null if none of its blocks is cached
+    uint32_t* find_inode(
+        const cache_mapping& _cache,
+        uint64_t             _dev,
+        uint64_t             _ino ) {
+        return find_bucket( _cache.inode_buckets(), 2 * _cache.header()->slots, inode_hash( _dev, _ino ), [&]( uint32_t _i ) {
+            return _cache.slot( _i )->dev == _dev && _cache.slot( _i )->ino == _ino;
+        } );
+    }
+
+    uint32_t& queue_head(
+        cache_header* _header,
+        uint32_t      _queue ) {
+        return QUEUE_A1IN == _queue ? _header->in_head : _header->am_head;
+    }
+
+    uint32_t& queue_tail(
+        cache_header* _header,
+        uint32_t      _queue ) {
+        return QUEUE_A1IN == _queue ? _header->in_tail : _header->am_tail;
+    }
+
+    void queue_push_back(
+        const cache_mapping& _cache,
+        uint32_t             _index ) {
+        cache_header* header = _cache.header();
+        cache_slot*   s      = _cache.slot( _index );
+        uint32_t&     head   = queue_head( header, s->queue );
+        uint32_t&     tail   = queue_tail( header, s->queue );
+        s->prev = tail;
+        s->next = 0;
+        if ( tail ) {
+            _cache.slot( tail - 1 )->next = _index + 1;
+        }
+        else {
+            head = _index + 1;
+        }
+        tail = _index + 1;
+    }
+
+    void queue_remove(
+        const cache_mapping& _cache,
+        uint32_t             _index ) {
+        cache_header* header = _cache.header();
+        cache_slot*   s      = _cache.slot( _index );
+        if ( s->prev ) {
+            _cache.slot( s->prev - 1 )->next = s->next;
+        }
+        else {
+            queue_head( header, s->queue ) = s->next;
+        }
+        if ( s->next ) {
+            _cache.slot( s->next - 1 )->prev = s->prev;
+        }
+        else {
+            queue_tail( header, s->queue ) = s->prev;
+        }
+        s->prev = 0;
+        s->next = 0;
+    }
+
+    void rebuild_tables(
+        const cache_mapping& _cache ) {
+        cache_header* header = _cache.header();
+        memset( _cache.block_buckets(), 0, 4 * static_cast< size_t >( header->slots ) * sizeof( uint32_t ) );
+        header->block_deleted = 0;
+        header->inode_deleted = 0;
+        for ( uint32_t i = 0; i < header->fresh; ++i ) {
+            const cache_slot* s = _cache.slot( i );
+            if ( QUEUE_FREE == s->queue ) {
+                continue;
+            }
+            insert_bucket( _cache.block_buckets(), 2 * header->slots, slot_hash( *s ), i, header->block_deleted );
+            if ( 0 == s->inode_prev ) {
+                insert_bucket( _cache.inode_buckets(), 2 * header->slots, inode_hash( s->dev, s->ino ), i, header->inode_deleted );
+            }
+        }
+    }
+
+    void rebuild_ghosts(
+        const cache_mapping& _cache ) {
+        cache_header* header = _cache.header();
+        uint64_t*     ghosts = _cache.ghosts();
+        memset( _cache.ghost_buckets(), 0, 2 * static_cast< size_t >( header->ghosts ) * sizeof( uint32_t ) );
+        header->ghost_deleted = 0;
+        for ( uint32_t i = 0; i < header->ghosts; ++i ) {
+            if ( ghosts[ i ] ) {
+                insert_bucket( _cache.ghost_buckets(), 2 * header->ghosts, ghosts[ i ], i, header->ghost_deleted );
+            }
+        }
+    }
+
+    // =-=-=-=-=-=-=-
+    // put a slot holding a block, its queue set, into the index: at the
+    // back of its queue and at the front of the chain of its file
+    void link_slot(
+        const cache_mapping& _cache,
+        uint32_t             _index ) {
+        cache_header* header = _cache.header();
+        cache_slot*   s      = _cache.slot( _index );
+        queue_push_back( _cache, _index );
+        if ( QUEUE_A1IN == s->queue ) {
+            ++header->in_count;
+        }
+        insert_bucket( _cache.block_buckets(), 2 * header->slots, slot_hash( *s ), _index, header->block_deleted );
+
+        s->inode_prev = 0;
+        s->inode_next = 0;
+        uint32_t* first = find_inode( _cache, s->dev, s->ino );
+        if ( first ) {
+            s->inode_next = *first;
+            _cache.slot( *first - 1 )->inode_prev = _index + 1;
+            *first = _index + 1;
+        }
+        else {
+            insert_bucket( _cache.inode_buckets(), 2 * header->slots, inode_hash( s->dev, s->ino ), _index, header->inode_deleted );
+        }
+    }
+
+    // =-=-=-=-=-=-=-
+    // take a slot out of the index, its queue and the chain of its file
+    void unlink_slot(
+        const cache_mapping& _cache,
+        uint32_t             _index ) {
+        cache_header* header = _cache.header();
+        cache_slot*   s      = _cache.slot( _index );
+        if ( QUEUE_FREE == s->queue ) {
+            return;
+        }
+
+        queue_remove( _cache, _index );
+        if ( QUEUE_A1IN == s->queue ) {
+            --header->in_count;
+        }
+        uint32_t* bucket = find_bucket( _cache.block_buckets(), 2 * header->slots, slot_hash( *s ), [&]( uint32_t _i ) {
+            return _i == _index;
+        } );
+        if ( bucket ) {
+            erase_bucket( bucket, header->block_deleted );
+        }
+
+        if ( s->inode_prev ) {
+            _cache.slot( s->inode_prev - 1 )->inode_next = s->inode_next;
+        }
+        else if ( ( bucket = find_inode( _cache, s->dev, s->ino ) ) != 0 ) {
+            if ( s->inode_next ) {
+                *bucket = s->inode_next;
+            }
+            else {
+                erase_bucket( bucket, header->inode_deleted );
+            }
+        }
+        if ( s->inode_next ) {
+            _cache.slot( s->inode_next - 1 )->inode_prev = s->inode_prev;
+        }
+        s->inode_prev = 0;
+        s->inode_next = 0;
+        s->queue      = QUEUE_FREE;
+
+        if ( header->block_deleted > header->slots / 2 || header->inode_deleted > header->slots / 2 ) {
+            rebuild_tables( _cache );
+        }
+    }
+
+    // =-=-=-=-=-=-=-
+    // take a slot out of the index and make it free
+    void release_slot(
+        const cache_mapping& _cache,
+        uint32_t             _index ) {
+        cache_header* header = _cache.header();
+        cache_slot*   s      = _cache.slot( _index );
+        if ( QUEUE_FREE == s->queue ) {
+            return;
+        }
+        unlink_slot( _cache, _index );
+        s->next           = header->free_head;
+        header->free_head = _index + 1;
+    }
+
+    void remember_ghost(
+        const cache_mapping& _cache,
+        uint64_t             _hash ) {
+        cache_header* header = _cache.header();
+        uint64_t*     ghosts = _cache.ghosts();
+        uint32_t      pos    = header->ghost_next;
+        if ( ghosts[ pos ] ) {
+            uint32_t* bucket = find_bucket( _cache.ghost_buckets(), 2 * header->ghosts, ghosts[ pos ], [&]( uint32_t _i ) {
+                return _i == pos;
+            } );
+            if ( bucket ) {
+                erase_bucket( bucket, header->ghost_deleted );
+            }
+        }
+        ghosts[ pos ] = _hash;
+        insert_bucket( _cache.ghost_buckets(), 2 * header->ghosts, _hash, pos, header->ghost_deleted );
+        header->ghost_next = ( pos + 1 ) % header->ghosts;
+        if ( header->ghost_deleted > header->ghosts / 2 ) {
+            rebuild_ghosts( _cache );
+        }
+    }
+
+    bool take_ghost(
+        const cache_mapping& _cache,
+        uint64_t             _hash ) {
+        cache_header* header = _cache.header();
+        uint64_t*     ghosts = _cache.ghosts();
+        uint32_t*     bucket = find_bucket( _cache.ghost_buckets(), 2 * header->ghosts, _hash, [&]( uint32_t _i ) {
+            return ghosts[ _i ] == _hash;
+        } );
+        if ( !bucket ) {
+            return false;
+        }
+        ghosts[ *bucket - 1 ] = 0;
+        erase_bucket( bucket, header->ghost_deleted );
+        if ( header->ghost_deleted > header->ghosts / 2 ) {
+            rebuild_ghosts( _cache );
+        }
+        return true;
+    }
+
+    // =-=-=-=-=-=-=-
+    // an agent which died holding the lock may have left the lists and
+    // tables half changed.  they are laid out again from what each slot
+    // records: its queue, and its tick which orders the queues again.
+    void recover_index(
+        const cache_mapping& _cache ) {
+        cache_header* header = _cache.header();
+        std::vector< std::pair< uint64_t, uint32_t > > held;
+        header->free_head = 0;
+        header->in_head   = header->in_tail = 0;
+        header->am_head   = header->am_tail = 0;
+        header->in_count  = 0;
+        header->fresh     = std::min( header->fresh, header->slots );
+        for ( uint32_t i = header->fresh; i > 0; --i ) {
+            cache_slot* s = _cache.slot( i - 1 );
+            if ( QUEUE_A1IN == s->queue || QUEUE_AM == s->queue ) {
+                held.push_back( std::make_pair( s->tick, i - 1 ) );
+            }
+            else {
+                s->queue          = QUEUE_FREE;
+                s->next           = header->free_head;
+                header->free_head = i;
+            }
+        }
+        std::sort( held.begin(), held.end() );
+
+        memset( _cache.block_buckets(), 0, 4 * static_cast< size_t >( header->slots ) * sizeof( uint32_t ) );
+        header->block_deleted = 0;
+        header->inode_deleted = 0;
+        for ( size_t i = 0; i < held.size(); ++i ) {
+            link_slot( _cache, held[ i ].second );
+        }
+        header->ghost_next = header->ghost_next % header->ghosts;
+        rebuild_ghosts( _cache );
+    }
+
+    class locked_cache {
+        public:
+            explicit locked_cache( const cache_mapping& _cache ) : cache_( _cache ), lock_( *_cache.mutex ) {
+                while ( flock( cache_.index_fd, LOCK_EX ) < 0 && EINTR == errno ) {
+                }
+                if ( cache_.header()->changing ) {
+                    recover_index( cache_ );
+                }
+                cache_.header()->changing = 1;
+            }
+
+            ~locked_cache() {
+                cache_.header()->changing = 0;
+                flock( cache_.index_fd, LOCK_UN );
+            }
+
+        private:
+            const cache_mapping&             cache_;
+            std::lock_guard< std::mutex >    lock_;
+    };
+
+    // =-=-=-=-=-=-=-
+    // the oldest slot of a queue which is not being rewritten.  a slot
+    // being rewritten is passed over until a whole cache worth of blocks
+    // has gone by, so one left odd by a crashed writer is eventually
+    // reclaimed.
+    int oldest_settled(
+        const cache_mapping& _cache,
+        uint32_t             _queue ) {
+        cache_header* header = _cache.header();
+        uint32_t      next   = queue_head( header, _queue );
+        for ( uint32_t skipped = 0; next && skipped < MAX_SKIPPED; ++skipped ) {
+            const cache_slot* s = _cache.slot( next - 1 );
+            bool writing = s->generation.load( std::memory_order_relaxed ) & 1;
+            if ( !writing || header->tick - s->tick >= header->slots ) {
+                return next - 1;
+            }
+            next = s->next;
+        }
+        return -1;
+    }
+
+    // =-=-=-=-=-=-=-
+    // a slot to fill, out of the index: a free slot, else the head of
+    // A1in while it holds more than its share, else the least recently
+    // used block of Am.  a block evicted from A1in is remembered as a
+    // ghost.
+    int choose_victim(
+        const cache_mapping& _cache ) {
+        cache_header* header = _cache.header();
+        if ( header->free_head ) {
+            uint32_t index = header->free_head - 1;
+            header->free_head = _cache.slot( index )->next;
+            return index;
+        }
+        if ( header->fresh < header->slots ) {
+            return header->fresh++;
+        }
+
+        int victim = -1;
+        if ( header->in_count > std::max< uint32_t >( header->slots / 4, 1 ) || 0 == header->am_head ) {
+            victim = oldest_settled( _cache, QUEUE_A1IN );
+        }
+        if ( victim < 0 ) {
+            victim = oldest_settled( _cache, QUEUE_AM );
+        }
+        if ( victim < 0 ) {
+            victim = oldest_settled( _cache, QUEUE_A1IN );
+        }
+        if ( victim < 0 ) {
+            return -1;
+        }
+
+        cache_slot* s = _cache.slot( victim );
+        if ( QUEUE_A1IN == s->queue ) {
+            remember_ghost( _cache, slot_hash( *s ) );
+        }
+        header->evictions.fetch_add( 1, std::memory_order_relaxed );
+        unlink_slot( _cache, victim );
+        return victim;
+    }
+
+    ssize_t pread_full(
+        int    _fd,
+        char*  _buf,
+        size_t _len,
+        off_t  _offset ) {
+        size_t done = 0;
+        while ( done < _len ) {
+            ssize_t n = pread( _fd, _buf + done, _len - done, _offset + done );
+            if ( n < 0 && EINTR == errno ) {
+                continue;
+            }
+            if ( n < 0 ) {
+                return -errno;
+            }
+            if ( 0 == n ) {
+                break;
+            }
+            done += n;
+        }
+        return done;
+    }
+
+    // =-=-=-=-=-=-=-
+    // fill _buf with block _block of the file, from the cache when it holds
+    // it, otherwise from _fd and then into the cache
+    ssize_t read_block(
+        const cache_mapping&      _cache,
+        int                       _fd,
+        const shareuf_block_file& _file,
+        uint64_t                  _block,
+        char*                     _buf,
+        bool&                     _hit ) {
+        cache_header* header     = _cache.header();
+        uint32_t      block_size = header->block_size;
+        _hit = false;
+
+        int      index      = -1;
+        uint64_t generation = 0;
+        uint32_t length     = 0;
+        uint32_t crc        = 0;
+        {
+            locked_cache lock( _cache );
+            index = lookup( _cache, _file, _block );
+            if ( index >= 0 ) {
+                cache_slot* s = _cache.slot( index );
+                generation = s->generation.load( std::memory_order_acquire );
+                length     = s->length;
+                crc        = s->crc;
+                if ( generation & 1 ) {
+                    index = -1;
+                }
+                else if ( QUEUE_AM == s->queue ) {
+                    s->tick = ++header->tick;
+                    queue_remove( _cache, index );
+                    queue_push_back( _cache, index );
+                }
+            }
+        }
+
+        if ( index >= 0 &&
+                pread_full( _cache.data_fd, _buf, length, static_cast< off_t >( index ) * block_size ) == static_cast< ssize_t >( length ) &&
+                shareuf_crc32c( 0, _buf, length ) == crc &&
+                _cache.slot( index )->generation.load( std::memory_order_acquire ) == generation ) {
+            _hit = true;
+            header->hits.fetch_add( 1, std::memory_order_relaxed );
+            return length;
+        }
+
+        ssize_t n = pread_full( _fd, _buf, block_size, static_cast< off_t >( _block ) * block_size );
+        if ( n <= 0 ) {
+            return n;
+        }
+        header->misses.fetch_add( 1, std::memory_order_relaxed );
+
+        cache_slot* s = 0;
+        {
+            locked_cache lock( _cache );
+            if ( lookup( _cache, _file, _block ) >= 0 ) {
+                return n;
+            }
+            int victim = choose_victim( _cache );
+            if ( victim < 0 ) {
+                return n;
+            }
+            s = _cache.slot( victim );
+
+            // =-=-=-=-=-=-=-
+            // odd while the data is written, also when taking over a slot
+            // a crashed writer left odd
+            bool again = take_ghost( _cache, key_hash( _file, _block ) );
+            s->generation.store( ( s->generation.load( std::memory_order_relaxed ) + 2 ) | 1, std::memory_order_release );
+            s->dev      = _file.dev;
+            s->ino      = _file.ino;
+            s->mtime_ns = _file.mtime_ns;
+            s->block    = _block;
+            s->length   = n;
+            s->crc      = shareuf_crc32c( 0, _buf, n );
+            s->tick     = ++header->tick;
+            s->queue    = again ? QUEUE_AM : QUEUE_A1IN;
+            link_slot( _cache, victim );
+
+            index = victim;
+        }
+
+        bool written = pwrite( _cache.data_fd, _buf, n, static_cast< off_t >( index ) * block_size ) == n;
+        if ( !written ) {
+            locked_cache lock( _cache );
+            release_slot( _cache, index );
+        }
+        s->generation.fetch_add( 1, std::memory_order_acq_rel );
+        return n;
+    }
+
+} // namespace
+
+int shareuf_block_file_of(
+    int                 _fd,
+    shareuf_block_file& _out ) {
+    struct stat sb;
+    if ( fstat( _fd, &sb ) < 0 ) {
+        return -errno;
+    }
+    _out.dev      = sb.st_dev;
+    _out.ino      = sb.st_ino;
+    _out.mtime_ns = static_cast< int64_t >( sb.st_mtim.tv_sec ) * 1000000000LL + sb.st_mtim.tv_nsec;
+    return 0;
+
+} // shareuf_block_file_of
+
+ssize_t shareuf_cached_pread(
+    const shareuf_block_cache_options& _opts,
+    int                                _fd,
+    const shareuf_block_file&          _file,
+    void*                              _buf,
+    size_t                             _len,
+    off_t                              _offset,
+    shareuf_block_cache_io&            _io ) {
+    cache_mapping cache;
+    if ( attach( _opts, cache ) < 0 ) {
+        ssize_t n = pread( _fd, _buf, _len, _offset );
+        return n < 0 ? -errno : n;
+    }
+
+    uint32_t block_size = cache.header()->block_size;
+    thread_local std::vector< char > block;
+    block.resize( block_size );
+
+    size_t done = 0;
+    while ( done < _len ) {
+        off_t    offset = _offset + done;
+        uint64_t index  = offset / block_size;
+        size_t   skip   = offset % block_size;
+        bool     hit    = false;
+        ssize_t  n      = read_block( cache, _fd, _file, index, block.data(), hit );
+        if ( n < 0 ) {
+            return done > 0 ? static_cast< ssize_t >( done ) : n;
+        }
+        if ( static_cast< size_t >( n ) <= skip ) {
+            break;
+        }
+
+        size_t count = std::min( static_cast< size_t >( n ) - skip, _len - done );
+        memcpy( static_cast< char* >( _buf ) + done, block.data() + skip, count );
+        done += count;
+        if ( hit ) {
+            ++_io.hits;
+            _io.bytes_saved += count;
+            cache.header()->bytes_saved.fetch_add( count, std::memory_order_relaxed );
+        }
+        else {
+            ++_io.misses;
+        }
+        if ( static_cast< size_t >( n ) < block_size ) {
+            break;
+        }
+    }
+    return done;
+
+} // shareuf_cached_pread
+
+void shareuf_block_cache_invalidate(
+    const shareuf_block_cache_options& _opts,
+    uint64_t                           _dev,
+    uint64_t                           _ino ) {
+    cache_mapping cache;
+    if ( attach( _opts, cache ) < 0 ) {
+        return;
+    }
+
+    // =-=-=-=-=-=-=-
+    // walk the chain of the blocks of the file, a file never cached has
+    // none.  a block being written stays, it is keyed by the mtime it was
+    // read at.
+    locked_cache lock( cache );
+    uint32_t* first = find_inode( cache, _dev, _ino );
+    for ( uint32_t next = first ? *first : 0; next; ) {
+        uint32_t    index = next - 1;
+        cache_slot* s     = cache.slot( index );
+        next = s->inode_next;
+        if ( 0 == ( s->generation.load( std::memory_order_relaxed ) & 1 ) ) {
+            release_slot( cache, index );
+            s->generation.fetch_add( 2, std::memory_order_acq_rel );
+        }
+    }
+
+} // shareuf_block_cache_invalidate
+
+int shareuf_block_cache_read_totals(
+    const shareuf_block_cache_options& _opts,
+    shareuf_block_cache_totals&        _out ) {
+    cache_mapping cache;
+    int status = attach( _opts, cache );
+    if ( status < 0 ) {
+        return status;
+    }
+    _out.hits        = cache.header()->hits.load();
+    _out.misses      = cache.header()->misses.load();
+    _out.bytes_saved = cache.header()->bytes_saved.load();
+    _out.evictions   = cache.header()->evictions.load();
+    return 0;
+
+} // shareuf_block_cache_read_totals
@@ -0,0 +1,103 @@
+/* Read-through block cache on a local SSD in front of slow vault storage.
+ *
+ * The cache directory holds a data file of fixed-size slots and an index
+ * file mapped by every agent on the host.  Blocks are keyed by the device,
+ * inode and mtime of the file they come from and their index in it, so a
+ * file changed behind the plugin's back simply stops hitting; writes,
+ * truncates and unlinks through the plugin also drop its blocks.
+ *
+ * Replacement follows 2Q: a block read once enters a FIFO limited to a
+ * quarter of the slots, a block read again while still remembered in the
+ * ghost list of recently evicted FIFO blocks enters an LRU.  A single scan
+ * of a large file thus only cycles the FIFO and leaves the LRU alone.
+ * The queues are lists linked through the slots, the ghosts have a hash
+ * table of their own and the blocks of a file are chained together, so
+ * neither a miss nor dropping a file's blocks scans the index.
+ *
+ * The index is changed under an flock.  An agent which dies holding it
+ * leaves a mark, and the next holder lays the lists and tables out again
+ * from the slots.  Each slot carries a generation
+ * which is odd while its data is rewritten, and a CRC32C of its data, so a
+ * reader copying a block outside the lock, or after a crash which lost
+ * some data file writes, never returns the wrong bytes.
+ */
+#ifndef SHAREUF_BLOCK_CACHE_HPP
+#define SHAREUF_BLOCK_CACHE_HPP
+
+// =-=-=-=-=-=-=-
+// stl includes
+#include <string>
+
+// =-=-=-=-=-=-=-
+// system includes
+#include <stdint.h>
+#include <sys/types.h>
+
+struct shareuf_block_cache_options {
+    std::string dir;            // cache directory, created if missing
+    mode_t      dir_mode;       // of the cache directory
+    uint64_t    size;           // bytes of cached data
+    uint32_t    block_size;
+
+    shareuf_block_cache_options() : dir_mode( 0755 ), size( 0 ), block_size( 0 ) {}
+};
+
+// =-=-=-=-=-=-=-
+/// @brief identity of a cached file
+struct shareuf_block_file {
+    uint64_t dev;
+    uint64_t ino;
+    int64_t  mtime_ns;
+
+    shareuf_block_file() : dev( 0 ), ino( 0 ), mtime_ns( 0 ) {}
+};
+
+struct shareuf_block_cache_io {
+    unsigned long long hits;
+    unsigned long long misses;
+    unsigned long long bytes_saved;     // bytes served from the cache
+
+    shareuf_block_cache_io() : hits( 0 ), misses( 0 ), bytes_saved( 0 ) {}
+};
+
+struct shareuf_block_cache_totals {
+    unsigned long long hits;
+    unsigned long long misses;
+    unsigned long long bytes_saved;
+    unsigned long long evictions;
+
+    shareuf_block_cache_totals() : hits( 0 ), misses( 0 ), bytes_saved( 0 ), evictions( 0 ) {}
+};
+
+// =-=-=-=-=-=-=-
+/// @brief identity of the file open as _fd, returns 0 or -errno
+int shareuf_block_file_of( int _fd, shareuf_block_file& _out );
+
+// =-=-=-=-=-=-=-
+/// @brief read up to _len bytes at _offset of the file _file open as _fd,
+///        through the cache.  an existing cache keeps the geometry it was
+///        made with.  returns the bytes read, 0 at end of file, or -errno;
+///        a cache which cannot be used is bypassed.
+ssize_t shareuf_cached_pread(
+    const shareuf_block_cache_options& _opts,
+    int                                _fd,
+    const shareuf_block_file&          _file,
+    void*                              _buf,
+    size_t                             _len,
+    off_t                              _offset,
+    shareuf_block_cache_io&            _io );
+
+// =-=-=-=-=-=-=-
+/// @brief drop every cached block of the file with _dev and _ino
+void shareuf_block_cache_invalidate(
+    const shareuf_block_cache_options& _opts,
+    uint64_t                           _dev,
+    uint64_t                           _ino );
+
+// =-=-=-=-=-=-=-
+/// @brief counters of the cache since it was made, returns 0 or -errno
+int shareuf_block_cache_read_totals(
+    const shareuf_block_cache_options& _opts,
+    shareuf_block_cache_totals&        _out );
+
+#endif // SHAREUF_BLOCK_CACHE_HPP
@@ -0,0 +1,206 @@
+#include "shareuf_block_diff.hpp"
+
+// =-=-=-=-=-=-=-
+// stl includes
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+// =-=-=-=-=-=-=-
+// system includes
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
+namespace {
+
+    // =-=-=-=-=-=-=-
+    // read exactly _len bytes at _offset, returns 0 or -errno; a file which
+    // ends early reads as -EIO since its size was already checked
+    int pread_full(
+        int    _fd,
+        char*  _buf,
+        size_t _len,
+        off_t  _offset ) {
+        size_t done = 0;
+        while ( done < _len ) {
+            ssize_t n = pread( _fd, _buf + done, _len - done, _offset + done );
+            if ( n < 0 ) {
+                if ( EINTR == errno ) {
+                    continue;
+                }
+                return -errno;
+            }
+            if ( 0 == n ) {
+                return -EIO;
+            }
+            done += n;
+        }
+        return 0;
+    }
+
+    int pwrite_full(
+        int         _fd,
+        const char* _buf,
+        size_t      _len,
+        off_t       _offset ) {
+        size_t done = 0;
+        while ( done < _len ) {
+            ssize_t n = pwrite( _fd, _buf + done, _len - done, _offset + done );
+            if ( n < 0 ) {
+                if ( EINTR == errno ) {
+                    continue;
+                }
+                return -errno;
+            }
+            done += n;
+        }
+        return 0;
+    }
+
+    class block_differ {
+        public:
+            block_differ(
+                int                               _src_fd,
+                off_t                             _src_size,
+                int                               _dst_fd,
+                off_t                             _dst_size,
+                const shareuf_block_diff_options& _opts ) :
+                src_fd_( _src_fd ),
+                src_size_( _src_size ),
+                dst_fd_( _dst_fd ),
+                dst_size_( _dst_size ),
+                opts_( _opts ),
+                blocks_( ( _src_size + _opts.block_size - 1 ) / _opts.block_size ),
+                changed_limit_( static_cast< unsigned long long >( _opts.max_changed_fraction * _src_size ) ),
+                next_( 0 ),
+                status_( 0 ),
+                changed_blocks_( 0 ),
+                changed_bytes_( 0 ),
+                saved_bytes_( 0 ) {
+            }
+
+            int run( shareuf_block_diff_summary& _summary ) {
+                unsigned threads = opts_.threads > 0 ? opts_.threads : 1;
+                if ( threads > blocks_ ) {
+                    threads = blocks_ > 0 ? static_cast< unsigned >( blocks_ ) : 1;
+                }
+
+                std::vector< std::thread > pool;
+                for ( unsigned i = 1; i < threads; ++i ) {
+                    pool.push_back( std::thread( &block_differ::worker, this ) );
+                }
+                worker();
+                for ( size_t i = 0; i < pool.size(); ++i ) {
+                    pool[ i ].join();
+                }
+
+                _summary.blocks         = blocks_;
+                _summary.changed_blocks = changed_blocks_;
+                _summary.bytes_written  = changed_bytes_;
+                _summary.bytes_saved    = saved_bytes_;
+                return status_;
+            }
+
+        private:
+            void fail( int _status ) {
+                int expected = 0;
+                status_.compare_exchange_strong( expected, _status );
+            }
+
+            void worker() {
+                std::unique_ptr< char[] > src( new char[ opts_.block_size ] );
+                std::unique_ptr< char[] > dst( new char[ opts_.block_size ] );
+
+                for ( ;; ) {
+                    unsigned long long block = next_.fetch_add( 1 );
+                    if ( block >= blocks_ || 0 != status_.load() ) {
+                        return;
+                    }
+
+                    off_t  offset = static_cast< off_t >( block * opts_.block_size );
+                    size_t len    = static_cast< size_t >( std::min< off_t >( opts_.block_size, src_size_ - offset ) );
+
+                    int status = pread_full( src_fd_, src.get(), len, offset );
+                    if ( status < 0 ) {
+                        fail( status );
+                        return;
+                    }
+                    if ( opts_.on_read ) {
+                        opts_.on_read( len );
+                    }
+
+                    // =-=-=-=-=-=-=-
+                    // blocks reaching past the end of the destination are
+                    // written whatever their content
+                    if ( offset + static_cast< off_t >( len ) <= dst_size_ ) {
+                        status = pread_full( dst_fd_, dst.get(), len, offset );
+                        if ( status < 0 ) {
+                            fail( status );
+                            return;
+                        }
+                        if ( 0 == memcmp( src.get(), dst.get(), len ) ) {
+                            saved_bytes_ += len;
+                            continue;
+                        }
+                    }
+
+                    if ( changed_bytes_.fetch_add( len ) + len > changed_limit_ ) {
+                        fail( -E2BIG );
+                        return;
+                    }
+                    status = pwrite_full( dst_fd_, src.get(), len, offset );
+                    if ( status < 0 ) {
+                        fail( status );
+                        return;
+                    }
+                    ++changed_blocks_;
+                }
+            }
+
+            int                                 src_fd_;
+            off_t                               src_size_;
+            int                                 dst_fd_;
+            off_t                               dst_size_;
+            const shareuf_block_diff_options&   opts_;
+            unsigned long long                  blocks_;
+            unsigned long long                  changed_limit_;
+            std::atomic< unsigned long long >   next_;
+            std::atomic< int >                  status_;
+            std::atomic< unsigned long long >   changed_blocks_;
+            std::atomic< unsigned long long >   changed_bytes_;
+            std::atomic< unsigned long long >   saved_bytes_;
+
+    }; // class block_differ
+
+} // namespace
+
+int shareuf_block_diff_sync(
+    int                               _src_fd,
+    off_t                             _src_size,
+    int                               _dst_fd,
+    const shareuf_block_diff_options& _opts,
+    shareuf_block_diff_summary&       _summary ) {
+    if ( 0 == _opts.block_size ) {
+        return -EINVAL;
+    }
+
+    off_t dst_size = lseek( _dst_fd, 0, SEEK_END );
+    if ( dst_size < 0 ) {
+        return -errno;
+    }
+
+    block_differ differ( _src_fd, _src_size, _dst_fd, dst_size, _opts );
+    int status = differ.run( _summary );
+    if ( status < 0 ) {
+        return status;
+    }
+
+    if ( dst_size > _src_size && ftruncate( _dst_fd, _src_size ) < 0 ) {
+        return -errno;
+    }
+    return 0;
+
+} // shareuf_block_diff_sync
@@ -0,0 +1,60 @@
+/* Block differential update of one file from another, used to sync a
+ * cache copy back over an archive copy that differs from it in only a
+ * few places, such as an appended log or a small edit to a big table.
+ *
+ * Both files are read in fixed-size blocks by a pool of threads, and only
+ * the blocks that differ are rewritten in place.  Blocks are compared
+ * byte for byte, which reads no more than hashing both sides would and
+ * cannot miss a change through a collision.
+ */
+#ifndef SHAREUF_BLOCK_DIFF_HPP
+#define SHAREUF_BLOCK_DIFF_HPP
+
+// =-=-=-=-=-=-=-
+// stl includes
+#include <functional>
+
+// =-=-=-=-=-=-=-
+// system includes
+#include <stddef.h>
+#include <sys/types.h>
+
+struct shareuf_block_diff_options {
+    size_t                            block_size;
+    double                            max_changed_fraction;   // of the source, before giving up
+    unsigned                          threads;
+    std::function< void( size_t ) >   on_read;                // charged per source block, may be empty
+
+    shareuf_block_diff_options() :
+        block_size( 1024 * 1024 ),
+        max_changed_fraction( 0.5 ),
+        threads( 4 ) {
+    }
+};
+
+struct shareuf_block_diff_summary {
+    unsigned long long blocks;
+    unsigned long long changed_blocks;
+    unsigned long long bytes_written;
+    unsigned long long bytes_saved;
+
+    shareuf_block_diff_summary() :
+        blocks( 0 ), changed_blocks( 0 ), bytes_written( 0 ), bytes_saved( 0 ) {
+    }
+};
+
+// =-=-=-=-=-=-=-
+/// @brief make the file open read-write as _dst_fd identical to the first
+///        _src_size bytes of _src_fd, rewriting only the blocks that differ
+///        and truncating or extending _dst_fd to _src_size.
+///        returns 0, -E2BIG once more than max_changed_fraction of the
+///        source differs, or -errno.  on failure _dst_fd may be partly
+///        updated and should be rewritten in full.
+int shareuf_block_diff_sync(
+    int                               _src_fd,
+    off_t                             _src_size,
+    int                               _dst_fd,
+    const shareuf_block_diff_options& _opts,
+    shareuf_block_diff_summary&       _summary );
+
+#endif // SHAREUF_BLOCK_DIFF_HPP
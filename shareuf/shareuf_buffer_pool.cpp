@@ -0,0 +1,172 @@
+#include "shareuf_buffer_pool.hpp"
+#include "shareuf_metrics.hpp"
+
+// =-=-=-=-=-=-=-
+// system includes
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace {
+    const size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+    size_t round_up(
+        size_t _size,
+        size_t _unit ) {
+        return ( _size + _unit - 1 ) / _unit * _unit;
+    }
+}
+
+shareuf_buffer_pool::buffer::buffer(
+    buffer&& _rhs ) :
+    data_( _rhs.data_ ),
+    size_( _rhs.size_ ) {
+    _rhs.data_ = 0;
+    _rhs.size_ = 0;
+
+} // move ctor
+
+shareuf_buffer_pool::buffer& shareuf_buffer_pool::buffer::operator=(
+    buffer&& _rhs ) {
+    if ( this != &_rhs ) {
+        if ( data_ ) {
+            shareuf_buffer_pool::instance().release( data_, size_ );
+        }
+        data_      = _rhs.data_;
+        size_      = _rhs.size_;
+        _rhs.data_ = 0;
+        _rhs.size_ = 0;
+    }
+    return *this;
+
+} // move assignment
+
+shareuf_buffer_pool::buffer::~buffer() {
+    if ( data_ ) {
+        shareuf_buffer_pool::instance().release( data_, size_ );
+    }
+
+} // dtor
+
+shareuf_buffer_pool& shareuf_buffer_pool::instance() {
+    static shareuf_buffer_pool pool;
+    return pool;
+
+} // instance
+
+shareuf_buffer_pool::shareuf_buffer_pool() :
+    max_cached_( 4 ),
+    hugetlb_( false ) {
+    stats_.allocations  = 0;
+    stats_.reuses       = 0;
+    stats_.hugetlb      = 0;
+    stats_.failures     = 0;
+    stats_.cached       = 0;
+    stats_.cached_bytes = 0;
+    stats_.outstanding  = 0;
+
+} // ctor
+
+shareuf_buffer_pool::~shareuf_buffer_pool() {
+    trim();
+
+} // dtor
+
+void shareuf_buffer_pool::configure(
+    size_t _max_cached,
+    bool   _hugetlb ) {
+    std::lock_guard< std::mutex > lock( mutex_ );
+    max_cached_ = _max_cached;
+    hugetlb_    = _hugetlb;
+
+} // configure
+
+shareuf_buffer_pool::buffer shareuf_buffer_pool::acquire(
+    size_t _size ) {
+    size_t page = static_cast< size_t >( sysconf( _SC_PAGESIZE ) );
+    size_t size = _size >= HUGE_PAGE_SIZE ? round_up( _size, HUGE_PAGE_SIZE ) : round_up( _size, page );
+
+    bool hugetlb;
+    {
+        std::lock_guard< std::mutex > lock( mutex_ );
+        // =-=-=-=-=-=-=-
+        // do not hand a large idle buffer to a small request
+        std::multimap< size_t, char* >::iterator itr = idle_.lower_bound( size );
+        if ( itr != idle_.end() && itr->first <= 2 * size ) {
+            buffer b( itr->second, itr->first );
+            stats_.cached_bytes -= itr->first;
+            idle_.erase( itr );
+            stats_.cached = idle_.size();
+            ++stats_.reuses;
+            ++stats_.outstanding;
+            shareuf_metrics::instance().add( "buffer_pool.reuses", 1 );
+            return b;
+        }
+        hugetlb = hugetlb_ && size >= HUGE_PAGE_SIZE;
+    }
+
+    // =-=-=-=-=-=-=-
+    // explicit huge pages may not be reserved, fall back to normal pages
+    // with a transparent huge page hint
+    void* p = MAP_FAILED;
+    if ( hugetlb ) {
+        p = mmap( 0, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0 );
+    }
+    bool got_hugetlb = p != MAP_FAILED;
+    if ( !got_hugetlb ) {
+        p = mmap( 0, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 );
+        if ( p != MAP_FAILED && size >= HUGE_PAGE_SIZE ) {
+            madvise( p, size, MADV_HUGEPAGE );
+        }
+    }
+
+    std::lock_guard< std::mutex > lock( mutex_ );
+    if ( p == MAP_FAILED ) {
+        ++stats_.failures;
+        return buffer();
+    }
+    ++stats_.allocations;
+    ++stats_.outstanding;
+    if ( got_hugetlb ) {
+        ++stats_.hugetlb;
+    }
+    shareuf_metrics::instance().add( "buffer_pool.allocations", 1 );
+    return buffer( static_cast< char* >( p ), size );
+
+} // acquire
+
+void shareuf_buffer_pool::release(
+    char*  _data,
+    size_t _size ) {
+    {
+        std::lock_guard< std::mutex > lock( mutex_ );
+        --stats_.outstanding;
+        if ( idle_.size() < max_cached_ ) {
+            idle_.insert( std::make_pair( _size, _data ) );
+            stats_.cached       = idle_.size();
+            stats_.cached_bytes += _size;
+            return;
+        }
+    }
+    munmap( _data, _size );
+
+} // release
+
+void shareuf_buffer_pool::trim() {
+    std::multimap< size_t, char* > idle;
+    {
+        std::lock_guard< std::mutex > lock( mutex_ );
+        idle.swap( idle_ );
+        stats_.cached       = 0;
+        stats_.cached_bytes = 0;
+    }
+    for ( std::multimap< size_t, char* >::iterator itr = idle.begin(); itr != idle.end(); ++itr ) {
+        munmap( itr->second, itr->first );
+    }
+
+} // trim
+
+shareuf_buffer_pool::stats shareuf_buffer_pool::get_stats() {
+    std::lock_guard< std::mutex > lock( mutex_ );
+    return stats_;
+
+} // get_stats
@@ -0,0 +1,87 @@
+/* Process-wide pool of page aligned staging buffers.  Buffers are mapped
+ * anonymously, optionally from explicit huge pages (MAP_HUGETLB) and
+ * otherwise with transparent huge pages requested, and kept mapped after
+ * use so back to back transfers do not fault and zero fresh memory.
+ */
+#ifndef SHAREUF_BUFFER_POOL_HPP
+#define SHAREUF_BUFFER_POOL_HPP
+
+// =-=-=-=-=-=-=-
+// stl includes
+#include <map>
+#include <mutex>
+
+// =-=-=-=-=-=-=-
+// system includes
+#include <stddef.h>
+
+class shareuf_buffer_pool {
+    public:
+        // =-=-=-=-=-=-=-
+        /// @brief a buffer on loan from the pool, returned when destroyed
+        class buffer {
+            public:
+                buffer() : data_( 0 ), size_( 0 ) {}
+                buffer( buffer&& _rhs );
+                buffer& operator=( buffer&& _rhs );
+                ~buffer();
+
+                char*  data() const { return data_; }
+                size_t size() const { return size_; }
+
+                /// @brief true unless the allocation failed
+                explicit operator bool() const { return data_ != 0; }
+
+            private:
+                friend class shareuf_buffer_pool;
+                buffer( char* _data, size_t _size ) : data_( _data ), size_( _size ) {}
+                buffer( const buffer& );
+                buffer& operator=( const buffer& );
+
+                char*  data_;
+                size_t size_;
+        };
+
+        struct stats {
+            unsigned long long allocations;     // fresh mappings
+            unsigned long long reuses;          // requests served from the cache
+            unsigned long long hugetlb;         // mappings backed by MAP_HUGETLB
+            unsigned long long failures;
+            size_t             cached;          // buffers parked in the pool
+            size_t             cached_bytes;
+            size_t             outstanding;     // buffers on loan
+        };
+
+        static shareuf_buffer_pool& instance();
+
+        // =-=-=-=-=-=-=-
+        /// @brief _max_cached bounds the number of idle buffers kept mapped,
+        ///        _hugetlb asks for explicit huge pages first
+        void configure( size_t _max_cached, bool _hugetlb );
+
+        // =-=-=-=-=-=-=-
+        /// @brief borrow a buffer of at least _size bytes, aligned to a page,
+        ///        test the result for allocation failure
+        buffer acquire( size_t _size );
+
+        // =-=-=-=-=-=-=-
+        /// @brief unmap every idle buffer
+        void trim();
+
+        stats get_stats();
+
+    private:
+        shareuf_buffer_pool();
+        ~shareuf_buffer_pool();
+
+        void release( char* _data, size_t _size );
+
+        std::mutex                     mutex_;
+        std::multimap< size_t, char* > idle_;
+        size_t                         max_cached_;
+        bool                           hugetlb_;
+        stats                          stats_;
+
+}; // class shareuf_buffer_pool
+
+#endif // SHAREUF_BUFFER_POOL_HPP
@@ -0,0 +1,196 @@
+#include "shareuf_bulk_ingest.hpp"
+
+// =-=-=-=-=-=-=-
+// system includes
+#include <dirent.h>
+#include <string.h>
+
+namespace {
+
+    // =-=-=-=-=-=-=-
+    // a cache this big means the ingest is not confined to a few
+    // directories, starting over costs only some probes
+    const size_t MAX_CACHED_DIRECTORIES = 65536;
+
+} // namespace
+
+shareuf_bulk_ingest& shareuf_bulk_ingest::instance() {
+    static shareuf_bulk_ingest state;
+    return state;
+
+} // instance
+
+void shareuf_bulk_ingest::start(
+    long long _expected,
+    unsigned  _idle_seconds ) {
+    std::lock_guard< std::mutex > lock( mutex_ );
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    if ( !active_ ) {
+        // =-=-=-=-=-=-=-
+        // every object of a recursive put carries the same count
+        active_           = true;
+        expected_         = _expected;
+        started_          = now;
+        summary_          = shareuf_bulk_ingest_summary();
+        summary_.expected = _expected;
+        directories_.clear();
+    }
+    idle_seconds_ = _idle_seconds;
+    last_used_    = now;
+
+} // start
+
+bool shareuf_bulk_ingest::active() {
+    std::lock_guard< std::mutex > lock( mutex_ );
+    return active_ && !done_locked();
+
+} // active
+
+bool shareuf_bulk_ingest::done_locked() const {
+    return summary_.objects >= expected_ ||
+           std::chrono::steady_clock::now() - last_used_ > std::chrono::seconds( idle_seconds_ );
+
+} // done_locked
+
+bool shareuf_bulk_ingest::finish_if_done(
+    shareuf_bulk_ingest_summary& _out ) {
+    std::lock_guard< std::mutex > lock( mutex_ );
+    if ( !active_ || !done_locked() ) {
+        return false;
+    }
+    finish_locked( _out );
+    return true;
+
+} // finish_if_done
+
+bool shareuf_bulk_ingest::finish(
+    shareuf_bulk_ingest_summary& _out ) {
+    std::lock_guard< std::mutex > lock( mutex_ );
+    if ( !active_ ) {
+        return false;
+    }
+    finish_locked( _out );
+    return true;
+
+} // finish
+
+void shareuf_bulk_ingest::finish_locked(
+    shareuf_bulk_ingest_summary& _out ) {
+    for ( std::map< std::string, batch >::iterator itr = batches_.begin(); itr != batches_.end(); ++itr ) {
+        shareuf_release_reservation( itr->second.reservation );
+    }
+    batches_.clear();
+    directories_.clear();
+
+    active_          = false;
+    summary_.seconds = std::chrono::duration< double >( std::chrono::steady_clock::now() - started_ ).count();
+    _out             = summary_;
+
+} // finish_locked
+
+void shareuf_bulk_ingest::note_object() {
+    std::lock_guard< std::mutex > lock( mutex_ );
+    if ( active_ ) {
+        ++summary_.objects;
+        last_used_ = std::chrono::steady_clock::now();
+    }
+
+} // note_object
+
+bool shareuf_bulk_ingest::known_directory(
+    const std::string& _dir ) {
+    std::lock_guard< std::mutex > lock( mutex_ );
+    return active_ && directories_.count( _dir ) > 0;
+
+} // known_directory
+
+void shareuf_bulk_ingest::add_directory(
+    const std::string& _dir,
+    bool               _made ) {
+    std::lock_guard< std::mutex > lock( mutex_ );
+    if ( !active_ ) {
+        return;
+    }
+    if ( directories_.size() >= MAX_CACHED_DIRECTORIES ) {
+        directories_.clear();
+    }
+    directories_.insert( _dir );
+    if ( _made ) {
+        ++summary_.directories;
+    }
+
+} // add_directory
+
+void shareuf_bulk_ingest::forget_directory(
+    const std::string& _dir ) {
+    std::lock_guard< std::mutex > lock( mutex_ );
+    std::set< std::string >::iterator itr = directories_.lower_bound( _dir );
+    while ( itr != directories_.end() && itr->compare( 0, _dir.size(), _dir ) == 0 &&
+            ( itr->size() == _dir.size() || '/' == ( *itr )[ _dir.size() ] ) ) {
+        directories_.erase( itr++ );
+    }
+
+} // forget_directory
+
+void shareuf_bulk_ingest::prewarm(
+    const std::string& _dir ) {
+    std::set< std::string > found;
+    for ( std::string::size_type pos = _dir.find( '/', 1 ); pos != std::string::npos; pos = _dir.find( '/', pos + 1 ) ) {
+        found.insert( _dir.substr( 0, pos ) );
+    }
+    found.insert( _dir );
+
+    DIR* dir = opendir( _dir.c_str() );
+    if ( !dir ) {
+        return;
+    }
+    while ( struct dirent* entry = readdir( dir ) ) {
+        if ( DT_DIR == entry->d_type && strcmp( entry->d_name, "." ) != 0 && strcmp( entry->d_name, ".." ) != 0 ) {
+            found.insert( _dir + "/" + entry->d_name );
+        }
+    }
+    closedir( dir );
+
+    std::lock_guard< std::mutex > lock( mutex_ );
+    if ( active_ && directories_.size() + found.size() <= MAX_CACHED_DIRECTORIES ) {
+        directories_.insert( found.begin(), found.end() );
+    }
+
+} // prewarm
+
+bool shareuf_bulk_ingest::draw(
+    const std::string& _ledger,
+    int64_t            _bytes ) {
+    std::lock_guard< std::mutex > lock( mutex_ );
+    std::map< std::string, batch >::iterator itr = batches_.find( _ledger );
+    if ( !active_ || itr == batches_.end() || itr->second.remaining < _bytes ) {
+        return false;
+    }
+    itr->second.remaining -= _bytes;
+    return true;
+
+} // draw
+
+void shareuf_bulk_ingest::drop(
+    const std::string& _ledger ) {
+    std::lock_guard< std::mutex > lock( mutex_ );
+    std::map< std::string, batch >::iterator itr = batches_.find( _ledger );
+    if ( itr != batches_.end() ) {
+        shareuf_release_reservation( itr->second.reservation );
+        batches_.erase( itr );
+    }
+
+} // drop
+
+void shareuf_bulk_ingest::hold(
+    const std::string&         _ledger,
+    const shareuf_reservation& _res,
+    int64_t                    _bytes ) {
+    std::lock_guard< std::mutex > lock( mutex_ );
+    batch& b = batches_[ _ledger ];
+    shareuf_release_reservation( b.reservation );
+    b.reservation = _res;
+    b.remaining   = _bytes;
+    ++summary_.refills;
+
+} // hold
@@ -0,0 +1,113 @@
+/* Bulk-ingest mode of an agent.
+ *
+ * A recursive put announces how many objects it is about to send.  When
+ * that is large the agent switches to a mode tuned for many small creates
+ * in few directories: directories known to exist are remembered instead of
+ * being probed for every object, free space is reserved once for a batch
+ * of objects rather than once per create, and per-object logging is
+ * demoted in favour of a summary when the mode ends.  The mode ends once
+ * the announced objects have been created or the agent has been idle for
+ * a while.
+ */
+#ifndef SHAREUF_BULK_INGEST_HPP
+#define SHAREUF_BULK_INGEST_HPP
+
+#include "shareuf_reservations.hpp"
+
+// =-=-=-=-=-=-=-
+// stl includes
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+
+// =-=-=-=-=-=-=-
+// system includes
+#include <stdint.h>
+
+struct shareuf_bulk_ingest_summary {
+    long long expected;
+    long long objects;
+    long long directories;
+    long long refills;
+    double    seconds;
+
+    shareuf_bulk_ingest_summary() :
+        expected( 0 ), objects( 0 ), directories( 0 ), refills( 0 ), seconds( 0 ) {
+    }
+};
+
+// =-=-=-=-=-=-=-
+/// @brief process-wide bulk-ingest state
+class shareuf_bulk_ingest {
+    public:
+        static shareuf_bulk_ingest& instance();
+
+        /// @brief switch the mode on for _expected objects, or keep it on
+        void start( long long _expected, unsigned _idle_seconds );
+
+        bool active();
+
+        /// @brief end the mode if its objects are in or it went idle,
+        ///        releasing any batch reservation.  true if it just ended.
+        bool finish_if_done( shareuf_bulk_ingest_summary& _out );
+
+        /// @brief end the mode now, true if it was on
+        bool finish( shareuf_bulk_ingest_summary& _out );
+
+        /// @brief count a created object
+        void note_object();
+
+        // =-=-=-=-=-=-=-
+        // directory cache, only consulted while the mode is on
+        bool known_directory( const std::string& _dir );
+        void add_directory( const std::string& _dir, bool _made );
+
+        /// @brief forget _dir and everything below it
+        void forget_directory( const std::string& _dir );
+
+        /// @brief remember _dir, its ancestors and its subdirectories
+        void prewarm( const std::string& _dir );
+
+        // =-=-=-=-=-=-=-
+        // batch reservations, one per ledger
+
+        /// @brief take _bytes from the batch held for _ledger, false if it
+        ///        does not have them
+        bool draw( const std::string& _ledger, int64_t _bytes );
+
+        /// @brief give back what is left of the batch held for _ledger,
+        ///        before reserving the next one so it is not counted twice
+        void drop( const std::string& _ledger );
+
+        /// @brief hold _res as the batch for _ledger, releasing any other
+        ///        one held meanwhile
+        void hold( const std::string& _ledger, const shareuf_reservation& _res, int64_t _bytes );
+
+    private:
+        shareuf_bulk_ingest() :
+            active_( false ), expected_( 0 ), idle_seconds_( 0 ) {
+        }
+
+        struct batch {
+            shareuf_reservation reservation;
+            int64_t             remaining;
+        };
+
+        bool done_locked() const;
+        void finish_locked( shareuf_bulk_ingest_summary& _out );
+
+        std::mutex                                   mutex_;
+        bool                                         active_;
+        long long                                    expected_;
+        unsigned                                     idle_seconds_;
+        std::chrono::steady_clock::time_point        started_;
+        std::chrono::steady_clock::time_point        last_used_;
+        shareuf_bulk_ingest_summary                  summary_;
+        std::set< std::string >                      directories_;
+        std::map< std::string, batch >               batches_;
+
+}; // class shareuf_bulk_ingest
+
+#endif // SHAREUF_BULK_INGEST_HPP
@@ -0,0 +1,296 @@
+#include "shareuf_checksum.hpp"
+#include "shareuf_checksum_kernels.hpp"
+
+// =-=-=-=-=-=-=-
+// system includes
+#include <string.h>
+#if defined(__x86_64__)
+#include <cpuid.h>
+#endif
+
+// =-=-=-=-=-=-=-
+// runtime kernel selection
+bool shareuf_cpu_has_sse42() {
+#if defined(__x86_64__)
+    unsigned int eax, ebx, ecx, edx;
+    if ( !__get_cpuid( 1, &eax, &ebx, &ecx, &edx ) ) {
+        return false;
+    }
+    return ( ecx & bit_SSE4_2 ) != 0;
+#else
+    return false;
+#endif
+
+} // shareuf_cpu_has_sse42
+
+bool shareuf_cpu_has_shani() {
+#if defined(__x86_64__)
+    unsigned int eax, ebx, ecx, edx;
+    if ( !__get_cpuid( 1, &eax, &ebx, &ecx, &edx ) || !( ecx & bit_SSE4_1 ) || !( ecx & bit_SSSE3 ) ) {
+        return false;
+    }
+    if ( __get_cpuid_max( 0, NULL ) < 7 ) {
+        return false;
+    }
+    __cpuid_count( 7, 0, eax, ebx, ecx, edx );
+    return ( ebx & ( 1u << 29 ) ) != 0;
+#else
+    return false;
+#endif
+
+} // shareuf_cpu_has_shani
+
+namespace {
+    struct checksum_kernels {
+        shareuf_crc32c_kernel_t crc32c;
+        const char*             crc32c_name;
+        shareuf_sha256_kernel_t sha256;
+        const char*             sha256_name;
+
+        checksum_kernels() :
+            crc32c( shareuf_crc32c_scalar ),
+            crc32c_name( "scalar" ),
+            sha256( shareuf_sha256_blocks_scalar ),
+            sha256_name( "scalar" ) {
+            if ( shareuf_cpu_has_sse42() ) {
+                crc32c      = shareuf_crc32c_sse42;
+                crc32c_name = "sse4.2";
+            }
+            if ( shareuf_cpu_has_shani() ) {
+                sha256      = shareuf_sha256_blocks_shani;
+                sha256_name = "sha-ni";
+            }
+        }
+    };
+
+    const checksum_kernels& kernels() {
+        static const checksum_kernels k;
+        return k;
+    }
+}
+
+const char* shareuf_crc32c_kernel_name() {
+    return kernels().crc32c_name;
+
+} // shareuf_crc32c_kernel_name
+
+const char* shareuf_sha256_kernel_name() {
+    return kernels().sha256_name;
+
+} // shareuf_sha256_kernel_name
+
+// =-=-=-=-=-=-=-
+// SHA-256, FIPS 180-4
+static const uint32_t sha256_k[ 64 ] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+static inline uint32_t rotr32( uint32_t _x, unsigned _n ) {
+    return ( _x >> _n ) | ( _x << ( 32 - _n ) );
+}
+
+void shareuf_sha256_blocks_scalar(
+    uint32_t             _state[ 8 ],
+    const unsigned char* _data,
+    size_t               _blocks ) {
+    for ( ; _blocks > 0; --_blocks, _data += 64 ) {
+        uint32_t w[ 64 ];
+        for ( int i = 0; i < 16; ++i ) {
+            w[ i ] = ( uint32_t )_data[ i * 4 ] << 24 | ( uint32_t )_data[ i * 4 + 1 ] << 16 |
+                     ( uint32_t )_data[ i * 4 + 2 ] << 8 | ( uint32_t )_data[ i * 4 + 3 ];
+        }
+        for ( int i = 16; i < 64; ++i ) {
+            uint32_t s0 = rotr32( w[ i - 15 ], 7 ) ^ rotr32( w[ i - 15 ], 18 ) ^ ( w[ i - 15 ] >> 3 );
+            uint32_t s1 = rotr32( w[ i - 2 ], 17 ) ^ rotr32( w[ i - 2 ], 19 ) ^ ( w[ i - 2 ] >> 10 );
+            w[ i ] = w[ i - 16 ] + s0 + w[ i - 7 ] + s1;
+        }
+
+        uint32_t a = _state[ 0 ], b = _state[ 1 ], c = _state[ 2 ], d = _state[ 3 ];
+        uint32_t e = _state[ 4 ], f = _state[ 5 ], g = _state[ 6 ], h = _state[ 7 ];
+        for ( int i = 0; i < 64; ++i ) {
+            uint32_t s1  = rotr32( e, 6 ) ^ rotr32( e, 11 ) ^ rotr32( e, 25 );
+            uint32_t ch  = ( e & f ) ^ ( ~e & g );
+            uint32_t t1  = h + s1 + ch + sha256_k[ i ] + w[ i ];
+            uint32_t s0  = rotr32( a, 2 ) ^ rotr32( a, 13 ) ^ rotr32( a, 22 );
+            uint32_t maj = ( a & b ) ^ ( a & c ) ^ ( b & c );
+            uint32_t t2  = s0 + maj;
+            h = g;
+            g = f;
+            f = e;
+            e = d + t1;
+            d = c;
+            c = b;
+            b = a;
+            a = t1 + t2;
+        }
+        _state[ 0 ] += a;
+        _state[ 1 ] += b;
+        _state[ 2 ] += c;
+        _state[ 3 ] += d;
+        _state[ 4 ] += e;
+        _state[ 5 ] += f;
+        _state[ 6 ] += g;
+        _state[ 7 ] += h;
+    }
+
+} // shareuf_sha256_blocks_scalar
+
+shareuf_sha256::shareuf_sha256() {
+    reset();
+
+} // ctor
+
+void shareuf_sha256::reset() {
+    static const uint32_t init[ 8 ] = {
+        0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+    };
+    memcpy( state_, init, sizeof( state_ ) );
+    length_    = 0;
+    block_len_ = 0;
+
+} // reset
+
+void shareuf_sha256::update(
+    const void* _data,
+    size_t      _len ) {
+    const unsigned char* p = static_cast< const unsigned char* >( _data );
+    length_ += _len;
+
+    if ( block_len_ > 0 ) {
+        size_t take = sizeof( block_ ) - block_len_;
+        if ( take > _len ) {
+            take = _len;
+        }
+        memcpy( block_ + block_len_, p, take );
+        block_len_ += take;
+        p          += take;
+        _len       -= take;
+        if ( block_len_ < sizeof( block_ ) ) {
+            return;
+        }
+        kernels().sha256( state_, block_, 1 );
+        block_len_ = 0;
+    }
+
+    size_t blocks = _len / 64;
+    if ( blocks > 0 ) {
+        kernels().sha256( state_, p, blocks );
+        p    += blocks * 64;
+        _len -= blocks * 64;
+    }
+
+    if ( _len > 0 ) {
+        memcpy( block_, p, _len );
+        block_len_ = _len;
+    }
+
+} // update
+
+void shareuf_sha256::final(
+    unsigned char _digest[ SHAREUF_SHA256_DIGEST_SIZE ] ) {
+    uint64_t bits = length_ * 8;
+
+    block_[ block_len_++ ] = 0x80;
+    if ( block_len_ > 56 ) {
+        memset( block_ + block_len_, 0, sizeof( block_ ) - block_len_ );
+        kernels().sha256( state_, block_, 1 );
+        block_len_ = 0;
+    }
+    memset( block_ + block_len_, 0, 56 - block_len_ );
+    for ( int i = 0; i < 8; ++i ) {
+        block_[ 63 - i ] = static_cast< unsigned char >( bits >> ( i * 8 ) );
+    }
+    kernels().sha256( state_, block_, 1 );
+
+    for ( int i = 0; i < 8; ++i ) {
+        _digest[ i * 4 ]     = static_cast< unsigned char >( state_[ i ] >> 24 );
+        _digest[ i * 4 + 1 ] = static_cast< unsigned char >( state_[ i ] >> 16 );
+        _digest[ i * 4 + 2 ] = static_cast< unsigned char >( state_[ i ] >> 8 );
+        _digest[ i * 4 + 3 ] = static_cast< unsigned char >( state_[ i ] );
+    }
+
+} // final
+
+// =-=-=-=-=-=-=-
+// CRC32C, reflected polynomial 0x82f63b78, slicing by 8
+namespace {
+    struct crc32c_tables {
+        uint32_t t[ 8 ][ 256 ];
+
+        crc32c_tables() {
+            for ( uint32_t i = 0; i < 256; ++i ) {
+                uint32_t crc = i;
+                for ( int k = 0; k < 8; ++k ) {
+                    crc = ( crc >> 1 ) ^ ( 0x82f63b78 & ( 0 - ( crc & 1 ) ) );
+                }
+                t[ 0 ][ i ] = crc;
+            }
+            for ( uint32_t i = 0; i < 256; ++i ) {
+                for ( int k = 1; k < 8; ++k ) {
+                    t[ k ][ i ] = ( t[ k - 1 ][ i ] >> 8 ) ^ t[ 0 ][ t[ k - 1 ][ i ] & 0xff ];
+                }
+            }
+        }
+    };
+
+    const crc32c_tables crc_tables;
+}
+
+uint32_t shareuf_crc32c_scalar(
+    uint32_t             _crc,
+    const unsigned char* _data,
+    size_t               _len ) {
+    const unsigned char* p = _data;
+    const uint32_t ( *t )[ 256 ] = crc_tables.t;
+    uint32_t crc = _crc;
+
+    while ( _len >= 8 ) {
+        uint32_t lo = ( p[ 0 ] | ( uint32_t )p[ 1 ] << 8 | ( uint32_t )p[ 2 ] << 16 | ( uint32_t )p[ 3 ] << 24 ) ^ crc;
+        uint32_t hi = p[ 4 ] | ( uint32_t )p[ 5 ] << 8 | ( uint32_t )p[ 6 ] << 16 | ( uint32_t )p[ 7 ] << 24;
+        crc = t[ 7 ][ lo & 0xff ] ^ t[ 6 ][ ( lo >> 8 ) & 0xff ] ^ t[ 5 ][ ( lo >> 16 ) & 0xff ] ^ t[ 4 ][ lo >> 24 ] ^
+              t[ 3 ][ hi & 0xff ] ^ t[ 2 ][ ( hi >> 8 ) & 0xff ] ^ t[ 1 ][ ( hi >> 16 ) & 0xff ] ^ t[ 0 ][ hi >> 24 ];
+        p    += 8;
+        _len -= 8;
+    }
+    while ( _len-- > 0 ) {
+        crc = t[ 0 ][ ( crc ^ *p++ ) & 0xff ] ^ ( crc >> 8 );
+    }
+    return crc;
+
+} // shareuf_crc32c_scalar
+
+uint32_t shareuf_crc32c(
+    uint32_t    _crc,
+    const void* _data,
+    size_t      _len ) {
+    return ~kernels().crc32c( ~_crc, static_cast< const unsigned char* >( _data ), _len );
+
+} // shareuf_crc32c
+
+std::string shareuf_sha256_to_irods(
+    const unsigned char _digest[ SHAREUF_SHA256_DIGEST_SIZE ] ) {
+    static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    std::string out( "sha2:" );
+    for ( size_t i = 0; i < SHAREUF_SHA256_DIGEST_SIZE; i += 3 ) {
+        uint32_t n = ( uint32_t )_digest[ i ] << 16;
+        if ( i + 1 < SHAREUF_SHA256_DIGEST_SIZE ) {
+            n |= ( uint32_t )_digest[ i + 1 ] << 8;
+        }
+        if ( i + 2 < SHAREUF_SHA256_DIGEST_SIZE ) {
+            n |= _digest[ i + 2 ];
+        }
+        out += alphabet[ ( n >> 18 ) & 0x3f ];
+        out += alphabet[ ( n >> 12 ) & 0x3f ];
+        out += i + 1 < SHAREUF_SHA256_DIGEST_SIZE ? alphabet[ ( n >> 6 ) & 0x3f ] : '=';
+        out += i + 2 < SHAREUF_SHA256_DIGEST_SIZE ? alphabet[ n & 0x3f ] : '=';
+    }
+    return out;
+
+} // shareuf_sha256_to_irods
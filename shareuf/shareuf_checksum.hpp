@@ -0,0 +1,52 @@
+/* Checksum primitives used by the shareuf plugin: incremental SHA-256,
+ * whose base64 form matches the "sha2:" checksums iRODS keeps in the
+ * catalog, and CRC32C as a cheap companion digest.
+ */
+#ifndef SHAREUF_CHECKSUM_HPP
+#define SHAREUF_CHECKSUM_HPP
+
+// =-=-=-=-=-=-=-
+// stl includes
+#include <string>
+
+// =-=-=-=-=-=-=-
+// system includes
+#include <stddef.h>
+#include <stdint.h>
+
+const size_t SHAREUF_SHA256_DIGEST_SIZE = 32;
+
+// =-=-=-=-=-=-=-
+/// @brief incremental SHA-256
+class shareuf_sha256 {
+    public:
+        shareuf_sha256();
+
+        void update( const void* _data, size_t _len );
+
+        /// @brief finish the digest, the object must be reset() before reuse
+        void final( unsigned char _digest[ SHAREUF_SHA256_DIGEST_SIZE ] );
+
+        void reset();
+
+    private:
+        uint32_t      state_[ 8 ];
+        uint64_t      length_;
+        unsigned char block_[ 64 ];
+        size_t        block_len_;
+
+}; // class shareuf_sha256
+
+// =-=-=-=-=-=-=-
+/// @brief extend a CRC32C (Castagnoli) over _len bytes, start with _crc = 0
+uint32_t shareuf_crc32c(
+    uint32_t    _crc,
+    const void* _data,
+    size_t      _len );
+
+// =-=-=-=-=-=-=-
+/// @brief iRODS style "sha2:<base64>" rendering of a SHA-256 digest
+std::string shareuf_sha256_to_irods(
+    const unsigned char _digest[ SHAREUF_SHA256_DIGEST_SIZE ] );
+
+#endif // SHAREUF_CHECKSUM_HPP
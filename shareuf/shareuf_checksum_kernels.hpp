@@ -0,0 +1,34 @@
+/* Individual checksum kernels behind the runtime dispatch in
+ * shareuf_checksum.cpp.  The accelerated kernels live in their own
+ * translation units, built with the instruction set they need, and must
+ * only be called once the matching shareuf_cpu_has_* check passed.
+ */
+#ifndef SHAREUF_CHECKSUM_KERNELS_HPP
+#define SHAREUF_CHECKSUM_KERNELS_HPP
+
+// =-=-=-=-=-=-=-
+// system includes
+#include <stddef.h>
+#include <stdint.h>
+
+// =-=-=-=-=-=-=-
+/// @brief CRC32C kernels work on the raw register, the caller applies the
+///        pre and post inversion
+typedef uint32_t ( *shareuf_crc32c_kernel_t )( uint32_t _crc, const unsigned char* _data, size_t _len );
+typedef void ( *shareuf_sha256_kernel_t )( uint32_t _state[ 8 ], const unsigned char* _data, size_t _blocks );
+
+uint32_t shareuf_crc32c_scalar( uint32_t _crc, const unsigned char* _data, size_t _len );
+uint32_t shareuf_crc32c_sse42( uint32_t _crc, const unsigned char* _data, size_t _len );
+
+void shareuf_sha256_blocks_scalar( uint32_t _state[ 8 ], const unsigned char* _data, size_t _blocks );
+void shareuf_sha256_blocks_shani( uint32_t _state[ 8 ], const unsigned char* _data, size_t _blocks );
+
+bool shareuf_cpu_has_sse42();
+bool shareuf_cpu_has_shani();
+
+// =-=-=-=-=-=-=-
+/// @brief names of the kernels picked for this CPU, for logging
+const char* shareuf_crc32c_kernel_name();
+const char* shareuf_sha256_kernel_name();
+
+#endif // SHAREUF_CHECKSUM_KERNELS_HPP
@@ -0,0 +1,82 @@
+/* SHA-256 block function using the x86 SHA extensions.  This file is
+ * built with -msha -msse4.1 and is only entered after
+ * shareuf_cpu_has_shani().
+ */
+#include "shareuf_checksum_kernels.hpp"
+
+#if defined(__x86_64__)
+
+#include <immintrin.h>
+
+namespace {
+    const uint32_t sha256_k[ 64 ] __attribute__( ( aligned( 16 ) ) ) = {
+        0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+        0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+        0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+        0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+        0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+        0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+        0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+        0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+    };
+}
+
+void shareuf_sha256_blocks_shani(
+    uint32_t             _state[ 8 ],
+    const unsigned char* _data,
+    size_t               _blocks ) {
+    const __m128i byte_swap = _mm_set_epi64x( 0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL );
+
+    // =-=-=-=-=-=-=-
+    // the sha256rnds2 instruction wants the state as ABEF / CDGH
+    __m128i tmp    = _mm_shuffle_epi32( _mm_loadu_si128( reinterpret_cast< const __m128i* >( &_state[ 0 ] ) ), 0xb1 );
+    __m128i state1 = _mm_shuffle_epi32( _mm_loadu_si128( reinterpret_cast< const __m128i* >( &_state[ 4 ] ) ), 0x1b );
+    __m128i state0 = _mm_alignr_epi8( tmp, state1, 8 );
+    state1         = _mm_blend_epi16( state1, tmp, 0xf0 );
+
+    for ( ; _blocks > 0; --_blocks, _data += 64 ) {
+        __m128i abef_save = state0;
+        __m128i cdgh_save = state1;
+        __m128i w[ 4 ];
+
+        for ( int i = 0; i < 16; ++i ) {
+            __m128i& wi = w[ i & 3 ];
+            if ( i < 4 ) {
+                wi = _mm_shuffle_epi8( _mm_loadu_si128( reinterpret_cast< const __m128i* >( _data + i * 16 ) ), byte_swap );
+            }
+            else {
+                // w[i] = msg2( msg1( w[i-4], w[i-3] ) + alignr( w[i-1], w[i-2], 4 ), w[i-1] )
+                __m128i t = _mm_sha256msg1_epu32( wi, w[ ( i - 3 ) & 3 ] );
+                t  = _mm_add_epi32( t, _mm_alignr_epi8( w[ ( i - 1 ) & 3 ], w[ ( i - 2 ) & 3 ], 4 ) );
+                wi = _mm_sha256msg2_epu32( t, w[ ( i - 1 ) & 3 ] );
+            }
+
+            __m128i msg = _mm_add_epi32( wi, _mm_load_si128( reinterpret_cast< const __m128i* >( &sha256_k[ i * 4 ] ) ) );
+            state1 = _mm_sha256rnds2_epu32( state1, state0, msg );
+            state0 = _mm_sha256rnds2_epu32( state0, state1, _mm_shuffle_epi32( msg, 0x0e ) );
+        }
+
+        state0 = _mm_add_epi32( state0, abef_save );
+        state1 = _mm_add_epi32( state1, cdgh_save );
+    }
+
+    tmp    = _mm_shuffle_epi32( state0, 0x1b );
+    state1 = _mm_shuffle_epi32( state1, 0xb1 );
+    state0 = _mm_blend_epi16( tmp, state1, 0xf0 );
+    state1 = _mm_alignr_epi8( state1, tmp, 8 );
+    _mm_storeu_si128( reinterpret_cast< __m128i* >( &_state[ 0 ] ), state0 );
+    _mm_storeu_si128( reinterpret_cast< __m128i* >( &_state[ 4 ] ), state1 );
+
+} // shareuf_sha256_blocks_shani
+
+#else
+
+void shareuf_sha256_blocks_shani(
+    uint32_t             _state[ 8 ],
+    const unsigned char* _data,
+    size_t               _blocks ) {
+    shareuf_sha256_blocks_scalar( _state, _data, _blocks );
+
+} // shareuf_sha256_blocks_shani
+
+#endif
@@ -0,0 +1,298 @@
+#include "shareuf_copy_progress.hpp"
+#include "shareuf_checksum.hpp"
+
+// =-=-=-=-=-=-=-
+// stl includes
+#include <cstdio>
+#include <fstream>
+#include <mutex>
+#include <set>
+#include <sstream>
+
+// =-=-=-=-=-=-=-
+// system includes
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace {
+
+    const char   PARTIAL_SUFFIX[]          = ".shareuf-partial";
+    const char   PROGRESS_SUFFIX[]         = ".shareuf-partial.progress";
+    const size_t MAX_PARTIAL_DIRECTORIES   = 256;
+
+    std::mutex              partial_mutex;
+    std::set< std::string > partial_directories;
+
+    bool ends_with(
+        const std::string& _name,
+        const char*        _suffix,
+        size_t             _len ) {
+        return _name.size() > _len && _name.compare( _name.size() - _len, _len, _suffix ) == 0;
+    }
+
+} // namespace
+
+bool shareuf_copy_progress::same_source(
+    const struct stat& _sb ) const {
+    return source_size == _sb.st_size && source_ino == _sb.st_ino &&
+           source_mtime.tv_sec == _sb.st_mtim.tv_sec && source_mtime.tv_nsec == _sb.st_mtim.tv_nsec;
+
+} // same_source
+
+std::string shareuf_partial_path(
+    const std::string& _dest ) {
+    std::string::size_type slash = _dest.find_last_of( '/' );
+    std::string::size_type name  = std::string::npos == slash ? 0 : slash + 1;
+
+    {
+        std::lock_guard< std::mutex > lock( partial_mutex );
+        if ( partial_directories.size() < MAX_PARTIAL_DIRECTORIES ) {
+            partial_directories.insert( std::string::npos == slash ? std::string( "." ) : _dest.substr( 0, slash ) );
+        }
+    }
+
+    return _dest.substr( 0, name ) + "." + _dest.substr( name ) + PARTIAL_SUFFIX;
+
+} // shareuf_partial_path
+
+std::string shareuf_progress_path(
+    const std::string& _dest ) {
+    return shareuf_partial_path( _dest ) + ".progress";
+
+} // shareuf_progress_path
+
+void shareuf_partial_directories(
+    std::vector< std::string >& _out ) {
+    std::lock_guard< std::mutex > lock( partial_mutex );
+    _out.insert( _out.end(), partial_directories.begin(), partial_directories.end() );
+
+} // shareuf_partial_directories
+
+int shareuf_reap_partial_copies(
+    const std::string&                           _dir,
+    time_t                                       _min_age,
+    const std::chrono::steady_clock::time_point& _deadline,
+    unsigned long long&                          _reaped ) {
+    DIR* dir = opendir( _dir.c_str() );
+    if ( !dir ) {
+        return -errno;
+    }
+
+    int    status = 0;
+    time_t now    = time( 0 );
+    while ( struct dirent* ent = readdir( dir ) ) {
+        if ( std::chrono::steady_clock::now() >= _deadline ) {
+            status = -ETIMEDOUT;
+            break;
+        }
+
+        std::string name( ent->d_name );
+        std::string partial;
+        if ( ends_with( name, PARTIAL_SUFFIX, sizeof( PARTIAL_SUFFIX ) - 1 ) ) {
+            partial = name;
+        }
+        else if ( ends_with( name, PROGRESS_SUFFIX, sizeof( PROGRESS_SUFFIX ) - 1 ) ) {
+            partial = name.substr( 0, name.size() - ( sizeof( PROGRESS_SUFFIX ) - sizeof( PARTIAL_SUFFIX ) ) );
+        }
+        if ( partial.empty() || '.' != partial[ 0 ] ) {
+            continue;
+        }
+
+        // =-=-=-=-=-=-=-
+        // a copy still running writes the partial file and checkpoints
+        // the sidecar, either one recently written keeps both
+        std::string progress = partial + ".progress";
+        struct stat partial_sb, progress_sb;
+        bool has_partial  = fstatat( dirfd( dir ), partial.c_str(), &partial_sb, AT_SYMLINK_NOFOLLOW ) == 0;
+        bool has_progress = fstatat( dirfd( dir ), progress.c_str(), &progress_sb, AT_SYMLINK_NOFOLLOW ) == 0;
+        if ( ( has_partial && ( !S_ISREG( partial_sb.st_mode ) || now - partial_sb.st_mtime < _min_age ) ) ||
+                ( has_progress && now - progress_sb.st_mtime < _min_age ) ) {
+            continue;
+        }
+        if ( name != partial && has_partial ) {
+            // =-=-=-=-=-=-=-
+            // reaped with its partial file
+            continue;
+        }
+
+        if ( ( has_partial && unlinkat( dirfd( dir ), partial.c_str(), 0 ) == 0 ) ||
+                ( !has_partial && unlinkat( dirfd( dir ), progress.c_str(), 0 ) == 0 ) ) {
+            ++_reaped;
+        }
+        unlinkat( dirfd( dir ), progress.c_str(), 0 );
+        unlinkat( dirfd( dir ), ( progress + ".tmp" ).c_str(), 0 );
+    }
+    closedir( dir );
+    return status;
+
+} // shareuf_reap_partial_copies
+
+bool shareuf_read_copy_progress(
+    const std::string&     _path,
+    shareuf_copy_progress& _out ) {
+    std::ifstream in( _path.c_str() );
+    std::string line;
+    if ( !std::getline( in, line ) ) {
+        return false;
+    }
+
+    // =-=-=-=-=-=-=-
+    // v1 <source size> <sec>.<nsec> <source inode> <offset> <crc32c hex>
+    char                version[ 4 ] = { 0 };
+    long long           size   = 0;
+    long long           sec    = 0;
+    long                nsec   = 0;
+    unsigned long long  ino    = 0;
+    long long           offset = 0;
+    unsigned            crc    = 0;
+    if ( sscanf( line.c_str(), "%3s %lld %lld.%ld %llu %lld %x", version, &size, &sec, &nsec, &ino, &offset, &crc ) != 7 ||
+            std::string( version ) != "v1" || offset < 0 || offset > size ) {
+        return false;
+    }
+
+    _out.source_size          = size;
+    _out.source_mtime.tv_sec  = sec;
+    _out.source_mtime.tv_nsec = nsec;
+    _out.source_ino           = ino;
+    _out.offset               = offset;
+    _out.crc32c               = crc;
+    return true;
+
+} // shareuf_read_copy_progress
+
+int shareuf_write_copy_progress(
+    const std::string&           _path,
+    const shareuf_copy_progress& _progress ) {
+    char line[ 128 ];
+    int len = snprintf( line, sizeof( line ), "v1 %lld %lld.%09ld %llu %lld %08x\n",
+                        static_cast< long long >( _progress.source_size ),
+                        static_cast< long long >( _progress.source_mtime.tv_sec ),
+                        static_cast< long >( _progress.source_mtime.tv_nsec ),
+                        static_cast< unsigned long long >( _progress.source_ino ),
+                        static_cast< long long >( _progress.offset ),
+                        _progress.crc32c );
+
+    std::string temp = _path + ".tmp";
+    int fd = open( temp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600 );
+    if ( fd < 0 ) {
+        return -errno;
+    }
+    int     status  = 0;
+    ssize_t written = write( fd, line, len );
+    if ( written < 0 || fdatasync( fd ) < 0 ) {
+        status = -errno;
+    }
+    else if ( written != len ) {
+        status = -EIO;
+    }
+    close( fd );
+    if ( 0 == status && rename( temp.c_str(), _path.c_str() ) < 0 ) {
+        status = -errno;
+    }
+    if ( status < 0 ) {
+        unlink( temp.c_str() );
+    }
+    return status;
+
+} // shareuf_write_copy_progress
+
+bool shareuf_verify_partial(
+    int                          _fd,
+    const shareuf_copy_progress& _progress,
+    char*                        _buf,
+    size_t                       _len,
+    shareuf_inline_digest*       _digest ) {
+    struct stat sb;
+    if ( fstat( _fd, &sb ) < 0 || sb.st_size < _progress.offset ) {
+        return false;
+    }
+
+    uint32_t crc    = 0;
+    off_t    offset = 0;
+    while ( offset < _progress.offset ) {
+        size_t  want = static_cast< size_t >( _progress.offset - offset ) < _len ? _progress.offset - offset : _len;
+        ssize_t n    = pread( _fd, _buf, want, offset );
+        if ( n <= 0 ) {
+            return false;
+        }
+        crc = shareuf_crc32c( crc, _buf, n );
+        if ( _digest ) {
+            _digest->update( offset, _buf, n );
+        }
+        offset += n;
+    }
+    return crc == _progress.crc32c;
+
+} // shareuf_verify_partial
+
+int shareuf_resume_copy(
+    shareuf_chunked_copy&  _copy,
+    const struct stat&     _sb,
+    shareuf_inline_digest* _digest ) {
+    _copy.copied = 0;
+    _copy.crc32c = 0;
+    if ( shareuf_read_copy_progress( _copy.progress_path, _copy.progress ) && _copy.progress.same_source( _sb ) &&
+            shareuf_verify_partial( _copy.out_fd, _copy.progress, _copy.buf, _copy.len, _digest ) ) {
+        _copy.copied = _copy.progress.offset;
+        _copy.crc32c = _copy.progress.crc32c;
+    }
+    else {
+        _copy.progress = shareuf_copy_progress();
+        _copy.progress.source_size  = _sb.st_size;
+        _copy.progress.source_mtime = _sb.st_mtim;
+        _copy.progress.source_ino   = _sb.st_ino;
+    }
+
+    if ( ftruncate( _copy.out_fd, _copy.copied ) < 0 || lseek( _copy.out_fd, _copy.copied, SEEK_SET ) < 0 ||
+            lseek( _copy.in_fd, _copy.copied, SEEK_SET ) < 0 ) {
+        return -errno;
+    }
+    return 0;
+
+} // shareuf_resume_copy
+
+int shareuf_run_copy(
+    shareuf_chunked_copy&               _copy,
+    const std::function< void( int ) >& _on_checkpoint_error ) {
+    while ( true ) {
+        ssize_t n = _copy.read ? _copy.read( _copy.in_fd, _copy.buf, _copy.len ) : read( _copy.in_fd, _copy.buf, _copy.len );
+        if ( n <= 0 ) {
+            return 0;
+        }
+        ssize_t written = _copy.write ? _copy.write( _copy.out_fd, _copy.buf, n ) : write( _copy.out_fd, _copy.buf, n );
+        if ( written != n ) {
+            return written < 0 ? -errno : -EIO;
+        }
+        if ( _copy.on_chunk ) {
+            _copy.on_chunk( _copy.buf, written, _copy.copied );
+        }
+        _copy.copied += written;
+
+        // =-=-=-=-=-=-=-
+        // the checkpoint may only cover data already on disk
+        if ( _copy.checkpoint > 0 ) {
+            _copy.crc32c = shareuf_crc32c( _copy.crc32c, _copy.buf, written );
+            if ( _copy.copied - _copy.progress.offset >= _copy.checkpoint && 0 == fdatasync( _copy.out_fd ) ) {
+                _copy.progress.offset = _copy.copied;
+                _copy.progress.crc32c = _copy.crc32c;
+                int status = shareuf_write_copy_progress( _copy.progress_path, _copy.progress );
+                if ( status < 0 && _on_checkpoint_error ) {
+                    _on_checkpoint_error( status );
+                }
+            }
+        }
+    }
+
+} // shareuf_run_copy
+
+int shareuf_publish_copy(
+    const std::string& _dest ) {
+    if ( rename( shareuf_partial_path( _dest ).c_str(), _dest.c_str() ) < 0 ) {
+        return -errno;
+    }
+    unlink( shareuf_progress_path( _dest ).c_str() );
+    return 0;
+
+} // shareuf_publish_copy
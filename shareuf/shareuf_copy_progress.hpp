@@ -0,0 +1,146 @@
+/* Checkpoints of a resumable copy.  The copy is written to a hidden
+ * partial sibling of its destination and renamed into place when done;
+ * next to the partial file a small progress sidecar records the source it
+ * was made from, how many bytes of it are known to be on disk and the
+ * CRC32C of those bytes, so that a retried copy can check what is there
+ * and carry on from it.  Partial copies no retry came back for are
+ * unlinked once they have not been written to for a while.
+ *
+ * shareuf_file_copy runs its copies through shareuf_run_copy, resumable
+ * or not, so the checkpoint and resume sequence is the one tested by
+ * tools/shareuf_copy_resume_test.cpp.
+ */
+#ifndef SHAREUF_COPY_PROGRESS_HPP
+#define SHAREUF_COPY_PROGRESS_HPP
+
+#include "shareuf_inline_digest.hpp"
+
+// =-=-=-=-=-=-=-
+// stl includes
+#include <chrono>
+#include <functional>
+#include <string>
+#include <vector>
+
+// =-=-=-=-=-=-=-
+// system includes
+#include <stdint.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <time.h>
+
+struct shareuf_copy_progress {
+    off_t           source_size;
+    struct timespec source_mtime;
+    ino_t           source_ino;
+    off_t           offset;     // bytes of the partial file known to be on disk
+    uint32_t        crc32c;     // of those bytes
+
+    shareuf_copy_progress() : source_size( 0 ), source_ino( 0 ), offset( 0 ), crc32c( 0 ) {
+        source_mtime.tv_sec  = 0;
+        source_mtime.tv_nsec = 0;
+    }
+
+    /// @brief true when recorded for the source described by _sb
+    bool same_source( const struct stat& _sb ) const;
+
+}; // struct shareuf_copy_progress
+
+// =-=-=-=-=-=-=-
+/// @brief a copy from the position of in_fd to that of out_fd, in chunks
+///        of len bytes through buf.  with checkpoint set, every checkpoint
+///        bytes out_fd is synced and the sidecar at progress_path replaced.
+struct shareuf_chunked_copy {
+    int                   in_fd;
+    int                   out_fd;
+    char*                 buf;
+    size_t                len;
+    off_t                 checkpoint;
+    std::string           progress_path;
+    shareuf_copy_progress progress;     // the last checkpoint
+    off_t                 copied;       // bytes of the source copied
+    uint32_t              crc32c;       // of those bytes, with checkpoint set
+
+    // =-=-=-=-=-=-=-
+    // read and write default to read() and write(), on_chunk is told of
+    // each chunk once written at its offset
+    std::function< ssize_t( int, char*, size_t ) >       read;
+    std::function< ssize_t( int, const char*, size_t ) > write;
+    std::function< void( const char*, size_t, off_t ) >  on_chunk;
+
+    shareuf_chunked_copy() : in_fd( -1 ), out_fd( -1 ), buf( 0 ), len( 0 ), checkpoint( 0 ), copied( 0 ), crc32c( 0 ) {}
+
+}; // struct shareuf_chunked_copy
+
+// =-=-=-=-=-=-=-
+/// @brief the hidden partial sibling of _dest and its progress sidecar
+std::string shareuf_partial_path( const std::string& _dest );
+std::string shareuf_progress_path( const std::string& _dest );
+
+// =-=-=-=-=-=-=-
+/// @brief the directories this process has named partial copies in
+void shareuf_partial_directories( std::vector< std::string >& _out );
+
+// =-=-=-=-=-=-=-
+/// @brief unlink the partial copies in _dir and their progress sidecars
+///        when neither was written to for _min_age seconds, and sidecars
+///        left without their partial file.  stops with -ETIMEDOUT at
+///        _deadline.  returns 0 or -errno.
+int shareuf_reap_partial_copies(
+    const std::string&                           _dir,
+    time_t                                       _min_age,
+    const std::chrono::steady_clock::time_point& _deadline,
+    unsigned long long&                          _reaped );
+
+// =-=-=-=-=-=-=-
+/// @brief read a progress sidecar, false if it is missing or malformed
+bool shareuf_read_copy_progress(
+    const std::string&     _path,
+    shareuf_copy_progress& _out );
+
+// =-=-=-=-=-=-=-
+/// @brief atomically replace a progress sidecar, returns 0 or -errno.
+///        the partial file must be synced first.
+int shareuf_write_copy_progress(
+    const std::string&           _path,
+    const shareuf_copy_progress& _progress );
+
+// =-=-=-=-=-=-=-
+/// @brief re-read the first _progress.offset bytes of the partial file
+///        _fd through _buf, folding them into _digest when it is not null.
+///        true if they match the recorded CRC32C, in which case the copy
+///        may resume at _progress.offset.
+bool shareuf_verify_partial(
+    int                          _fd,
+    const shareuf_copy_progress& _progress,
+    char*                        _buf,
+    size_t                       _len,
+    shareuf_inline_digest*       _digest );
+
+// =-=-=-=-=-=-=-
+/// @brief start a resumable copy of the source described by _sb into its
+///        partial file: from the checkpoint in progress_path when the
+///        partial file still matches it, folding the verified bytes into
+///        _digest when it is not null, otherwise from the start.  the
+///        partial file is cut to copied and both descriptors are moved
+///        there.  returns 0 or -errno.
+int shareuf_resume_copy(
+    shareuf_chunked_copy&  _copy,
+    const struct stat&     _sb,
+    shareuf_inline_digest* _digest );
+
+// =-=-=-=-=-=-=-
+/// @brief copy until the source ends.  returns 0, or -errno of a write
+///        which failed; a read which fails ends the copy short of the
+///        source.  a checkpoint which cannot be written is reported to
+///        _on_checkpoint_error, when set, and the copy goes on.
+int shareuf_run_copy(
+    shareuf_chunked_copy&               _copy,
+    const std::function< void( int ) >& _on_checkpoint_error = std::function< void( int ) >() );
+
+// =-=-=-=-=-=-=-
+/// @brief rename the finished partial copy of _dest into place and unlink
+///        its progress sidecar, returns 0 or -errno
+int shareuf_publish_copy( const std::string& _dest );
+
+#endif // SHAREUF_COPY_PROGRESS_HPP
@@ -0,0 +1,347 @@
+#include "shareuf_dedup.hpp"
+#include "shareuf_checksum.hpp"
+
+// =-=-=-=-=-=-=-
+// stl includes
+#include <algorithm>
+#include <vector>
+
+// =-=-=-=-=-=-=-
+// system includes
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/fs.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+    const unsigned PROBE_LIMIT = 16;
+    const off_t    DEDUPE_CHUNK = 16 * 1024 * 1024;
+
+    // =-=-=-=-=-=-=-
+    // one index entry, written whole by a single pwrite.  the crc covers
+    // everything after it, so a torn or zeroed slot reads as empty.
+    struct index_slot {
+        uint32_t crc;
+        uint32_t used;
+        int64_t  size;
+        char     digest[ 96 ];
+        uint16_t path_len;
+        char     path[ SHAREUF_DEDUP_MAX_PATH ];
+        char     pad[ 14 ];
+    };
+
+    static_assert( sizeof( index_slot ) == 1024, "dedup index slots must stay 1024 bytes" );
+
+    uint32_t slot_crc(
+        const index_slot& _slot ) {
+        return shareuf_crc32c( 0, reinterpret_cast< const char* >( &_slot ) + sizeof( _slot.crc ),
+                               sizeof( _slot ) - sizeof( _slot.crc ) );
+    }
+
+    bool slot_valid(
+        const index_slot& _slot ) {
+        return 1 == _slot.used && _slot.crc == slot_crc( _slot ) && _slot.path_len < sizeof( _slot.path );
+    }
+
+    uint64_t key_hash(
+        const std::string& _digest,
+        off_t              _size ) {
+        uint64_t h = 14695981039346656037ULL;
+        for ( size_t i = 0; i < _digest.size(); ++i ) {
+            h ^= static_cast< unsigned char >( _digest[ i ] );
+            h *= 1099511628211ULL;
+        }
+        return h ^ static_cast< uint64_t >( _size );
+    }
+
+    // =-=-=-=-=-=-=-
+    // the probe window of one key, read and written under an exclusive
+    // flock on the index file.  the lock is let go while extents are
+    // shared, which may take long for a large file, and the window is
+    // read again when it is taken back.
+    class locked_index {
+        public:
+            locked_index(
+                const std::string& _path,
+                unsigned           _slots,
+                const std::string& _digest,
+                off_t              _size ) :
+                fd_( -1 ),
+                status_( 0 ),
+                home_( key_hash( _digest, _size ) % ( _slots > 0 ? _slots : 1 ) ),
+                slots_( _slots > 0 ? _slots : 1 ),
+                window_( std::min( PROBE_LIMIT, slots_ ) ) {
+                fd_ = open( _path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600 );
+                if ( fd_ < 0 ) {
+                    status_ = -errno;
+                    return;
+                }
+                lock();
+            }
+
+            // =-=-=-=-=-=-=-
+            // take the lock and read the window
+            int lock() {
+                if ( flock( fd_, LOCK_EX ) < 0 ) {
+                    return status_ = -errno;
+                }
+
+                // =-=-=-=-=-=-=-
+                // a sparse or short file reads as empty slots
+                for ( unsigned i = 0; i < window_.size(); ++i ) {
+                    ssize_t n = pread( fd_, &window_[ i ], sizeof( index_slot ), offset( i ) );
+                    if ( n < 0 ) {
+                        return status_ = -errno;
+                    }
+                    memset( reinterpret_cast< char* >( &window_[ i ] ) + n, 0, sizeof( index_slot ) - n );
+                }
+                return status_ = 0;
+            }
+
+            void unlock() {
+                flock( fd_, LOCK_UN );
+            }
+
+            ~locked_index() {
+                if ( fd_ >= 0 ) {
+                    close( fd_ );
+                }
+            }
+
+            int status() const { return status_; }
+
+            size_t size() const { return window_.size(); }
+
+            index_slot& operator[]( size_t _i ) { return window_[ _i ]; }
+
+            int write_slot(
+                size_t _i ) {
+                window_[ _i ].crc = slot_crc( window_[ _i ] );
+                ssize_t n = pwrite( fd_, &window_[ _i ], sizeof( index_slot ), offset( _i ) );
+                return n < 0 ? -errno : 0;
+            }
+
+            int clear_slot(
+                size_t _i ) {
+                memset( &window_[ _i ], 0, sizeof( index_slot ) );
+                ssize_t n = pwrite( fd_, &window_[ _i ], sizeof( index_slot ), offset( _i ) );
+                return n < 0 ? -errno : 0;
+            }
+
+        private:
+            off_t offset(
+                size_t _i ) const {
+                return static_cast< off_t >( ( home_ + _i ) % slots_ ) * sizeof( index_slot );
+            }
+
+            int                         fd_;
+            int                         status_;
+            uint64_t                    home_;
+            unsigned                    slots_;
+            std::vector< index_slot >   window_;
+
+    }; // class locked_index
+
+    bool slot_matches(
+        const index_slot&  _slot,
+        const std::string& _digest,
+        off_t              _size ) {
+        return slot_valid( _slot ) && _slot.size == _size &&
+               strncmp( _slot.digest, _digest.c_str(), sizeof( _slot.digest ) ) == 0;
+    }
+
+    std::string slot_path(
+        const index_slot& _slot ) {
+        return std::string( _slot.path, _slot.path_len );
+    }
+
+    // =-=-=-=-=-=-=-
+    // drop the entries of the key for _path, unless another process
+    // recorded it again meanwhile
+    void clear_path(
+        locked_index&      _index,
+        const std::string& _path,
+        const std::string& _digest,
+        off_t              _size ) {
+        for ( size_t i = 0; i < _index.size(); ++i ) {
+            if ( slot_matches( _index[ i ], _digest, _size ) && slot_path( _index[ i ] ) == _path ) {
+                _index.clear_slot( i );
+            }
+        }
+    }
+
+    // =-=-=-=-=-=-=-
+    // record _path for the key, in the first free slot of the window or
+    // else over the home slot
+    int record(
+        locked_index&      _index,
+        const std::string& _path,
+        const std::string& _digest,
+        off_t              _size ) {
+        size_t target = 0;
+        for ( size_t i = 0; i < _index.size(); ++i ) {
+            if ( !slot_valid( _index[ i ] ) ) {
+                target = i;
+                break;
+            }
+        }
+
+        index_slot& slot = _index[ target ];
+        memset( &slot, 0, sizeof( slot ) );
+        slot.used     = 1;
+        slot.size     = _size;
+        slot.path_len = static_cast< uint16_t >( _path.size() );
+        memcpy( slot.digest, _digest.data(), _digest.size() );
+        memcpy( slot.path, _path.data(), _path.size() );
+        return _index.write_slot( target );
+    }
+
+    // =-=-=-=-=-=-=-
+    // share _len bytes of _src_fd with _dst_fd, returns 1 when the kernel
+    // found the content differs, 0 or -errno
+    int dedupe_range(
+        int   _src_fd,
+        int   _dst_fd,
+        off_t _len ) {
+#ifdef FIDEDUPERANGE
+        std::vector< char > storage( sizeof( file_dedupe_range ) + sizeof( file_dedupe_range_info ) );
+        file_dedupe_range* range = reinterpret_cast< file_dedupe_range* >( &storage[0] );
+
+        off_t done = 0;
+        while ( done < _len ) {
+            memset( &storage[0], 0, storage.size() );
+            range->src_offset            = done;
+            range->src_length            = std::min( DEDUPE_CHUNK, _len - done );
+            range->dest_count            = 1;
+            range->info[ 0 ].dest_fd     = _dst_fd;
+            range->info[ 0 ].dest_offset = done;
+            if ( ioctl( _src_fd, FIDEDUPERANGE, range ) < 0 ) {
+                return EINVAL == errno || ENOTTY == errno ? -EOPNOTSUPP : -errno;
+            }
+            if ( FILE_DEDUPE_RANGE_DIFFERS == range->info[ 0 ].status ) {
+                return 1;
+            }
+            if ( range->info[ 0 ].status < 0 ) {
+                return EINVAL == -range->info[ 0 ].status ? -EOPNOTSUPP : range->info[ 0 ].status;
+            }
+            if ( 0 == range->info[ 0 ].bytes_deduped ) {
+                return -EIO;
+            }
+            done += range->info[ 0 ].bytes_deduped;
+        }
+        return 0;
+#else
+        ( void )_src_fd;
+        ( void )_dst_fd;
+        ( void )_len;
+        return -EOPNOTSUPP;
+#endif
+    }
+
+} // namespace
+
+int shareuf_dedup_file(
+    const std::string&  _index_path,
+    unsigned            _slots,
+    int                 _fd,
+    const std::string&  _path,
+    const std::string&  _digest,
+    off_t               _size,
+    unsigned long long& _saved ) {
+    _saved = 0;
+    if ( _digest.empty() || _digest.size() >= sizeof( index_slot().digest ) ||
+            _path.size() >= SHAREUF_DEDUP_MAX_PATH || _size <= 0 ) {
+        return 0;
+    }
+
+    struct stat dst_stat;
+    if ( fstat( _fd, &dst_stat ) < 0 ) {
+        return -errno;
+    }
+
+    locked_index index( _index_path, _slots, _digest, _size );
+    if ( index.status() < 0 ) {
+        return index.status();
+    }
+
+    // =-=-=-=-=-=-=-
+    // the indexed files with the key are taken under the lock and tried
+    // without it
+    std::vector< std::string > candidates;
+    for ( size_t i = 0; i < index.size(); ++i ) {
+        if ( slot_matches( index[ i ], _digest, _size ) ) {
+            candidates.push_back( slot_path( index[ i ] ) );
+        }
+    }
+    if ( candidates.empty() ) {
+        return record( index, _path, _digest, _size );
+    }
+    index.unlock();
+
+    // =-=-=-=-=-=-=-
+    // try every candidate, noting those which are gone or no longer hold
+    // the content
+    std::vector< std::string > stale;
+    int  status = 0;
+    bool done   = false;
+    for ( size_t i = 0; i < candidates.size() && !done; ++i ) {
+        int src_fd = open( candidates[ i ].c_str(), O_RDONLY | O_CLOEXEC );
+        struct stat src_stat;
+        if ( src_fd < 0 || fstat( src_fd, &src_stat ) < 0 || src_stat.st_size != _size ) {
+            if ( src_fd >= 0 ) {
+                close( src_fd );
+            }
+            stale.push_back( candidates[ i ] );
+            continue;
+        }
+
+        if ( src_stat.st_dev == dst_stat.st_dev && src_stat.st_ino == dst_stat.st_ino ) {
+            done = true;
+        }
+        else if ( src_stat.st_dev == dst_stat.st_dev ) {
+            int shared = dedupe_range( src_fd, _fd, _size );
+            if ( 0 == shared ) {
+                _saved = _size;
+                done   = true;
+            }
+            else if ( shared < 0 ) {
+                status = shared;
+                done   = true;
+            }
+            else {
+                stale.push_back( candidates[ i ] );
+            }
+        }
+        close( src_fd );
+    }
+    if ( done && stale.empty() ) {
+        return status;
+    }
+
+    // =-=-=-=-=-=-=-
+    // back under the lock to drop the stale entries and, with no file
+    // shared, record this one
+    if ( index.lock() < 0 ) {
+        return done ? status : index.status();
+    }
+    for ( size_t i = 0; i < stale.size(); ++i ) {
+        clear_path( index, stale[ i ], _digest, _size );
+    }
+    if ( done ) {
+        return status;
+    }
+    for ( size_t i = 0; i < index.size(); ++i ) {
+        if ( slot_matches( index[ i ], _digest, _size ) && slot_path( index[ i ] ) == _path ) {
+            return 0;
+        }
+    }
+    return record( index, _path, _digest, _size );
+
+} // shareuf_dedup_file
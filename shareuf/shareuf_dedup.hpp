@@ -0,0 +1,40 @@
+/* Content-addressed deduplication of whole files by reflink.
+ *
+ * Each vault filesystem keeps a content index in its state directory: a
+ * fixed-size open-addressing hash table file mapping a digest and size to
+ * the path of a file known to hold that content.  Every slot is written
+ * with a single pwrite and carries a CRC32C, so a slot torn by a crash
+ * reads as empty and the index never needs repair.  The index is only a
+ * hint: matches are confirmed by the kernel, which compares the data
+ * before FIDEDUPERANGE shares any extents, so a stale or overwritten
+ * entry costs a lookup but can never change file content.
+ */
+#ifndef SHAREUF_DEDUP_HPP
+#define SHAREUF_DEDUP_HPP
+
+// =-=-=-=-=-=-=-
+// stl includes
+#include <string>
+
+// =-=-=-=-=-=-=-
+// system includes
+#include <sys/types.h>
+
+const size_t SHAREUF_DEDUP_MAX_PATH = 896;
+
+// =-=-=-=-=-=-=-
+/// @brief share the extents of the file open for writing as _fd at _path
+///        with an indexed file of the same _digest and _size, or record
+///        _path in the index at _index_path when there is none.
+///        _saved is set to the bytes now shared.  returns 0, -EOPNOTSUPP
+///        where the filesystem cannot share extents, or -errno.
+int shareuf_dedup_file(
+    const std::string&  _index_path,
+    unsigned            _slots,
+    int                 _fd,
+    const std::string&  _path,
+    const std::string&  _digest,
+    off_t               _size,
+    unsigned long long& _saved );
+
+#endif // SHAREUF_DEDUP_HPP
@@ -0,0 +1,263 @@
+#include "shareuf_durability.hpp"
+
+// =-=-=-=-=-=-=-
+// stl includes
+#include <chrono>
+
+// =-=-=-=-=-=-=-
+// system includes
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <unistd.h>
+
+namespace {
+
+    // =-=-=-=-=-=-=-
+    // the ticket file holds the last ticket taken and the last one known
+    // durable, each guarded by a lock on its own byte range so taking a
+    // ticket does not wait behind a flush
+    const off_t STATE_LOCK = 0;
+    const off_t FLUSH_LOCK = 1;
+
+    struct ticket_state {
+        uint64_t taken;
+        uint64_t durable;
+    };
+
+    // =-=-=-=-=-=-=-
+    // open file description locks, held per descriptor rather than per
+    // process so threads of one agent exclude each other as well
+    int lock_byte(
+        int   _fd,
+        off_t _byte,
+        short _type ) {
+        struct flock fl;
+        fl.l_type   = _type;
+        fl.l_whence = SEEK_SET;
+        fl.l_start  = _byte;
+        fl.l_len    = 1;
+        fl.l_pid    = 0;
+        while ( fcntl( _fd, F_OFD_SETLKW, &fl ) < 0 ) {
+            if ( EINTR != errno ) {
+                return -errno;
+            }
+        }
+        return 0;
+    }
+
+    int read_state(
+        int           _fd,
+        ticket_state& _state ) {
+        ssize_t n = pread( _fd, &_state, sizeof( _state ), 0 );
+        if ( n < 0 ) {
+            return -errno;
+        }
+        if ( n != sizeof( _state ) ) {
+            _state.taken   = 0;
+            _state.durable = 0;
+        }
+        return 0;
+    }
+
+    int write_state(
+        int                 _fd,
+        const ticket_state& _state ) {
+        return pwrite( _fd, &_state, sizeof( _state ), 0 ) == sizeof( _state ) ? 0 : -EIO;
+    }
+
+    // =-=-=-=-=-=-=-
+    // apply _update to the ticket state under its lock
+    template< typename UPDATE >
+    int update_state(
+        int          _fd,
+        ticket_state& _state,
+        UPDATE       _update ) {
+        int status = lock_byte( _fd, STATE_LOCK, F_WRLCK );
+        if ( status < 0 ) {
+            return status;
+        }
+        status = read_state( _fd, _state );
+        if ( 0 == status && _update( _state ) ) {
+            status = write_state( _fd, _state );
+        }
+        lock_byte( _fd, STATE_LOCK, F_UNLCK );
+        return status;
+    }
+
+} // namespace
+
+bool shareuf_parse_durability_mode(
+    const std::string&       _value,
+    shareuf_durability_mode& _mode ) {
+    if ( _value == "none" ) {
+        _mode = SHAREUF_DURABILITY_NONE;
+    }
+    else if ( _value == "fdatasync_on_close" ) {
+        _mode = SHAREUF_DURABILITY_FDATASYNC;
+    }
+    else if ( _value == "group_commit" ) {
+        _mode = SHAREUF_DURABILITY_GROUP_COMMIT;
+    }
+    else {
+        return false;
+    }
+    return true;
+
+} // shareuf_parse_durability_mode
+
+int shareuf_shared_syncfs(
+    const std::string& _ticket_path,
+    int                _fd,
+    unsigned           _window_usec ) {
+    int ticket_fd = open( _ticket_path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600 );
+    if ( ticket_fd < 0 ) {
+        return -errno;
+    }
+
+    // =-=-=-=-=-=-=-
+    // the data of _fd was written before its ticket was taken, so any
+    // syncfs started once the ticket is counted covers it
+    ticket_state state  = { 0, 0 };
+    uint64_t     mine   = 0;
+    int          status = update_state( ticket_fd, state, [&mine]( ticket_state& _s ) {
+        mine = ++_s.taken;
+        return true;
+    } );
+    if ( status < 0 ) {
+        close( ticket_fd );
+        return status;
+    }
+
+    status = lock_byte( ticket_fd, FLUSH_LOCK, F_WRLCK );
+    if ( status < 0 ) {
+        close( ticket_fd );
+        return status;
+    }
+
+    // =-=-=-=-=-=-=-
+    // the flush lock was held by whoever synced on our behalf, or we sync
+    // for every ticket taken by the end of the window.  a failed syncfs
+    // leaves the tickets pending and each of their holders tries again.
+    update_state( ticket_fd, state, []( ticket_state& ) { return false; } );
+    if ( state.durable < mine ) {
+        if ( _window_usec > 0 ) {
+            std::this_thread::sleep_for( std::chrono::microseconds( _window_usec ) );
+        }
+        uint64_t covered = 0;
+        update_state( ticket_fd, state, [&covered]( ticket_state& _s ) {
+            covered = _s.taken;
+            return false;
+        } );
+        status = syncfs( _fd ) < 0 ? -errno : 0;
+        if ( 0 == status ) {
+            update_state( ticket_fd, state, [covered]( ticket_state& _s ) {
+                if ( _s.durable >= covered ) {
+                    return false;
+                }
+                _s.durable = covered;
+                return true;
+            } );
+        }
+    }
+
+    lock_byte( ticket_fd, FLUSH_LOCK, F_UNLCK );
+    close( ticket_fd );
+    return status;
+
+} // shareuf_shared_syncfs
+
+shareuf_group_commit& shareuf_group_commit::instance() {
+    static shareuf_group_commit gc;
+    return gc;
+
+} // instance
+
+shareuf_group_commit::~shareuf_group_commit() {
+    {
+        std::lock_guard< std::mutex > lock( mutex_ );
+        stop_ = true;
+    }
+    work_cv_.notify_all();
+    if ( thread_.joinable() ) {
+        thread_.join();
+    }
+
+} // dtor
+
+int shareuf_group_commit::commit(
+    int      _fd,
+    unsigned _window_usec ) {
+    std::unique_lock< std::mutex > lock( mutex_ );
+
+    // =-=-=-=-=-=-=-
+    // the flusher is started lazily so agents which never write do not
+    // carry an idle thread
+    if ( !thread_.joinable() ) {
+        thread_ = std::thread( &shareuf_group_commit::flusher, this );
+    }
+
+    if ( !open_batch_ ) {
+        open_batch_.reset( new batch );
+        window_usec_ = _window_usec;
+        work_cv_.notify_one();
+    }
+
+    std::shared_ptr< batch > mine = open_batch_;
+    size_t slot = mine->fds.size();
+    mine->fds.push_back( _fd );
+    mine->status.push_back( 0 );
+
+    done_cv_.wait( lock, [&mine] { return mine->done; } );
+    return mine->status[ slot ];
+
+} // commit
+
+bool shareuf_group_commit::drain(
+    std::chrono::microseconds _budget ) {
+    std::unique_lock< std::mutex > lock( mutex_ );
+    if ( open_batch_ ) {
+        hurry_ = true;
+        work_cv_.notify_all();
+    }
+    return done_cv_.wait_for( lock, _budget, [this] { return !open_batch_ && !flushing_; } );
+
+} // drain
+
+void shareuf_group_commit::flusher() {
+    std::unique_lock< std::mutex > lock( mutex_ );
+    while ( true ) {
+        work_cv_.wait( lock, [this] { return stop_ || open_batch_; } );
+        if ( !open_batch_ ) {
+            return;
+        }
+
+        // =-=-=-=-=-=-=-
+        // let the window fill, closes keep joining the open batch meanwhile
+        if ( !stop_ ) {
+            work_cv_.wait_for( lock, std::chrono::microseconds( window_usec_ ), [this] { return stop_ || hurry_; } );
+        }
+
+        std::shared_ptr< batch > b = open_batch_;
+        open_batch_.reset();
+        hurry_     = false;
+        flushing_  = true;
+
+        lock.unlock();
+        flush( *b );
+        lock.lock();
+
+        flushing_ = false;
+        b->done   = true;
+        done_cv_.notify_all();
+    }
+
+} // flusher
+
+void shareuf_group_commit::flush(
+    batch& _batch ) {
+    for ( size_t i = 0; i < _batch.fds.size(); ++i ) {
+        _batch.status[ i ] = fdatasync( _batch.fds[ i ] ) < 0 ? -errno : 0;
+    }
+
+} // flush
@@ -0,0 +1,110 @@
+/* Durability policy applied when the plugin closes a file it wrote.
+ *
+ *   none                - plain close(), the historical behaviour
+ *   fdatasync_on_close  - fdatasync() every written file before close()
+ *   group_commit        - closes are made durable together.  with syncfs
+ *                         the closes of every agent on the host writing to
+ *                         a filesystem share one syncfs(): they take
+ *                         tickets in a file under the vault kept for that
+ *                         device, and whichever holds the flush lock syncs
+ *                         for all tickets taken so far.
+ *                         without syncfs only the threads of one agent, as
+ *                         in a parallel transfer, share a batch of
+ *                         fdatasync() calls run by a background flusher.
+ *
+ * Agents serve one client each and close its files one after the other,
+ * so the batching only pays across agents or transfer threads.
+ */
+#ifndef SHAREUF_DURABILITY_HPP
+#define SHAREUF_DURABILITY_HPP
+
+// =-=-=-=-=-=-=-
+// stl includes
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+enum shareuf_durability_mode {
+    SHAREUF_DURABILITY_NONE,
+    SHAREUF_DURABILITY_FDATASYNC,
+    SHAREUF_DURABILITY_GROUP_COMMIT
+};
+
+// =-=-=-=-=-=-=-
+/// @brief parse the durability_mode context string value, false if unknown
+bool shareuf_parse_durability_mode(
+    const std::string&        _value,
+    shareuf_durability_mode&  _mode );
+
+// =-=-=-=-=-=-=-
+/// @brief the durability settings of a resource, parsed once
+struct shareuf_durability_options {
+    shareuf_durability_mode mode;
+    unsigned                window_usec;    // time a batch stays open for others to join
+    bool                    use_syncfs;
+
+    shareuf_durability_options() : mode( SHAREUF_DURABILITY_NONE ), window_usec( 0 ), use_syncfs( false ) {}
+};
+
+// =-=-=-=-=-=-=-
+/// @brief make the data written through _fd durable with a syncfs() shared
+///        by every process taking tickets in _ticket_path, created if
+///        missing.  every ticket of _ticket_path must be taken for a
+///        descriptor on the filesystem of _fd.  the process holding the flush lock keeps it open for
+///        _window_usec so more tickets are covered.  returns 0, -ENOENT
+///        when the directory of _ticket_path is missing, or -errno.
+int shareuf_shared_syncfs(
+    const std::string& _ticket_path,
+    int                _fd,
+    unsigned           _window_usec );
+
+class shareuf_group_commit {
+    public:
+        static shareuf_group_commit& instance();
+
+        // =-=-=-=-=-=-=-
+        /// @brief joins _fd to the open batch and blocks until that batch has
+        ///        been flushed.  the batch is flushed _window_usec after it was
+        ///        opened.  returns 0 or -errno from the fdatasync of _fd.
+        int commit(
+            int      _fd,
+            unsigned _window_usec );
+
+        // =-=-=-=-=-=-=-
+        /// @brief flush the open batch without waiting out its window and
+        ///        wait up to _budget for it.  true once nothing is left
+        ///        to flush.
+        bool drain( std::chrono::microseconds _budget );
+
+    private:
+        shareuf_group_commit() : stop_( false ), hurry_( false ), flushing_( false ), window_usec_( 0 ) {}
+        ~shareuf_group_commit();
+
+        struct batch {
+            std::vector< int > fds;
+            std::vector< int > status;
+            bool               done;
+
+            batch() : done( false ) {}
+        };
+
+        void flusher();
+        static void flush( batch& _batch );
+
+        std::mutex                mutex_;
+        std::condition_variable   work_cv_;
+        std::condition_variable   done_cv_;
+        std::shared_ptr< batch >  open_batch_;
+        std::thread               thread_;
+        bool                      stop_;
+        bool                      hurry_;       // cut the window of the open batch short
+        bool                      flushing_;    // a batch is being flushed
+        unsigned                  window_usec_;
+
+}; // class shareuf_group_commit
+
+#endif // SHAREUF_DURABILITY_HPP
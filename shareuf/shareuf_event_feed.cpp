@@ -0,0 +1,296 @@
+#include "shareuf_event_feed.hpp"
+
+// =-=-=-=-=-=-=-
+// stl includes
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <sstream>
+
+// =-=-=-=-=-=-=-
+// system includes
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+
+    const char     RING_MAGIC[ 8 ] = { 'S', 'H', 'U', 'F', 'E', 'V', 'T', '1' };
+    const size_t   RING_HEADER_SIZE = 4096;
+    const size_t   RING_RECORD_SIZE = 2048;
+
+    struct ring_header {
+        char                    magic[ 8 ];
+        uint32_t                records;
+        uint32_t                record_size;
+        std::atomic< uint64_t > head;       // last sequence number handed out
+    };
+
+    struct ring_record {
+        std::atomic< uint64_t > sequence;   // 0 while being written
+        uint32_t                type;
+        uint16_t                path_len;
+        uint16_t                detail_len;
+        int64_t                 size;
+        int64_t                 time_ns;
+        char                    data[ RING_RECORD_SIZE - 32 ];
+    };
+
+    static_assert( sizeof( ring_header ) <= RING_HEADER_SIZE, "ring header must fit its page" );
+    static_assert( sizeof( ring_record ) == RING_RECORD_SIZE, "ring records must stay 2048 bytes" );
+
+    struct ring_mapping {
+        void*  base;
+        size_t length;
+
+        ring_header* header() const {
+            return static_cast< ring_header* >( base );
+        }
+
+        ring_record* record(
+            uint64_t _sequence ) const {
+            char* records = static_cast< char* >( base ) + RING_HEADER_SIZE;
+            return reinterpret_cast< ring_record* >( records + ( ( _sequence - 1 ) % header()->records ) * RING_RECORD_SIZE );
+        }
+    };
+
+    // =-=-=-=-=-=-=-
+    // map an existing ring, or create and lay it out under an flock so
+    // concurrent creators agree on its size
+    int map_ring(
+        const std::string& _path,
+        unsigned           _records,
+        bool               _writable,
+        ring_mapping&      _out ) {
+        int fd = open( _path.c_str(), ( _writable ? O_RDWR | O_CREAT : O_RDONLY ) | O_CLOEXEC, 0644 );
+        if ( fd < 0 ) {
+            return -errno;
+        }
+
+        struct stat sb;
+        if ( _writable && ( flock( fd, LOCK_EX ) < 0 || fstat( fd, &sb ) < 0 ) ) {
+            int status = -errno;
+            close( fd );
+            return status;
+        }
+        if ( _writable && 0 == sb.st_size ) {
+            ring_header header;
+            memset( static_cast< void* >( &header ), 0, sizeof( header ) );
+            memcpy( header.magic, RING_MAGIC, sizeof( RING_MAGIC ) );
+            header.records     = _records > 0 ? _records : 1;
+            header.record_size = RING_RECORD_SIZE;
+            if ( ftruncate( fd, RING_HEADER_SIZE + static_cast< off_t >( header.records ) * RING_RECORD_SIZE ) < 0 ||
+                    pwrite( fd, &header, sizeof( header ), 0 ) != static_cast< ssize_t >( sizeof( header ) ) ) {
+                int status = -errno;
+                close( fd );
+                return status;
+            }
+        }
+
+        ring_header header;
+        if ( fstat( fd, &sb ) < 0 || pread( fd, &header, sizeof( header ), 0 ) != static_cast< ssize_t >( sizeof( header ) ) ||
+                memcmp( header.magic, RING_MAGIC, sizeof( RING_MAGIC ) ) != 0 || RING_RECORD_SIZE != header.record_size ||
+                0 == header.records || sb.st_size < static_cast< off_t >( RING_HEADER_SIZE + static_cast< off_t >( header.records ) * RING_RECORD_SIZE ) ) {
+            close( fd );
+            return -EINVAL;
+        }
+
+        _out.length = RING_HEADER_SIZE + static_cast< size_t >( header.records ) * RING_RECORD_SIZE;
+        _out.base   = mmap( 0, _out.length, _writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0 );
+        int status  = MAP_FAILED == _out.base ? -errno : 0;
+        close( fd );
+        return status;
+    }
+
+    // =-=-=-=-=-=-=-
+    // one writable mapping per ring for the life of the process
+    int attach(
+        const std::string& _path,
+        mode_t             _dir_mode,
+        unsigned           _records,
+        ring_mapping&      _out ) {
+        static std::mutex                              mutex;
+        static std::map< std::string, ring_mapping >   mapped;
+
+        std::lock_guard< std::mutex > lock( mutex );
+        std::map< std::string, ring_mapping >::iterator itr = mapped.find( _path );
+        if ( itr != mapped.end() ) {
+            _out = itr->second;
+            return 0;
+        }
+
+        int status = map_ring( _path, _records, true, _out );
+        if ( -ENOENT == status ) {
+            // =-=-=-=-=-=-=-
+            // the mode is applied with chmod, the umask is process wide
+            std::string dir = _path.substr( 0, _path.find_last_of( '/' ) );
+            if ( 0 == mkdir( dir.c_str(), _dir_mode ) ) {
+                chmod( dir.c_str(), _dir_mode );
+            }
+            status = map_ring( _path, _records, true, _out );
+        }
+        if ( 0 == status ) {
+            mapped[ _path ] = _out;
+        }
+        return status;
+    }
+
+} // namespace
+
+const char* shareuf_event_name(
+    shareuf_event_type _type ) {
+    switch ( _type ) {
+        case SHAREUF_EVENT_CREATE:
+            return "create";
+        case SHAREUF_EVENT_CLOSE:
+            return "close";
+        case SHAREUF_EVENT_RENAME:
+            return "rename";
+        case SHAREUF_EVENT_UNLINK:
+            return "unlink";
+        case SHAREUF_EVENT_REGISTERED:
+            return "registered";
+        case SHAREUF_EVENT_UNREGISTERED:
+            return "unregistered";
+        case SHAREUF_EVENT_MODIFIED:
+            return "modified";
+        case SHAREUF_EVENT_NOTIFY:
+            return "notify";
+    }
+    return "unknown";
+
+} // shareuf_event_name
+
+std::string shareuf_format_event(
+    const shareuf_event& _event ) {
+    std::stringstream line;
+    line << _event.sequence << '\t' << shareuf_event_name( _event.type ) << '\t' << _event.size << '\t'
+         << _event.time_ns << '\t' << _event.path;
+    if ( !_event.detail.empty() ) {
+        line << '\t' << _event.detail;
+    }
+    return line.str();
+
+} // shareuf_format_event
+
+int shareuf_ring_append(
+    const std::string&   _ring_path,
+    mode_t               _dir_mode,
+    unsigned             _records,
+    const shareuf_event& _event ) {
+    ring_mapping ring;
+    int status = attach( _ring_path, _dir_mode, _records, ring );
+    if ( status < 0 ) {
+        return status;
+    }
+
+    uint64_t     sequence = ring.header()->head.fetch_add( 1 ) + 1;
+    ring_record* record   = ring.record( sequence );
+
+    record->sequence.store( 0, std::memory_order_release );
+    std::atomic_thread_fence( std::memory_order_release );
+
+    size_t path_len   = std::min( _event.path.size(), sizeof( record->data ) );
+    size_t detail_len = std::min( _event.detail.size(), sizeof( record->data ) - path_len );
+    record->type       = _event.type;
+    record->path_len   = static_cast< uint16_t >( path_len );
+    record->detail_len = static_cast< uint16_t >( detail_len );
+    record->size       = _event.size;
+    record->time_ns    = _event.time_ns;
+    memcpy( record->data, _event.path.data(), path_len );
+    memcpy( record->data + path_len, _event.detail.data(), detail_len );
+
+    record->sequence.store( sequence, std::memory_order_release );
+    return 0;
+
+} // shareuf_ring_append
+
+int shareuf_ring_read(
+    const std::string&            _ring_path,
+    uint64_t&                     _next,
+    std::vector< shareuf_event >& _out,
+    uint64_t&                     _lost ) {
+    ring_mapping ring;
+    int status = map_ring( _ring_path, 0, false, ring );
+    if ( status < 0 ) {
+        return status;
+    }
+
+    uint64_t head    = ring.header()->head.load( std::memory_order_acquire );
+    uint64_t records = ring.header()->records;
+    if ( _next < 1 ) {
+        _next = 1;
+    }
+    if ( head >= records && _next < head - records + 1 ) {
+        _lost += head - records + 1 - _next;
+        _next  = head - records + 1;
+    }
+
+    for ( ; _next <= head; ++_next ) {
+        const ring_record* record = ring.record( _next );
+        uint64_t before = record->sequence.load( std::memory_order_acquire );
+        if ( before < _next && head - _next < records / 2 ) {
+            // =-=-=-=-=-=-=-
+            // not written yet, come back for it.  a record left half
+            // written by a crashed writer is given up on once half the
+            // ring has been written past it.
+            break;
+        }
+        if ( before != _next ) {
+            ++_lost;
+            continue;
+        }
+
+        shareuf_event event;
+        event.sequence = _next;
+        event.type     = static_cast< shareuf_event_type >( record->type );
+        event.size     = record->size;
+        event.time_ns  = record->time_ns;
+        size_t path_len   = std::min< size_t >( record->path_len, sizeof( record->data ) );
+        size_t detail_len = std::min< size_t >( record->detail_len, sizeof( record->data ) - path_len );
+        event.path.assign( record->data, path_len );
+        event.detail.assign( record->data + path_len, detail_len );
+
+        std::atomic_thread_fence( std::memory_order_acquire );
+        if ( record->sequence.load( std::memory_order_relaxed ) != _next ) {
+            ++_lost;
+            continue;
+        }
+        _out.push_back( event );
+    }
+
+    munmap( ring.base, ring.length );
+    return 0;
+
+} // shareuf_ring_read
+
+int shareuf_socket_send(
+    const std::string&   _socket_path,
+    const shareuf_event& _event ) {
+    static int sock = socket( AF_UNIX, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0 );
+    if ( sock < 0 ) {
+        return -EBADF;
+    }
+
+    struct sockaddr_un addr;
+    memset( &addr, 0, sizeof( addr ) );
+    addr.sun_family = AF_UNIX;
+    if ( _socket_path.size() >= sizeof( addr.sun_path ) ) {
+        return -ENAMETOOLONG;
+    }
+    memcpy( addr.sun_path, _socket_path.data(), _socket_path.size() );
+
+    std::string line = shareuf_format_event( _event ) + "\n";
+    if ( sendto( sock, line.data(), line.size(), MSG_NOSIGNAL, reinterpret_cast< struct sockaddr* >( &addr ), sizeof( addr ) ) < 0 ) {
+        return -errno;
+    }
+    return 0;
+
+} // shareuf_socket_send
@@ -0,0 +1,83 @@
+/* Local change-event feed for processes that consume the vault directly.
+ *
+ * Events go to either or both of
+ *
+ *   - a ring file of fixed-size records which any number of agents append
+ *     to through a shared mapping and any number of readers tail.  The
+ *     header holds the last sequence number handed out; each record holds
+ *     its own sequence number, zeroed while it is being written, so a
+ *     reader can tell committed, in-progress and overwritten records
+ *     apart without taking a lock.
+ *   - a Unix datagram socket, one tab separated text line per event,
+ *     dropped when nobody is listening.
+ */
+#ifndef SHAREUF_EVENT_FEED_HPP
+#define SHAREUF_EVENT_FEED_HPP
+
+// =-=-=-=-=-=-=-
+// stl includes
+#include <string>
+#include <vector>
+
+// =-=-=-=-=-=-=-
+// system includes
+#include <stdint.h>
+#include <sys/types.h>
+
+enum shareuf_event_type {
+    SHAREUF_EVENT_CREATE = 1,
+    SHAREUF_EVENT_CLOSE,            // a written descriptor was closed
+    SHAREUF_EVENT_RENAME,
+    SHAREUF_EVENT_UNLINK,
+    SHAREUF_EVENT_REGISTERED,
+    SHAREUF_EVENT_UNREGISTERED,
+    SHAREUF_EVENT_MODIFIED,
+    SHAREUF_EVENT_NOTIFY
+};
+
+struct shareuf_event {
+    uint64_t           sequence;    // assigned by the ring, 0 otherwise
+    shareuf_event_type type;
+    int64_t            size;        // -1 when unknown
+    int64_t            time_ns;     // CLOCK_REALTIME
+    std::string        path;
+    std::string        detail;      // previous path of a rename, operation of a notify
+
+    shareuf_event() : sequence( 0 ), type( SHAREUF_EVENT_NOTIFY ), size( -1 ), time_ns( 0 ) {}
+};
+
+const char* shareuf_event_name( shareuf_event_type _type );
+
+// =-=-=-=-=-=-=-
+/// @brief "<sequence>\t<event>\t<size>\t<time_ns>\t<path>[\t<detail>]"
+std::string shareuf_format_event( const shareuf_event& _event );
+
+// =-=-=-=-=-=-=-
+/// @brief append _event to the ring file at _ring_path, created with room
+///        for _records events if it does not exist, as is its directory
+///        with _dir_mode.  paths too long for a record are truncated.
+///        returns 0 or -errno.
+int shareuf_ring_append(
+    const std::string&   _ring_path,
+    mode_t               _dir_mode,
+    unsigned             _records,
+    const shareuf_event& _event );
+
+// =-=-=-=-=-=-=-
+/// @brief read the committed events from sequence _next on into _out and
+///        advance _next past them.  _lost is increased by the events
+///        overwritten before they could be read.  returns 0 or -errno.
+int shareuf_ring_read(
+    const std::string&            _ring_path,
+    uint64_t&                     _next,
+    std::vector< shareuf_event >& _out,
+    uint64_t&                     _lost );
+
+// =-=-=-=-=-=-=-
+/// @brief send _event to the datagram socket bound at _socket_path without
+///        blocking, returns 0 or -errno
+int shareuf_socket_send(
+    const std::string&   _socket_path,
+    const shareuf_event& _event );
+
+#endif // SHAREUF_EVENT_FEED_HPP
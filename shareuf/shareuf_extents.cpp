@@ -0,0 +1,74 @@
+#include "shareuf_extents.hpp"
+
+// =-=-=-=-=-=-=-
+// stl includes
+#include <algorithm>
+
+// =-=-=-=-=-=-=-
+// system includes
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/falloc.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+    // =-=-=-=-=-=-=-
+    // free [_from, _to) chunk by chunk from the end.  stops quietly where
+    // the filesystem cannot punch holes, ftruncate() frees the rest.
+    void punch_tail(
+        int                       _fd,
+        off_t                     _from,
+        off_t                     _to,
+        off_t                     _chunk,
+        shareuf_truncate_summary& _summary ) {
+        for ( off_t end = _to; end > _from; ) {
+            off_t start = std::max( _from, end - _chunk );
+            if ( fallocate( _fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, start, end - start ) < 0 ) {
+                return;
+            }
+            ++_summary.punches;
+            end = start;
+        }
+    }
+
+} // namespace
+
+int shareuf_truncate_fd(
+    int                             _fd,
+    off_t                           _size,
+    const shareuf_truncate_options& _opts,
+    shareuf_truncate_summary&       _summary ) {
+    struct stat sb;
+    if ( _size < 0 ) {
+        return -EINVAL;
+    }
+    if ( fstat( _fd, &sb ) < 0 ) {
+        return -errno;
+    }
+    _summary.old_size = sb.st_size;
+
+    if ( _size < sb.st_size && _opts.punch_chunk > 0 && sb.st_size - _size > _opts.punch_chunk ) {
+        // =-=-=-=-=-=-=-
+        // keep the block holding the new end, ftruncate() zeroes its tail
+        off_t block = sb.st_blksize > 0 ? sb.st_blksize : 4096;
+        off_t from  = ( _size + block - 1 ) / block * block;
+        punch_tail( _fd, from, sb.st_size, _opts.punch_chunk, _summary );
+    }
+    else if ( _size > sb.st_size && _opts.preallocate ) {
+        if ( fallocate( _fd, 0, sb.st_size, _size - sb.st_size ) == 0 ) {
+            _summary.preallocated = _size - sb.st_size;
+            return 0;
+        }
+        if ( ENOSPC == errno ) {
+            // =-=-=-=-=-=-=-
+            // give back whatever part of the range was allocated
+            ftruncate( _fd, sb.st_size );
+            return -ENOSPC;
+        }
+    }
+
+    return ftruncate( _fd, _size ) == 0 ? 0 : -errno;
+
+} // shareuf_truncate_fd
@@ -0,0 +1,43 @@
+/* Extent-aware truncation.
+ *
+ * Freeing the extents of a large file in one ftruncate() can hold the
+ * inode, and the agent, for seconds on some filesystems.  A shrink by more
+ * than a chunk therefore punches the tail out chunk by chunk from the end
+ * with FALLOC_FL_PUNCH_HOLE before the final ftruncate(), which then has
+ * little left to free.  A grow can preallocate the new range instead of
+ * leaving a hole.
+ */
+#ifndef SHAREUF_EXTENTS_HPP
+#define SHAREUF_EXTENTS_HPP
+
+// =-=-=-=-=-=-=-
+// system includes
+#include <sys/types.h>
+
+struct shareuf_truncate_options {
+    off_t punch_chunk;      // largest range freed per call, 0 frees it all in ftruncate()
+    bool  preallocate;      // allocate the blocks of a grow
+
+    shareuf_truncate_options() : punch_chunk( 0 ), preallocate( false ) {}
+};
+
+struct shareuf_truncate_summary {
+    off_t    old_size;
+    unsigned punches;       // hole punching calls made
+    off_t    preallocated;  // bytes allocated by a grow
+
+    shareuf_truncate_summary() : old_size( 0 ), punches( 0 ), preallocated( 0 ) {}
+};
+
+// =-=-=-=-=-=-=-
+/// @brief truncate or extend the file open as _fd to _size.  filesystems
+///        without hole punching or preallocation get a plain ftruncate().
+///        returns 0 or -errno, -ENOSPC when a preallocation does not fit,
+///        leaving the file at its old size.
+int shareuf_truncate_fd(
+    int                             _fd,
+    off_t                           _size,
+    const shareuf_truncate_options& _opts,
+    shareuf_truncate_summary&       _summary );
+
+#endif // SHAREUF_EXTENTS_HPP
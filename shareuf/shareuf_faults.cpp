@@ -0,0 +1,266 @@
+#include "shareuf_faults.hpp"
+
+// =-=-=-=-=-=-=-
+// stl includes
+#include <chrono>
+#include <thread>
+
+// =-=-=-=-=-=-=-
+// system includes
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+namespace {
+
+    struct errno_name {
+        const char* name;
+        int         value;
+    };
+
+    const errno_name errno_names[] = {
+        { "EIO",       EIO },
+        { "ENOSPC",    ENOSPC },
+        { "EDQUOT",    EDQUOT },
+        { "EROFS",     EROFS },
+        { "EACCES",    EACCES },
+        { "EPERM",     EPERM },
+        { "ENOENT",    ENOENT },
+        { "EEXIST",    EEXIST },
+        { "ENOTDIR",   ENOTDIR },
+        { "EISDIR",    EISDIR },
+        { "ESTALE",    ESTALE },
+        { "ETIMEDOUT", ETIMEDOUT },
+        { "EINTR",     EINTR },
+        { "EAGAIN",    EAGAIN },
+        { "EBUSY",     EBUSY },
+        { "EMFILE",    EMFILE },
+        { "ENFILE",    ENFILE },
+        { "ENOMEM",    ENOMEM },
+        { "EFBIG",     EFBIG },
+        { "EBADF",     EBADF }
+    };
+
+    bool parse_errno(
+        const std::string& _text,
+        int&               _out ) {
+        for ( size_t i = 0; i < sizeof( errno_names ) / sizeof( errno_names[ 0 ] ); ++i ) {
+            if ( _text == errno_names[ i ].name ) {
+                _out = errno_names[ i ].value;
+                return true;
+            }
+        }
+        char* end = 0;
+        long value = strtol( _text.c_str(), &end, 10 );
+        if ( _text.empty() || *end || value <= 0 ) {
+            return false;
+        }
+        _out = static_cast< int >( value );
+        return true;
+    }
+
+    bool parse_number(
+        const std::string& _text,
+        double&            _out ) {
+        char* end = 0;
+        _out = strtod( _text.c_str(), &end );
+        return !_text.empty() && !*end && _out >= 0;
+    }
+
+    bool parse_probability(
+        const std::string& _text,
+        double&            _out ) {
+        return parse_number( _text, _out ) && _out <= 1;
+    }
+
+    // =-=-=-=-=-=-=-
+    // split _text at the first _sep, false when there is none
+    bool split(
+        const std::string& _text,
+        char               _sep,
+        std::string&       _head,
+        std::string&       _tail ) {
+        std::string::size_type pos = _text.find( _sep );
+        if ( std::string::npos == pos ) {
+            return false;
+        }
+        _head = _text.substr( 0, pos );
+        _tail = _text.substr( pos + 1 );
+        return true;
+    }
+
+} // namespace
+
+shareuf_faults& shareuf_faults::instance() {
+    static shareuf_faults faults;
+    return faults;
+
+} // instance
+
+bool shareuf_faults::parse(
+    const std::string&  _spec,
+    std::vector< rule >& _rules,
+    unsigned long long& _seed,
+    bool&               _seeded ) {
+    std::string::size_type start = 0;
+    while ( start < _spec.size() ) {
+        std::string::size_type end = _spec.find( ',', start );
+        if ( std::string::npos == end ) {
+            end = _spec.size();
+        }
+        std::string item = _spec.substr( start, end - start );
+        start = end + 1;
+        if ( item.empty() ) {
+            continue;
+        }
+
+        std::string name, args;
+        if ( !split( item, ':', name, args ) ) {
+            return false;
+        }
+        if ( "seed" == name ) {
+            double seed;
+            if ( !parse_number( args, seed ) ) {
+                return false;
+            }
+            _seed   = static_cast< unsigned long long >( seed );
+            _seeded = true;
+            continue;
+        }
+
+        rule r;
+        std::string fault;
+        if ( !split( name, '.', r.op, fault ) || r.op.empty() ) {
+            return false;
+        }
+        r.a     = 0;
+        r.b     = 0;
+        r.p     = 1;
+        r.error = 0;
+
+        std::string lhs, rhs;
+        if ( "latency_us" == fault ) {
+            if ( split( args, '/', lhs, rhs ) ) {
+                r.type = FAULT_LATENCY_EXPONENTIAL;
+                if ( "exp" != lhs || !parse_number( rhs, r.a ) ) {
+                    return false;
+                }
+            }
+            else if ( split( args, '-', lhs, rhs ) ) {
+                r.type = FAULT_LATENCY_UNIFORM;
+                if ( !parse_number( lhs, r.a ) || !parse_number( rhs, r.b ) || r.b < r.a ) {
+                    return false;
+                }
+            }
+            else {
+                r.type = FAULT_LATENCY_FIXED;
+                if ( !parse_number( args, r.a ) ) {
+                    return false;
+                }
+            }
+        }
+        else if ( "spike_us" == fault ) {
+            r.type = FAULT_SPIKE;
+            if ( !split( args, '/', lhs, rhs ) || !parse_number( lhs, r.a ) || !parse_probability( rhs, r.p ) ) {
+                return false;
+            }
+        }
+        else if ( "error" == fault ) {
+            r.type = FAULT_ERROR;
+            if ( !split( args, '/', lhs, rhs ) || !parse_errno( lhs, r.error ) || !parse_probability( rhs, r.p ) ) {
+                return false;
+            }
+        }
+        else if ( "short" == fault ) {
+            r.type = FAULT_SHORT_IO;
+            if ( !parse_probability( args, r.p ) ) {
+                return false;
+            }
+        }
+        else {
+            return false;
+        }
+        _rules.push_back( r );
+    }
+    return true;
+
+} // parse
+
+int shareuf_faults::configure(
+    const std::string& _spec ) {
+    std::lock_guard< std::mutex > lock( mutex_ );
+    if ( _spec == spec_ ) {
+        return valid_ ? 0 : -EINVAL;
+    }
+
+    std::vector< rule > rules;
+    unsigned long long  seed   = 0;
+    bool                seeded = false;
+    spec_  = _spec;
+    valid_ = parse( _spec, rules, seed, seeded );
+    rules_.swap( rules );
+    if ( !valid_ ) {
+        rules_.clear();
+        return -EINVAL;
+    }
+    random_.seed( seeded ? seed : std::random_device()() );
+    return 0;
+
+} // configure
+
+int shareuf_faults::inject(
+    const std::string& _op,
+    size_t*            _len,
+    shareuf_fault_io&  _io ) {
+    double delay  = 0;
+    int    status = 0;
+    {
+        std::lock_guard< std::mutex > lock( mutex_ );
+        std::uniform_real_distribution< double > uniform( 0, 1 );
+        for ( size_t i = 0; i < rules_.size(); ++i ) {
+            const rule& r = rules_[ i ];
+            if ( r.op != _op && r.op != "*" ) {
+                continue;
+            }
+            switch ( r.type ) {
+                case FAULT_LATENCY_FIXED:
+                    delay += r.a;
+                    break;
+                case FAULT_LATENCY_UNIFORM:
+                    delay += r.a + ( r.b - r.a ) * uniform( random_ );
+                    break;
+                case FAULT_LATENCY_EXPONENTIAL:
+                    if ( r.a > 0 ) {
+                        delay += std::exponential_distribution< double >( 1 / r.a )( random_ );
+                    }
+                    break;
+                case FAULT_SPIKE:
+                    if ( uniform( random_ ) < r.p ) {
+                        delay += r.a;
+                    }
+                    break;
+                case FAULT_ERROR:
+                    if ( 0 == status && uniform( random_ ) < r.p ) {
+                        status = -r.error;
+                    }
+                    break;
+                case FAULT_SHORT_IO:
+                    if ( _len && *_len > 1 && !_io.shortened && uniform( random_ ) < r.p ) {
+                        *_len         = 1 + static_cast< size_t >( uniform( random_ ) * ( *_len - 1 ) );
+                        _io.shortened = true;
+                    }
+                    break;
+            }
+        }
+    }
+
+    // =-=-=-=-=-=-=-
+    // a failing operation takes its time as well, like a hung mount
+    if ( delay >= 1 ) {
+        _io.delay_us += static_cast< unsigned long long >( delay );
+        std::this_thread::sleep_for( std::chrono::microseconds( static_cast< long long >( delay ) ) );
+    }
+    _io.error = status < 0;
+    return status;
+
+} // inject
@@ -0,0 +1,93 @@
+/* Fault and latency injection for testing the plugin against a slow or
+ * flaky vault, built only with the SHAREUF_FAULT_INJECTION CMake option.
+ *
+ * A spec is a comma separated list of <op>.<fault>:<arguments>, where <op>
+ * names a plugin operation (create, open, read, write, close, unlink,
+ * stat, lseek, mkdir, rmdir, opendir, closedir, readdir, rename, truncate,
+ * freespace, stage, sync) or is * for all of them:
+ *
+ *   <op>.latency_us:<n>           sleep n microseconds
+ *   <op>.latency_us:<a>-<b>       sleep uniformly between a and b
+ *   <op>.latency_us:exp/<mean>    sleep exponentially around mean
+ *   <op>.spike_us:<n>/<p>         sleep n more with probability p
+ *   <op>.error:<errno>/<p>        fail with errno, a name such as EIO or a
+ *                                 number, with probability p
+ *   <op>.short:<p>                shorten a read or write with probability p
+ *   seed:<n>                      seed the random draws
+ *
+ * e.g. "*.latency_us:100-500,read.spike_us:200000/0.001,write.error:ENOSPC/0.0001".
+ * The spec holds neither ';' nor '=' so it fits in a context string.
+ */
+#ifndef SHAREUF_FAULTS_HPP
+#define SHAREUF_FAULTS_HPP
+
+// =-=-=-=-=-=-=-
+// stl includes
+#include <mutex>
+#include <random>
+#include <string>
+#include <vector>
+
+// =-=-=-=-=-=-=-
+// system includes
+#include <stddef.h>
+
+struct shareuf_fault_io {
+    unsigned long long delay_us;    // time slept
+    bool               error;       // the operation was failed
+    bool               shortened;   // the length was cut
+
+    shareuf_fault_io() : delay_us( 0 ), error( false ), shortened( false ) {}
+};
+
+class shareuf_faults {
+    public:
+        static shareuf_faults& instance();
+
+        // =-=-=-=-=-=-=-
+        /// @brief inject the faults of _spec from now on, it is parsed again
+        ///        only when it changes.  returns 0, or -EINVAL for a
+        ///        malformed spec, which injects nothing.
+        int configure( const std::string& _spec );
+
+        // =-=-=-=-=-=-=-
+        /// @brief apply the faults configured for _op: sleep the latency
+        ///        drawn for it and return -errno for an injected error, or
+        ///        0.  _len, when given, may come back shorter.
+        int inject(
+            const std::string& _op,
+            size_t*            _len,
+            shareuf_fault_io&  _io );
+
+    private:
+        shareuf_faults() : valid_( true ) {}
+
+        enum kind {
+            FAULT_LATENCY_FIXED,
+            FAULT_LATENCY_UNIFORM,
+            FAULT_LATENCY_EXPONENTIAL,
+            FAULT_SPIKE,
+            FAULT_ERROR,
+            FAULT_SHORT_IO
+        };
+
+        struct rule {
+            std::string op;
+            kind        type;
+            double      a;          // latency, lower bound or mean
+            double      b;          // upper bound
+            double      p;          // probability
+            int         error;
+        };
+
+        static bool parse( const std::string& _spec, std::vector< rule >& _rules, unsigned long long& _seed, bool& _seeded );
+
+        std::mutex          mutex_;
+        std::string         spec_;
+        bool                valid_;
+        std::vector< rule > rules_;
+        std::mt19937_64     random_;
+
+}; // class shareuf_faults
+
+#endif // SHAREUF_FAULTS_HPP
@@ -0,0 +1,153 @@
+#include "shareuf_fd_pool.hpp"
+
+// =-=-=-=-=-=-=-
+// system includes
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+static bool same_version(
+    const struct stat&     _sb,
+    dev_t                  _dev,
+    ino_t                  _ino,
+    const struct timespec& _mtime,
+    off_t                  _size ) {
+    return _sb.st_dev == _dev &&
+           _sb.st_ino == _ino &&
+           _sb.st_size == _size &&
+           _sb.st_mtim.tv_sec == _mtime.tv_sec &&
+           _sb.st_mtim.tv_nsec == _mtime.tv_nsec;
+
+} // same_version
+
+// =-=-=-=-=-=-=-
+// a duplicate above descriptor 0, which iRODS would take for a status
+static int lend(
+    int _fd ) {
+    return fcntl( _fd, F_DUPFD, 1 );
+
+} // lend
+
+shareuf_fd_pool& shareuf_fd_pool::instance() {
+    static shareuf_fd_pool pool;
+    return pool;
+
+} // instance
+
+shareuf_fd_pool::~shareuf_fd_pool() {
+    evict_locked( entries_.size() );
+
+} // dtor
+
+int shareuf_fd_pool::borrow(
+    const std::string& _path,
+    size_t             _capacity,
+    struct stat&       _sb ) {
+    // =-=-=-=-=-=-=-
+    // revalidate against the path, not the pooled descriptor, so a file
+    // replaced by rename is never served from a stale inode
+    if ( stat( _path.c_str(), &_sb ) < 0 ) {
+        return -errno;
+    }
+
+    if ( !S_ISREG( _sb.st_mode ) ) {
+        return -EINVAL;
+    }
+
+    std::lock_guard< std::mutex > lock( mutex_ );
+
+    entry_map_t::iterator itr = entries_.find( _path );
+    if ( itr != entries_.end() ) {
+        if ( same_version( _sb, itr->second.dev, itr->second.ino, itr->second.mtime, itr->second.size ) ) {
+            int fd = lend( itr->second.fd );
+            if ( fd < 0 ) {
+                return -errno;
+            }
+            itr->second.last_used = ++clock_;
+            return fd;
+        }
+
+        close( itr->second.fd );
+        entries_.erase( itr );
+    }
+
+    if ( _capacity > 0 && entries_.size() >= _capacity ) {
+        evict_locked( entries_.size() - _capacity + 1 );
+    }
+
+    int pool_fd = open( _path.c_str(), O_RDONLY | O_CLOEXEC );
+    if ( pool_fd < 0 && ( errno == EMFILE || errno == ENFILE ) && evict_locked( entries_.size() / 2 + 1 ) > 0 ) {
+        pool_fd = open( _path.c_str(), O_RDONLY | O_CLOEXEC );
+    }
+    if ( pool_fd < 0 ) {
+        return -errno;
+    }
+
+    // =-=-=-=-=-=-=-
+    // key the entry on what was actually opened
+    if ( fstat( pool_fd, &_sb ) < 0 ) {
+        int errsav = errno;
+        close( pool_fd );
+        return -errsav;
+    }
+
+    int fd = lend( pool_fd );
+    if ( fd < 0 ) {
+        int errsav = errno;
+        close( pool_fd );
+        return -errsav;
+    }
+
+    entry& e    = entries_[ _path ];
+    e.fd        = pool_fd;
+    e.dev       = _sb.st_dev;
+    e.ino       = _sb.st_ino;
+    e.mtime     = _sb.st_mtim;
+    e.size      = _sb.st_size;
+    e.last_used = ++clock_;
+
+    return fd;
+
+} // borrow
+
+void shareuf_fd_pool::invalidate(
+    const std::string& _path ) {
+    std::lock_guard< std::mutex > lock( mutex_ );
+    entry_map_t::iterator itr = entries_.find( _path );
+    if ( itr != entries_.end() ) {
+        close( itr->second.fd );
+        entries_.erase( itr );
+    }
+
+} // invalidate
+
+size_t shareuf_fd_pool::evict(
+    size_t _count ) {
+    std::lock_guard< std::mutex > lock( mutex_ );
+    return evict_locked( _count );
+
+} // evict
+
+size_t shareuf_fd_pool::evict_locked(
+    size_t _count ) {
+    size_t evicted = 0;
+    while ( evicted < _count && !entries_.empty() ) {
+        entry_map_t::iterator lru = entries_.begin();
+        for ( entry_map_t::iterator itr = entries_.begin(); itr != entries_.end(); ++itr ) {
+            if ( itr->second.last_used < lru->second.last_used ) {
+                lru = itr;
+            }
+        }
+        close( lru->second.fd );
+        entries_.erase( lru );
+        ++evicted;
+    }
+    return evicted;
+
+} // evict_locked
+
+size_t shareuf_fd_pool::size() {
+    std::lock_guard< std::mutex > lock( mutex_ );
+    return entries_.size();
+
+} // size
@@ -0,0 +1,73 @@
+/* A bounded pool of read-only descriptors for vault files that are
+ * opened over and over. On network filesystems every open() is a
+ * round trip plus a permission check; borrowing from the pool costs a
+ * stat() and a dup().
+ *
+ * Borrowed descriptors share their file offset with the pool entry, so
+ * callers must read them with pread() and track the offset themselves.
+ */
+#ifndef SHAREUF_FD_POOL_HPP
+#define SHAREUF_FD_POOL_HPP
+
+// =-=-=-=-=-=-=-
+// stl includes
+#include <map>
+#include <mutex>
+#include <string>
+
+// =-=-=-=-=-=-=-
+// system includes
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <time.h>
+
+class shareuf_fd_pool {
+    public:
+        static shareuf_fd_pool& instance();
+
+        // =-=-=-=-=-=-=-
+        /// @brief returns a dup of a pooled O_RDONLY descriptor for _path,
+        ///        opening and pooling one if no valid entry exists.  the dup
+        ///        is never descriptor 0.  _capacity bounds the number of
+        ///        pooled descriptors.  on success _sb holds the attributes the
+        ///        entry was validated against.  returns -errno on failure.
+        int borrow(
+            const std::string& _path,
+            size_t             _capacity,
+            struct stat&       _sb );
+
+        // =-=-=-=-=-=-=-
+        /// @brief drops any pooled descriptor for _path, called by writers
+        void invalidate( const std::string& _path );
+
+        // =-=-=-=-=-=-=-
+        /// @brief closes up to _count least recently used descriptors,
+        ///        returns the number closed
+        size_t evict( size_t _count );
+
+        size_t size();
+
+    private:
+        shareuf_fd_pool() : clock_( 0 ) {}
+        ~shareuf_fd_pool();
+
+        struct entry {
+            int             fd;
+            dev_t           dev;
+            ino_t           ino;
+            struct timespec mtime;
+            off_t           size;
+            unsigned long   last_used;
+        };
+
+        typedef std::map< std::string, entry > entry_map_t;
+
+        size_t evict_locked( size_t _count );
+
+        std::mutex    mutex_;
+        entry_map_t   entries_;
+        unsigned long clock_;
+
+}; // class shareuf_fd_pool
+
+#endif // SHAREUF_FD_POOL_HPP
@@ -0,0 +1,141 @@
+#include "shareuf_inline_digest.hpp"
+
+// =-=-=-=-=-=-=-
+// stl includes
+#include <sstream>
+
+// =-=-=-=-=-=-=-
+// system includes
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/xattr.h>
+
+const char* const SHAREUF_DIGEST_XATTR = "user.shareuf.checksum";
+
+void shareuf_inline_digest::update(
+    off_t       _offset,
+    const void* _data,
+    size_t      _len ) {
+    if ( !valid ) {
+        return;
+    }
+    if ( _offset != next_offset ) {
+        valid = false;
+        return;
+    }
+    sha256.update( _data, _len );
+    crc32c       = shareuf_crc32c( crc32c, _data, _len );
+    next_offset += _len;
+
+} // update
+
+int shareuf_store_digest(
+    int                    _fd,
+    shareuf_inline_digest& _digest ) {
+    struct stat sb;
+    if ( fstat( _fd, &sb ) < 0 ) {
+        return -errno;
+    }
+
+    if ( !_digest.valid || sb.st_size != _digest.next_offset ) {
+        shareuf_drop_digest( _fd );
+        return 0;
+    }
+
+    unsigned char sha[ SHAREUF_SHA256_DIGEST_SIZE ];
+    _digest.sha256.final( sha );
+    _digest.valid = false;
+
+    char crc[ 16 ];
+    snprintf( crc, sizeof( crc ), "%08x", _digest.crc32c );
+
+    // =-=-=-=-=-=-=-
+    // v1 <size> <mtime sec>.<mtime nsec> <sha2:...> <crc32c>
+    std::stringstream value;
+    value << "v1 " << sb.st_size << " " << sb.st_mtim.tv_sec << "." << sb.st_mtim.tv_nsec
+          << " " << shareuf_sha256_to_irods( sha ) << " " << crc;
+    std::string v = value.str();
+
+    if ( fsetxattr( _fd, SHAREUF_DIGEST_XATTR, v.data(), v.size(), 0 ) < 0 ) {
+        return -errno;
+    }
+    return 0;
+
+} // shareuf_store_digest
+
+static bool parse_digest(
+    const char*            _value,
+    ssize_t                _len,
+    shareuf_stored_digest& _out ) {
+    if ( _len <= 0 ) {
+        return false;
+    }
+
+    std::stringstream in( std::string( _value, _len ) );
+    std::string version, mtime, crc;
+    in >> version >> _out.size >> mtime >> _out.sha256 >> crc;
+    if ( in.fail() || version != "v1" ) {
+        return false;
+    }
+
+    long long sec = 0, nsec = 0;
+    if ( sscanf( mtime.c_str(), "%lld.%lld", &sec, &nsec ) != 2 ) {
+        return false;
+    }
+    _out.mtime.tv_sec  = sec;
+    _out.mtime.tv_nsec = nsec;
+    _out.crc32c        = static_cast< uint32_t >( strtoul( crc.c_str(), NULL, 16 ) );
+
+    return true;
+
+} // parse_digest
+
+static bool is_current(
+    const shareuf_stored_digest& _digest,
+    const struct stat&           _sb ) {
+    return _digest.size == _sb.st_size &&
+           _digest.mtime.tv_sec == _sb.st_mtim.tv_sec &&
+           _digest.mtime.tv_nsec == _sb.st_mtim.tv_nsec;
+
+} // is_current
+
+bool shareuf_read_digest(
+    int                    _fd,
+    shareuf_stored_digest& _out ) {
+    char value[ 256 ];
+    return parse_digest( value, fgetxattr( _fd, SHAREUF_DIGEST_XATTR, value, sizeof( value ) ), _out );
+
+} // shareuf_read_digest
+
+bool shareuf_lookup_digest(
+    int                    _fd,
+    const struct stat&     _sb,
+    shareuf_stored_digest& _out ) {
+    char value[ 256 ];
+    return parse_digest( value, fgetxattr( _fd, SHAREUF_DIGEST_XATTR, value, sizeof( value ) ), _out ) &&
+           is_current( _out, _sb );
+
+} // shareuf_lookup_digest
+
+bool shareuf_lookup_digest(
+    const std::string&     _path,
+    const struct stat&     _sb,
+    shareuf_stored_digest& _out ) {
+    char value[ 256 ];
+    return parse_digest( value, getxattr( _path.c_str(), SHAREUF_DIGEST_XATTR, value, sizeof( value ) ), _out ) &&
+           is_current( _out, _sb );
+
+} // shareuf_lookup_digest
+
+void shareuf_drop_digest(
+    int _fd ) {
+    fremovexattr( _fd, SHAREUF_DIGEST_XATTR );
+
+} // shareuf_drop_digest
+
+void shareuf_drop_digest(
+    const std::string& _path ) {
+    removexattr( _path.c_str(), SHAREUF_DIGEST_XATTR );
+
+} // shareuf_drop_digest
@@ -0,0 +1,79 @@
+/* Digests computed while a file is written sequentially, and stored with
+ * the file in an extended attribute so they can be trusted later for as
+ * long as the file's size and mtime are unchanged.
+ */
+#ifndef SHAREUF_INLINE_DIGEST_HPP
+#define SHAREUF_INLINE_DIGEST_HPP
+
+#include "shareuf_checksum.hpp"
+
+// =-=-=-=-=-=-=-
+// stl includes
+#include <string>
+
+// =-=-=-=-=-=-=-
+// system includes
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <time.h>
+
+extern const char* const SHAREUF_DIGEST_XATTR;
+
+// =-=-=-=-=-=-=-
+/// @brief digest as recorded in the extended attribute
+struct shareuf_stored_digest {
+    off_t           size;
+    struct timespec mtime;
+    std::string     sha256;     // iRODS "sha2:" form
+    uint32_t        crc32c;
+};
+
+// =-=-=-=-=-=-=-
+/// @brief running digest of the bytes written to a descriptor, which
+///        stays valid only while every write lands at next_offset
+struct shareuf_inline_digest {
+    shareuf_sha256 sha256;
+    uint32_t       crc32c;
+    off_t          next_offset;
+    bool           valid;
+
+    shareuf_inline_digest() : crc32c( 0 ), next_offset( 0 ), valid( true ) {}
+
+    /// @brief fold in _len bytes written at _offset
+    void update( off_t _offset, const void* _data, size_t _len );
+
+}; // struct shareuf_inline_digest
+
+// =-=-=-=-=-=-=-
+/// @brief finish _digest and attach it to _fd, or drop any stored digest if
+///        _digest no longer covers the whole file.  returns 0 or -errno.
+int shareuf_store_digest(
+    int                    _fd,
+    shareuf_inline_digest& _digest );
+
+// =-=-=-=-=-=-=-
+/// @brief fast lookup of a stored digest, true only if one exists and was
+///        recorded for the size and mtime in _sb
+bool shareuf_lookup_digest(
+    int                    _fd,
+    const struct stat&     _sb,
+    shareuf_stored_digest& _out );
+
+bool shareuf_lookup_digest(
+    const std::string&     _path,
+    const struct stat&     _sb,
+    shareuf_stored_digest& _out );
+
+// =-=-=-=-=-=-=-
+/// @brief read the stored digest whether or not it is still current,
+///        false if there is none or it cannot be parsed
+bool shareuf_read_digest(
+    int                    _fd,
+    shareuf_stored_digest& _out );
+
+// =-=-=-=-=-=-=-
+/// @brief remove the stored digest, if any
+void shareuf_drop_digest( int _fd );
+void shareuf_drop_digest( const std::string& _path );
+
+#endif // SHAREUF_INLINE_DIGEST_HPP
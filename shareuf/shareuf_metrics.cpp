@@ -0,0 +1,68 @@
+#include "shareuf_metrics.hpp"
+
+// =-=-=-=-=-=-=-
+// stl includes
+#include <sstream>
+
+shareuf_metrics& shareuf_metrics::instance() {
+    static shareuf_metrics metrics;
+    return metrics;
+
+} // instance
+
+void shareuf_metrics::add(
+    const std::string& _name,
+    long long          _value ) {
+    std::lock_guard< std::mutex > lock( mutex_ );
+    counters_[ _name ] += _value;
+
+} // add
+
+void shareuf_metrics::record_latency(
+    const std::string& _name,
+    long long          _usec ) {
+    std::lock_guard< std::mutex > lock( mutex_ );
+    std::map< std::string, latency >::iterator itr = latencies_.find( _name );
+    if ( itr == latencies_.end() ) {
+        latency l = { 0, 0, 0 };
+        itr = latencies_.insert( std::make_pair( _name, l ) ).first;
+    }
+    itr->second.count      += 1;
+    itr->second.total_usec += _usec;
+    if ( _usec > itr->second.max_usec ) {
+        itr->second.max_usec = _usec;
+    }
+
+} // record_latency
+
+std::string shareuf_metrics::format() {
+    std::lock_guard< std::mutex > lock( mutex_ );
+    std::stringstream out;
+    for ( std::map< std::string, long long >::const_iterator itr = counters_.begin(); itr != counters_.end(); ++itr ) {
+        out << itr->first << "=" << itr->second << " ";
+    }
+    for ( std::map< std::string, latency >::const_iterator itr = latencies_.begin(); itr != latencies_.end(); ++itr ) {
+        out << itr->first << ".count=" << itr->second.count << " "
+            << itr->first << ".avg_us=" << itr->second.total_usec / itr->second.count << " "
+            << itr->first << ".max_us=" << itr->second.max_usec << " ";
+    }
+    std::string formatted = out.str();
+    if ( !formatted.empty() ) {
+        formatted.erase( formatted.size() - 1 );
+    }
+    return formatted;
+
+} // format
+
+bool shareuf_metrics::empty() {
+    std::lock_guard< std::mutex > lock( mutex_ );
+    return counters_.empty() && latencies_.empty();
+
+} // empty
+
+void shareuf_metrics::reset() {
+    std::lock_guard< std::mutex > lock( mutex_ );
+    counters_.clear();
+    latencies_.clear();
+
+} // reset
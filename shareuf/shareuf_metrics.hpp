@@ -0,0 +1,74 @@
+/* Process-wide counters and latency summaries for the shareuf plugin.
+ * They are written to the server log once the client has disconnected
+ * and again, if anything was counted since, when the resource is torn down.
+ */
+#ifndef SHAREUF_METRICS_HPP
+#define SHAREUF_METRICS_HPP
+
+// =-=-=-=-=-=-=-
+// stl includes
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <string>
+
+class shareuf_metrics {
+    public:
+        static shareuf_metrics& instance();
+
+        // =-=-=-=-=-=-=-
+        /// @brief add _value to the counter _name
+        void add( const std::string& _name, long long _value );
+
+        // =-=-=-=-=-=-=-
+        /// @brief fold one observation, in microseconds, into the latency summary _name
+        void record_latency( const std::string& _name, long long _usec );
+
+        // =-=-=-=-=-=-=-
+        /// @brief render all counters and summaries as space separated key=value pairs
+        std::string format();
+
+        bool empty();
+
+        // =-=-=-=-=-=-=-
+        /// @brief drop all counters and summaries, once they have been logged
+        void reset();
+
+    private:
+        shareuf_metrics() {}
+
+        struct latency {
+            long long count;
+            long long total_usec;
+            long long max_usec;
+        };
+
+        std::mutex                           mutex_;
+        std::map< std::string, long long >   counters_;
+        std::map< std::string, latency >     latencies_;
+
+}; // class shareuf_metrics
+
+// =-=-=-=-=-=-=-
+/// @brief records the lifetime of the object as a latency observation
+class shareuf_latency_timer {
+    public:
+        explicit shareuf_latency_timer( const std::string& _name ) :
+            name_( _name ),
+            start_( std::chrono::steady_clock::now() ) {
+        }
+
+        ~shareuf_latency_timer() {
+            shareuf_metrics::instance().record_latency(
+                name_,
+                std::chrono::duration_cast< std::chrono::microseconds >(
+                    std::chrono::steady_clock::now() - start_ ).count() );
+        }
+
+    private:
+        std::string                           name_;
+        std::chrono::steady_clock::time_point start_;
+
+}; // class shareuf_latency_timer
+
+#endif // SHAREUF_METRICS_HPP
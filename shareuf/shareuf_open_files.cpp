@@ -0,0 +1,85 @@
+#include "shareuf_open_files.hpp"
+
+// =-=-=-=-=-=-=-
+// system includes
+#include <fcntl.h>
+
+shareuf_shared_reservation::~shareuf_shared_reservation() {
+    if ( reservation.active() ) {
+        shareuf_release_reservation( reservation );
+    }
+
+} // dtor
+
+shareuf_open_files& shareuf_open_files::instance() {
+    static shareuf_open_files table;
+    return table;
+
+} // instance
+
+void shareuf_open_files::insert(
+    int                   _fd,
+    shareuf_open_file_ptr _of ) {
+    std::lock_guard< std::mutex > lock( mutex_ );
+    files_[ _fd ] = _of;
+
+} // insert
+
+shareuf_open_file_ptr shareuf_open_files::find(
+    int _fd ) {
+    std::lock_guard< std::mutex > lock( mutex_ );
+    std::map< int, shareuf_open_file_ptr >::iterator itr = files_.find( _fd );
+    if ( itr == files_.end() ) {
+        return shareuf_open_file_ptr();
+    }
+    return itr->second;
+
+} // find
+
+shareuf_open_file_ptr shareuf_open_files::erase(
+    int _fd ) {
+    std::lock_guard< std::mutex > lock( mutex_ );
+    std::map< int, shareuf_open_file_ptr >::iterator itr = files_.find( _fd );
+    if ( itr == files_.end() ) {
+        return shareuf_open_file_ptr();
+    }
+    shareuf_open_file_ptr of = itr->second;
+    files_.erase( itr );
+    return of;
+
+} // erase
+
+int shareuf_open_files::dup_writable(
+    const std::string& _path ) {
+    // =-=-=-=-=-=-=-
+    // duplicated under the lock, close() erases an entry before closing it
+    std::lock_guard< std::mutex > lock( mutex_ );
+    for ( std::map< int, shareuf_open_file_ptr >::iterator itr = files_.begin(); itr != files_.end(); ++itr ) {
+        if ( itr->second->path == _path && !itr->second->pooled && ( itr->second->flags & O_ACCMODE ) != O_RDONLY ) {
+            return fcntl( itr->first, F_DUPFD_CLOEXEC, 3 );
+        }
+    }
+    return -1;
+
+} // dup_writable
+
+shareuf_shared_reservation_ptr shareuf_open_files::reservation_of(
+    const std::string& _path ) {
+    std::lock_guard< std::mutex > lock( mutex_ );
+    for ( std::map< int, shareuf_open_file_ptr >::iterator itr = files_.begin(); itr != files_.end(); ++itr ) {
+        if ( itr->second->path == _path && itr->second->reservation ) {
+            return itr->second->reservation;
+        }
+    }
+    return shareuf_shared_reservation_ptr();
+
+} // reservation_of
+
+void shareuf_open_files::list(
+    std::vector< shareuf_open_file_ptr >& _out ) {
+    std::lock_guard< std::mutex > lock( mutex_ );
+    for ( std::map< int, shareuf_open_file_ptr >::iterator itr = files_.begin(); itr != files_.end(); ++itr ) {
+        _out.push_back( itr->second );
+    }
+
+} // list
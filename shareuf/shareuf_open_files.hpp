@@ -0,0 +1,124 @@
+/* Per-descriptor state kept by the shareuf plugin for files it has
+ * opened or created, keyed by the descriptor handed back to iRODS.
+ */
+#ifndef SHAREUF_OPEN_FILES_HPP
+#define SHAREUF_OPEN_FILES_HPP
+
+#include "shareuf_block_cache.hpp"
+#include "shareuf_inline_digest.hpp"
+#include "shareuf_prefetch.hpp"
+#include "shareuf_reservations.hpp"
+#include "shareuf_streaming_io.hpp"
+
+// =-=-=-=-=-=-=-
+// stl includes
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// =-=-=-=-=-=-=-
+// system includes
+#include <sys/types.h>
+
+// =-=-=-=-=-=-=-
+/// @brief free space held for a file being written, shared by every
+///        descriptor writing it, as the threads of a parallel transfer
+///        reopen the created file.  released when the last of them lets
+///        go of it.
+struct shareuf_shared_reservation {
+    std::mutex          mutex;
+    shareuf_reservation reservation;
+    int64_t             total;          // size announced by the create
+    int64_t             unsettled;      // bytes written since the reservation was last shrunk
+
+    shareuf_shared_reservation() : total( 0 ), unsettled( 0 ) {}
+    ~shareuf_shared_reservation();
+
+}; // struct shareuf_shared_reservation
+
+typedef std::shared_ptr< shareuf_shared_reservation > shareuf_shared_reservation_ptr;
+
+// =-=-=-=-=-=-=-
+/// @brief state tracked for a descriptor returned by create or open
+struct shareuf_open_file {
+    std::string path;           // full physical path the descriptor refers to
+    int         flags;          // open flags as requested by the server
+    bool        pooled;         // descriptor is a dup of a shared read-only pool entry
+    off_t       offset;         // current file offset as seen by the server
+    off_t       size;           // size of the file when it was opened
+
+    shareuf_streaming_mode streaming;       // handling of writes once past the threshold
+    off_t                  streaming_threshold;
+    bool                   direct;          // O_DIRECT is currently set on the descriptor
+    off_t                  dropped;         // written pages before this offset were dropped
+
+    shareuf_shared_reservation_ptr reservation;     // free space held for the rest of the file
+
+    std::unique_ptr< shareuf_inline_digest > digest;    // running digest of sequential writes
+
+    std::string            publish_path;    // final path of an unpublished file, linked on its last close
+
+    bool                   cached;              // read through the block cache
+    shareuf_block_file     cache_file;          // identity the blocks are cached under
+    bool                   cache_invalidated;   // written, cached blocks were dropped
+
+    shareuf_prefetch_ptr   prefetch;            // read-ahead of a large read-only file
+
+    shareuf_open_file(
+        const std::string& _path,
+        int                _flags ) :
+        path( _path ),
+        flags( _flags ),
+        pooled( false ),
+        offset( 0 ),
+        size( 0 ),
+        streaming( SHAREUF_STREAMING_BUFFERED ),
+        streaming_threshold( 0 ),
+        direct( false ),
+        dropped( 0 ),
+        cached( false ),
+        cache_invalidated( false ) {
+    }
+
+}; // struct shareuf_open_file
+
+typedef std::shared_ptr< shareuf_open_file > shareuf_open_file_ptr;
+
+// =-=-=-=-=-=-=-
+/// @brief process-wide table of open descriptors. iRODS serializes the
+///        operations on any one descriptor, so entries are only guarded
+///        while they are inserted, looked up or removed.
+class shareuf_open_files {
+    public:
+        static shareuf_open_files& instance();
+
+        void insert( int _fd, shareuf_open_file_ptr _of );
+
+        /// @brief returns a null pointer when the descriptor is not tracked
+        shareuf_open_file_ptr find( int _fd );
+
+        /// @brief removes and returns the entry, null if it was not tracked
+        shareuf_open_file_ptr erase( int _fd );
+
+        /// @brief a duplicate of a descriptor open for writing on _path, or
+        ///        -1 when there is none
+        int dup_writable( const std::string& _path );
+
+        /// @brief the reservation held by a descriptor open on _path, null
+        ///        when there is none
+        shareuf_shared_reservation_ptr reservation_of( const std::string& _path );
+
+        /// @brief copy the entries still open into _out
+        void list( std::vector< shareuf_open_file_ptr >& _out );
+
+    private:
+        shareuf_open_files() {}
+
+        std::mutex                              mutex_;
+        std::map< int, shareuf_open_file_ptr >  files_;
+
+}; // class shareuf_open_files
+
+#endif // SHAREUF_OPEN_FILES_HPP
@@ -0,0 +1,400 @@
+#include "shareuf_prefetch.hpp"
+
+// =-=-=-=-=-=-=-
+// stl includes
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <system_error>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// =-=-=-=-=-=-=-
+// system includes
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+namespace {
+
+    enum chunk_state {
+        CHUNK_QUEUED,
+        CHUNK_READING,
+        CHUNK_READY,
+        CHUNK_FAILED,
+        CHUNK_DROPPED       // dropped while being read, the reader releases it
+    };
+
+    struct chunk {
+        off_t               offset;
+        size_t              length;     // bytes asked for, those read once ready
+        size_t              reserved;   // bytes counted against the memory cap
+        size_t              served;
+        chunk_state         state;
+        std::vector< char > data;
+
+        chunk(
+            off_t  _offset,
+            size_t _length ) :
+            offset( _offset ),
+            length( _length ),
+            reserved( _length ),
+            served( 0 ),
+            state( CHUNK_QUEUED ) {
+        }
+    };
+
+    typedef std::shared_ptr< chunk > chunk_ptr;
+
+    // =-=-=-=-=-=-=-
+    // bytes reserved by the chunks of every stream.  kept outside the
+    // engine, streams may outlive it at exit.
+    std::atomic< size_t > held_memory( 0 );
+
+    // =-=-=-=-=-=-=-
+    // streams started and not cancelled, which share the memory cap
+    std::atomic< size_t > live_streams( 0 );
+
+    // =-=-=-=-=-=-=-
+    // read _chunk from _fd, called without the lock.  a short chunk is the
+    // end of the file.
+    bool fetch(
+        int    _fd,
+        chunk& _chunk ) {
+        _chunk.data.resize( _chunk.length );
+        size_t got = 0;
+        while ( got < _chunk.length ) {
+            ssize_t n = pread( _fd, &_chunk.data[ got ], _chunk.length - got, _chunk.offset + got );
+            if ( n < 0 ) {
+                if ( EINTR == errno ) {
+                    continue;
+                }
+                return false;
+            }
+            if ( 0 == n ) {
+                break;
+            }
+            got += n;
+        }
+        _chunk.length = got;
+        return true;
+    }
+
+} // namespace
+
+class shareuf_prefetch_stream : public std::enable_shared_from_this< shareuf_prefetch_stream > {
+    public:
+        shareuf_prefetch_stream(
+            int                             _fd,
+            off_t                           _size,
+            off_t                           _offset,
+            const shareuf_prefetch_options& _opts ) :
+            fd( _fd ),
+            size( _size ),
+            opts( _opts ),
+            position( _offset ),
+            next( _offset ),
+            sequential( true ),
+            cancelled( false ) {
+        }
+
+        ~shareuf_prefetch_stream() {
+            // =-=-=-=-=-=-=-
+            // queued jobs hold the stream, no chunk left here is in flight
+            if ( !cancelled ) {
+                --live_streams;
+            }
+            for ( size_t i = 0; i < chunks.size(); ++i ) {
+                held_memory -= chunks[ i ]->reserved;
+            }
+            close( fd );
+        }
+
+        int                         fd;         // duplicate read by the pool
+        off_t                       size;
+        shareuf_prefetch_options    opts;
+        off_t                       position;   // offset the reader is expected at, -1 after a jump
+        off_t                       next;       // first offset not queued yet
+        bool                        sequential; // the reader continued where it left off
+        bool                        cancelled;
+        std::deque< chunk_ptr >     chunks;     // contiguous, ending at next
+
+}; // class shareuf_prefetch_stream
+
+namespace {
+
+    class prefetch_engine {
+        public:
+            static prefetch_engine& instance() {
+                static prefetch_engine engine;
+                return engine;
+            }
+
+            // =-=-=-=-=-=-=-
+            // queue the chunks missing from the window of _stream, the lock
+            // is held
+            void fill(
+                shareuf_prefetch_stream& _stream ) {
+                if ( _stream.cancelled || !_stream.sequential ) {
+                    return;
+                }
+                // =-=-=-=-=-=-=-
+                // a window larger than a fair share of the cap would let
+                // the first streams keep all of it
+                size_t share = std::max( _stream.opts.chunk, _stream.opts.max_memory / std::max< size_t >( live_streams, 1 ) );
+                off_t  limit = std::min< off_t >( _stream.size, _stream.position + std::min( _stream.opts.window, share ) );
+                while ( _stream.next < limit ) {
+                    size_t len = static_cast< size_t >( std::min< off_t >( _stream.opts.chunk, _stream.size - _stream.next ) );
+                    if ( held_memory + len > _stream.opts.max_memory ) {
+                        break;
+                    }
+                    held_memory += len;
+
+                    chunk_ptr c( new chunk( _stream.next, len ) );
+                    _stream.chunks.push_back( c );
+                    _stream.next += len;
+                    jobs_.push_back( std::make_pair( _stream.shared_from_this(), c ) );
+                    work_cv_.notify_one();
+                }
+
+                // =-=-=-=-=-=-=-
+                // the pool grows on demand.  a reader reaching a chunk
+                // nobody picked up reads it itself, so a pool which cannot
+                // grow only costs the read-ahead.
+                try {
+                    while ( threads_.size() < _stream.opts.threads && !jobs_.empty() ) {
+                        threads_.push_back( std::thread( &prefetch_engine::worker, this ) );
+                    }
+                }
+                catch ( const std::system_error& ) {
+                }
+            }
+
+            // =-=-=-=-=-=-=-
+            // forget _chunk, the lock is held
+            void drop(
+                chunk&               _chunk,
+                shareuf_prefetch_io& _io ) {
+                if ( CHUNK_READING == _chunk.state ) {
+                    _io.wasted   += _chunk.reserved;
+                    _chunk.state  = CHUNK_DROPPED;
+                    return;
+                }
+                if ( CHUNK_READY == _chunk.state ) {
+                    _io.wasted += _chunk.length - _chunk.served;
+                }
+                _chunk.state  = CHUNK_DROPPED;
+                held_memory  -= _chunk.reserved;
+            }
+
+            void drop_all(
+                shareuf_prefetch_stream& _stream,
+                shareuf_prefetch_io&     _io ) {
+                for ( size_t i = 0; i < _stream.chunks.size(); ++i ) {
+                    drop( *_stream.chunks[ i ], _io );
+                }
+                _stream.chunks.clear();
+            }
+
+            // =-=-=-=-=-=-=-
+            // the reader moved to _offset, keep what is still ahead of it.
+            // after a jump out of the window the read-ahead waits for two
+            // reads in a row before it starts again, so random access does
+            // not fetch a window per read.
+            void realign(
+                shareuf_prefetch_stream& _stream,
+                off_t                    _offset,
+                shareuf_prefetch_io&     _io ) {
+                if ( _stream.chunks.empty() || _stream.chunks.front()->offset > _offset || _offset >= _stream.next ) {
+                    drop_all( _stream, _io );
+                    _stream.next       = _offset;
+                    _stream.position   = -1;
+                    _stream.sequential = false;
+                    return;
+                }
+                while ( _stream.chunks.front()->offset + static_cast< off_t >( _stream.chunks.front()->reserved ) <= _offset ) {
+                    drop( *_stream.chunks.front(), _io );
+                    _stream.chunks.pop_front();
+                }
+                _stream.position = _offset;
+            }
+
+            std::mutex              mutex_;
+            std::condition_variable done_cv_;
+
+        private:
+            prefetch_engine() : stop_( false ) {}
+
+            ~prefetch_engine() {
+                {
+                    std::lock_guard< std::mutex > lock( mutex_ );
+                    stop_ = true;
+                }
+                work_cv_.notify_all();
+                for ( size_t i = 0; i < threads_.size(); ++i ) {
+                    threads_[ i ].join();
+                }
+            }
+
+            void worker() {
+                std::unique_lock< std::mutex > lock( mutex_ );
+                while ( true ) {
+                    work_cv_.wait( lock, [this] { return stop_ || !jobs_.empty(); } );
+                    if ( stop_ ) {
+                        return;
+                    }
+                    std::pair< shareuf_prefetch_ptr, chunk_ptr > job = jobs_.front();
+                    jobs_.pop_front();
+                    chunk& c = *job.second;
+                    if ( CHUNK_QUEUED != c.state ) {
+                        continue;
+                    }
+
+                    c.state = CHUNK_READING;
+                    lock.unlock();
+                    bool ok = fetch( job.first->fd, c );
+                    lock.lock();
+
+                    if ( CHUNK_DROPPED == c.state ) {
+                        held_memory -= c.reserved;
+                        std::vector< char >().swap( c.data );
+                    }
+                    else {
+                        c.state = ok ? CHUNK_READY : CHUNK_FAILED;
+                        done_cv_.notify_all();
+                    }
+                }
+            }
+
+            std::condition_variable                                    work_cv_;
+            std::deque< std::pair< shareuf_prefetch_ptr, chunk_ptr > > jobs_;
+            std::vector< std::thread >                                 threads_;
+            bool                                                       stop_;
+
+    }; // class prefetch_engine
+
+} // namespace
+
+shareuf_prefetch_ptr shareuf_prefetch_start(
+    int                             _fd,
+    off_t                           _offset,
+    off_t                           _size,
+    const shareuf_prefetch_options& _opts ) {
+    if ( 0 == _opts.window || 0 == _opts.chunk || 0 == _opts.threads || _opts.max_memory < _opts.chunk || _offset >= _size ) {
+        return shareuf_prefetch_ptr();
+    }
+    int fd = fcntl( _fd, F_DUPFD_CLOEXEC, 0 );
+    if ( fd < 0 ) {
+        return shareuf_prefetch_ptr();
+    }
+
+    shareuf_prefetch_ptr stream( new shareuf_prefetch_stream( fd, _size, _offset, _opts ) );
+    ++live_streams;
+    prefetch_engine& engine = prefetch_engine::instance();
+    std::lock_guard< std::mutex > lock( engine.mutex_ );
+    engine.fill( *stream );
+    return stream;
+
+} // shareuf_prefetch_start
+
+size_t shareuf_prefetch_read(
+    shareuf_prefetch_stream& _stream,
+    void*                    _buf,
+    size_t                   _len,
+    off_t                    _offset,
+    shareuf_prefetch_io&     _io ) {
+    prefetch_engine& engine = prefetch_engine::instance();
+    std::unique_lock< std::mutex > lock( engine.mutex_ );
+    if ( _stream.cancelled ) {
+        return 0;
+    }
+    if ( _offset != _stream.position ) {
+        engine.realign( _stream, _offset, _io );
+        if ( !_stream.sequential ) {
+            _stream.position = _offset + _len;
+            return 0;
+        }
+    }
+    else if ( !_stream.sequential ) {
+        _stream.sequential = true;
+        _stream.next       = _offset;
+    }
+
+    // =-=-=-=-=-=-=-
+    // only this reader drops chunks of the stream, those it holds stay put
+    // while it copies them without the lock
+    size_t copied = 0;
+    while ( copied < _len && !_stream.chunks.empty() ) {
+        chunk_ptr c   = _stream.chunks.front();
+        off_t     pos = _offset + copied;
+        if ( CHUNK_QUEUED == c->state ) {
+            c->state = CHUNK_READING;
+            lock.unlock();
+            bool ok = fetch( _stream.fd, *c );
+            lock.lock();
+            c->state = ok ? CHUNK_READY : CHUNK_FAILED;
+        }
+        else if ( CHUNK_READING == c->state ) {
+            ++_io.waits;
+            engine.done_cv_.wait( lock, [&c] { return CHUNK_READING != c->state; } );
+        }
+        if ( CHUNK_FAILED == c->state ) {
+            break;  // the caller reads, and reports, the error itself
+        }
+
+        size_t skip = static_cast< size_t >( pos - c->offset );
+        size_t n    = skip < c->length ? std::min( _len - copied, c->length - skip ) : 0;
+        if ( n > 0 ) {
+            lock.unlock();
+            memcpy( static_cast< char* >( _buf ) + copied, &c->data[ skip ], n );
+            lock.lock();
+            c->served += n;
+            copied    += n;
+        }
+        if ( skip + n < c->length ) {
+            break;
+        }
+        engine.drop( *c, _io );
+        _stream.chunks.pop_front();
+        if ( c->length < c->reserved ) {
+            break;  // end of file
+        }
+    }
+
+    _stream.position  = _offset + copied;
+    _io.used         += copied;
+    engine.fill( _stream );
+    return copied;
+
+} // shareuf_prefetch_read
+
+void shareuf_prefetch_seek(
+    shareuf_prefetch_stream& _stream,
+    off_t                    _offset,
+    shareuf_prefetch_io&     _io ) {
+    prefetch_engine& engine = prefetch_engine::instance();
+    std::lock_guard< std::mutex > lock( engine.mutex_ );
+    if ( _stream.cancelled || _offset == _stream.position ) {
+        return;
+    }
+    engine.realign( _stream, _offset, _io );
+    engine.fill( _stream );
+
+} // shareuf_prefetch_seek
+
+void shareuf_prefetch_cancel(
+    shareuf_prefetch_stream& _stream,
+    shareuf_prefetch_io&     _io ) {
+    prefetch_engine& engine = prefetch_engine::instance();
+    std::lock_guard< std::mutex > lock( engine.mutex_ );
+    if ( !_stream.cancelled ) {
+        --live_streams;
+    }
+    _stream.cancelled = true;
+    engine.drop_all( _stream, _io );
+
+} // shareuf_prefetch_cancel
@@ -0,0 +1,85 @@
+/* Asynchronous read-ahead for sequential reads of large files.
+ *
+ * A stream is started on a read-only descriptor and keeps a window of
+ * chunks ahead of the reader queued on a small process-wide pool of
+ * threads, each reading its chunk into memory through a duplicate of the
+ * descriptor.  Reads are served from the chunks which have arrived; a read
+ * reaching a chunk still queued reads it itself rather than waiting behind
+ * other streams, and one reaching a chunk in flight waits for it.  Chunks
+ * are only queued while the memory held by all streams stays under a cap.
+ *
+ * A seek outside the window, or a read at an offset the stream did not
+ * expect, drops the chunks and stops the read-ahead until two reads in a
+ * row continue each other, which restarts the window there.  That suits
+ * the one seek per thread of a parallel transfer without fetching a window
+ * for every read of random access.  Each stream keeps at most its share of
+ * the cap, and bytes fetched but never served are counted as wasted.
+ */
+#ifndef SHAREUF_PREFETCH_HPP
+#define SHAREUF_PREFETCH_HPP
+
+// =-=-=-=-=-=-=-
+// stl includes
+#include <memory>
+
+// =-=-=-=-=-=-=-
+// system includes
+#include <sys/types.h>
+
+struct shareuf_prefetch_options {
+    size_t   window;        // bytes kept queued or held ahead of the reader
+    size_t   chunk;         // bytes fetched per background read
+    unsigned threads;       // size of the process-wide pool
+    size_t   max_memory;    // bytes held by all streams of the process
+
+    shareuf_prefetch_options() : window( 0 ), chunk( 0 ), threads( 0 ), max_memory( 0 ) {}
+};
+
+struct shareuf_prefetch_io {
+    unsigned long long used;    // bytes served from prefetched chunks
+    unsigned long long wasted;  // bytes fetched, or being fetched, and dropped unread
+    unsigned long long waits;   // reads which waited for a chunk in flight
+
+    shareuf_prefetch_io() : used( 0 ), wasted( 0 ), waits( 0 ) {}
+};
+
+class shareuf_prefetch_stream;
+typedef std::shared_ptr< shareuf_prefetch_stream > shareuf_prefetch_ptr;
+
+// =-=-=-=-=-=-=-
+/// @brief start reading ahead the _size bytes of the file open as _fd from
+///        _offset.  returns a null pointer when the options leave nothing
+///        to read ahead or the descriptor cannot be duplicated.
+shareuf_prefetch_ptr shareuf_prefetch_start(
+    int                             _fd,
+    off_t                           _offset,
+    off_t                           _size,
+    const shareuf_prefetch_options& _opts );
+
+// =-=-=-=-=-=-=-
+/// @brief copy up to _len prefetched bytes at _offset into _buf and move
+///        the window along.  returns the bytes copied, which is short of
+///        _len where the window ends or a background read failed; the
+///        caller reads the rest itself.
+size_t shareuf_prefetch_read(
+    shareuf_prefetch_stream& _stream,
+    void*                    _buf,
+    size_t                   _len,
+    off_t                    _offset,
+    shareuf_prefetch_io&     _io );
+
+// =-=-=-=-=-=-=-
+/// @brief the reader moved to _offset, keep the chunks still ahead of it
+void shareuf_prefetch_seek(
+    shareuf_prefetch_stream& _stream,
+    off_t                    _offset,
+    shareuf_prefetch_io&     _io );
+
+// =-=-=-=-=-=-=-
+/// @brief stop the stream and drop its chunks, reads in flight finish in
+///        the background
+void shareuf_prefetch_cancel(
+    shareuf_prefetch_stream& _stream,
+    shareuf_prefetch_io&     _io );
+
+#endif // SHAREUF_PREFETCH_HPP
@@ -0,0 +1,246 @@
+#include "shareuf_publish.hpp"
+
+// =-=-=-=-=-=-=-
+// stl includes
+#include <atomic>
+#include <set>
+#include <sstream>
+
+// =-=-=-=-=-=-=-
+// system includes
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+    std::string proc_fd_path(
+        int _fd ) {
+        char path[ 64 ];
+        snprintf( path, sizeof( path ), "/proc/self/fd/%d", _fd );
+        return path;
+    }
+
+    const char   TEMP_MARK[]             = ".shareuf-tmp.";
+    const size_t MAX_TEMP_DIRECTORIES    = 256;
+
+    std::mutex              temp_mutex;
+    std::set< std::string > temp_directories;
+
+    // =-=-=-=-=-=-=-
+    // the pid in a temp name, 0 when _name is not one
+    pid_t temp_owner(
+        const char* _name ) {
+        const char* mark = strstr( _name, TEMP_MARK );
+        if ( !mark || '.' != _name[ 0 ] ) {
+            return 0;
+        }
+        char* end = 0;
+        long pid = strtol( mark + sizeof( TEMP_MARK ) - 1, &end, 10 );
+        if ( pid <= 0 || '.' != *end || !end[ 1 ] ) {
+            return 0;
+        }
+        strtoul( end + 1, &end, 10 );
+        return *end ? 0 : static_cast< pid_t >( pid );
+    }
+
+} // namespace
+
+std::string shareuf_temp_path(
+    const std::string& _path ) {
+    static std::atomic< unsigned > counter( 0 );
+    std::string::size_type slash = _path.find_last_of( '/' );
+    std::string dir  = std::string::npos == slash ? std::string( "." ) : _path.substr( 0, slash );
+    std::string name = std::string::npos == slash ? _path : _path.substr( slash + 1 );
+
+    {
+        std::lock_guard< std::mutex > lock( temp_mutex );
+        if ( temp_directories.size() < MAX_TEMP_DIRECTORIES ) {
+            temp_directories.insert( dir );
+        }
+    }
+
+    std::stringstream temp;
+    temp << dir << "/." << name << TEMP_MARK << getpid() << "." << counter++;
+    return temp.str();
+
+} // shareuf_temp_path
+
+void shareuf_temp_directories(
+    std::vector< std::string >& _out ) {
+    std::lock_guard< std::mutex > lock( temp_mutex );
+    _out.insert( _out.end(), temp_directories.begin(), temp_directories.end() );
+
+} // shareuf_temp_directories
+
+int shareuf_reap_temp_files(
+    const std::string&                           _dir,
+    time_t                                       _min_age,
+    const std::chrono::steady_clock::time_point& _deadline,
+    unsigned long long&                          _reaped ) {
+    DIR* dir = opendir( _dir.c_str() );
+    if ( !dir ) {
+        return -errno;
+    }
+
+    int    status = 0;
+    time_t now    = time( 0 );
+    while ( struct dirent* ent = readdir( dir ) ) {
+        if ( std::chrono::steady_clock::now() >= _deadline ) {
+            status = -ETIMEDOUT;
+            break;
+        }
+
+        // =-=-=-=-=-=-=-
+        // a live owner, or a pid reused since, keeps its file
+        pid_t owner = temp_owner( ent->d_name );
+        if ( 0 == owner || getpid() == owner || 0 == kill( owner, 0 ) || ESRCH != errno ) {
+            continue;
+        }
+
+        struct stat sb;
+        if ( fstatat( dirfd( dir ), ent->d_name, &sb, AT_SYMLINK_NOFOLLOW ) < 0 ||
+                !S_ISREG( sb.st_mode ) || now - sb.st_mtime < _min_age ) {
+            continue;
+        }
+        if ( unlinkat( dirfd( dir ), ent->d_name, 0 ) == 0 ) {
+            ++_reaped;
+        }
+    }
+    closedir( dir );
+    return status;
+
+} // shareuf_reap_temp_files
+
+int shareuf_open_unpublished(
+    const std::string& _path,
+    mode_t             _mode,
+    std::string&       _temp ) {
+    _temp.clear();
+
+    struct stat sb;
+    if ( lstat( _path.c_str(), &sb ) == 0 || shareuf_pending_publishes::instance().pending( _path ) ) {
+        errno = EEXIST;
+        return -1;
+    }
+
+#ifdef O_TMPFILE
+    std::string::size_type slash = _path.find_last_of( '/' );
+    std::string dir = std::string::npos == slash ? std::string( "." ) : _path.substr( 0, slash );
+    int fd = open( dir.c_str(), O_TMPFILE | O_RDWR, _mode );
+    if ( fd >= 0 || ( EOPNOTSUPP != errno && EISDIR != errno && EINVAL != errno ) ) {
+        return fd;
+    }
+#endif
+
+    // =-=-=-=-=-=-=-
+    // no O_TMPFILE on this filesystem or kernel
+    _temp = shareuf_temp_path( _path );
+    return open( _temp.c_str(), O_RDWR | O_CREAT | O_EXCL, _mode );
+
+} // shareuf_open_unpublished
+
+int shareuf_publish(
+    int                _fd,
+    const std::string& _temp,
+    const std::string& _path ) {
+    if ( _temp.empty() ) {
+        if ( linkat( AT_FDCWD, proc_fd_path( _fd ).c_str(), AT_FDCWD, _path.c_str(), AT_SYMLINK_FOLLOW ) == 0 ) {
+            return 0;
+        }
+#ifdef AT_EMPTY_PATH
+        // =-=-=-=-=-=-=-
+        // without /proc, which needs CAP_DAC_READ_SEARCH
+        if ( ENOENT == errno && linkat( _fd, "", AT_FDCWD, _path.c_str(), AT_EMPTY_PATH ) == 0 ) {
+            return 0;
+        }
+#endif
+        return -errno;
+    }
+
+    // =-=-=-=-=-=-=-
+    // link rather than rename so a file created at _path meanwhile is
+    // not replaced, falling back to rename where hard links are refused
+    if ( link( _temp.c_str(), _path.c_str() ) == 0 ) {
+        unlink( _temp.c_str() );
+        return 0;
+    }
+    if ( EEXIST == errno ) {
+        return -EEXIST;
+    }
+    return rename( _temp.c_str(), _path.c_str() ) == 0 ? 0 : -errno;
+
+} // shareuf_publish
+
+shareuf_pending_publishes& shareuf_pending_publishes::instance() {
+    static shareuf_pending_publishes table;
+    return table;
+
+} // instance
+
+int shareuf_pending_publishes::add(
+    const std::string& _path,
+    const std::string& _temp,
+    int                _fd ) {
+    int anchor = fcntl( _fd, F_DUPFD_CLOEXEC, 3 );
+    if ( anchor < 0 ) {
+        return -errno;
+    }
+
+    std::lock_guard< std::mutex > lock( mutex_ );
+    entry& e = files_[ _path ];
+    e.temp   = _temp;
+    e.anchor = anchor;
+    e.refs   = 1;
+    return 0;
+
+} // add
+
+bool shareuf_pending_publishes::acquire(
+    const std::string& _path,
+    std::string&       _open_path ) {
+    std::lock_guard< std::mutex > lock( mutex_ );
+    std::map< std::string, entry >::iterator itr = files_.find( _path );
+    if ( itr == files_.end() ) {
+        return false;
+    }
+    ++itr->second.refs;
+    _open_path = itr->second.temp.empty() ? proc_fd_path( itr->second.anchor ) : itr->second.temp;
+    return true;
+
+} // acquire
+
+int shareuf_pending_publishes::release(
+    const std::string& _path,
+    bool&              _published ) {
+    _published = false;
+
+    std::lock_guard< std::mutex > lock( mutex_ );
+    std::map< std::string, entry >::iterator itr = files_.find( _path );
+    if ( itr == files_.end() || --itr->second.refs > 0 ) {
+        return 0;
+    }
+
+    int status = shareuf_publish( itr->second.anchor, itr->second.temp, _path );
+    if ( status < 0 && !itr->second.temp.empty() ) {
+        unlink( itr->second.temp.c_str() );
+    }
+    close( itr->second.anchor );
+    files_.erase( itr );
+    _published = 0 == status;
+    return status;
+
+} // release
+
+bool shareuf_pending_publishes::pending(
+    const std::string& _path ) {
+    std::lock_guard< std::mutex > lock( mutex_ );
+    return files_.find( _path ) != files_.end();
+
+} // pending
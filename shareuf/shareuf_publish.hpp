@@ -0,0 +1,103 @@
+/* Atomic publish of newly created files.
+ *
+ * A new file is written without a name, as an O_TMPFILE in its target
+ * directory, or under a hidden temp name beside it where the filesystem
+ * has no O_TMPFILE, and is linked into place once the last descriptor the
+ * agent holds on it is closed.  Processes reading the vault directly thus
+ * only ever see complete files, and a new name appearing (IN_CREATE or
+ * IN_MOVED_TO) means the content is there.
+ *
+ * Parallel transfers reopen the file by its final path while the creating
+ * descriptor is still open, so the agent keeps a table of the files
+ * pending publication which redirects those opens to the unnamed file.
+ */
+#ifndef SHAREUF_PUBLISH_HPP
+#define SHAREUF_PUBLISH_HPP
+
+// =-=-=-=-=-=-=-
+// stl includes
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// =-=-=-=-=-=-=-
+// system includes
+#include <sys/types.h>
+#include <time.h>
+
+// =-=-=-=-=-=-=-
+/// @brief a unique hidden name beside _path, ".<name>.shareuf-tmp.<pid>.<n>"
+std::string shareuf_temp_path( const std::string& _path );
+
+// =-=-=-=-=-=-=-
+/// @brief the directories this process has made temp names in
+void shareuf_temp_directories( std::vector< std::string >& _out );
+
+// =-=-=-=-=-=-=-
+/// @brief unlink the temp files in _dir left by processes which are gone,
+///        provided they were not modified for _min_age seconds since the
+///        vault may be shared with other hosts.  stops with -ETIMEDOUT at
+///        _deadline.  returns 0 or -errno.
+int shareuf_reap_temp_files(
+    const std::string&                           _dir,
+    time_t                                       _min_age,
+    const std::chrono::steady_clock::time_point& _deadline,
+    unsigned long long&                          _reaped );
+
+// =-=-=-=-=-=-=-
+/// @brief open a new file to be published at _path later, _temp is set to
+///        its hidden temp name or cleared for an O_TMPFILE.  returns the
+///        descriptor, or -1 with errno set, EEXIST if _path exists.
+int shareuf_open_unpublished(
+    const std::string& _path,
+    mode_t             _mode,
+    std::string&       _temp );
+
+// =-=-=-=-=-=-=-
+/// @brief name the unpublished file open as _fd _path, returns 0 or
+///        -errno, -EEXIST if _path was created in the meantime
+int shareuf_publish(
+    int                _fd,
+    const std::string& _temp,
+    const std::string& _path );
+
+// =-=-=-=-=-=-=-
+/// @brief process-wide table of files created but not yet published
+class shareuf_pending_publishes {
+    public:
+        static shareuf_pending_publishes& instance();
+
+        /// @brief track the file open as _fd for _path, holding one
+        ///        reference.  a duplicate of _fd is kept so the file can
+        ///        still be reopened and published once _fd is closed.
+        ///        returns 0 or -errno.
+        int add( const std::string& _path, const std::string& _temp, int _fd );
+
+        /// @brief take a reference on a pending _path and set _open_path to
+        ///        a name which opens the unpublished file, false if _path is
+        ///        not pending
+        bool acquire( const std::string& _path, std::string& _open_path );
+
+        /// @brief drop a reference, publishing the file when it was the
+        ///        last one.  returns 0 or -errno from the publish.
+        int release( const std::string& _path, bool& _published );
+
+        bool pending( const std::string& _path );
+
+    private:
+        shareuf_pending_publishes() {}
+
+        struct entry {
+            std::string temp;
+            int         anchor;
+            unsigned    refs;
+        };
+
+        std::mutex                       mutex_;
+        std::map< std::string, entry >   files_;
+
+}; // class shareuf_pending_publishes
+
+#endif // SHAREUF_PUBLISH_HPP
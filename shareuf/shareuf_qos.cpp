@@ -0,0 +1,239 @@
+#include "shareuf_qos.hpp"
+#include "shareuf_metrics.hpp"
+
+// =-=-=-=-=-=-=-
+// stl includes
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <thread>
+
+// =-=-=-=-=-=-=-
+// system includes
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+namespace {
+    const size_t  USER_BUCKETS   = 64;
+    const size_t  BOOT_ID_SIZE   = 40;
+    const int64_t BURST_NS       = 250 * 1000 * 1000;              // a quarter second of credit
+    const int64_t MAX_BACKLOG_NS = 60 * 1000 * 1000 * 1000LL;      // further ahead is stale
+
+    // =-=-=-=-=-=-=-
+    // theoretical arrival time of the next byte, in CLOCK_MONOTONIC
+    // nanoseconds, which all processes on the host share.  the clock
+    // starts over with each boot, so the file records the boot it
+    // belongs to.
+    struct buckets {
+        char                   boot_id[ BOOT_ID_SIZE ];
+        std::atomic< int64_t > classes[ SHAREUF_QOS_CLASSES ];
+        std::atomic< int64_t > users[ USER_BUCKETS ];
+    };
+
+    static_assert( ATOMIC_LLONG_LOCK_FREE == 2, "shared buckets need lock free 64 bit atomics" );
+
+    int64_t monotonic_ns() {
+        struct timespec ts;
+        clock_gettime( CLOCK_MONOTONIC, &ts );
+        return static_cast< int64_t >( ts.tv_sec ) * 1000000000LL + ts.tv_nsec;
+    }
+
+    // =-=-=-=-=-=-=-
+    // reserve the next _bytes in the bucket, returns how long to wait
+    int64_t reserve(
+        std::atomic< int64_t >& _tat,
+        unsigned long long      _rate,
+        unsigned long long      _bytes ) {
+        int64_t cost = static_cast< int64_t >( _bytes * 1000000000.0 / _rate );
+        int64_t now  = monotonic_ns();
+        int64_t tat  = _tat.load();
+        int64_t next;
+        do {
+            next = ( tat > now && tat - now <= MAX_BACKLOG_NS ? tat : now ) + cost;
+        }
+        while ( !_tat.compare_exchange_weak( tat, next ) );
+        return next - now - BURST_NS;
+    }
+
+    void read_boot_id(
+        char* _out ) {
+        memset( _out, 0, BOOT_ID_SIZE );
+        int fd = open( "/proc/sys/kernel/random/boot_id", O_RDONLY | O_CLOEXEC );
+        if ( fd >= 0 ) {
+            if ( read( fd, _out, BOOT_ID_SIZE - 1 ) < 0 ) {
+                _out[ 0 ] = '\0';
+            }
+            close( fd );
+        }
+    }
+
+    // =-=-=-=-=-=-=-
+    // arrival times kept from before a reboot would stall every caller for
+    // as long as the host was up, those buckets start empty.  under an
+    // flock so the first process after the boot resets them alone.
+    void check_boot(
+        int      _fd,
+        buckets* _b ) {
+        char boot_id[ BOOT_ID_SIZE ];
+        read_boot_id( boot_id );
+        flock( _fd, LOCK_EX );
+        if ( memcmp( _b->boot_id, boot_id, BOOT_ID_SIZE ) != 0 ) {
+            for ( int i = 0; i < SHAREUF_QOS_CLASSES; ++i ) {
+                _b->classes[ i ].store( 0 );
+            }
+            for ( size_t i = 0; i < USER_BUCKETS; ++i ) {
+                _b->users[ i ].store( 0 );
+            }
+            memcpy( _b->boot_id, boot_id, BOOT_ID_SIZE );
+        }
+        flock( _fd, LOCK_UN );
+    }
+
+    uint64_t user_hash(
+        const std::string& _user ) {
+        uint64_t h = 14695981039346656037ULL;
+        for ( size_t i = 0; i < _user.size(); ++i ) {
+            h = ( h ^ static_cast< unsigned char >( _user[ i ] ) ) * 1099511628211ULL;
+        }
+        return h;
+    }
+
+    // =-=-=-=-=-=-=-
+    // one mapping per state file for the life of the process
+    buckets* attach(
+        const std::string& _state_file,
+        mode_t             _dir_mode ) {
+        static std::mutex                          mutex;
+        static std::map< std::string, buckets* >   mapped;
+
+        std::lock_guard< std::mutex > lock( mutex );
+        std::map< std::string, buckets* >::iterator itr = mapped.find( _state_file );
+        if ( itr != mapped.end() ) {
+            return itr->second;
+        }
+
+        void* p = MAP_FAILED;
+        int fd = open( _state_file.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600 );
+        if ( fd < 0 && ENOENT == errno ) {
+            // =-=-=-=-=-=-=-
+            // the mode is applied with chmod, the umask is process wide
+            std::string dir = _state_file.substr( 0, _state_file.find_last_of( '/' ) );
+            if ( 0 == mkdir( dir.c_str(), _dir_mode ) ) {
+                chmod( dir.c_str(), _dir_mode );
+            }
+            fd = open( _state_file.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600 );
+        }
+        if ( fd >= 0 ) {
+            if ( 0 == ftruncate( fd, sizeof( buckets ) ) ) {
+                p = mmap( 0, sizeof( buckets ), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 );
+            }
+            if ( MAP_FAILED != p ) {
+                check_boot( fd, static_cast< buckets* >( p ) );
+            }
+            close( fd );
+        }
+        if ( MAP_FAILED == p ) {
+            p = mmap( 0, sizeof( buckets ), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 );
+        }
+        buckets* b = MAP_FAILED == p ? 0 : static_cast< buckets* >( p );
+        mapped[ _state_file ] = b;
+        return b;
+    }
+
+    int ioprio_get_self() {
+        return syscall( SYS_ioprio_get, 1 /* IOPRIO_WHO_PROCESS */, 0 );
+    }
+
+    int ioprio_set_self(
+        int _value ) {
+        return syscall( SYS_ioprio_set, 1 /* IOPRIO_WHO_PROCESS */, 0, _value );
+    }
+
+} // namespace
+
+void shareuf_qos_throttle(
+    const std::string&  _state_file,
+    mode_t              _dir_mode,
+    shareuf_qos_class   _class,
+    unsigned long long  _class_rate,
+    const std::string&  _user,
+    unsigned long long  _user_rate,
+    unsigned long long  _bytes ) {
+    if ( ( 0 == _class_rate && 0 == _user_rate ) || 0 == _bytes ) {
+        return;
+    }
+
+    buckets* b = attach( _state_file, _dir_mode );
+    if ( !b ) {
+        return;
+    }
+
+    int64_t wait = 0;
+    if ( _class_rate > 0 ) {
+        wait = reserve( b->classes[ _class ], _class_rate, _bytes );
+    }
+    if ( _user_rate > 0 ) {
+        int64_t user_wait = reserve( b->users[ user_hash( _user ) % USER_BUCKETS ], _user_rate, _bytes );
+        wait = user_wait > wait ? user_wait : wait;
+    }
+
+    if ( wait > 0 ) {
+        shareuf_metrics::instance().add( "qos.throttled_usec", wait / 1000 );
+        std::this_thread::sleep_for( std::chrono::nanoseconds( wait ) );
+    }
+
+} // shareuf_qos_throttle
+
+bool shareuf_parse_ioprio_class(
+    const std::string&    _value,
+    shareuf_ioprio_class& _class ) {
+    if ( _value == "none" ) {
+        _class = SHAREUF_IOPRIO_NONE;
+    }
+    else if ( _value == "be" ) {
+        _class = SHAREUF_IOPRIO_BE;
+    }
+    else if ( _value == "idle" ) {
+        _class = SHAREUF_IOPRIO_IDLE;
+    }
+    else {
+        return false;
+    }
+    return true;
+
+} // shareuf_parse_ioprio_class
+
+shareuf_ioprio_guard::shareuf_ioprio_guard(
+    shareuf_ioprio_class _class,
+    int                  _level ) :
+    previous_( -1 ) {
+    if ( SHAREUF_IOPRIO_NONE == _class ) {
+        return;
+    }
+    previous_ = ioprio_get_self();
+    if ( previous_ >= 0 && ioprio_set_self( ( _class << 13 ) | ( SHAREUF_IOPRIO_IDLE == _class ? 0 : _level ) ) < 0 ) {
+        previous_ = -1;
+    }
+
+} // ctor
+
+shareuf_ioprio_guard::~shareuf_ioprio_guard() {
+    if ( previous_ >= 0 ) {
+        ioprio_set_self( previous_ );
+    }
+
+} // dtor
+
+void shareuf_set_background_ioprio() {
+    ioprio_set_self( SHAREUF_IOPRIO_IDLE << 13 );
+
+} // shareuf_set_background_ioprio
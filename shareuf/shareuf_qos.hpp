@@ -0,0 +1,98 @@
+/* Bandwidth shaping of bulk vault traffic so that interactive requests
+ * keep their latency when copies and large uploads run.
+ *
+ * Each operation class, and each client user, has a rate shared by every
+ * server process using the resource: the buckets live in a small file
+ * mapped by all of them and are updated lock free with the generic cell
+ * rate algorithm, which only needs the theoretical arrival time of the
+ * next byte per bucket.  Users are hashed onto a fixed number of buckets.
+ *
+ * Background work additionally drops its I/O priority with ioprio_set,
+ * which the CFQ and BFQ schedulers honour.
+ */
+#ifndef SHAREUF_QOS_HPP
+#define SHAREUF_QOS_HPP
+
+// =-=-=-=-=-=-=-
+// stl includes
+#include <string>
+
+// =-=-=-=-=-=-=-
+// system includes
+#include <sys/types.h>
+
+enum shareuf_qos_class {
+    SHAREUF_QOS_COPY,           // stage_to_cache and sync_to_arch copies
+    SHAREUF_QOS_BULK_WRITE,     // write streams past the bulk threshold
+    SHAREUF_QOS_CLASSES
+};
+
+// =-=-=-=-=-=-=-
+/// @brief block until _bytes of class _class on behalf of _user may go,
+///        within _class_rate and _user_rate bytes per second, either of
+///        which may be 0 for unlimited.  the buckets are shared through
+///        _state_file, whose directory is made with _dir_mode if missing,
+///        or kept per process if it cannot be mapped.  they start over
+///        when the host has rebooted since they were last used.
+void shareuf_qos_throttle(
+    const std::string&  _state_file,
+    mode_t              _dir_mode,
+    shareuf_qos_class   _class,
+    unsigned long long  _class_rate,
+    const std::string&  _user,
+    unsigned long long  _user_rate,
+    unsigned long long  _bytes );
+
+enum shareuf_ioprio_class {
+    SHAREUF_IOPRIO_NONE = 0,
+    SHAREUF_IOPRIO_RT   = 1,
+    SHAREUF_IOPRIO_BE   = 2,
+    SHAREUF_IOPRIO_IDLE = 3
+};
+
+// =-=-=-=-=-=-=-
+// the QoS settings of a resource, parsed once
+struct shareuf_qos_options {
+    unsigned long long   class_rates[ SHAREUF_QOS_CLASSES ];   // 0 for unlimited
+    unsigned long long   user_rate;
+    long long            bulk_write_threshold;
+    shareuf_ioprio_class copy_ioprio;
+
+    shareuf_qos_options() :
+        user_rate( 0 ),
+        bulk_write_threshold( 16 * 1024 * 1024 ),
+        copy_ioprio( SHAREUF_IOPRIO_BE ) {
+        for ( int i = 0; i < SHAREUF_QOS_CLASSES; ++i ) {
+            class_rates[ i ] = 0;
+        }
+    }
+};
+
+// =-=-=-=-=-=-=-
+/// @brief parse an ioprio class name: none, be or idle.  false if unknown
+bool shareuf_parse_ioprio_class(
+    const std::string&    _value,
+    shareuf_ioprio_class& _class );
+
+// =-=-=-=-=-=-=-
+/// @brief sets the calling thread's I/O priority for its lifetime, or
+///        until the guard goes out of scope, when the previous one returns
+class shareuf_ioprio_guard {
+    public:
+        explicit shareuf_ioprio_guard( shareuf_ioprio_class _class, int _level = 7 );
+        ~shareuf_ioprio_guard();
+
+    private:
+        shareuf_ioprio_guard( const shareuf_ioprio_guard& );
+        shareuf_ioprio_guard& operator=( const shareuf_ioprio_guard& );
+
+        int previous_;
+
+}; // class shareuf_ioprio_guard
+
+// =-=-=-=-=-=-=-
+/// @brief drop the calling thread to the idle I/O class for good, used by
+///        background threads
+void shareuf_set_background_ioprio();
+
+#endif // SHAREUF_QOS_HPP
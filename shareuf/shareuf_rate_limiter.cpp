@@ -0,0 +1,43 @@
+#include "shareuf_rate_limiter.hpp"
+
+// =-=-=-=-=-=-=-
+// stl includes
+#include <thread>
+
+shareuf_rate_limiter::shareuf_rate_limiter(
+    unsigned long long _bytes_per_second ) :
+    rate_( _bytes_per_second ),
+    tokens_( static_cast< double >( _bytes_per_second ) ),
+    last_( std::chrono::steady_clock::now() ) {
+
+} // ctor
+
+void shareuf_rate_limiter::acquire(
+    unsigned long long _bytes ) {
+    if ( 0 == rate_ ) {
+        return;
+    }
+
+    std::chrono::steady_clock::duration wait;
+    {
+        std::lock_guard< std::mutex > lock( mutex_ );
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        tokens_ += std::chrono::duration< double >( now - last_ ).count() * rate_;
+        if ( tokens_ > static_cast< double >( rate_ ) ) {
+            tokens_ = static_cast< double >( rate_ );
+        }
+        last_ = now;
+
+        // =-=-=-=-=-=-=-
+        // go into debt and sleep it off, so a request larger than the
+        // bucket still makes progress
+        tokens_ -= static_cast< double >( _bytes );
+        if ( tokens_ >= 0 ) {
+            return;
+        }
+        wait = std::chrono::duration_cast< std::chrono::steady_clock::duration >(
+                   std::chrono::duration< double >( -tokens_ / rate_ ) );
+    }
+    std::this_thread::sleep_for( wait );
+
+} // acquire
@@ -0,0 +1,30 @@
+/* Token bucket used to cap the bandwidth of background vault work.
+ */
+#ifndef SHAREUF_RATE_LIMITER_HPP
+#define SHAREUF_RATE_LIMITER_HPP
+
+// =-=-=-=-=-=-=-
+// stl includes
+#include <chrono>
+#include <mutex>
+
+class shareuf_rate_limiter {
+    public:
+        // =-=-=-=-=-=-=-
+        /// @brief _bytes_per_second of 0 disables limiting, the bucket holds
+        ///        at most one second worth of tokens
+        explicit shareuf_rate_limiter( unsigned long long _bytes_per_second );
+
+        // =-=-=-=-=-=-=-
+        /// @brief block until _bytes may be transferred
+        void acquire( unsigned long long _bytes );
+
+    private:
+        unsigned long long                    rate_;
+        double                                tokens_;
+        std::chrono::steady_clock::time_point last_;
+        std::mutex                            mutex_;
+
+}; // class shareuf_rate_limiter
+
+#endif // SHAREUF_RATE_LIMITER_HPP
@@ -0,0 +1,311 @@
+#include "shareuf_rename.hpp"
+#include "shareuf_publish.hpp"
+
+// =-=-=-=-=-=-=-
+// stl includes
+#include <algorithm>
+#include <atomic>
+
+// =-=-=-=-=-=-=-
+// system includes
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/xattr.h>
+#include <unistd.h>
+
+namespace {
+
+    std::string parent_of(
+        const std::string& _path ) {
+        std::string::size_type slash = _path.find_last_of( '/' );
+        return std::string::npos == slash ? std::string( "." ) : 0 == slash ? std::string( "/" ) : _path.substr( 0, slash );
+    }
+
+    std::string name_of(
+        const std::string& _path ) {
+        std::string::size_type slash = _path.find_last_of( '/' );
+        return std::string::npos == slash ? _path : _path.substr( slash + 1 );
+    }
+
+    // =-=-=-=-=-=-=-
+    // renameat2 without flags, renameat on kernels which predate it
+    int rename_at(
+        int         _from_dir,
+        const char* _from,
+        int         _to_dir,
+        const char* _to ) {
+#ifdef SYS_renameat2
+        static std::atomic< bool > unsupported( false );
+        if ( !unsupported ) {
+            if ( syscall( SYS_renameat2, _from_dir, _from, _to_dir, _to, 0 ) == 0 ) {
+                return 0;
+            }
+            if ( ENOSYS != errno ) {
+                return -errno;
+            }
+            unsupported = true;
+        }
+#endif
+        return renameat( _from_dir, _from, _to_dir, _to ) == 0 ? 0 : -errno;
+    }
+
+    // =-=-=-=-=-=-=-
+    // copy _size bytes from the current offset of _in to that of _out
+    // without passing them through user space
+    int copy_data(
+        int   _in,
+        int   _out,
+        off_t _size ) {
+        static std::atomic< bool > no_copy_file_range( false );
+        off_t copied = 0;
+        while ( copied < _size ) {
+            size_t  chunk = static_cast< size_t >( std::min< off_t >( _size - copied, 1 << 30 ) );
+            ssize_t n     = -1;
+#ifdef SYS_copy_file_range
+            if ( !no_copy_file_range ) {
+                n = syscall( SYS_copy_file_range, _in, static_cast< loff_t* >( 0 ), _out, static_cast< loff_t* >( 0 ), chunk, 0 );
+                if ( n < 0 && ( ENOSYS == errno || EXDEV == errno || EINVAL == errno || EOPNOTSUPP == errno ) ) {
+                    // =-=-=-=-=-=-=-
+                    // kernels before 5.3 only copy within a filesystem
+                    if ( ENOSYS == errno ) {
+                        no_copy_file_range = true;
+                    }
+                    n = sendfile( _out, _in, 0, chunk );
+                }
+            }
+            else
+#endif
+            {
+                n = sendfile( _out, _in, 0, chunk );
+            }
+            if ( n < 0 ) {
+                if ( EINTR == errno ) {
+                    continue;
+                }
+                return -errno;
+            }
+            if ( 0 == n ) {
+                return -EIO;    // source shrank under us
+            }
+            copied += n;
+        }
+        return 0;
+    }
+
+    // =-=-=-=-=-=-=-
+    // best effort, a filesystem may refuse some namespaces
+    void copy_xattrs(
+        int _in,
+        int _out ) {
+        ssize_t len = flistxattr( _in, 0, 0 );
+        if ( len <= 0 ) {
+            return;
+        }
+        std::vector< char > names( len );
+        len = flistxattr( _in, names.data(), names.size() );
+        std::vector< char > value( 4096 );
+        for ( ssize_t pos = 0; pos < len; pos += strlen( &names[ pos ] ) + 1 ) {
+            ssize_t value_len = fgetxattr( _in, &names[ pos ], value.data(), value.size() );
+            if ( value_len >= 0 ) {
+                fsetxattr( _out, &names[ pos ], value.data(), value_len, 0 );
+            }
+        }
+    }
+
+    int move_file(
+        const std::string& _from,
+        const std::string& _to,
+        const struct stat& _sb ) {
+        int in = open( _from.c_str(), O_RDONLY | O_CLOEXEC | O_NOATIME );
+        if ( in < 0 && EPERM == errno ) {
+            in = open( _from.c_str(), O_RDONLY | O_CLOEXEC );
+        }
+        if ( in < 0 ) {
+            return -errno;
+        }
+
+        std::string temp = shareuf_temp_path( _to );
+        int out = open( temp.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0600 );
+        if ( out < 0 ) {
+            int status = -errno;
+            close( in );
+            return status;
+        }
+
+        int status = copy_data( in, out, _sb.st_size );
+        if ( 0 == status ) {
+            copy_xattrs( in, out );
+            struct timespec times[ 2 ] = { _sb.st_atim, _sb.st_mtim };
+            if ( fchmod( out, _sb.st_mode & 07777 ) < 0 || futimens( out, times ) < 0 || fdatasync( out ) < 0 ) {
+                status = -errno;
+            }
+        }
+        if ( close( out ) < 0 && 0 == status ) {
+            status = -errno;
+        }
+        close( in );
+
+        if ( 0 == status && rename( temp.c_str(), _to.c_str() ) < 0 ) {
+            status = -errno;
+        }
+        if ( status < 0 ) {
+            unlink( temp.c_str() );
+            return status;
+        }
+
+        // =-=-=-=-=-=-=-
+        // the copy is in place, a source which cannot be removed leaves
+        // both and reports the failure so the catalog keeps the old path
+        return unlink( _from.c_str() ) == 0 ? 0 : -errno;
+    }
+
+    int move_tree(
+        const std::string& _from,
+        const std::string& _to,
+        const struct stat& _sb ) {
+        if ( mkdir( _to.c_str(), _sb.st_mode & 07777 ) < 0 && EEXIST != errno ) {
+            return -errno;
+        }
+
+        DIR* dir = opendir( _from.c_str() );
+        if ( !dir ) {
+            return -errno;
+        }
+        std::vector< shareuf_rename_entry > files;
+        std::vector< std::string >          subdirs;
+        while ( struct dirent* entry = readdir( dir ) ) {
+            if ( strcmp( entry->d_name, "." ) == 0 || strcmp( entry->d_name, ".." ) == 0 ) {
+                continue;
+            }
+            if ( DT_DIR == entry->d_type ) {
+                subdirs.push_back( entry->d_name );
+            }
+            else {
+                files.push_back( shareuf_rename_entry( _from + "/" + entry->d_name, _to + "/" + entry->d_name ) );
+            }
+        }
+        closedir( dir );
+
+        int status = 0;
+        if ( shareuf_rename_batch( files ) > 0 ) {
+            for ( size_t i = 0; i < files.size() && 0 == status; ++i ) {
+                status = files[ i ].status;
+            }
+        }
+        for ( size_t i = 0; i < subdirs.size(); ++i ) {
+            int sub_status = shareuf_move_across_devices( _from + "/" + subdirs[ i ], _to + "/" + subdirs[ i ] );
+            if ( 0 == status ) {
+                status = sub_status;
+            }
+        }
+        if ( status < 0 ) {
+            return status;
+        }
+
+        struct timespec times[ 2 ] = { _sb.st_atim, _sb.st_mtim };
+        utimensat( AT_FDCWD, _to.c_str(), times, 0 );
+        return rmdir( _from.c_str() ) == 0 ? 0 : -errno;
+    }
+
+    struct by_directories {
+        const std::vector< shareuf_rename_entry >& entries;
+
+        bool operator()(
+            size_t _lhs,
+            size_t _rhs ) const {
+            std::string lhs_from = parent_of( entries[ _lhs ].from );
+            std::string rhs_from = parent_of( entries[ _rhs ].from );
+            if ( lhs_from != rhs_from ) {
+                return lhs_from < rhs_from;
+            }
+            return parent_of( entries[ _lhs ].to ) < parent_of( entries[ _rhs ].to );
+        }
+    };
+
+    int open_directory(
+        const std::string& _path ) {
+#ifdef O_PATH
+        return open( _path.c_str(), O_PATH | O_DIRECTORY | O_CLOEXEC );
+#else
+        return open( _path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC );
+#endif
+    }
+
+} // namespace
+
+int shareuf_rename(
+    const std::string& _from,
+    const std::string& _to ) {
+    return rename_at( AT_FDCWD, _from.c_str(), AT_FDCWD, _to.c_str() );
+
+} // shareuf_rename
+
+int shareuf_move_across_devices(
+    const std::string& _from,
+    const std::string& _to ) {
+    struct stat sb;
+    if ( lstat( _from.c_str(), &sb ) < 0 ) {
+        return -errno;
+    }
+    if ( S_ISREG( sb.st_mode ) ) {
+        return move_file( _from, _to, sb );
+    }
+    if ( S_ISDIR( sb.st_mode ) ) {
+        return move_tree( _from, _to, sb );
+    }
+    return -EXDEV;
+
+} // shareuf_move_across_devices
+
+size_t shareuf_rename_batch(
+    std::vector< shareuf_rename_entry >& _entries ) {
+    std::vector< size_t > order( _entries.size() );
+    for ( size_t i = 0; i < order.size(); ++i ) {
+        order[ i ] = i;
+    }
+    by_directories compare = { _entries };
+    std::sort( order.begin(), order.end(), compare );
+
+    size_t failed = 0;
+    for ( size_t first = 0; first < order.size(); ) {
+        std::string from_dir = parent_of( _entries[ order[ first ] ].from );
+        std::string to_dir   = parent_of( _entries[ order[ first ] ].to );
+        size_t last = first + 1;
+        while ( last < order.size() && parent_of( _entries[ order[ last ] ].from ) == from_dir &&
+                parent_of( _entries[ order[ last ] ].to ) == to_dir ) {
+            ++last;
+        }
+
+        int from_fd = open_directory( from_dir );
+        int to_fd   = from_fd < 0 ? -1 : open_directory( to_dir );
+        int status  = to_fd < 0 ? -errno : 0;
+        for ( size_t i = first; i < last; ++i ) {
+            shareuf_rename_entry& entry = _entries[ order[ i ] ];
+            entry.status = status;
+            if ( 0 == status ) {
+                entry.status = rename_at( from_fd, name_of( entry.from ).c_str(), to_fd, name_of( entry.to ).c_str() );
+                if ( -EXDEV == entry.status ) {
+                    entry.status = shareuf_move_across_devices( entry.from, entry.to );
+                }
+            }
+            if ( entry.status < 0 ) {
+                ++failed;
+            }
+        }
+        if ( from_fd >= 0 ) {
+            close( from_fd );
+        }
+        if ( to_fd >= 0 ) {
+            close( to_fd );
+        }
+        first = last;
+    }
+    return failed;
+
+} // shareuf_rename_batch
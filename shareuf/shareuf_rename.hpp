@@ -0,0 +1,50 @@
+/* Renames within the vault.
+ *
+ * A rename goes straight to renameat2(); the caller makes the parent
+ * directories only when it fails with ENOENT.  Paths on different
+ * filesystems, which happens when several mounts sit under one vault, are
+ * moved by copying through the kernel (copy_file_range, or sendfile where
+ * it cannot cross filesystems) into a temp file beside the destination,
+ * which is flushed and renamed into place before the source is unlinked.
+ * Mode, times and extended attributes, the stored digest among them, are
+ * kept.
+ */
+#ifndef SHAREUF_RENAME_HPP
+#define SHAREUF_RENAME_HPP
+
+// =-=-=-=-=-=-=-
+// stl includes
+#include <string>
+#include <vector>
+
+// =-=-=-=-=-=-=-
+/// @brief rename _from to _to, replacing _to.  returns 0 or -errno, -ENOENT
+///        when a parent of _to is missing and -EXDEV across filesystems.
+int shareuf_rename( const std::string& _from, const std::string& _to );
+
+// =-=-=-=-=-=-=-
+/// @brief move a file or directory tree from _from to _to on another
+///        filesystem and remove _from.  a file replaces _to, a directory is
+///        merged into it.  returns 0 or -errno; a failed move leaves _from
+///        in place, a directory possibly only partly moved.
+int shareuf_move_across_devices( const std::string& _from, const std::string& _to );
+
+struct shareuf_rename_entry {
+    std::string from;
+    std::string to;
+    int         status;     // 0 or -errno once renamed
+
+    shareuf_rename_entry( const std::string& _from, const std::string& _to ) :
+        from( _from ), to( _to ), status( 0 ) {
+    }
+};
+
+// =-=-=-=-=-=-=-
+/// @brief rename many files.  entries sharing source and destination
+///        directories are renamed relative to one pair of directory
+///        descriptors, and those crossing filesystems are moved.  the
+///        destination directories must exist.  returns the number of
+///        entries which failed, each with its status set.
+size_t shareuf_rename_batch( std::vector< shareuf_rename_entry >& _entries );
+
+#endif // SHAREUF_RENAME_HPP
@@ -0,0 +1,250 @@
+#include "shareuf_reservations.hpp"
+
+// =-=-=-=-=-=-=-
+// stl includes
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <vector>
+
+// =-=-=-=-=-=-=-
+// system includes
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/file.h>
+#include <sys/types.h>
+#include <time.h>
+#include <unistd.h>
+
+namespace {
+    const uint32_t LEDGER_SLOTS = 1024;
+
+    struct ledger_slot {
+        int32_t  pid;           // 0 when free
+        uint32_t unused;
+        uint64_t start_time;    // guards against pid reuse
+        uint64_t id;
+        int64_t  bytes;
+    };
+
+    // =-=-=-=-=-=-=-
+    // start time of a process in clock ticks since boot, 0 if unknown
+    uint64_t process_start_time(
+        pid_t _pid ) {
+        std::stringstream path;
+        path << "/proc/" << _pid << "/stat";
+        std::ifstream in( path.str().c_str() );
+        std::string stat;
+        if ( !std::getline( in, stat ) ) {
+            return 0;
+        }
+
+        // =-=-=-=-=-=-=-
+        // the command name may hold spaces, fields resume after its ')'
+        std::string::size_type pos = stat.rfind( ')' );
+        if ( std::string::npos == pos ) {
+            return 0;
+        }
+        std::istringstream fields( stat.substr( pos + 1 ) );
+        std::string field;
+        for ( int i = 3; i <= 22; ++i ) {
+            if ( !( fields >> field ) ) {
+                return 0;
+            }
+        }
+        return strtoull( field.c_str(), 0, 10 );
+    }
+
+    bool holder_alive(
+        const ledger_slot& _slot ) {
+        uint64_t start = process_start_time( _slot.pid );
+        if ( start != 0 ) {
+            return start == _slot.start_time;
+        }
+        return 0 == kill( _slot.pid, 0 ) || EPERM == errno;
+    }
+
+    uint64_t next_id() {
+        static std::atomic< uint64_t > counter( static_cast< uint64_t >( time( 0 ) ) << 20 );
+        uint64_t id;
+        do {
+            id = ++counter;
+        }
+        while ( 0 == id );
+        return id;
+    }
+
+    // =-=-=-=-=-=-=-
+    // the slot table read under an flock held for the object's lifetime
+    class locked_ledger {
+        public:
+            locked_ledger(
+                const std::string& _path,
+                bool               _create,
+                bool               _exclusive ) :
+                fd_( -1 ),
+                status_( 0 ),
+                slots_( LEDGER_SLOTS ) {
+                fd_ = open( _path.c_str(), O_RDWR | O_CLOEXEC | ( _create ? O_CREAT : 0 ), 0600 );
+                if ( fd_ < 0 ) {
+                    status_ = -errno;
+                    return;
+                }
+                if ( flock( fd_, _exclusive ? LOCK_EX : LOCK_SH ) < 0 ) {
+                    status_ = -errno;
+                    return;
+                }
+
+                // =-=-=-=-=-=-=-
+                // a new or short file reads as free slots
+                size_t  len = slots_.size() * sizeof( ledger_slot );
+                ssize_t n   = pread( fd_, &slots_[0], len, 0 );
+                if ( n < 0 ) {
+                    status_ = -errno;
+                    return;
+                }
+                memset( reinterpret_cast< char* >( &slots_[0] ) + n, 0, len - n );
+            }
+
+            ~locked_ledger() {
+                if ( fd_ >= 0 ) {
+                    close( fd_ );
+                }
+            }
+
+            int status() const { return status_; }
+
+            std::vector< ledger_slot >& slots() { return slots_; }
+
+            int write_slot(
+                uint32_t _index ) {
+                ssize_t n = pwrite( fd_, &slots_[ _index ], sizeof( ledger_slot ), _index * sizeof( ledger_slot ) );
+                return n < 0 ? -errno : 0;
+            }
+
+            // =-=-=-=-=-=-=-
+            // free the slots of exited processes and total the rest
+            int64_t reap() {
+                int64_t total = 0;
+                for ( uint32_t i = 0; i < slots_.size(); ++i ) {
+                    if ( 0 == slots_[ i ].pid ) {
+                        continue;
+                    }
+                    if ( holder_alive( slots_[ i ] ) ) {
+                        total += slots_[ i ].bytes;
+                    }
+                    else {
+                        memset( &slots_[ i ], 0, sizeof( ledger_slot ) );
+                        write_slot( i );
+                    }
+                }
+                return total;
+            }
+
+        private:
+            locked_ledger( const locked_ledger& );
+            locked_ledger& operator=( const locked_ledger& );
+
+            int                        fd_;
+            int                        status_;
+            std::vector< ledger_slot > slots_;
+
+    }; // class locked_ledger
+
+} // namespace
+
+int shareuf_reserve_space(
+    const std::string&   _ledger,
+    int64_t              _bytes,
+    int64_t              _available,
+    shareuf_reservation& _out ) {
+    locked_ledger ledger( _ledger, true, true );
+    if ( ledger.status() < 0 ) {
+        return ledger.status();
+    }
+
+    int64_t reserved = ledger.reap();
+    if ( reserved + _bytes > _available ) {
+        return -ENOSPC;
+    }
+
+    std::vector< ledger_slot >& slots = ledger.slots();
+    for ( uint32_t i = 0; i < slots.size(); ++i ) {
+        if ( slots[ i ].pid != 0 ) {
+            continue;
+        }
+        slots[ i ].pid        = getpid();
+        slots[ i ].start_time = process_start_time( getpid() );
+        slots[ i ].id         = next_id();
+        slots[ i ].bytes      = _bytes;
+        int status = ledger.write_slot( i );
+        if ( status < 0 ) {
+            return status;
+        }
+        _out.ledger = _ledger;
+        _out.slot   = i;
+        _out.id     = slots[ i ].id;
+        _out.bytes  = _bytes;
+        return 0;
+    }
+    return -ENOBUFS;
+
+} // shareuf_reserve_space
+
+int shareuf_update_reservation(
+    shareuf_reservation& _res,
+    int64_t              _remaining ) {
+    if ( !_res.active() ) {
+        return 0;
+    }
+
+    locked_ledger ledger( _res.ledger, false, true );
+    if ( ledger.status() < 0 ) {
+        return ledger.status();
+    }
+
+    ledger_slot& slot = ledger.slots()[ _res.slot ];
+    if ( slot.id != _res.id ) {
+        _res.id = 0;
+        return -ENOENT;
+    }
+    if ( _remaining > 0 ) {
+        slot.bytes = _remaining;
+    }
+    else {
+        memset( &slot, 0, sizeof( ledger_slot ) );
+    }
+    _res.bytes = _remaining > 0 ? _remaining : 0;
+    if ( _remaining <= 0 ) {
+        _res.id = 0;
+    }
+    return ledger.write_slot( _res.slot );
+
+} // shareuf_update_reservation
+
+int shareuf_release_reservation(
+    shareuf_reservation& _res ) {
+    return shareuf_update_reservation( _res, 0 );
+
+} // shareuf_release_reservation
+
+int64_t shareuf_reserved_space(
+    const std::string& _ledger ) {
+    locked_ledger ledger( _ledger, false, false );
+    if ( ledger.status() < 0 ) {
+        return 0;
+    }
+
+    int64_t total = 0;
+    std::vector< ledger_slot >& slots = ledger.slots();
+    for ( uint32_t i = 0; i < slots.size(); ++i ) {
+        if ( slots[ i ].pid != 0 && holder_alive( slots[ i ] ) ) {
+            total += slots[ i ].bytes;
+        }
+    }
+    return total;
+
+} // shareuf_reserved_space
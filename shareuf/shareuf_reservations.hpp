@@ -0,0 +1,59 @@
+/* Free space reserved by transfers in flight, shared by every server
+ * process on the host through a small slot table in a lock file under the
+ * vault.  A create reserves the size the client announced, writes shrink
+ * the reservation as the bytes reach the filesystem and close releases
+ * what is left.  Slots held by processes that have exited are reclaimed
+ * by whoever next takes the lock.
+ */
+#ifndef SHAREUF_RESERVATIONS_HPP
+#define SHAREUF_RESERVATIONS_HPP
+
+// =-=-=-=-=-=-=-
+// stl includes
+#include <string>
+
+// =-=-=-=-=-=-=-
+// system includes
+#include <stdint.h>
+
+// =-=-=-=-=-=-=-
+/// @brief a slot held in a ledger, inactive when id is 0
+struct shareuf_reservation {
+    std::string ledger;
+    uint32_t    slot;
+    uint64_t    id;
+    int64_t     bytes;      // space still reserved
+
+    shareuf_reservation() : slot( 0 ), id( 0 ), bytes( 0 ) {}
+
+    bool active() const { return id != 0; }
+
+}; // struct shareuf_reservation
+
+// =-=-=-=-=-=-=-
+/// @brief reserve _bytes in _ledger, created if missing, provided the space
+///        already reserved by others leaves room for them in _available.
+///        returns 0, -ENOSPC when it does not fit, or -errno.
+int shareuf_reserve_space(
+    const std::string&   _ledger,
+    int64_t              _bytes,
+    int64_t              _available,
+    shareuf_reservation& _out );
+
+// =-=-=-=-=-=-=-
+/// @brief shrink a reservation to the _remaining bytes not yet written
+int shareuf_update_reservation(
+    shareuf_reservation& _res,
+    int64_t              _remaining );
+
+// =-=-=-=-=-=-=-
+/// @brief give back whatever is left of a reservation
+int shareuf_release_reservation(
+    shareuf_reservation& _res );
+
+// =-=-=-=-=-=-=-
+/// @brief total space reserved by live processes, 0 when there is no ledger
+int64_t shareuf_reserved_space(
+    const std::string& _ledger );
+
+#endif // SHAREUF_RESERVATIONS_HPP
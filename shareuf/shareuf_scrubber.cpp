@@ -0,0 +1,401 @@
+#include "shareuf_scrubber.hpp"
+#include "shareuf_checksum.hpp"
+#include "shareuf_inline_digest.hpp"
+#include "shareuf_qos.hpp"
+#include "shareuf_rate_limiter.hpp"
+
+// =-=-=-=-=-=-=-
+// stl includes
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+// =-=-=-=-=-=-=-
+// system includes
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+    const size_t HASH_BUFFER_SIZE = 1024 * 1024;
+
+    // =-=-=-=-=-=-=-
+    // temp, partial and progress files belong to transfers in flight, not
+    // to the catalog, and carry no digest yet
+    bool transfer_file(
+        const char* _name ) {
+        return '.' == _name[ 0 ] && strstr( _name, ".shareuf-" ) != NULL;
+    }
+
+    std::string json_escape(
+        const std::string& _in ) {
+        std::string out;
+        out.reserve( _in.size() + 2 );
+        for ( size_t i = 0; i < _in.size(); ++i ) {
+            unsigned char c = _in[ i ];
+            if ( c == '"' || c == '\\' ) {
+                out += '\\';
+                out += c;
+            }
+            else if ( c < 0x20 ) {
+                char esc[ 8 ];
+                snprintf( esc, sizeof( esc ), "\\u%04x", c );
+                out += esc;
+            }
+            else {
+                out += c;
+            }
+        }
+        return out;
+    }
+
+    class scrubber {
+        public:
+            scrubber(
+                const shareuf_scrub_options& _opts,
+                shareuf_scrub_summary&       _summary ) :
+                opts_( _opts ),
+                summary_( _summary ),
+                limiter_( _opts.bytes_per_second ),
+                pending_( 0 ),
+                pushed_( 0 ) {
+            }
+
+            int run();
+
+        private:
+            struct work_queue {
+                std::mutex                mutex;
+                std::deque< std::string > dirs;
+            };
+
+            void worker( size_t _self );
+            bool next_dir( size_t _self, std::string& _dir );
+            void push_dir( size_t _self, const std::string& _dir );
+            void scan_dir( size_t _self, const std::string& _dir, std::vector< unsigned char >& _buf );
+            void verify_file( const std::string& _path, std::vector< unsigned char >& _buf );
+            void report( const std::string& _path, const char* _status, const std::string& _detail );
+            void finish_dir( const std::string& _dir );
+
+            const shareuf_scrub_options&                opts_;
+            shareuf_scrub_summary&                      summary_;
+            shareuf_rate_limiter                        limiter_;
+            std::vector< std::unique_ptr< work_queue > > queues_;
+            std::atomic< long >                         pending_;
+            std::mutex                                  idle_mutex_;
+            std::condition_variable                     idle_cv_;      // a directory was queued or the walk ended
+            unsigned long long                          pushed_;
+            std::set< std::string >                     finished_;
+            std::mutex                                  output_mutex_;
+            std::ofstream                               report_;
+            std::ofstream                               checkpoint_;
+    };
+
+    int scrubber::run() {
+        // =-=-=-=-=-=-=-
+        // a surviving checkpoint means the last scan was interrupted, so
+        // pick it up and keep appending to its report
+        {
+            std::ifstream in( opts_.checkpoint_path.c_str() );
+            std::string line;
+            while ( std::getline( in, line ) ) {
+                if ( !line.empty() ) {
+                    finished_.insert( line );
+                }
+            }
+        }
+
+        std::ios_base::openmode mode = finished_.empty() ? std::ios_base::trunc : std::ios_base::app;
+        report_.open( opts_.report_path.c_str(), std::ios_base::out | mode );
+        checkpoint_.open( opts_.checkpoint_path.c_str(), std::ios_base::out | mode );
+        if ( !report_ || !checkpoint_ ) {
+            return -EIO;
+        }
+
+        size_t threads = opts_.threads > 0 ? opts_.threads : 1;
+        for ( size_t i = 0; i < threads; ++i ) {
+            queues_.push_back( std::unique_ptr< work_queue >( new work_queue ) );
+        }
+        push_dir( 0, opts_.root );
+
+        std::vector< std::thread > pool;
+        for ( size_t i = 0; i < threads; ++i ) {
+            pool.push_back( std::thread( &scrubber::worker, this, i ) );
+        }
+        for ( size_t i = 0; i < pool.size(); ++i ) {
+            pool[ i ].join();
+        }
+
+        report_ << "{\"summary\":{"
+                << "\"files\":" << summary_.files
+                << ",\"bytes\":" << summary_.bytes
+                << ",\"verified\":" << summary_.verified
+                << ",\"mismatches\":" << summary_.mismatches
+                << ",\"stale_digests\":" << summary_.stale_digests
+                << ",\"missing_digests\":" << summary_.missing_digests
+                << ",\"orphans\":" << summary_.orphans
+                << ",\"errors\":" << summary_.errors
+                << ",\"resumed_dirs\":" << summary_.resumed_dirs
+                << "}}\n";
+        report_.close();
+
+        // =-=-=-=-=-=-=-
+        // the walk completed, the next scan starts over
+        checkpoint_.close();
+        unlink( opts_.checkpoint_path.c_str() );
+
+        return report_ ? 0 : -EIO;
+    }
+
+    void scrubber::push_dir(
+        size_t             _self,
+        const std::string& _dir ) {
+        ++pending_;
+        {
+            std::lock_guard< std::mutex > lock( queues_[ _self ]->mutex );
+            queues_[ _self ]->dirs.push_back( _dir );
+        }
+        std::lock_guard< std::mutex > lock( idle_mutex_ );
+        ++pushed_;
+        idle_cv_.notify_one();
+    }
+
+    bool scrubber::next_dir(
+        size_t       _self,
+        std::string& _dir ) {
+        while ( pending_ > 0 ) {
+            unsigned long long seen;
+            {
+                std::lock_guard< std::mutex > lock( idle_mutex_ );
+                seen = pushed_;
+            }
+
+            // =-=-=-=-=-=-=-
+            // own queue from the back, depth first, others from the front
+            {
+                std::lock_guard< std::mutex > lock( queues_[ _self ]->mutex );
+                if ( !queues_[ _self ]->dirs.empty() ) {
+                    _dir = queues_[ _self ]->dirs.back();
+                    queues_[ _self ]->dirs.pop_back();
+                    return true;
+                }
+            }
+            for ( size_t i = 1; i < queues_.size(); ++i ) {
+                work_queue& victim = *queues_[ ( _self + i ) % queues_.size() ];
+                std::lock_guard< std::mutex > lock( victim.mutex );
+                if ( !victim.dirs.empty() ) {
+                    _dir = victim.dirs.front();
+                    victim.dirs.pop_front();
+                    return true;
+                }
+            }
+
+            // =-=-=-=-=-=-=-
+            // nothing to steal, wait for a directory to be queued by the
+            // workers still scanning or for the last of them to finish
+            std::unique_lock< std::mutex > lock( idle_mutex_ );
+            idle_cv_.wait( lock, [this, seen] { return pushed_ != seen || 0 == pending_; } );
+        }
+        return false;
+    }
+
+    void scrubber::worker(
+        size_t _self ) {
+        shareuf_set_background_ioprio();
+        std::vector< unsigned char > buf( HASH_BUFFER_SIZE );
+        std::string dir;
+        while ( next_dir( _self, dir ) ) {
+            scan_dir( _self, dir, buf );
+            if ( 0 == --pending_ ) {
+                std::lock_guard< std::mutex > lock( idle_mutex_ );
+                idle_cv_.notify_all();
+            }
+        }
+    }
+
+    void scrubber::scan_dir(
+        size_t                        _self,
+        const std::string&            _dir,
+        std::vector< unsigned char >& _buf ) {
+        bool resumed = finished_.count( _dir ) > 0;
+
+        DIR* d = opendir( _dir.c_str() );
+        if ( NULL == d ) {
+            report( _dir, "error", strerror( errno ) );
+            return;
+        }
+
+        struct dirent* ent;
+        while ( ( ent = readdir( d ) ) != NULL ) {
+            if ( strcmp( ent->d_name, "." ) == 0 || strcmp( ent->d_name, ".." ) == 0 ) {
+                continue;
+            }
+            std::string path = _dir + "/" + ent->d_name;
+
+            unsigned char type = ent->d_type;
+            if ( DT_UNKNOWN == type ) {
+                struct stat sb;
+                if ( lstat( path.c_str(), &sb ) < 0 ) {
+                    continue;
+                }
+                type = S_ISDIR( sb.st_mode ) ? DT_DIR : S_ISREG( sb.st_mode ) ? DT_REG : DT_UNKNOWN;
+            }
+
+            if ( DT_DIR == type ) {
+                if ( path != opts_.skip_dir ) {
+                    push_dir( _self, path );
+                }
+            }
+            else if ( DT_REG == type && !resumed && !transfer_file( ent->d_name ) ) {
+                verify_file( path, _buf );
+            }
+        }
+        closedir( d );
+
+        if ( resumed ) {
+            std::lock_guard< std::mutex > lock( output_mutex_ );
+            ++summary_.resumed_dirs;
+        }
+        else {
+            finish_dir( _dir );
+        }
+    }
+
+    void scrubber::verify_file(
+        const std::string&            _path,
+        std::vector< unsigned char >& _buf ) {
+        if ( opts_.registered && opts_.registered->count( _path ) == 0 ) {
+            report( _path, "orphan", "not registered in the catalog" );
+        }
+
+        int fd = open( _path.c_str(), O_RDONLY | O_NOATIME );
+        if ( fd < 0 && EPERM == errno ) {
+            fd = open( _path.c_str(), O_RDONLY );
+        }
+        if ( fd < 0 ) {
+            report( _path, "error", strerror( errno ) );
+            std::lock_guard< std::mutex > lock( output_mutex_ );
+            ++summary_.files;
+            return;
+        }
+
+        struct stat sb;
+        shareuf_stored_digest stored;
+        if ( fstat( fd, &sb ) < 0 ) {
+            report( _path, "error", strerror( errno ) );
+            close( fd );
+            std::lock_guard< std::mutex > lock( output_mutex_ );
+            ++summary_.files;
+            return;
+        }
+        else if ( !shareuf_read_digest( fd, stored ) ) {
+            report( _path, "missing_digest", "" );
+        }
+        else if ( stored.size != sb.st_size ) {
+            std::stringstream detail;
+            detail << "recorded size " << stored.size << ", found " << sb.st_size;
+            report( _path, "size_mismatch", detail.str() );
+        }
+        else if ( stored.mtime.tv_sec != sb.st_mtim.tv_sec || stored.mtime.tv_nsec != sb.st_mtim.tv_nsec ) {
+            report( _path, "stale_digest", "modified since the digest was recorded" );
+        }
+        else {
+            // =-=-=-=-=-=-=-
+            // re-hash the file under the bandwidth cap
+            shareuf_sha256 sha;
+            ssize_t n = 0;
+            off_t   hashed = 0;
+            while ( ( n = read( fd, _buf.data(), _buf.size() ) ) > 0 ) {
+                limiter_.acquire( n );
+                sha.update( _buf.data(), n );
+                hashed += n;
+            }
+
+            if ( n < 0 ) {
+                report( _path, "error", strerror( errno ) );
+            }
+            else {
+                unsigned char digest[ SHAREUF_SHA256_DIGEST_SIZE ];
+                sha.final( digest );
+                std::string actual = shareuf_sha256_to_irods( digest );
+                if ( actual != stored.sha256 || hashed != stored.size ) {
+                    report( _path, "mismatch", "recorded " + stored.sha256 + ", computed " + actual );
+                }
+                else {
+                    std::lock_guard< std::mutex > lock( output_mutex_ );
+                    ++summary_.verified;
+                }
+            }
+        }
+        close( fd );
+
+        std::lock_guard< std::mutex > lock( output_mutex_ );
+        ++summary_.files;
+        summary_.bytes += sb.st_size;
+    }
+
+    void scrubber::report(
+        const std::string& _path,
+        const char*        _status,
+        const std::string& _detail ) {
+        std::lock_guard< std::mutex > lock( output_mutex_ );
+        if ( strcmp( _status, "mismatch" ) == 0 || strcmp( _status, "size_mismatch" ) == 0 ) {
+            ++summary_.mismatches;
+        }
+        else if ( strcmp( _status, "stale_digest" ) == 0 ) {
+            ++summary_.stale_digests;
+        }
+        else if ( strcmp( _status, "missing_digest" ) == 0 ) {
+            ++summary_.missing_digests;
+        }
+        else if ( strcmp( _status, "orphan" ) == 0 ) {
+            ++summary_.orphans;
+        }
+        else if ( strcmp( _status, "error" ) == 0 ) {
+            ++summary_.errors;
+        }
+        report_ << "{\"path\":\"" << json_escape( _path )
+                << "\",\"status\":\"" << _status
+                << "\",\"detail\":\"" << json_escape( _detail ) << "\"}\n";
+    }
+
+    void scrubber::finish_dir(
+        const std::string& _dir ) {
+        std::lock_guard< std::mutex > lock( output_mutex_ );
+        // =-=-=-=-=-=-=-
+        // the report must hold everything found in _dir before the
+        // checkpoint says it is done
+        report_.flush();
+        checkpoint_ << _dir << "\n";
+        checkpoint_.flush();
+    }
+
+} // namespace
+
+int shareuf_scrub_vault(
+    const shareuf_scrub_options& _opts,
+    shareuf_scrub_summary&       _summary ) {
+    struct stat sb;
+    if ( stat( _opts.root.c_str(), &sb ) < 0 ) {
+        return -errno;
+    }
+    if ( !S_ISDIR( sb.st_mode ) ) {
+        return -ENOTDIR;
+    }
+
+    scrubber s( _opts, _summary );
+    return s.run();
+
+} // shareuf_scrub_vault
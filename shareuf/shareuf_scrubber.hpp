@@ -0,0 +1,62 @@
+/* Vault scrubber: walks a vault with a pool of work-stealing threads,
+ * re-hashes every regular file at a bounded bandwidth and compares it to
+ * the digest and size stored with it by the inline checksum stage.
+ *
+ * Findings are appended to a JSON lines report, one object per line:
+ *
+ *   {"path":"...","status":"mismatch","detail":"..."}
+ *
+ * with status one of mismatch, size_mismatch, stale_digest,
+ * missing_digest, orphan or error, and a final {"summary":{...}} line.
+ * Each finished directory is appended to a checkpoint file, which lets
+ * an interrupted scan resume without re-hashing finished directories.
+ */
+#ifndef SHAREUF_SCRUBBER_HPP
+#define SHAREUF_SCRUBBER_HPP
+
+// =-=-=-=-=-=-=-
+// stl includes
+#include <set>
+#include <string>
+
+struct shareuf_scrub_options {
+    std::string                    root;               // vault directory to walk
+    std::string                    report_path;        // JSON lines report
+    std::string                    checkpoint_path;    // finished directories, one per line
+    std::string                    skip_dir;           // directory under root to leave alone
+    unsigned                       threads;
+    unsigned long long             bytes_per_second;   // 0 for unlimited
+    const std::set< std::string >* registered;         // catalog paths, null to skip orphan checks
+
+    shareuf_scrub_options() :
+        threads( 4 ),
+        bytes_per_second( 0 ),
+        registered( 0 ) {
+    }
+};
+
+struct shareuf_scrub_summary {
+    unsigned long long files;
+    unsigned long long bytes;
+    unsigned long long verified;
+    unsigned long long mismatches;
+    unsigned long long stale_digests;
+    unsigned long long missing_digests;
+    unsigned long long orphans;
+    unsigned long long errors;
+    unsigned long long resumed_dirs;
+
+    shareuf_scrub_summary() :
+        files( 0 ), bytes( 0 ), verified( 0 ), mismatches( 0 ), stale_digests( 0 ),
+        missing_digests( 0 ), orphans( 0 ), errors( 0 ), resumed_dirs( 0 ) {
+    }
+};
+
+// =-=-=-=-=-=-=-
+/// @brief scan _opts.root, returns 0 or -errno if the scan could not run.
+///        per-file problems are reported, not returned.
+int shareuf_scrub_vault(
+    const shareuf_scrub_options& _opts,
+    shareuf_scrub_summary&       _summary );
+
+#endif // SHAREUF_SCRUBBER_HPP
@@ -0,0 +1,163 @@
+#include "shareuf_streaming_io.hpp"
+#include "shareuf_metrics.hpp"
+
+// =-=-=-=-=-=-=-
+// system includes
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+bool shareuf_parse_streaming_mode(
+    const std::string&       _value,
+    shareuf_streaming_mode&  _mode ) {
+    if ( _value == "buffered" ) {
+        _mode = SHAREUF_STREAMING_BUFFERED;
+    }
+    else if ( _value == "direct" ) {
+        _mode = SHAREUF_STREAMING_DIRECT;
+    }
+    else if ( _value == "dontneed" ) {
+        _mode = SHAREUF_STREAMING_DONTNEED;
+    }
+    else {
+        return false;
+    }
+    return true;
+
+} // shareuf_parse_streaming_mode
+
+int shareuf_set_direct(
+    int  _fd,
+    bool _on ) {
+    int flags = fcntl( _fd, F_GETFL );
+    if ( flags < 0 ) {
+        return -errno;
+    }
+    int wanted = _on ? ( flags | O_DIRECT ) : ( flags & ~O_DIRECT );
+    if ( wanted != flags && fcntl( _fd, F_SETFL, wanted ) < 0 ) {
+        return -errno;
+    }
+    return 0;
+
+} // shareuf_set_direct
+
+static ssize_t write_all(
+    int         _fd,
+    const char* _buf,
+    size_t      _len ) {
+    size_t done = 0;
+    while ( done < _len ) {
+        ssize_t n = write( _fd, _buf + done, _len - done );
+        if ( n < 0 ) {
+            if ( EINTR == errno ) {
+                continue;
+            }
+            return done > 0 ? static_cast< ssize_t >( done ) : -1;
+        }
+        if ( 0 == n ) {
+            break;
+        }
+        done += n;
+    }
+    return done;
+
+} // write_all
+
+ssize_t shareuf_read_direct(
+    int    _fd,
+    char*  _buf,
+    size_t _len,
+    bool&  _direct ) {
+    ssize_t n = read( _fd, _buf, _len );
+    if ( n < 0 && EINVAL == errno && _direct ) {
+        shareuf_metrics::instance().add( "streaming_io.direct_fallbacks", 1 );
+        int status = shareuf_set_direct( _fd, false );
+        if ( status < 0 ) {
+            errno = -status;
+            return -1;
+        }
+        _direct = false;
+        n = read( _fd, _buf, _len );
+    }
+    return n;
+
+} // shareuf_read_direct
+
+ssize_t shareuf_write_direct(
+    int         _fd,
+    const char* _buf,
+    size_t      _len,
+    bool&       _direct ) {
+    size_t done = 0;
+    if ( _direct ) {
+        size_t aligned = _len - _len % SHAREUF_DIRECT_IO_ALIGNMENT;
+        if ( aligned > 0 ) {
+            ssize_t n = write_all( _fd, _buf, aligned );
+            if ( n < 0 && EINVAL == errno ) {
+                // =-=-=-=-=-=-=-
+                // the filesystem accepted the flag but not the I/O
+                shareuf_metrics::instance().add( "streaming_io.direct_fallbacks", 1 );
+            }
+            else if ( n < 0 ) {
+                return n;
+            }
+            else {
+                shareuf_metrics::instance().add( "streaming_io.direct_bytes", n );
+                done = n;
+            }
+        }
+
+        // =-=-=-=-=-=-=-
+        // a tail or short write leaves the offset unaligned, so the rest
+        // of the stream goes through the page cache
+        if ( done < _len ) {
+            int status = shareuf_set_direct( _fd, false );
+            if ( status < 0 ) {
+                if ( done > 0 ) {
+                    return done;
+                }
+                errno = -status;
+                return -1;
+            }
+            _direct = false;
+        }
+    }
+
+    if ( done < _len ) {
+        ssize_t n = write_all( _fd, _buf + done, _len - done );
+        if ( n < 0 ) {
+            return done > 0 ? static_cast< ssize_t >( done ) : n;
+        }
+        done += n;
+    }
+    return done;
+
+} // shareuf_write_direct
+
+void shareuf_write_behind(
+    int    _fd,
+    off_t& _dropped,
+    off_t  _offset,
+    off_t  _len ) {
+    sync_file_range( _fd, _offset, _len, SYNC_FILE_RANGE_WRITE );
+    if ( _dropped < _offset ) {
+        // =-=-=-=-=-=-=-
+        // earlier chunks had a whole chunk's time to reach the disk, so
+        // waiting on them rarely blocks, and clean pages can be dropped
+        sync_file_range( _fd, _dropped, _offset - _dropped,
+                         SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE | SYNC_FILE_RANGE_WAIT_AFTER );
+        posix_fadvise( _fd, _dropped, _offset - _dropped, POSIX_FADV_DONTNEED );
+        shareuf_metrics::instance().add( "streaming_io.dropped_bytes", _offset - _dropped );
+        _dropped = _offset;
+    }
+
+} // shareuf_write_behind
+
+void shareuf_drop_written(
+    int   _fd,
+    off_t _dropped ) {
+    sync_file_range( _fd, _dropped, 0,
+                     SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE | SYNC_FILE_RANGE_WAIT_AFTER );
+    posix_fadvise( _fd, _dropped, 0, POSIX_FADV_DONTNEED );
+
+} // shareuf_drop_written
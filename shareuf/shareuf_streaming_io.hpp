@@ -0,0 +1,82 @@
+/* Cache-friendly handling of large sequential transfers.
+ *
+ *   buffered  - plain read()/write() through the page cache, the default
+ *   direct    - O_DIRECT from page aligned buffers, with any unaligned
+ *               tail written through the page cache; filesystems that
+ *               refuse O_DIRECT silently get buffered I/O
+ *   dontneed  - buffered writes with write-behind: each chunk's writeback
+ *               is started as it is written and the pages of the previous
+ *               chunk are dropped with POSIX_FADV_DONTNEED once on disk
+ */
+#ifndef SHAREUF_STREAMING_IO_HPP
+#define SHAREUF_STREAMING_IO_HPP
+
+// =-=-=-=-=-=-=-
+// stl includes
+#include <string>
+
+// =-=-=-=-=-=-=-
+// system includes
+#include <sys/types.h>
+
+enum shareuf_streaming_mode {
+    SHAREUF_STREAMING_BUFFERED,
+    SHAREUF_STREAMING_DIRECT,
+    SHAREUF_STREAMING_DONTNEED
+};
+
+// =-=-=-=-=-=-=-
+// buffer address, file offset and length granularity used for O_DIRECT,
+// a multiple of the logical block size of any device we expect to meet
+const size_t SHAREUF_DIRECT_IO_ALIGNMENT = 4096;
+
+// =-=-=-=-=-=-=-
+/// @brief parse the streaming_io_mode context string value, false if unknown
+bool shareuf_parse_streaming_mode(
+    const std::string&       _value,
+    shareuf_streaming_mode&  _mode );
+
+// =-=-=-=-=-=-=-
+/// @brief set or clear O_DIRECT on an open descriptor, returns 0 or -errno
+int shareuf_set_direct(
+    int  _fd,
+    bool _on );
+
+// =-=-=-=-=-=-=-
+/// @brief read() that, while _direct is set, retries through the page cache
+///        when the filesystem rejects the O_DIRECT read, clearing _direct
+ssize_t shareuf_read_direct(
+    int    _fd,
+    char*  _buf,
+    size_t _len,
+    bool&  _direct );
+
+// =-=-=-=-=-=-=-
+/// @brief write all of _buf at the current offset of _fd, which must be
+///        aligned along with _buf. While _direct is set the aligned prefix
+///        goes out with O_DIRECT; an unaligned tail, or a filesystem that
+///        rejects O_DIRECT, turns it off on _fd and clears _direct.
+///        Returns the number of bytes written, or -1 with errno set.
+ssize_t shareuf_write_direct(
+    int         _fd,
+    const char* _buf,
+    size_t      _len,
+    bool&       _direct );
+
+// =-=-=-=-=-=-=-
+/// @brief start writeback of [_offset, _offset + _len) and drop the cached
+///        pages of everything from _dropped up to _offset, advancing it
+void shareuf_write_behind(
+    int    _fd,
+    off_t& _dropped,
+    off_t  _offset,
+    off_t  _len );
+
+// =-=-=-=-=-=-=-
+/// @brief wait for writeback of everything from _dropped to the end of the
+///        file and drop its cached pages
+void shareuf_drop_written(
+    int   _fd,
+    off_t _dropped );
+
+#endif // SHAREUF_STREAMING_IO_HPP
@@ -0,0 +1,439 @@
+#include "shareuf_tier_migrator.hpp"
+#include "shareuf_buffer_pool.hpp"
+#include "shareuf_inline_digest.hpp"
+#include "shareuf_metrics.hpp"
+#include "shareuf_publish.hpp"
+#include "shareuf_rate_limiter.hpp"
+
+// =-=-=-=-=-=-=-
+// stl includes
+#include <algorithm>
+#include <vector>
+
+// =-=-=-=-=-=-=-
+// system includes
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <sys/xattr.h>
+#include <unistd.h>
+
+namespace {
+    const size_t COPY_BUFFER_SIZE = 4 * 1024 * 1024;
+    const size_t MAX_STATE_SIZE   = 64 * 1024;
+
+    // =-=-=-=-=-=-=-
+    // kept in the state file as three nul terminated fields, the time of
+    // the last complete pass, the path an unfinished pass stopped at and
+    // the temp name of the copy in flight
+    struct pass_state {
+        time_t      last;
+        std::string cursor;
+        std::string temp;
+
+        pass_state() : last( 0 ) {
+        }
+    };
+
+    void read_state(
+        int         _fd,
+        pass_state& _state ) {
+        std::vector< char > buf( MAX_STATE_SIZE );
+        ssize_t n = pread( _fd, &buf[ 0 ], buf.size(), 0 );
+        std::vector< std::string > fields;
+        for ( ssize_t i = 0, begin = 0; i < n; ++i ) {
+            if ( '\0' == buf[ i ] ) {
+                fields.push_back( std::string( &buf[ begin ], i - begin ) );
+                begin = i + 1;
+            }
+        }
+        if ( fields.size() == 3 ) {
+            _state.last   = strtoll( fields[ 0 ].c_str(), 0, 10 );
+            _state.cursor = fields[ 1 ];
+            _state.temp   = fields[ 2 ];
+        }
+    }
+
+    void write_state(
+        int               _fd,
+        const pass_state& _state ) {
+        std::string data = std::to_string( static_cast< long long >( _state.last ) );
+        data += '\0';
+        data += _state.cursor;
+        data += '\0';
+        data += _state.temp;
+        data += '\0';
+        if ( ftruncate( _fd, 0 ) < 0 || pwrite( _fd, data.data(), data.size(), 0 ) < 0 ) {
+            shareuf_metrics::instance().add( "tier.state_write_errors", 1 );
+        }
+    }
+
+    bool same_data(
+        const struct stat& _a,
+        const struct stat& _b ) {
+        return _a.st_dev == _b.st_dev && _a.st_ino == _b.st_ino && _a.st_size == _b.st_size &&
+               _a.st_mtim.tv_sec == _b.st_mtim.tv_sec && _a.st_mtim.tv_nsec == _b.st_mtim.tv_nsec;
+    }
+
+    bool same_file_state(
+        const struct stat& _a,
+        const struct stat& _b ) {
+        return same_data( _a, _b ) &&
+               _a.st_ctim.tv_sec == _b.st_ctim.tv_sec && _a.st_ctim.tv_nsec == _b.st_ctim.tv_nsec;
+    }
+
+    // =-=-=-=-=-=-=-
+    // 1 with a write lease on _fd, 0 where the filesystem or the ownership
+    // of the file allow none, -1 when the file is open elsewhere.  a break
+    // is noticed with F_GETLEASE, the signal is set to one ignored by
+    // default since the SIGIO otherwise sent would end the agent
+    int take_lease(
+        int _fd ) {
+        if ( fcntl( _fd, F_SETSIG, SIGURG ) == 0 && fcntl( _fd, F_SETLEASE, F_WRLCK ) == 0 ) {
+            return 1;
+        }
+        return EAGAIN == errno || EBUSY == errno ? -1 : 0;
+    }
+
+    bool lease_held(
+        int _fd,
+        int _leased ) {
+        return _leased <= 0 || fcntl( _fd, F_GETLEASE ) == F_WRLCK;
+    }
+
+    // =-=-=-=-=-=-=-
+    // the mode is applied with chmod, the umask is process wide and other
+    // threads may be relying on it
+    int make_parents(
+        const std::string& _path,
+        mode_t             _mode ) {
+        std::string::size_type pos = 0;
+        while ( ( pos = _path.find( '/', pos + 1 ) ) != std::string::npos ) {
+            std::string dir = _path.substr( 0, pos );
+            if ( 0 == mkdir( dir.c_str(), _mode ) ) {
+                chmod( dir.c_str(), _mode );
+            }
+            else if ( errno != EEXIST ) {
+                return -errno;
+            }
+        }
+        return 0;
+    }
+
+    class migrator {
+        public:
+            migrator(
+                const shareuf_migrator_options& _opts,
+                shareuf_migrator_summary&       _summary,
+                int                             _state_fd,
+                pass_state&                     _state ) :
+                opts_( _opts ),
+                summary_( _summary ),
+                limiter_( _opts.bytes_per_second ),
+                now_( time( 0 ) ),
+                state_fd_( _state_fd ),
+                state_( _state ),
+                resuming_( !_state.cursor.empty() ) {
+                std::string::size_type begin = 0, end;
+                while ( ( end = _state.cursor.find( '/', begin ) ) != std::string::npos ) {
+                    cursor_.push_back( _state.cursor.substr( begin, end - begin ) );
+                    begin = end + 1;
+                }
+                if ( resuming_ ) {
+                    cursor_.push_back( _state.cursor.substr( begin ) );
+                }
+            }
+
+            // =-=-=-=-=-=-=-
+            // false when the walk stopped at the deadline
+            bool walk( const std::string& _dir, const std::string& _relative, size_t _depth );
+
+            const std::string& last() const {
+                return last_;
+            }
+
+        private:
+            void demote( const std::string& _path, const std::string& _relative, const struct stat& _sb );
+            int  copy( int _in, int _out, const struct stat& _sb, shareuf_buffer_pool::buffer& _buf );
+            void record_temp( const std::string& _temp );
+
+            const shareuf_migrator_options& opts_;
+            shareuf_migrator_summary&       summary_;
+            shareuf_rate_limiter            limiter_;
+            time_t                          now_;
+            int                             state_fd_;
+            pass_state&                     state_;
+            std::vector< std::string >      cursor_;
+            bool                            resuming_;
+            std::string                     last_;
+    };
+
+    bool migrator::walk(
+        const std::string& _dir,
+        const std::string& _relative,
+        size_t             _depth ) {
+        DIR* dir = opendir( _dir.c_str() );
+        if ( !dir ) {
+            ++summary_.errors;
+            return true;
+        }
+
+        // =-=-=-=-=-=-=-
+        // in name order, so a pass can carry on from where it stopped
+        std::vector< std::string > names;
+        while ( struct dirent* ent = readdir( dir ) ) {
+            std::string name( ent->d_name );
+            if ( "." != name && ".." != name ) {
+                names.push_back( name );
+            }
+        }
+        closedir( dir );
+        std::sort( names.begin(), names.end() );
+
+        for ( size_t i = 0; i < names.size(); ++i ) {
+            const std::string& name = names[ i ];
+            if ( resuming_ ) {
+                if ( _depth < cursor_.size() && name < cursor_[ _depth ] ) {
+                    continue;
+                }
+                if ( _depth >= cursor_.size() || name > cursor_[ _depth ] ) {
+                    resuming_ = false;
+                }
+            }
+            if ( std::chrono::steady_clock::now() >= opts_.deadline ) {
+                return false;
+            }
+
+            std::string path     = _dir + "/" + name;
+            std::string relative = _relative.empty() ? name : _relative + "/" + name;
+            struct stat sb;
+            if ( lstat( path.c_str(), &sb ) < 0 ) {
+                continue;
+            }
+            if ( S_ISDIR( sb.st_mode ) ) {
+                if ( path != opts_.skip_dir ) {
+                    last_ = relative;
+                    if ( !walk( path, relative, _depth + 1 ) ) {
+                        return false;
+                    }
+                }
+            }
+            else if ( S_ISREG( sb.st_mode ) ) {
+                // =-=-=-=-=-=-=-
+                // still resuming here means this is the file the last
+                // pass stopped after
+                if ( resuming_ ) {
+                    resuming_ = false;
+                    continue;
+                }
+
+                // =-=-=-=-=-=-=-
+                // temp, partial and progress files belong to transfers
+                last_ = relative;
+                if ( '.' == name[ 0 ] && name.find( ".shareuf-" ) != std::string::npos ) {
+                    continue;
+                }
+                ++summary_.files;
+
+                // =-=-=-=-=-=-=-
+                // noatime and relatime leave the access time behind, a
+                // recent write or inode change keeps the file as well
+                time_t used = std::max( sb.st_atime, std::max( sb.st_mtime, sb.st_ctime ) );
+                if ( now_ - used >= opts_.demote_after ) {
+                    demote( path, relative, sb );
+                }
+            }
+        }
+        return true;
+    }
+
+    void migrator::record_temp(
+        const std::string& _temp ) {
+        state_.temp = _temp;
+        write_state( state_fd_, state_ );
+    }
+
+    int migrator::copy(
+        int                          _in,
+        int                          _out,
+        const struct stat&           _sb,
+        shareuf_buffer_pool::buffer& _buf ) {
+        off_t offset = 0;
+        while ( offset < _sb.st_size ) {
+            ssize_t n = pread( _in, _buf.data(), _buf.size(), offset );
+            if ( n < 0 ) {
+                return -errno;
+            }
+            if ( 0 == n ) {
+                break;
+            }
+            limiter_.acquire( n );
+            for ( ssize_t done = 0; done < n; ) {
+                ssize_t w = pwrite( _out, _buf.data() + done, n - done, offset + done );
+                if ( w < 0 ) {
+                    return -errno;
+                }
+                done += w;
+            }
+            offset += n;
+        }
+
+        // =-=-=-=-=-=-=-
+        // the stored digest stays valid because size and mtime are kept
+        char digest[ 256 ];
+        ssize_t len = fgetxattr( _in, SHAREUF_DIGEST_XATTR, digest, sizeof( digest ) );
+        if ( len > 0 ) {
+            fsetxattr( _out, SHAREUF_DIGEST_XATTR, digest, len, 0 );
+        }
+
+        struct timespec times[ 2 ] = { _sb.st_atim, _sb.st_mtim };
+        if ( fchmod( _out, _sb.st_mode & 07777 ) < 0 || futimens( _out, times ) < 0 || fdatasync( _out ) < 0 ) {
+            return -errno;
+        }
+        return 0;
+    }
+
+    void migrator::demote(
+        const std::string& _path,
+        const std::string& _relative,
+        const struct stat& _sb ) {
+        std::string dest = opts_.destination( _relative );
+        if ( dest.empty() ) {
+            return;
+        }
+
+        int in = open( _path.c_str(), O_RDONLY | O_NOATIME | O_CLOEXEC );
+        if ( in < 0 && EPERM == errno ) {
+            in = open( _path.c_str(), O_RDONLY | O_CLOEXEC );
+        }
+        if ( in < 0 ) {
+            ++summary_.errors;
+            return;
+        }
+
+        // =-=-=-=-=-=-=-
+        // a file open anywhere on the host refuses the lease and waits for
+        // a later pass
+        int leased = take_lease( in );
+        struct stat before;
+        if ( leased < 0 || fstat( in, &before ) < 0 || !same_file_state( _sb, before ) ) {
+            close( in );
+            ++summary_.skipped;
+            return;
+        }
+
+        shareuf_buffer_pool::buffer buf = shareuf_buffer_pool::instance().acquire( COPY_BUFFER_SIZE );
+        std::string temp = shareuf_temp_path( dest );
+        int out = -1;
+        if ( buf && make_parents( dest, opts_.dir_mode ) == 0 ) {
+            record_temp( temp );
+            out = open( temp.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0600 );
+        }
+        if ( out < 0 ) {
+            close( in );
+            ++summary_.errors;
+            return;
+        }
+
+        int status = copy( in, out, _sb, buf );
+        close( out );
+
+        // =-=-=-=-=-=-=-
+        // a file written, truncated, replaced or opened during the copy
+        // stays put
+        struct stat after;
+        bool changed = fstat( in, &after ) < 0 || !same_file_state( _sb, after ) ||
+                       lstat( _path.c_str(), &after ) < 0 || !same_file_state( _sb, after ) ||
+                       !lease_held( in, leased );
+        if ( 0 == status && changed ) {
+            unlink( temp.c_str() );
+            ++summary_.skipped;
+        }
+        else if ( status < 0 || rename( temp.c_str(), dest.c_str() ) < 0 ) {
+            unlink( temp.c_str() );
+            ++summary_.errors;
+        }
+        else {
+            // =-=-=-=-=-=-=-
+            // moved aside rather than unlinked, so a write or an open which
+            // slipped in after the check can still be undone.  the rename
+            // changes the ctime, only the data is compared again.
+            std::string aside = shareuf_temp_path( _path );
+            record_temp( aside );
+            if ( rename( _path.c_str(), aside.c_str() ) < 0 ) {
+                unlink( dest.c_str() );
+                ++summary_.errors;
+            }
+            else if ( fstat( in, &after ) < 0 || !same_data( _sb, after ) || !lease_held( in, leased ) ) {
+                rename( aside.c_str(), _path.c_str() );
+                unlink( dest.c_str() );
+                ++summary_.skipped;
+            }
+            else {
+                unlink( aside.c_str() );
+                ++summary_.demoted;
+                summary_.bytes += _sb.st_size;
+                shareuf_metrics::instance().add( "tier.demoted_files", 1 );
+                shareuf_metrics::instance().add( "tier.demoted_bytes", _sb.st_size );
+            }
+        }
+
+        if ( leased > 0 ) {
+            fcntl( in, F_SETLEASE, F_UNLCK );
+        }
+        close( in );
+        record_temp( std::string() );
+    }
+
+} // namespace
+
+int shareuf_demote_cold_files(
+    const shareuf_migrator_options& _opts,
+    shareuf_migrator_summary&       _summary ) {
+    int fd = open( _opts.state_path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600 );
+    if ( fd < 0 ) {
+        return -errno;
+    }
+    if ( flock( fd, LOCK_EX | LOCK_NB ) < 0 ) {
+        int status = -errno;
+        close( fd );
+        return status;
+    }
+
+    // =-=-=-=-=-=-=-
+    // the lock is ours, so a temp still named here was left by a process
+    // which died during its copy
+    pass_state state;
+    read_state( fd, state );
+    if ( !state.temp.empty() ) {
+        unlink( state.temp.c_str() );
+        state.temp.clear();
+        shareuf_metrics::instance().add( "tier.temp_files_reaped", 1 );
+    }
+
+    int    status = -EWOULDBLOCK;
+    time_t now    = time( 0 );
+    if ( !state.cursor.empty() || state.last > now || now - state.last >= _opts.interval ) {
+        migrator m( _opts, _summary, fd, state );
+        if ( m.walk( _opts.fast_root, std::string(), 0 ) ) {
+            state.last = now;
+            state.cursor.clear();
+            status = 0;
+        }
+        else {
+            if ( !m.last().empty() ) {
+                state.cursor = m.last();
+            }
+            status = -ETIMEDOUT;
+        }
+    }
+    write_state( fd, state );
+
+    close( fd );
+    return status;
+
+} // shareuf_demote_cold_files
@@ -0,0 +1,84 @@
+/* Demotion of cold files from the small object tier to the bulk vault.
+ *
+ * A pass walks the fast tier and moves every regular file that has not
+ * been read, written or had its inode changed for a while to the path the
+ * bulk tier gives it: the data is copied to a temp name beside it at a
+ * bounded bandwidth, the mode, times and stored digest are carried over,
+ * the copy is renamed into place and the original unlinked.
+ *
+ * The original is held under a write lease for the copy, so a file open
+ * anywhere on the host is skipped and an open during the copy is noticed.
+ * A file whose size or times change, or whose lease is broken, before it
+ * is unlinked stays where it is.  Filesystems without leases rely on the
+ * stat comparison alone.
+ *
+ * Passes run in the agents, from rebalance and the maintenance after a
+ * client disconnects, one process per host at a time under an flock on
+ * the state file.  The file keeps the time of the last complete pass, the
+ * path an unfinished pass stopped at, so the next one carries on from
+ * there, and the temp name of the copy in flight, which is unlinked by the
+ * next pass should its process have died.
+ */
+#ifndef SHAREUF_TIER_MIGRATOR_HPP
+#define SHAREUF_TIER_MIGRATOR_HPP
+
+// =-=-=-=-=-=-=-
+// stl includes
+#include <chrono>
+#include <functional>
+#include <string>
+
+// =-=-=-=-=-=-=-
+// system includes
+#include <sys/types.h>
+#include <time.h>
+
+struct shareuf_migrator_summary {
+    unsigned long long files;
+    unsigned long long demoted;
+    unsigned long long bytes;
+    unsigned long long skipped;     // open, or changed while being copied
+    unsigned long long errors;
+
+    shareuf_migrator_summary() :
+        files( 0 ), demoted( 0 ), bytes( 0 ), skipped( 0 ), errors( 0 ) {
+    }
+};
+
+struct shareuf_migrator_options {
+    std::string        fast_root;          // tier files are demoted from
+    std::string        skip_dir;           // directory under fast_root to leave alone
+    std::string        state_path;         // flocked, holds the pass state
+    unsigned long long bytes_per_second;   // 0 for unlimited
+    time_t             demote_after;       // seconds since last access or change
+    time_t             interval;           // seconds between complete passes
+    mode_t             dir_mode;           // for directories made on the bulk tier
+
+    // =-=-=-=-=-=-=-
+    // the pass stops here and carries on from the same path next time
+    std::chrono::steady_clock::time_point deadline;
+
+    // =-=-=-=-=-=-=-
+    // bulk tier path for a path relative to fast_root, empty to skip it
+    std::function< std::string( const std::string& ) > destination;
+
+    shareuf_migrator_options() :
+        bytes_per_second( 0 ),
+        demote_after( 0 ),
+        interval( 0 ),
+        dir_mode( 0755 ),
+        deadline( std::chrono::steady_clock::time_point::max() ) {
+    }
+};
+
+// =-=-=-=-=-=-=-
+/// @brief run or carry on a pass over _opts.fast_root when one is due,
+///        returns 0 once it is complete, -ETIMEDOUT if it stopped at the
+///        deadline, -EWOULDBLOCK if another process holds the state file or
+///        the last pass was less than _opts.interval ago, or -errno if the
+///        pass could not run
+int shareuf_demote_cold_files(
+    const shareuf_migrator_options& _opts,
+    shareuf_migrator_summary&       _summary );
+
+#endif // SHAREUF_TIER_MIGRATOR_HPP
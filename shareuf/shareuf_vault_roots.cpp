@@ -0,0 +1,92 @@
+#include "shareuf_vault_roots.hpp"
+
+// =-=-=-=-=-=-=-
+// stl includes
+#include <algorithm>
+#include <functional>
+#include <sstream>
+#include <utility>
+
+// =-=-=-=-=-=-=-
+// system includes
+#include <stdint.h>
+
+namespace {
+    // =-=-=-=-=-=-=-
+    // FNV-1a finished with the splitmix64 mixer; std::hash is not stable
+    // across builds and the order must agree between every server
+    uint64_t weight(
+        const std::string& _root,
+        const std::string& _key ) {
+        uint64_t h = 14695981039346656037ULL;
+        for ( size_t i = 0; i < _root.size(); ++i ) {
+            h = ( h ^ static_cast< unsigned char >( _root[ i ] ) ) * 1099511628211ULL;
+        }
+        h = ( h ^ 0 ) * 1099511628211ULL;
+        for ( size_t i = 0; i < _key.size(); ++i ) {
+            h = ( h ^ static_cast< unsigned char >( _key[ i ] ) ) * 1099511628211ULL;
+        }
+        h += 0x9e3779b97f4a7c15ULL;
+        h = ( h ^ ( h >> 30 ) ) * 0xbf58476d1ce4e5b9ULL;
+        h = ( h ^ ( h >> 27 ) ) * 0x94d049bb133111ebULL;
+        return h ^ ( h >> 31 );
+    }
+}
+
+std::vector< std::string > shareuf_parse_vault_roots(
+    const std::string& _list ) {
+    std::vector< std::string > roots;
+    std::istringstream in( _list );
+    std::string root;
+    while ( std::getline( in, root, ',' ) ) {
+        root.erase( 0, root.find_first_not_of( " \t" ) );
+        root.erase( root.find_last_not_of( " \t" ) + 1 );
+        while ( root.size() > 1 && '/' == root[ root.size() - 1 ] ) {
+            root.erase( root.size() - 1 );
+        }
+        if ( !root.empty() && std::find( roots.begin(), roots.end(), root ) == roots.end() ) {
+            roots.push_back( root );
+        }
+    }
+    return roots;
+
+} // shareuf_parse_vault_roots
+
+std::vector< size_t > shareuf_rendezvous_order(
+    const std::vector< std::string >& _roots,
+    const std::string&                _key ) {
+    std::vector< std::pair< uint64_t, size_t > > weights;
+    weights.reserve( _roots.size() );
+    for ( size_t i = 0; i < _roots.size(); ++i ) {
+        weights.push_back( std::make_pair( weight( _roots[ i ], _key ), i ) );
+    }
+    std::sort( weights.begin(), weights.end(), std::greater< std::pair< uint64_t, size_t > >() );
+
+    std::vector< size_t > order;
+    order.reserve( weights.size() );
+    for ( size_t i = 0; i < weights.size(); ++i ) {
+        order.push_back( weights[ i ].second );
+    }
+    return order;
+
+} // shareuf_rendezvous_order
+
+bool shareuf_path_under(
+    const std::string& _root,
+    const std::string& _path,
+    std::string&       _relative ) {
+    if ( _path.compare( 0, _root.size(), _root ) != 0 ) {
+        return false;
+    }
+    if ( _path.size() == _root.size() ) {
+        _relative.clear();
+        return true;
+    }
+    if ( _path[ _root.size() ] != '/' ) {
+        return false;
+    }
+    _relative = _path.substr( _root.size() + 1 );
+    _relative.erase( 0, _relative.find_first_not_of( '/' ) );
+    return true;
+
+} // shareuf_path_under
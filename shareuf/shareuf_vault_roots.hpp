@@ -0,0 +1,36 @@
+/* Placement of objects across several vault roots, one per filesystem.
+ * Every object has a deterministic preference order over the roots from
+ * rendezvous (highest random weight) hashing of its path below the vault,
+ * so adding or removing a root only moves the objects that ranked it
+ * first, and an object is found by probing the roots in that order.
+ */
+#ifndef SHAREUF_VAULT_ROOTS_HPP
+#define SHAREUF_VAULT_ROOTS_HPP
+
+// =-=-=-=-=-=-=-
+// stl includes
+#include <string>
+#include <vector>
+
+// =-=-=-=-=-=-=-
+/// @brief split a comma separated list of absolute roots, dropping empty
+///        entries and trailing slashes
+std::vector< std::string > shareuf_parse_vault_roots(
+    const std::string& _list );
+
+// =-=-=-=-=-=-=-
+/// @brief indices of _roots from most to least preferred for _key, the
+///        same on every host and in every process
+std::vector< size_t > shareuf_rendezvous_order(
+    const std::vector< std::string >& _roots,
+    const std::string&                _key );
+
+// =-=-=-=-=-=-=-
+/// @brief true when _path is _root or lies below it, _relative receives
+///        the remainder without its leading slash
+bool shareuf_path_under(
+    const std::string& _root,
+    const std::string& _path,
+    std::string&       _relative );
+
+#endif // SHAREUF_VAULT_ROOTS_HPP
@@ -0,0 +1,72 @@
+/* Reports the throughput of each checksum kernel usable on this CPU.
+ *
+ * usage: shareuf-checksum-bench [megabytes]
+ */
+#include "shareuf_checksum.hpp"
+#include "shareuf_checksum_kernels.hpp"
+
+// =-=-=-=-=-=-=-
+// stl includes
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+static double seconds_since(
+    std::chrono::steady_clock::time_point _start ) {
+    return std::chrono::duration< double >( std::chrono::steady_clock::now() - _start ).count();
+}
+
+static void bench_crc32c(
+    const char*                       _name,
+    shareuf_crc32c_kernel_t           _kernel,
+    const std::vector< unsigned char >& _buf,
+    int                               _rounds ) {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    uint32_t crc = 0;
+    for ( int i = 0; i < _rounds; ++i ) {
+        crc = _kernel( crc, _buf.data(), _buf.size() );
+    }
+    double elapsed = seconds_since( start );
+    printf( "crc32c  %-8s %8.2f GB/s  (%08x)\n", _name, _buf.size() * double( _rounds ) / elapsed / 1e9, crc );
+}
+
+static void bench_sha256(
+    const char*                       _name,
+    shareuf_sha256_kernel_t           _kernel,
+    const std::vector< unsigned char >& _buf,
+    int                               _rounds ) {
+    uint32_t state[ 8 ] = { 0 };
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for ( int i = 0; i < _rounds; ++i ) {
+        _kernel( state, _buf.data(), _buf.size() / 64 );
+    }
+    double elapsed = seconds_since( start );
+    printf( "sha256  %-8s %8.2f GB/s  (%08x)\n", _name, _buf.size() * double( _rounds ) / elapsed / 1e9, state[ 0 ] );
+}
+
+int main( int _argc, char** _argv ) {
+    size_t megabytes = _argc > 1 ? strtoul( _argv[ 1 ], NULL, 10 ) : 64;
+    if ( megabytes == 0 ) {
+        megabytes = 64;
+    }
+
+    std::vector< unsigned char > buf( megabytes * 1024 * 1024 );
+    for ( size_t i = 0; i < buf.size(); ++i ) {
+        buf[ i ] = static_cast< unsigned char >( i * 2654435761u >> 24 );
+    }
+
+    printf( "selected: crc32c=%s sha256=%s\n", shareuf_crc32c_kernel_name(), shareuf_sha256_kernel_name() );
+
+    bench_crc32c( "scalar", shareuf_crc32c_scalar, buf, 4 );
+    if ( shareuf_cpu_has_sse42() ) {
+        bench_crc32c( "sse4.2", shareuf_crc32c_sse42, buf, 16 );
+    }
+
+    bench_sha256( "scalar", shareuf_sha256_blocks_scalar, buf, 2 );
+    if ( shareuf_cpu_has_shani() ) {
+        bench_sha256( "sha-ni", shareuf_sha256_blocks_shani, buf, 8 );
+    }
+
+    return 0;
+}
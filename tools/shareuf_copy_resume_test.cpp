@@ -0,0 +1,215 @@
+/* Checks that a resumable copy killed part way can be carried on.
+ *
+ * usage: shareuf-copy-resume-test <scratch directory>
+ *
+ * A child process copies a source through the checkpointed copy of
+ * shareuf_file_copy and is killed between two checkpoints.  The
+ * partial file it leaves must verify against its progress sidecar and
+ * resume to a copy identical to the source, while a partial file cut short
+ * of the checkpoint or with a byte changed in its prefix must fail the
+ * CRC32C check.  Last, abandoned partial copies are reaped by age.  Exits
+ * non-zero if any check fails.
+ */
+#include "shareuf_copy_progress.hpp"
+
+// =-=-=-=-=-=-=-
+// stl includes
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+// =-=-=-=-=-=-=-
+// system includes
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+static const off_t  SOURCE_SIZE = 8 * 1024 * 1024 + 12345;
+static const off_t  CHECKPOINT  = 1024 * 1024;
+static const off_t  KILL_AT     = 5 * 1024 * 1024 + 4096;
+static const size_t CHUNK       = 64 * 1024;
+
+static int failures = 0;
+
+#define CHECK( _cond ) \
+    do { \
+        if ( !( _cond ) ) { \
+            fprintf( stderr, "FAILED line %d: %s\n", __LINE__, #_cond ); \
+            ++failures; \
+        } \
+    } while ( 0 )
+
+static bool read_file(
+    const std::string&   _path,
+    std::vector< char >& _out ) {
+    int fd = open( _path.c_str(), O_RDONLY );
+    if ( fd < 0 ) {
+        return false;
+    }
+    struct stat sb;
+    bool ok = fstat( fd, &sb ) == 0;
+    _out.resize( ok ? sb.st_size : 0 );
+    ok = ok && pread( fd, _out.data(), _out.size(), 0 ) == static_cast< ssize_t >( _out.size() );
+    close( fd );
+    return ok;
+}
+
+static bool exists(
+    const std::string& _path ) {
+    struct stat sb;
+    return lstat( _path.c_str(), &sb ) == 0;
+}
+
+// =-=-=-=-=-=-=-
+// a resumable copy as shareuf_file_copy makes it: resume from the
+// checkpoint, copy in CHUNK sized pieces checkpointed every CHECKPOINT
+// bytes, then publish.  with _kill_at set the process kills itself once a
+// chunk written past it is on its way to disk.
+static int copy_checkpointed(
+    const std::string& _source,
+    const std::string& _dest,
+    off_t              _kill_at ) {
+    int in = open( _source.c_str(), O_RDONLY );
+    struct stat sb;
+    if ( in < 0 || fstat( in, &sb ) < 0 ) {
+        return -errno;
+    }
+    int out = open( shareuf_partial_path( _dest ).c_str(), O_RDWR | O_CREAT, 0600 );
+    if ( out < 0 ) {
+        close( in );
+        return -errno;
+    }
+
+    std::vector< char > buf( CHUNK );
+    shareuf_chunked_copy copy;
+    copy.in_fd         = in;
+    copy.out_fd        = out;
+    copy.buf           = buf.data();
+    copy.len           = buf.size();
+    copy.checkpoint    = CHECKPOINT;
+    copy.progress_path = shareuf_progress_path( _dest );
+    copy.on_chunk      = [_kill_at]( const char*, size_t _len, off_t _offset ) {
+        if ( _kill_at > 0 && _offset + static_cast< off_t >( _len ) > _kill_at ) {
+            raise( SIGKILL );
+        }
+    };
+    int status = shareuf_resume_copy( copy, sb, 0 );
+    if ( 0 == status ) {
+        status = shareuf_run_copy( copy );
+    }
+    close( out );
+    close( in );
+    if ( 0 == status && copy.copied != sb.st_size ) {
+        status = -EIO;
+    }
+    return 0 == status ? shareuf_publish_copy( _dest ) : status;
+}
+
+static void copy_and_kill(
+    const std::string& _source,
+    const std::string& _dest ) {
+    pid_t pid = fork();
+    if ( 0 == pid ) {
+        _exit( copy_checkpointed( _source, _dest, KILL_AT ) == 0 ? 0 : 1 );
+    }
+    int status = 0;
+    CHECK( pid > 0 && waitpid( pid, &status, 0 ) == pid );
+    CHECK( WIFSIGNALED( status ) && SIGKILL == WTERMSIG( status ) );
+}
+
+static bool partial_verifies(
+    const std::string& _source,
+    const std::string& _dest ) {
+    struct stat sb;
+    shareuf_copy_progress progress;
+    std::vector< char > buf( CHUNK );
+    int fd = open( shareuf_partial_path( _dest ).c_str(), O_RDONLY );
+    bool ok = fd >= 0 && stat( _source.c_str(), &sb ) == 0 &&
+              shareuf_read_copy_progress( shareuf_progress_path( _dest ), progress ) &&
+              progress.same_source( sb ) && progress.offset == KILL_AT / CHECKPOINT * CHECKPOINT &&
+              shareuf_verify_partial( fd, progress, buf.data(), buf.size(), 0 );
+    if ( fd >= 0 ) {
+        close( fd );
+    }
+    return ok;
+}
+
+int main( int _argc, char** _argv ) {
+    if ( _argc != 2 ) {
+        fprintf( stderr, "usage: %s <scratch directory>\n", _argv[ 0 ] );
+        return 1;
+    }
+    std::string dir    = _argv[ 1 ];
+    std::string source = dir + "/source";
+    std::string dest   = dir + "/dest";
+    unlink( dest.c_str() );
+    unlink( shareuf_partial_path( dest ).c_str() );
+    unlink( shareuf_progress_path( dest ).c_str() );
+
+    std::vector< char > data( SOURCE_SIZE );
+    srand( 1 );
+    for ( size_t i = 0; i < data.size(); ++i ) {
+        data[ i ] = static_cast< char >( rand() );
+    }
+    int fd = open( source.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0600 );
+    if ( fd < 0 || write( fd, data.data(), data.size() ) != static_cast< ssize_t >( data.size() ) ) {
+        fprintf( stderr, "cannot write %s\n", source.c_str() );
+        return 1;
+    }
+    close( fd );
+
+    // =-=-=-=-=-=-=-
+    // killed past the fifth checkpoint, resumed from it
+    std::vector< char > copy;
+    copy_and_kill( source, dest );
+    CHECK( partial_verifies( source, dest ) );
+    CHECK( copy_checkpointed( source, dest, 0 ) == 0 );
+    CHECK( read_file( dest, copy ) && copy == data );
+    CHECK( !exists( shareuf_partial_path( dest ) ) && !exists( shareuf_progress_path( dest ) ) );
+
+    // =-=-=-=-=-=-=-
+    // cut short of the checkpoint, the copy starts over
+    unlink( dest.c_str() );
+    copy_and_kill( source, dest );
+    CHECK( truncate( shareuf_partial_path( dest ).c_str(), CHECKPOINT ) == 0 );
+    CHECK( !partial_verifies( source, dest ) );
+    CHECK( copy_checkpointed( source, dest, 0 ) == 0 );
+    CHECK( read_file( dest, copy ) && copy == data );
+
+    // =-=-=-=-=-=-=-
+    // a byte changed in the verified prefix, the copy starts over
+    unlink( dest.c_str() );
+    copy_and_kill( source, dest );
+    fd = open( shareuf_partial_path( dest ).c_str(), O_WRONLY );
+    char flipped = ~data[ CHECKPOINT + 17 ];
+    CHECK( fd >= 0 && pwrite( fd, &flipped, 1, CHECKPOINT + 17 ) == 1 );
+    close( fd );
+    CHECK( !partial_verifies( source, dest ) );
+    CHECK( copy_checkpointed( source, dest, 0 ) == 0 );
+    CHECK( read_file( dest, copy ) && copy == data );
+
+    // =-=-=-=-=-=-=-
+    // an abandoned partial copy stays while it is young, then goes with
+    // its sidecar, as does a sidecar left alone
+    unlink( dest.c_str() );
+    copy_and_kill( source, dest );
+    std::string lone = shareuf_progress_path( dir + "/lone" );
+    fd = open( lone.c_str(), O_WRONLY | O_CREAT, 0600 );
+    close( fd );
+    std::chrono::steady_clock::time_point never = std::chrono::steady_clock::time_point::max();
+    unsigned long long reaped = 0;
+    CHECK( shareuf_reap_partial_copies( dir, 3600, never, reaped ) == 0 && 0 == reaped );
+    CHECK( exists( shareuf_partial_path( dest ) ) && exists( shareuf_progress_path( dest ) ) && exists( lone ) );
+    CHECK( shareuf_reap_partial_copies( dir, 0, never, reaped ) == 0 && 2 == reaped );
+    CHECK( !exists( shareuf_partial_path( dest ) ) && !exists( shareuf_progress_path( dest ) ) && !exists( lone ) );
+    CHECK( exists( source ) );
+
+    unlink( source.c_str() );
+    printf( "%s\n", failures ? "FAILED" : "passed" );
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,73 @@
+/* Prints the events of a shareuf event ring, one tab separated line each:
+ *
+ *   <sequence> <event> <size> <time_ns> <path> [<detail>]
+ *
+ * usage: shareuf-events <ring file> [-f] [-s sequence]
+ *
+ *   -f   keep following the ring for new events
+ *   -s   start at this sequence number instead of the oldest event kept
+ *
+ * Events overwritten before they could be read are reported on stderr; a
+ * consumer seeing that has to rescan the vault.
+ */
+#include "shareuf_event_feed.hpp"
+
+// =-=-=-=-=-=-=-
+// stl includes
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+int main( int _argc, char** _argv ) {
+    const char* ring   = NULL;
+    bool        follow = false;
+    uint64_t    next   = 1;
+    for ( int i = 1; i < _argc; ++i ) {
+        if ( strcmp( _argv[ i ], "-f" ) == 0 ) {
+            follow = true;
+        }
+        else if ( strcmp( _argv[ i ], "-s" ) == 0 && i + 1 < _argc ) {
+            next = strtoull( _argv[ ++i ], NULL, 10 );
+        }
+        else {
+            ring = _argv[ i ];
+        }
+    }
+    if ( !ring ) {
+        fprintf( stderr, "usage: %s <ring file> [-f] [-s sequence]\n", _argv[ 0 ] );
+        return 2;
+    }
+
+    // =-=-=-=-=-=-=-
+    // without -s, events from before the ring wrapped are not counted lost
+    bool     first = next <= 1;
+    uint64_t lost  = 0;
+    for ( ;; ) {
+        std::vector< shareuf_event > events;
+        uint64_t missed = 0;
+        int status = shareuf_ring_read( ring, next, events, missed );
+        if ( status < 0 ) {
+            fprintf( stderr, "%s: %s\n", ring, strerror( -status ) );
+            return 1;
+        }
+        if ( missed > 0 && !first ) {
+            lost += missed;
+            fprintf( stderr, "# lost %llu events\n", static_cast< unsigned long long >( missed ) );
+        }
+        first = false;
+
+        for ( size_t i = 0; i < events.size(); ++i ) {
+            printf( "%s\n", shareuf_format_event( events[ i ] ).c_str() );
+        }
+        fflush( stdout );
+
+        if ( !follow ) {
+            break;
+        }
+        std::this_thread::sleep_for( std::chrono::milliseconds( 200 ) );
+    }
+    return lost > 0 ? 3 : 0;
+}
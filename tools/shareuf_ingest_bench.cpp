@@ -0,0 +1,183 @@
+/* Replays the filesystem work the plugin does for a recursive put, with
+ * and without bulk-ingest mode, under a scratch directory.
+ *
+ * usage: shareuf-ingest-bench <scratch directory> [files] [files per directory]
+ *
+ * Each object goes through what a create costs the plugin: its directory is
+ * made, free space is probed and reserved in the ledger, the file is
+ * created, written and closed and the reservation given back.  The scratch
+ * directory is left behind for inspection.
+ */
+#include "shareuf_bulk_ingest.hpp"
+#include "shareuf_reservations.hpp"
+
+// =-=-=-=-=-=-=-
+// stl includes
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+// =-=-=-=-=-=-=-
+// system includes
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/vfs.h>
+#include <unistd.h>
+
+static const int64_t OBJECT_SIZE = 4096;
+static const int64_t BATCH_SIZE  = 1024LL * 1024 * 1024;
+
+static double seconds_since(
+    std::chrono::steady_clock::time_point _start ) {
+    return std::chrono::duration< double >( std::chrono::steady_clock::now() - _start ).count();
+}
+
+static int64_t free_space(
+    const std::string& _dir ) {
+    struct statfs sb;
+    return statfs( _dir.c_str(), &sb ) < 0 ? -1 : static_cast< int64_t >( sb.f_bavail ) * sb.f_bsize;
+}
+
+// =-=-=-=-=-=-=-
+// shareuf_file_mkdir_r as it runs outside bulk-ingest mode: every component
+// is made and stat'ed for the log line
+static void mkdir_every_component(
+    const std::string& _path ) {
+    for ( std::string::size_type pos = _path.find( '/', 1 ); ; pos = _path.find( '/', pos + 1 ) ) {
+        std::string subdir = _path.substr( 0, pos );
+        struct stat sb;
+        mkdir( subdir.c_str(), 0755 );
+        stat( subdir.c_str(), &sb );
+        if ( std::string::npos == pos ) {
+            break;
+        }
+    }
+}
+
+// =-=-=-=-=-=-=-
+// and inside it, skipping the components already known
+static void mkdir_unknown_components(
+    const std::string& _path ) {
+    shareuf_bulk_ingest& bulk = shareuf_bulk_ingest::instance();
+    for ( std::string::size_type pos = _path.find( '/', 1 ); ; pos = _path.find( '/', pos + 1 ) ) {
+        std::string subdir = _path.substr( 0, pos );
+        if ( !bulk.known_directory( subdir ) ) {
+            int status = mkdir( subdir.c_str(), 0755 );
+            bulk.add_directory( subdir, status >= 0 );
+        }
+        if ( std::string::npos == pos ) {
+            break;
+        }
+    }
+}
+
+static bool write_object(
+    const std::string& _path ) {
+    static const char data[ OBJECT_SIZE ] = { 0 };
+    int fd = open( _path.c_str(), O_WRONLY | O_CREAT | O_EXCL, 0600 );
+    if ( fd < 0 ) {
+        return false;
+    }
+    bool ok = write( fd, data, sizeof( data ) ) == static_cast< ssize_t >( sizeof( data ) );
+    return close( fd ) == 0 && ok;
+}
+
+static bool ingest(
+    const std::string& _root,
+    const std::string& _ledger,
+    long               _files,
+    long               _per_dir,
+    bool               _bulk ) {
+    shareuf_bulk_ingest& bulk = shareuf_bulk_ingest::instance();
+    if ( _bulk ) {
+        bulk.start( _files, 30 );
+    }
+
+    for ( long i = 0; i < _files; ++i ) {
+        char name[ 64 ];
+        snprintf( name, sizeof( name ), "/d%03ld/d%04ld", i / _per_dir / 1000, i / _per_dir );
+        std::string dir  = _root + name;
+        snprintf( name, sizeof( name ), "/f%08ld", i );
+        std::string path = dir + name;
+
+        shareuf_reservation reservation;
+        if ( _bulk ) {
+            struct stat sb;
+            if ( !bulk.known_directory( dir ) && stat( dir.c_str(), &sb ) < 0 ) {
+                mkdir_unknown_components( dir );
+            }
+            bulk.add_directory( dir, false );
+            if ( !bulk.draw( _ledger, OBJECT_SIZE ) ) {
+                bulk.drop( _ledger );
+                shareuf_reservation batch;
+                if ( shareuf_reserve_space( _ledger, BATCH_SIZE, free_space( dir ), batch ) < 0 ) {
+                    return false;
+                }
+                bulk.hold( _ledger, batch, BATCH_SIZE );
+                bulk.draw( _ledger, OBJECT_SIZE );
+            }
+        }
+        else {
+            struct stat sb;
+            if ( stat( dir.c_str(), &sb ) < 0 ) {
+                mkdir_every_component( dir );
+            }
+            if ( shareuf_reserve_space( _ledger, OBJECT_SIZE, free_space( dir ), reservation ) < 0 ) {
+                return false;
+            }
+        }
+
+        if ( !write_object( path ) ) {
+            perror( path.c_str() );
+            return false;
+        }
+        shareuf_release_reservation( reservation );
+
+        if ( _bulk ) {
+            bulk.note_object();
+        }
+    }
+
+    if ( _bulk ) {
+        shareuf_bulk_ingest_summary summary;
+        bulk.finish( summary );
+        printf( "  %lld directories made, %lld batch reservations\n", summary.directories, summary.refills );
+    }
+    return true;
+}
+
+int main( int _argc, char** _argv ) {
+    if ( _argc < 2 ) {
+        fprintf( stderr, "usage: %s <scratch directory> [files] [files per directory]\n", _argv[ 0 ] );
+        return 1;
+    }
+    std::string scratch = _argv[ 1 ];
+    long files   = _argc > 2 ? strtol( _argv[ 2 ], NULL, 10 ) : 100000;
+    long per_dir = _argc > 3 ? strtol( _argv[ 3 ], NULL, 10 ) : 100;
+    if ( files <= 0 || per_dir <= 0 ) {
+        fprintf( stderr, "files and files per directory must be positive\n" );
+        return 1;
+    }
+
+    if ( mkdir( scratch.c_str(), 0755 ) < 0 && EEXIST != errno ) {
+        perror( scratch.c_str() );
+        return 1;
+    }
+    std::string ledger = scratch + "/reservations";
+
+    const char* modes[] = { "per-create", "bulk-ingest" };
+    for ( int bulk = 0; bulk < 2; ++bulk ) {
+        std::string root = scratch + ( bulk ? "/bulk" : "/plain" );
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        if ( !ingest( root, ledger, files, per_dir, bulk != 0 ) ) {
+            fprintf( stderr, "%s ingest failed\n", modes[ bulk ] );
+            return 1;
+        }
+        double elapsed = seconds_since( start );
+        printf( "%-12s %ld files in %.2f s, %.0f files/s\n", modes[ bulk ], files, elapsed, files / elapsed );
+    }
+
+    return 0;
+}
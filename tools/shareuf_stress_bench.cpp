@@ -0,0 +1,790 @@
+/* Concurrency stress benchmark: replays the syscalls of the plugin's file
+ * operations from many threads in several processes against one vault.
+ *
+ * usage: shareuf-stress-bench [options] <vault directory>
+ *
+ *   -t 1,2,4,8     thread counts per process, one step of the curve each
+ *   -p 1           processes, as several agents on the host
+ *   -s 10          seconds per step
+ *   -f 1000        most files alive per thread
+ *   -d 16          directories shared by all threads
+ *   -m MIX         operation mix, default
+ *                  create:20,read:30,stat:25,rename:10,unlink:10,readdir:5
+ *   -z SIZES       file sizes and weights, default 4096:70,1048576:25,16777216:5
+ *   -u 077         umask of the processes
+ *
+ * A create is the plugin's create, write and close: statfs for the free
+ * space check, an O_EXCL open with mode 0644 and an fchmod to 0644, 1 MiB
+ * writes, close.  A read is open, read and close.  Every step prints the
+ * throughput and the p50/p99/p999 latency of each call, and checks what
+ * it did: modes other than 0644, files lost or left behind by rename and
+ * unlink, sizes and contents which differ from what was written, and a
+ * process umask which changed while the threads ran.
+ * The exit status is 1 when any check failed.
+ *
+ * Built with SHAREUF_FAULT_INJECTION, the latency and errors given in
+ * SHAREUF_FAULTS are injected before each call, see the README.
+ */
+#ifdef SHAREUF_FAULT_INJECTION
+#include "shareuf_faults.hpp"
+#endif
+
+// =-=-=-=-=-=-=-
+// stl includes
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+// =-=-=-=-=-=-=-
+// system includes
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <sys/stat.h>
+#include <sys/vfs.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+static const mode_t FILE_MODE  = 0644;
+static const size_t IO_SIZE    = 1024 * 1024;
+
+// =-=-=-=-=-=-=-
+// timed calls
+enum call {
+    CALL_CREATE,
+    CALL_WRITE,
+    CALL_CLOSE,
+    CALL_OPEN,
+    CALL_READ,
+    CALL_STAT,
+    CALL_RENAME,
+    CALL_UNLINK,
+    CALL_READDIR,
+    CALL_COUNT
+};
+
+static const char* call_names[ CALL_COUNT ] = {
+    "create", "write", "close", "open", "read", "stat", "rename", "unlink", "readdir"
+};
+
+// =-=-=-=-=-=-=-
+// operations of the mix
+enum operation {
+    OP_CREATE,
+    OP_READ,
+    OP_STAT,
+    OP_RENAME,
+    OP_UNLINK,
+    OP_READDIR,
+    OP_COUNT
+};
+
+static const char* operation_names[ OP_COUNT ] = {
+    "create", "read", "stat", "rename", "unlink", "readdir"
+};
+
+enum issue {
+    ISSUE_WRONG_MODE,
+    ISSUE_LOST_FILE,
+    ISSUE_STALE_FILE,
+    ISSUE_SIZE_MISMATCH,
+    ISSUE_CONTENT_MISMATCH,
+    ISSUE_UMASK_CHANGED,
+    ISSUE_COUNT
+};
+
+static const char* issue_names[ ISSUE_COUNT ] = {
+    "wrong modes", "lost files", "files left behind", "size mismatches", "content mismatches", "umask changes"
+};
+
+// =-=-=-=-=-=-=-
+// log-linear latency histogram in nanoseconds, 32 buckets per power of two
+static const int SUB_BUCKETS = 32;
+static const int BUCKETS     = 64 + 40 * SUB_BUCKETS;
+
+static int bucket_of(
+    uint64_t _ns ) {
+    if ( _ns < 64 ) {
+        return static_cast< int >( _ns );
+    }
+    int msb   = 63 - __builtin_clzll( _ns );
+    int shift = msb - 5;
+    int index = 64 + ( shift - 1 ) * SUB_BUCKETS + static_cast< int >( ( _ns >> shift ) - SUB_BUCKETS );
+    return std::min( index, BUCKETS - 1 );
+}
+
+static double bucket_value(
+    int _index ) {
+    if ( _index < 64 ) {
+        return _index;
+    }
+    int shift = ( _index - 64 ) / SUB_BUCKETS + 1;
+    int sub   = ( _index - 64 ) % SUB_BUCKETS + SUB_BUCKETS;
+    return ( sub + 0.5 ) * ( 1ULL << shift );
+}
+
+// =-=-=-=-=-=-=-
+// what a thread, then a process, then a step did.  plain data, children
+// hand it to the parent through a pipe.
+struct results {
+    uint64_t histogram[ CALL_COUNT ][ BUCKETS ];
+    uint64_t calls[ CALL_COUNT ];
+    uint64_t errors[ CALL_COUNT ];
+    uint64_t operations;
+    uint64_t bytes;
+    uint64_t issues[ ISSUE_COUNT ];
+
+    void add( const results& _other ) {
+        for ( int c = 0; c < CALL_COUNT; ++c ) {
+            for ( int b = 0; b < BUCKETS; ++b ) {
+                histogram[ c ][ b ] += _other.histogram[ c ][ b ];
+            }
+            calls[ c ]  += _other.calls[ c ];
+            errors[ c ] += _other.errors[ c ];
+        }
+        operations += _other.operations;
+        bytes      += _other.bytes;
+        for ( int i = 0; i < ISSUE_COUNT; ++i ) {
+            issues[ i ] += _other.issues[ i ];
+        }
+    }
+
+    double percentile(
+        int    _call,
+        double _fraction ) const {
+        uint64_t target = static_cast< uint64_t >( _fraction * calls[ _call ] );
+        uint64_t seen   = 0;
+        for ( int b = 0; b < BUCKETS; ++b ) {
+            seen += histogram[ _call ][ b ];
+            if ( seen > target ) {
+                return bucket_value( b );
+            }
+        }
+        return bucket_value( BUCKETS - 1 );
+    }
+};
+
+struct options {
+    std::vector< int >                       threads;
+    int                                      processes;
+    int                                      seconds;
+    size_t                                   max_files;
+    int                                      directories;
+    std::vector< std::pair< int, double > >  mix;       // operation, cumulative weight
+    std::vector< std::pair< off_t, double > > sizes;    // size, cumulative weight
+    mode_t                                   mask;
+};
+
+struct file_record {
+    int      dir;
+    uint64_t name;
+    off_t    size;
+    uint64_t seed;
+};
+
+// =-=-=-=-=-=-=-
+// contents are a function of a seed and the offset, so a read checks every
+// byte without keeping a copy
+static void fill_pattern(
+    char*    _buf,
+    size_t   _len,
+    off_t    _offset,
+    uint64_t _seed ) {
+    for ( size_t i = 0; i < _len; i += 8 ) {
+        uint64_t word = _seed ^ ( ( _offset + i ) * 0x9E3779B97F4A7C15ULL );
+        memcpy( _buf + i, &word, std::min< size_t >( 8, _len - i ) );
+    }
+}
+
+static bool parse_ints(
+    const char*         _text,
+    std::vector< int >& _out ) {
+    for ( const char* p = _text; *p; ) {
+        char* end = 0;
+        long  n   = strtol( p, &end, 10 );
+        if ( end == p || n <= 0 ) {
+            return false;
+        }
+        _out.push_back( static_cast< int >( n ) );
+        p = *end == ',' ? end + 1 : end;
+        if ( *end && *end != ',' ) {
+            return false;
+        }
+    }
+    return !_out.empty();
+}
+
+// =-=-=-=-=-=-=-
+// "name:weight,..." with the names resolved by _lookup, cumulative weights
+template< typename T, typename F >
+static bool parse_weights(
+    const char*                          _text,
+    F                                    _lookup,
+    std::vector< std::pair< T, double > >& _out ) {
+    double      total = 0;
+    std::string text  = _text;
+    for ( std::string::size_type start = 0; start < text.size(); ) {
+        std::string::size_type end = text.find( ',', start );
+        if ( std::string::npos == end ) {
+            end = text.size();
+        }
+        std::string            item  = text.substr( start, end - start );
+        std::string::size_type colon = item.find( ':' );
+        T                      key;
+        double                 weight;
+        if ( std::string::npos == colon || !_lookup( item.substr( 0, colon ), key ) ||
+                ( weight = strtod( item.c_str() + colon + 1, 0 ) ) < 0 ) {
+            return false;
+        }
+        total += weight;
+        _out.push_back( std::make_pair( key, total ) );
+        start = end + 1;
+    }
+    return total > 0;
+}
+
+class worker {
+    public:
+        worker(
+            const options&     _opts,
+            const std::string& _root,
+            int                _id,
+            results&           _results ) :
+            opts_( _opts ),
+            root_( _root ),
+            id_( _id ),
+            results_( _results ),
+            random_( _id * 7919 + getpid() ),
+            next_name_( 0 ),
+            buf_( IO_SIZE ),
+            check_( IO_SIZE ) {
+        }
+
+        void run(
+            std::chrono::steady_clock::time_point _deadline ) {
+            while ( std::chrono::steady_clock::now() < _deadline ) {
+                int op = draw( opts_.mix );
+                if ( files_.empty() && OP_READDIR != op ) {
+                    op = OP_CREATE;
+                }
+                else if ( OP_CREATE == op && files_.size() >= opts_.max_files ) {
+                    op = OP_UNLINK;
+                }
+                switch ( op ) {
+                    case OP_CREATE:  create();  break;
+                    case OP_READ:    read();    break;
+                    case OP_STAT:    stat();    break;
+                    case OP_RENAME:  rename();  break;
+                    case OP_UNLINK:  unlink();  break;
+                    case OP_READDIR: readdir(); break;
+                }
+                ++results_.operations;
+            }
+        }
+
+        // =-=-=-=-=-=-=-
+        // everything this thread believes is in the vault must be there as
+        // it was written, then it is removed for the next step
+        void verify_and_clean() {
+            for ( size_t i = 0; i < files_.size(); ++i ) {
+                std::string path = path_of( files_[ i ] );
+                struct stat sb;
+                if ( ::stat( path.c_str(), &sb ) < 0 ) {
+                    ++results_.issues[ ISSUE_LOST_FILE ];
+                    continue;
+                }
+                check_file( files_[ i ], sb );
+                ::unlink( path.c_str() );
+            }
+            files_.clear();
+        }
+
+    private:
+        template< typename T >
+        T draw( const std::vector< std::pair< T, double > >& _weights ) {
+            double x = std::uniform_real_distribution< double >( 0, _weights.back().second )( random_ );
+            for ( size_t i = 0; i < _weights.size(); ++i ) {
+                if ( x < _weights[ i ].second ) {
+                    return _weights[ i ].first;
+                }
+            }
+            return _weights.back().first;
+        }
+
+        size_t pick() {
+            return std::uniform_int_distribution< size_t >( 0, files_.size() - 1 )( random_ );
+        }
+
+        std::string dir_of( int _dir ) const {
+            char name[ 32 ];
+            snprintf( name, sizeof( name ), "/d%03d", _dir );
+            return root_ + name;
+        }
+
+        std::string path_of( const file_record& _file ) const {
+            char name[ 64 ];
+            snprintf( name, sizeof( name ), "/p%d-t%d-%llu", static_cast< int >( getpid() ), id_,
+                      static_cast< unsigned long long >( _file.name ) );
+            return dir_of( _file.dir ) + name;
+        }
+
+        // =-=-=-=-=-=-=-
+        // time one call, false when it failed
+        template< typename F >
+        bool timed(
+            call _call,
+            F    _f ) {
+            // =-=-=-=-=-=-=-
+            // injected latency counts, as it would in the plugin
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            int errsav = 0;
+#ifdef SHAREUF_FAULT_INJECTION
+            shareuf_fault_io io;
+            errsav = -shareuf_faults::instance().inject( call_names[ _call ], 0, io );
+#endif
+            bool ok = 0 == errsav && _f();
+            if ( 0 == errsav ) {
+                errsav = errno;
+            }
+            uint64_t ns = std::chrono::duration_cast< std::chrono::nanoseconds >( std::chrono::steady_clock::now() - start ).count();
+            ++results_.calls[ _call ];
+            ++results_.histogram[ _call ][ bucket_of( ns ) ];
+            if ( !ok ) {
+                ++results_.errors[ _call ];
+            }
+            errno = errsav;
+            return ok;
+        }
+
+        void check_file(
+            const file_record& _file,
+            const struct stat& _sb ) {
+            if ( ( _sb.st_mode & 07777 ) != FILE_MODE ) {
+                ++results_.issues[ ISSUE_WRONG_MODE ];
+            }
+            if ( _sb.st_size != _file.size ) {
+                ++results_.issues[ ISSUE_SIZE_MISMATCH ];
+            }
+        }
+
+        void create() {
+            file_record file;
+            file.dir  = std::uniform_int_distribution< int >( 0, opts_.directories - 1 )( random_ );
+            file.name = next_name_++;
+            file.size = draw( opts_.sizes );
+            file.seed = random_();
+            std::string path = path_of( file );
+
+            // =-=-=-=-=-=-=-
+            // as shareuf_file_create: free space, then the open and an
+            // fchmod so the mode is exactly 0644 whatever the umask
+            int fd = -1;
+            if ( !timed( CALL_CREATE, [&] {
+                    struct statfs fs;
+                    if ( statfs( dir_of( file.dir ).c_str(), &fs ) < 0 ) {
+                        return false;
+                    }
+                    fd = open( path.c_str(), O_RDWR | O_CREAT | O_EXCL, FILE_MODE );
+                    if ( fd >= 0 ) {
+                        fchmod( fd, FILE_MODE );
+                    }
+                    return fd >= 0;
+                } ) ) {
+                return;
+            }
+
+            struct stat sb;
+            if ( fstat( fd, &sb ) == 0 && ( sb.st_mode & 07777 ) != FILE_MODE ) {
+                ++results_.issues[ ISSUE_WRONG_MODE ];
+            }
+
+            bool ok = true;
+            for ( off_t offset = 0; ok && offset < file.size; ) {
+                size_t len = static_cast< size_t >( std::min< off_t >( IO_SIZE, file.size - offset ) );
+                fill_pattern( &buf_[ 0 ], len, offset, file.seed );
+                ok = timed( CALL_WRITE, [&] {
+                    return write( fd, &buf_[ 0 ], len ) == static_cast< ssize_t >( len );
+                } );
+                offset += len;
+            }
+            ok = timed( CALL_CLOSE, [&] { return close( fd ) == 0; } ) && ok;
+            if ( !ok ) {
+                ::unlink( path.c_str() );
+                return;
+            }
+            results_.bytes += file.size;
+            files_.push_back( file );
+        }
+
+        void read() {
+            const file_record& file = files_[ pick() ];
+            std::string path = path_of( file );
+            int fd = -1;
+            if ( !timed( CALL_OPEN, [&] { return ( fd = open( path.c_str(), O_RDONLY ) ) >= 0; } ) ) {
+                if ( ENOENT == errno ) {
+                    ++results_.issues[ ISSUE_LOST_FILE ];
+                }
+                return;
+            }
+
+            off_t offset = 0;
+            bool  good   = true;
+            while ( true ) {
+                ssize_t n = -1;
+                if ( !timed( CALL_READ, [&] { return ( n = ::read( fd, &buf_[ 0 ], IO_SIZE ) ) >= 0; } ) || 0 == n ) {
+                    break;
+                }
+                fill_pattern( &check_[ 0 ], n, offset, file.seed );
+                if ( good && memcmp( &buf_[ 0 ], &check_[ 0 ], n ) != 0 ) {
+                    ++results_.issues[ ISSUE_CONTENT_MISMATCH ];
+                    good = false;
+                }
+                offset += n;
+            }
+            timed( CALL_CLOSE, [&] { return close( fd ) == 0; } );
+            if ( offset != file.size ) {
+                ++results_.issues[ ISSUE_SIZE_MISMATCH ];
+            }
+            results_.bytes += offset;
+        }
+
+        void stat() {
+            const file_record& file = files_[ pick() ];
+            std::string path = path_of( file );
+            struct stat sb;
+            if ( timed( CALL_STAT, [&] { return ::stat( path.c_str(), &sb ) == 0; } ) ) {
+                check_file( file, sb );
+            }
+            else if ( ENOENT == errno ) {
+                ++results_.issues[ ISSUE_LOST_FILE ];
+            }
+        }
+
+        void rename() {
+            file_record& file = files_[ pick() ];
+            file_record  moved( file );
+            moved.dir  = std::uniform_int_distribution< int >( 0, opts_.directories - 1 )( random_ );
+            moved.name = next_name_++;
+            std::string from = path_of( file );
+            std::string to   = path_of( moved );
+            if ( !timed( CALL_RENAME, [&] { return ::rename( from.c_str(), to.c_str() ) == 0; } ) ) {
+                if ( ENOENT == errno ) {
+                    ++results_.issues[ ISSUE_LOST_FILE ];
+                }
+                return;
+            }
+            struct stat sb;
+            if ( ::stat( from.c_str(), &sb ) == 0 ) {
+                ++results_.issues[ ISSUE_STALE_FILE ];
+            }
+            file = moved;
+        }
+
+        void unlink() {
+            size_t      i    = pick();
+            std::string path = path_of( files_[ i ] );
+            bool ok = timed( CALL_UNLINK, [&] { return ::unlink( path.c_str() ) == 0; } );
+            if ( !ok && ENOENT == errno ) {
+                ++results_.issues[ ISSUE_LOST_FILE ];
+            }
+            struct stat sb;
+            if ( ok && ::stat( path.c_str(), &sb ) == 0 ) {
+                ++results_.issues[ ISSUE_STALE_FILE ];
+            }
+            if ( ok || ENOENT == errno ) {
+                files_[ i ] = files_.back();
+                files_.pop_back();
+            }
+        }
+
+        // =-=-=-=-=-=-=-
+        // list a shared directory, every file of this thread in it must be
+        // listed
+        void readdir() {
+            int                     dir = std::uniform_int_distribution< int >( 0, opts_.directories - 1 )( random_ );
+            std::string             path = dir_of( dir );
+            std::set< std::string > names;
+            bool ok = timed( CALL_READDIR, [&] {
+                DIR* d = opendir( path.c_str() );
+                if ( !d ) {
+                    return false;
+                }
+                while ( struct dirent* entry = ::readdir( d ) ) {
+                    names.insert( entry->d_name );
+                }
+                closedir( d );
+                return true;
+            } );
+            if ( !ok ) {
+                return;
+            }
+            for ( size_t i = 0; i < files_.size(); ++i ) {
+                if ( files_[ i ].dir != dir ) {
+                    continue;
+                }
+                std::string full = path_of( files_[ i ] );
+                if ( !names.count( full.substr( full.find_last_of( '/' ) + 1 ) ) ) {
+                    ++results_.issues[ ISSUE_LOST_FILE ];
+                }
+            }
+        }
+
+        const options&              opts_;
+        std::string                 root_;
+        int                         id_;
+        results&                    results_;
+        std::mt19937_64             random_;
+        uint64_t                    next_name_;
+        std::vector< file_record >  files_;
+        std::vector< char >         buf_;
+        std::vector< char >         check_;
+};
+
+// =-=-=-=-=-=-=-
+// one process of a step: _threads workers, then the process-wide checks
+static void run_process(
+    const options&     _opts,
+    const std::string& _root,
+    int                _threads,
+    results&           _out ) {
+    std::vector< results* >    per_thread;
+    std::vector< std::thread > threads;
+    std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::seconds( _opts.seconds );
+    for ( int t = 0; t < _threads; ++t ) {
+        per_thread.push_back( static_cast< results* >( calloc( 1, sizeof( results ) ) ) );
+    }
+    for ( int t = 0; t < _threads; ++t ) {
+        threads.push_back( std::thread( [&_opts, &_root, t, &per_thread, deadline] {
+            worker w( _opts, _root, t, *per_thread[ t ] );
+            w.run( deadline );
+            w.verify_and_clean();
+        } ) );
+    }
+    for ( int t = 0; t < _threads; ++t ) {
+        threads[ t ].join();
+        _out.add( *per_thread[ t ] );
+        free( per_thread[ t ] );
+    }
+
+    // =-=-=-=-=-=-=-
+    // nothing the threads run may change the process umask
+    mode_t mask = umask( _opts.mask );
+    if ( mask != _opts.mask ) {
+        ++_out.issues[ ISSUE_UMASK_CHANGED ];
+    }
+}
+
+static bool read_all(
+    int    _fd,
+    void*  _buf,
+    size_t _len ) {
+    for ( size_t got = 0; got < _len; ) {
+        ssize_t n = read( _fd, static_cast< char* >( _buf ) + got, _len - got );
+        if ( n <= 0 ) {
+            if ( n < 0 && EINTR == errno ) {
+                continue;
+            }
+            return false;
+        }
+        got += n;
+    }
+    return true;
+}
+
+static bool write_all(
+    int         _fd,
+    const void* _buf,
+    size_t      _len ) {
+    for ( size_t done = 0; done < _len; ) {
+        ssize_t n = write( _fd, static_cast< const char* >( _buf ) + done, _len - done );
+        if ( n < 0 ) {
+            if ( EINTR == errno ) {
+                continue;
+            }
+            return false;
+        }
+        done += n;
+    }
+    return true;
+}
+
+// =-=-=-=-=-=-=-
+// fork the processes of a step and gather what they did
+static bool run_step(
+    const options&     _opts,
+    const std::string& _root,
+    int                _threads,
+    results&           _out ) {
+    std::vector< pid_t > children;
+    std::vector< int >   pipes;
+    for ( int p = 0; p < _opts.processes; ++p ) {
+        int fds[ 2 ];
+        if ( pipe( fds ) < 0 ) {
+            perror( "pipe" );
+            return false;
+        }
+        pid_t pid = fork();
+        if ( pid < 0 ) {
+            perror( "fork" );
+            return false;
+        }
+        if ( 0 == pid ) {
+            close( fds[ 0 ] );
+            results* mine = static_cast< results* >( calloc( 1, sizeof( results ) ) );
+            run_process( _opts, _root, _threads, *mine );
+            _exit( write_all( fds[ 1 ], mine, sizeof( results ) ) ? 0 : 1 );
+        }
+        close( fds[ 1 ] );
+        children.push_back( pid );
+        pipes.push_back( fds[ 0 ] );
+    }
+
+    bool ok = true;
+    results* theirs = static_cast< results* >( calloc( 1, sizeof( results ) ) );
+    for ( size_t p = 0; p < children.size(); ++p ) {
+        if ( read_all( pipes[ p ], theirs, sizeof( results ) ) ) {
+            _out.add( *theirs );
+        }
+        else {
+            ok = false;
+        }
+        close( pipes[ p ] );
+        int status = 0;
+        waitpid( children[ p ], &status, 0 );
+        ok = ok && WIFEXITED( status ) && 0 == WEXITSTATUS( status );
+    }
+    free( theirs );
+    return ok;
+}
+
+static void report(
+    int            _processes,
+    int            _threads,
+    double         _seconds,
+    const results& _results ) {
+    printf( "%d x %d threads: %.0f ops/s, %.1f MiB/s\n", _processes, _threads,
+            _results.operations / _seconds, _results.bytes / _seconds / ( 1024 * 1024 ) );
+    printf( "  %-8s %10s %8s %10s %10s %10s\n", "call", "count", "errors", "p50 us", "p99 us", "p999 us" );
+    for ( int c = 0; c < CALL_COUNT; ++c ) {
+        if ( 0 == _results.calls[ c ] ) {
+            continue;
+        }
+        printf( "  %-8s %10llu %8llu %10.1f %10.1f %10.1f\n", call_names[ c ],
+                static_cast< unsigned long long >( _results.calls[ c ] ),
+                static_cast< unsigned long long >( _results.errors[ c ] ),
+                _results.percentile( c, 0.5 ) / 1000, _results.percentile( c, 0.99 ) / 1000,
+                _results.percentile( c, 0.999 ) / 1000 );
+    }
+    for ( int i = 0; i < ISSUE_COUNT; ++i ) {
+        if ( _results.issues[ i ] > 0 ) {
+            printf( "  FAILED: %llu %s\n", static_cast< unsigned long long >( _results.issues[ i ] ), issue_names[ i ] );
+        }
+    }
+}
+
+static bool lookup_operation(
+    const std::string& _name,
+    int&               _out ) {
+    for ( int op = 0; op < OP_COUNT; ++op ) {
+        if ( _name == operation_names[ op ] ) {
+            _out = op;
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool lookup_size(
+    const std::string& _name,
+    off_t&             _out ) {
+    char* end = 0;
+    _out = strtoll( _name.c_str(), &end, 10 );
+    return !_name.empty() && !*end && _out >= 0;
+}
+
+int main( int _argc, char** _argv ) {
+    options opts;
+    opts.processes   = 1;
+    opts.seconds     = 10;
+    opts.max_files   = 1000;
+    opts.directories = 16;
+    opts.mask        = 077;
+    const char* threads = "1,2,4,8";
+    const char* mix     = "create:20,read:30,stat:25,rename:10,unlink:10,readdir:5";
+    const char* sizes   = "4096:70,1048576:25,16777216:5";
+
+    bool usage = false;
+    int  c;
+    while ( ( c = getopt( _argc, _argv, "t:p:s:f:d:m:z:u:" ) ) != -1 ) {
+        switch ( c ) {
+            case 't': threads           = optarg; break;
+            case 'p': opts.processes    = atoi( optarg ); break;
+            case 's': opts.seconds      = atoi( optarg ); break;
+            case 'f': opts.max_files    = strtoul( optarg, 0, 10 ); break;
+            case 'd': opts.directories  = atoi( optarg ); break;
+            case 'm': mix               = optarg; break;
+            case 'z': sizes             = optarg; break;
+            case 'u': opts.mask         = strtoul( optarg, 0, 8 ) & 0777; break;
+            default:  usage             = true; break;
+        }
+    }
+    if ( usage || optind != _argc - 1 || !parse_ints( threads, opts.threads ) || opts.processes <= 0 || opts.seconds <= 0 ||
+            opts.max_files < 2 || opts.directories <= 0 || !parse_weights( mix, lookup_operation, opts.mix ) ||
+            !parse_weights( sizes, lookup_size, opts.sizes ) ) {
+        fprintf( stderr, "usage: %s [-t threads,...] [-p processes] [-s seconds] [-f files per thread] [-d directories]\n"
+                         "       [-m op:weight,...] [-z size:weight,...] [-u umask] <vault directory>\n", _argv[ 0 ] );
+        return 1;
+    }
+    std::string vault = _argv[ optind ];
+
+#ifdef SHAREUF_FAULT_INJECTION
+    const char* faults = getenv( "SHAREUF_FAULTS" );
+    if ( faults && shareuf_faults::instance().configure( faults ) < 0 ) {
+        fprintf( stderr, "invalid SHAREUF_FAULTS [%s]\n", faults );
+        return 1;
+    }
+#endif
+
+    umask( opts.mask );
+    bool failed = false;
+    for ( size_t s = 0; s < opts.threads.size(); ++s ) {
+        char name[ 32 ];
+        snprintf( name, sizeof( name ), "/stress-%dx%d", opts.processes, opts.threads[ s ] );
+        std::string root = vault + name;
+        if ( mkdir( root.c_str(), 0755 ) < 0 && EEXIST != errno ) {
+            perror( root.c_str() );
+            return 1;
+        }
+        for ( int d = 0; d < opts.directories; ++d ) {
+            char dir[ 32 ];
+            snprintf( dir, sizeof( dir ), "/d%03d", d );
+            if ( mkdir( ( root + dir ).c_str(), 0755 ) < 0 && EEXIST != errno ) {
+                perror( ( root + dir ).c_str() );
+                return 1;
+            }
+        }
+
+        results* step = static_cast< results* >( calloc( 1, sizeof( results ) ) );
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        if ( !run_step( opts, root, opts.threads[ s ], *step ) ) {
+            fprintf( stderr, "a process of the %d thread step failed\n", opts.threads[ s ] );
+            failed = true;
+        }
+        double elapsed = std::chrono::duration< double >( std::chrono::steady_clock::now() - start ).count();
+        report( opts.processes, opts.threads[ s ], std::min< double >( elapsed, opts.seconds ), *step );
+        for ( int i = 0; i < ISSUE_COUNT; ++i ) {
+            failed = failed || step->issues[ i ] > 0;
+        }
+        free( step );
+    }
+
+    return failed ? 1 : 0;
+}